@@ -0,0 +1,759 @@
+// bench.c
+// 客户机微基准：手工编码的 RV64 程序直接在模拟器核心上跑，不需要内核和工具链。
+//
+//   rv-bench [-s scale] [-o out.json] [-c baseline.json] [name...]
+//
+// 每个基准以 ebreak 结束，报告退休指令数、主机耗时、MIPS 和各自的吞吐指标，
+// 结果写成 JSON（每个基准一行，方便 diff 和脚本处理）。-c 给出之前的结果时打印前后对比。
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "cpu.h"
+#include "bus.h"
+#include "memory.h"
+#include "uart.h"
+#include "plic.h"
+#include "virtio_blk.h"
+#include "virtio_net.h"
+#include "trap.h"
+#include "stats.h"
+#include "rvasm.h"
+
+#ifndef RVEMU_BUILD_TYPE
+#define RVEMU_BUILD_TYPE "unknown"
+#endif
+
+extern VM_LOCAL uint8_t *memory;
+extern VM_LOCAL Bus bus;
+extern VM_LOCAL CPU_State cpu[MAX_CORES];
+extern VM_LOCAL virtio_blk_device dev;
+
+// 客户机物理内存布局
+#define CODE_ADDR       (MEMORY_BASE)
+#define CODE2_ADDR      (MEMORY_BASE + 0x10000)     // trap 处理函数 / S 模式代码
+#define PT_ADDR         (MEMORY_BASE + 0x100000)    // 页表
+#define VQ_ADDR         (MEMORY_BASE + 0x200000)    // virtqueue
+#define DATA_ADDR       (MEMORY_BASE + 0x1000000)
+#define DATA2_ADDR      (MEMORY_BASE + 0x2000000)
+
+#define TLB_VA_BASE     0x40000000ULL
+
+static UARTDevice *uart;
+static int scale = 1;
+static char disk_path[64];
+
+static inline uint8_t *host(uint64_t pa) { return memory + (pa - MEMORY_BASE); }
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+    const char *name;
+    uint64_t insts;
+    double secs;
+    bool ok;
+    const char *metric;     // 主要吞吐指标名，没有时为 NULL
+    double value;
+    const char *metric2;    // 第二个指标（可选）
+    double value2;
+} BenchResult;
+
+// 从 entry 开始跑到 ebreak（或超过 limit 条指令）
+static void run_guest(uint64_t entry, uint64_t limit, BenchResult *r) {
+    cpu[0].bus = bus;
+    cpu_init(&cpu[0], 0);
+    cpu[0].pc = entry;
+
+    double t0 = now_sec();
+    while (cpu[0].running && !cpu[0].halted && cpu[0].inst_count < limit) {
+        cpu_step(&cpu[0], memory);
+        virtio_disk_update(&cpu[0].cycle_count);
+        check_and_handle_interrupts(&cpu[0]);
+    }
+    r->secs = now_sec() - t0;
+    r->insts = cpu[0].inst_count;
+    r->ok = cpu[0].halted;
+    if (!r->ok)
+        fprintf(stderr, "[bench] %s: stopped at pc 0x%lx after %lu instructions without reaching ebreak\n",
+                r->name, cpu[0].pc, r->insts);
+}
+
+/* ---------- benchmarks ---------- */
+
+// 整数 ALU 循环：每次迭代 9 条
+static void bench_int_loop(BenchResult *r) {
+    uint64_t iters = 2000000ull * scale;
+    Asm a;
+    asm_init(&a, host(CODE_ADDR), CODE_ADDR);
+    LI(&a, A0, iters);
+    LI(&a, A1, 1);
+    LI(&a, A2, 0x12345);
+    uint64_t loop = asm_label(&a);
+    ADD(&a, A2, A2, A1);
+    XOR(&a, A3, A2, A0);
+    SLLI(&a, A4, A3, 3);
+    SRLI(&a, A5, A4, 7);
+    AND(&a, A3, A3, A5);
+    MUL(&a, A6, A5, A1);
+    ADDI(&a, A1, A1, 3);
+    ADDI(&a, A0, A0, -1);
+    BNE(&a, A0, ZERO, loop);
+    EBREAK(&a);
+
+    run_guest(CODE_ADDR, iters * 9 + 1000, r);
+}
+
+// 1 MiB 块拷贝，ld/sd 各四条展开
+static void bench_memcpy(BenchResult *r) {
+    const uint64_t size = 1 << 20;
+    uint64_t reps = 8ull * scale;
+    for (uint64_t i = 0; i < size; i++) host(DATA_ADDR)[i] = (uint8_t)(i * 131 + 7);
+    memset(host(DATA2_ADDR), 0, size);
+
+    Asm a;
+    asm_init(&a, host(CODE_ADDR), CODE_ADDR);
+    LI(&a, S0, reps);
+    uint64_t outer = asm_label(&a);
+    LI(&a, A0, DATA_ADDR);
+    LI(&a, A1, DATA2_ADDR);
+    LI(&a, A2, DATA_ADDR + size);
+    uint64_t inner = asm_label(&a);
+    LD(&a, T0, A0, 0);
+    LD(&a, T1, A0, 8);
+    LD(&a, T2, A0, 16);
+    LD(&a, T3, A0, 24);
+    SD(&a, T0, A1, 0);
+    SD(&a, T1, A1, 8);
+    SD(&a, T2, A1, 16);
+    SD(&a, T3, A1, 24);
+    ADDI(&a, A0, A0, 32);
+    ADDI(&a, A1, A1, 32);
+    BLTU(&a, A0, A2, inner);
+    ADDI(&a, S0, S0, -1);
+    BNE(&a, S0, ZERO, outer);
+    EBREAK(&a);
+
+    run_guest(CODE_ADDR, reps * (size / 32 * 11 + 100) + 1000, r);
+    if (r->ok && memcmp(host(DATA_ADDR), host(DATA2_ADDR), size) != 0) {
+        fprintf(stderr, "[bench] memcpy: destination does not match source\n");
+        r->ok = false;
+    }
+    r->metric = "mb_per_s";
+    r->value = reps * size / r->secs / 1e6;
+}
+
+// 随机排列成环的链表，每个节点 64 字节，共 4 MiB
+static void bench_pointer_chase(BenchResult *r) {
+    const uint32_t nodes = 1 << 16;
+    uint64_t steps = 2000000ull * scale;
+    uint32_t *perm = malloc(nodes * sizeof(uint32_t));
+    for (uint32_t i = 0; i < nodes; i++) perm[i] = i;
+    srand(12345);
+    for (uint32_t i = nodes - 1; i > 0; i--) {
+        uint32_t k = rand() % (i + 1), t = perm[i];
+        perm[i] = perm[k];
+        perm[k] = t;
+    }
+    for (uint32_t i = 0; i < nodes; i++) {
+        uint64_t next = DATA_ADDR + (uint64_t)perm[(i + 1) % nodes] * 64;
+        memcpy(host(DATA_ADDR + (uint64_t)perm[i] * 64), &next, 8);
+    }
+    uint64_t head = DATA_ADDR + (uint64_t)perm[0] * 64;
+    uint64_t expect = DATA_ADDR + (uint64_t)perm[steps % nodes] * 64;
+    free(perm);
+
+    Asm a;
+    asm_init(&a, host(CODE_ADDR), CODE_ADDR);
+    LI(&a, A0, head);
+    LI(&a, A1, steps);
+    uint64_t loop = asm_label(&a);
+    LD(&a, A0, A0, 0);
+    ADDI(&a, A1, A1, -1);
+    BNE(&a, A1, ZERO, loop);
+    EBREAK(&a);
+
+    run_guest(CODE_ADDR, steps * 3 + 1000, r);
+    if (r->ok && cpu[0].gpr[A0] != expect) {
+        fprintf(stderr, "[bench] pointer_chase: ended at 0x%lx, expected 0x%lx\n", cpu[0].gpr[A0], expect);
+        r->ok = false;
+    }
+    r->metric = "ns_per_load";
+    r->value = r->secs * 1e9 / steps;
+}
+
+// M 模式 ecall -> mtvec 处理函数 -> mepc += 4 -> mret
+static void bench_trap(BenchResult *r) {
+    uint64_t n = 200000ull * scale;
+    Asm h;
+    asm_init(&h, host(CODE2_ADDR), CODE2_ADDR);
+    CSRR(&h, T0, CSR_MEPC);
+    ADDI(&h, T0, T0, 4);
+    CSRW(&h, CSR_MEPC, T0);
+    MRET(&h);
+
+    Asm a;
+    asm_init(&a, host(CODE_ADDR), CODE_ADDR);
+    LI(&a, T0, CODE2_ADDR);
+    CSRW(&a, CSR_MTVEC, T0);
+    LI(&a, A0, n);
+    uint64_t loop = asm_label(&a);
+    ECALL(&a);
+    ADDI(&a, A0, A0, -1);
+    BNE(&a, A0, ZERO, loop);
+    EBREAK(&a);
+
+    uint64_t before = emu_stats.exceptions[EXC_ECALL_M];
+    run_guest(CODE_ADDR, n * 7 + 1000, r);
+    uint64_t traps = emu_stats.exceptions[EXC_ECALL_M] - before;
+    if (r->ok && traps != n) {
+        fprintf(stderr, "[bench] trap_roundtrip: %lu traps taken, expected %lu\n", traps, n);
+        r->ok = false;
+    }
+    r->metric = "traps_per_s";
+    r->value = traps / r->secs;
+}
+
+// sv39 下在 S 模式轮流访问 1024 个 4 KiB 页，远超 TLB 容量，几乎每次访问都要页表遍历
+static void bench_tlb_thrash(BenchResult *r) {
+    const uint64_t pages = 1024;
+    uint64_t reps = 200ull * scale;
+    const uint64_t V = 1, R = 2, W = 4, X = 8, A = 64, D = 128;
+
+    // sv39_translate 只支持 4 KiB 叶子页，代码区也按 4 KiB 恒等映射（前 2 MiB）
+    const uint64_t root_pa = PT_ADDR, l1_code_pa = PT_ADDR + 0x1000, l0_code_pa = PT_ADDR + 0x2000;
+    const uint64_t l1_data_pa = PT_ADDR + 0x3000, l0_data_pa = PT_ADDR + 0x4000;
+    uint64_t *root = (uint64_t *)host(root_pa);
+    uint64_t *l1_code = (uint64_t *)host(l1_code_pa), *l0_code = (uint64_t *)host(l0_code_pa);
+    uint64_t *l1_data = (uint64_t *)host(l1_data_pa);
+    memset(root, 0, l0_data_pa - root_pa + pages * 8);
+
+    root[(MEMORY_BASE >> 30) & 0x1ff] = (l1_code_pa >> 12) << 10 | V;
+    l1_code[(MEMORY_BASE >> 21) & 0x1ff] = (l0_code_pa >> 12) << 10 | V;
+    for (uint64_t i = 0; i < 512; i++)
+        l0_code[i] = ((MEMORY_BASE + i * 0x1000) >> 12) << 10 | R | W | X | A | D | V;
+
+    root[(TLB_VA_BASE >> 30) & 0x1ff] = (l1_data_pa >> 12) << 10 | V;
+    for (uint64_t t = 0; t < pages / 512; t++) {
+        uint64_t *l0 = (uint64_t *)host(l0_data_pa + t * 0x1000);
+        l1_data[t] = ((l0_data_pa + t * 0x1000) >> 12) << 10 | V;
+        for (uint64_t i = 0; i < 512; i++)
+            l0[i] = ((DATA_ADDR + (t * 512 + i) * 0x1000) >> 12) << 10 | R | W | A | D | V;
+    }
+
+    Asm s;
+    asm_init(&s, host(CODE2_ADDR), CODE2_ADDR);
+    LI(&s, S0, reps);
+    LI(&s, A2, TLB_VA_BASE + pages * 0x1000);
+    uint64_t outer = asm_label(&s);
+    LI(&s, A0, TLB_VA_BASE);
+    uint64_t inner = asm_label(&s);
+    LD(&s, T0, A0, 0);
+    LI(&s, T1, 0x1000);
+    ADD(&s, A0, A0, T1);
+    BLTU(&s, A0, A2, inner);
+    ADDI(&s, S0, S0, -1);
+    BNE(&s, S0, ZERO, outer);
+    EBREAK(&s);
+
+    // M 模式打开 sv39，经 mret 进入 S 模式
+    Asm a;
+    asm_init(&a, host(CODE_ADDR), CODE_ADDR);
+    LI(&a, T0, (8ull << 60) | (root_pa >> 12));
+    CSRW(&a, CSR_SATP, T0);
+    SFENCE_VMA(&a);
+    LI(&a, T0, 1 << 11);        // MPP = S
+    CSRW(&a, CSR_MSTATUS, T0);
+    LI(&a, T0, CODE2_ADDR);
+    CSRW(&a, CSR_MEPC, T0);
+    MRET(&a);
+
+    uint64_t walks = emu_stats.page_walks;
+    run_guest(CODE_ADDR, reps * (pages * 5 + 10) + 1000, r);
+    walks = emu_stats.page_walks - walks;
+    if (r->ok && cpu[0].privilege != 1) {
+        fprintf(stderr, "[bench] tlb_thrash: finished in privilege %d, expected S\n", cpu[0].privilege);
+        r->ok = false;
+    }
+    r->metric = "page_walks_per_s";
+    r->value = walks / r->secs;
+}
+
+// 经 virtio-blk 反复读同一段 64 KiB：客户机自己配置队列、提交请求、轮询 used ring
+static void bench_disk(BenchResult *r) {
+    const uint32_t len = 64 * 1024;
+    uint64_t reqs = 200ull * scale;
+    const uint64_t desc = VQ_ADDR, avail = VQ_ADDR + 0x1000, used = VQ_ADDR + 0x2000;
+    const uint64_t hdr = VQ_ADDR + 0x3000, status = VQ_ADDR + 0x3100;
+
+    // 请求头（读 0 号扇区）和三段描述符链由宿主侧预先写好，avail 环每一项都指向 0 号描述符
+    memset(host(VQ_ADDR), 0, 0x4000);
+    uint32_t type = VIRTIO_BLK_T_IN;
+    memcpy(host(hdr), &type, 4);
+    struct { uint64_t addr; uint32_t len; uint16_t flags, next; } d[3] = {
+        { hdr,       16,  VRING_DESC_F_NEXT, 1 },
+        { DATA_ADDR, len, VRING_DESC_F_NEXT | VRING_DESC_F_WRITE, 2 },
+        { status,    1,   VRING_DESC_F_WRITE, 0 },
+    };
+    memcpy(host(desc), d, sizeof(d));
+
+    Asm a;
+    asm_init(&a, host(CODE_ADDR), CODE_ADDR);
+    LI(&a, S3, VIRTIO_MMIO_BASE);
+    LI(&a, T0, 8);
+    SW(&a, T0, S3, 0x038);              // QueueNum
+    LI(&a, T0, desc);
+    SW(&a, T0, S3, 0x080);              // QueueDescLow
+    SW(&a, ZERO, S3, 0x084);
+    LI(&a, T0, avail);
+    SW(&a, T0, S3, 0x090);              // QueueDriverLow
+    SW(&a, ZERO, S3, 0x094);
+    LI(&a, T0, used);
+    SW(&a, T0, S3, 0x0a0);              // QueueDeviceLow
+    SW(&a, ZERO, S3, 0x0a4);
+    LI(&a, T0, 1);
+    SW(&a, T0, S3, 0x044);              // QueueReady
+    LI(&a, T0, 0xf);
+    SW(&a, T0, S3, 0x070);              // Status = DRIVER_OK
+    LI(&a, S0, reqs);
+    LI(&a, S1, avail);
+    LI(&a, S2, used);
+    LI(&a, T2, 0);
+    uint64_t loop = asm_label(&a);
+    ADDI(&a, T2, T2, 1);
+    SH(&a, T2, S1, 2);                  // avail->idx
+    SW(&a, ZERO, S3, 0x050);            // QueueNotify
+    uint64_t wait = asm_label(&a);
+    LHU(&a, T0, S2, 2);                 // used->idx
+    BNE(&a, T0, T2, wait);
+    ADDI(&a, S0, S0, -1);
+    BNE(&a, S0, ZERO, loop);
+    EBREAK(&a);
+
+    uint64_t before = dev.bytes_in;
+    run_guest(CODE_ADDR, reqs * (DISK_LATENCY_CYCLES * 3 + 100) + 1000, r);
+    uint64_t bytes = dev.bytes_in - before;
+    if (r->ok && (bytes != reqs * len || *host(status) != VIRTIO_BLK_S_OK)) {
+        fprintf(stderr, "[bench] virtio_blk_read: %lu bytes read, expected %lu\n", bytes, reqs * len);
+        r->ok = false;
+    }
+    r->metric = "mb_per_s";
+    r->value = bytes / r->secs / 1e6;
+}
+
+// 轮询 LSR.THRE 后写 THR，后端为 null
+static void bench_uart(BenchResult *r) {
+    uint64_t n = 200000ull * scale;
+    Asm a;
+    asm_init(&a, host(CODE_ADDR), CODE_ADDR);
+    LI(&a, S0, n);
+    LI(&a, S1, UART_BASE);
+    LI(&a, T1, 'x');
+    uint64_t loop = asm_label(&a);
+    uint64_t wait = asm_label(&a);
+    LBU(&a, T0, S1, 5);
+    ANDI(&a, T0, T0, 0x20);
+    BEQ(&a, T0, ZERO, wait);
+    SB(&a, T1, S1, 0);
+    ADDI(&a, S0, S0, -1);
+    BNE(&a, S0, ZERO, loop);
+    EBREAK(&a);
+
+    uint64_t before = uart->tx_bytes;
+    run_guest(CODE_ADDR, n * 1000 + 1000, r);
+    // TX 线程异步写后端，等它把 FIFO 里剩下的写完
+    uint64_t bytes = 0;
+    for (int i = 0; i < 200 && bytes < n; i++) {
+        bytes = __atomic_load_n(&uart->tx_bytes, __ATOMIC_RELAXED) - before;
+        if (bytes < n) usleep(10000);
+    }
+    if (r->ok && bytes != n) {
+        fprintf(stderr, "[bench] uart_tx: %lu bytes sent, expected %lu\n", bytes, n);
+        r->ok = false;
+    }
+    r->metric = "mb_per_s";
+    r->value = n / r->secs / 1e6;
+}
+
+// 两个模拟器实例经 UNIX SEQPACKET socket 相连：fork 出的子进程是发送端（connect:），本进程是接收端（listen:）。
+// 发送端每次发一个窗口（32 个 1514 字节的帧，一次 notify），等接收端回一个 ack 帧再发下一个窗口，
+// 窗口小于 socket 缓冲区和 rxq，整个过程不丢帧。报告接收端交付给客户机的包速率和带宽，计时从收到第一个帧开始。
+#define NET_FRAME       1514
+#define NET_ACK_FRAME   60
+#define NET_WINDOW      32
+#define NET_BUF_SIZE    2048
+
+// 两个队列的环：接收 VQ_ADDR 起，发送 VQ_ADDR + 0x4000 起；缓冲区分别在 DATA_ADDR / DATA2_ADDR
+#define NET_RX_RING     (VQ_ADDR)
+#define NET_TX_RING     (VQ_ADDR + 0x4000)
+#define RING_DESC(r)    (r)
+#define RING_AVAIL(r)   ((r) + 0x1000)
+#define RING_USED(r)    ((r) + 0x2000)
+
+static uint64_t net_rd(void *o, uint64_t off, unsigned sz) { return virtio_net_mmio_read(o, off, sz); }
+static void net_wr(void *o, uint64_t off, uint64_t v, unsigned sz) { virtio_net_mmio_write(o, off, v, sz); }
+
+// 每个描述符指向自己的 2 KiB 缓冲区，avail 环第 i 项固定是 i 号描述符；
+// 设备按顺序用缓冲区，驱动只要把 avail->idx 往前推就是原样归还
+static void net_ring_init(uint64_t ring, uint64_t bufs, uint32_t len, uint16_t flags) {
+    memset(host(ring), 0, 0x3000);
+    for (int i = 0; i < VIRTIO_NET_QUEUE_MAX; i++) {
+        struct { uint64_t addr; uint32_t len; uint16_t flags, next; } d = {
+            bufs + (uint64_t)i * NET_BUF_SIZE, len, flags, 0
+        };
+        memcpy(host(RING_DESC(ring) + 16 * i), &d, sizeof(d));
+        uint16_t id = i;
+        memcpy(host(RING_AVAIL(ring) + 4 + 2 * i), &id, 2);
+    }
+    if (flags & VRING_DESC_F_WRITE) {
+        uint16_t idx = VIRTIO_NET_QUEUE_MAX;        // 接收缓冲区一开始全部可用
+        memcpy(host(RING_AVAIL(ring) + 2), &idx, 2);
+    }
+}
+
+// 发送缓冲区：virtio_net_hdr 全 0，后面是广播帧
+static void net_frames_init(uint64_t bufs, uint32_t frame) {
+    for (int i = 0; i < VIRTIO_NET_QUEUE_MAX; i++) {
+        uint8_t *p = host(bufs + (uint64_t)i * NET_BUF_SIZE);
+        memset(p, 0, sizeof(virtio_net_hdr));
+        uint8_t *f = p + sizeof(virtio_net_hdr);
+        memset(f, 0xff, 6);
+        memcpy(f + 6, netdev.mac, 6);
+        f[12] = 0x88; f[13] = 0xb5;                 // 实验用 EtherType
+        for (uint32_t k = 14; k < frame; k++) f[k] = (uint8_t)(i + k);
+    }
+}
+
+// 协商 VERSION_1（12 字节头），两个队列都配成 VIRTIO_NET_QUEUE_MAX 深；S3 = MMIO 基址
+static void net_driver_init(Asm *a) {
+    LI(a, S3, VIRTIO_NET_BASE);
+    LI(a, T0, 3);
+    SW(a, T0, S3, 0x070);               // Status = ACKNOWLEDGE | DRIVER
+    LI(a, T0, 1);
+    SW(a, T0, S3, 0x024);               // DriverFeaturesSel = 1
+    SW(a, T0, S3, 0x020);               // VIRTIO_F_VERSION_1
+    for (int q = 0; q < VIRTIO_NET_NUM_QUEUES; q++) {
+        uint64_t ring = q == VIRTIO_NET_RX_QUEUE ? NET_RX_RING : NET_TX_RING;
+        LI(a, T0, q);
+        SW(a, T0, S3, 0x030);           // QueueSel
+        LI(a, T0, VIRTIO_NET_QUEUE_MAX);
+        SW(a, T0, S3, 0x038);           // QueueNum
+        LI(a, T0, RING_DESC(ring));
+        SW(a, T0, S3, 0x080);
+        SW(a, ZERO, S3, 0x084);
+        LI(a, T0, RING_AVAIL(ring));
+        SW(a, T0, S3, 0x090);
+        SW(a, ZERO, S3, 0x094);
+        LI(a, T0, RING_USED(ring));
+        SW(a, T0, S3, 0x0a0);
+        SW(a, ZERO, S3, 0x0a4);
+        LI(a, T0, 1);
+        SW(a, T0, S3, 0x044);           // QueueReady
+    }
+    LI(a, T0, 0xf);
+    SW(a, T0, S3, 0x070);               // DRIVER_OK
+}
+
+// 等接收队列的 used->idx 不同于 last，把新用掉的缓冲区还回去；结束时 last 更新为新的 used->idx
+static void net_rx_wait(Asm *a, int last) {
+    uint64_t wait = asm_label(a);
+    LHU(a, T0, S2, 2);                  // used->idx
+    BEQ(a, T0, last, wait);
+    ADDI(a, last, T0, 0);
+    ADDI(a, T1, T0, VIRTIO_NET_QUEUE_MAX);
+    SH(a, T1, S1, 2);                   // avail->idx
+    SW(a, ZERO, S3, 0x050);             // QueueNotify(RX)
+}
+
+// 子进程：发 n 帧，每个窗口等一个 ack
+static void net_sender(const char *path, uint64_t n) {
+    char spec[128];
+    snprintf(spec, sizeof(spec), "connect:%s", path);
+    if (virtio_net_init(spec) < 0) _exit(1);
+
+    net_ring_init(NET_RX_RING, DATA_ADDR, sizeof(virtio_net_hdr) + VIRTIO_NET_MAX_FRAME, VRING_DESC_F_WRITE);
+    net_ring_init(NET_TX_RING, DATA2_ADDR, sizeof(virtio_net_hdr) + NET_FRAME, 0);
+    net_frames_init(DATA2_ADDR, NET_FRAME);
+
+    Asm a;
+    asm_init(&a, host(CODE_ADDR), CODE_ADDR);
+    net_driver_init(&a);
+    LI(&a, S0, n / NET_WINDOW);
+    LI(&a, S1, RING_AVAIL(NET_RX_RING));
+    LI(&a, S2, RING_USED(NET_RX_RING));
+    LI(&a, A0, RING_AVAIL(NET_TX_RING));
+    LI(&a, A1, VIRTIO_NET_TX_QUEUE);
+    LI(&a, T2, 0);                      // 发送 avail->idx
+    LI(&a, A4, 0);                      // 接收 used->idx
+    uint64_t loop = asm_label(&a);
+    ADDI(&a, T2, T2, NET_WINDOW);
+    SH(&a, T2, A0, 2);
+    SW(&a, A1, S3, 0x050);              // QueueNotify(TX)：设备同步发完整个窗口
+    net_rx_wait(&a, A4);                // ack
+    ADDI(&a, S0, S0, -1);
+    BNE(&a, S0, ZERO, loop);
+    EBREAK(&a);
+
+    // 连上之前发的帧都会被丢掉
+    for (int i = 0; i < 500 && __atomic_load_n(&netdev.backend.fd, __ATOMIC_ACQUIRE) < 0; i++) usleep(10000);
+
+    BenchResult r = { .name = "virtio_net_pair" };
+    cpu[0].bus = bus;
+    cpu_init(&cpu[0], 0);
+    cpu[0].pc = CODE_ADDR;
+    double start = now_sec();
+    while (!cpu[0].halted && now_sec() - start < 60) {
+        for (int i = 0; i < 4096 && !cpu[0].halted; i++) {
+            cpu_step(&cpu[0], memory);
+            virtio_net_update();
+            check_and_handle_interrupts(&cpu[0]);
+        }
+    }
+    r.ok = cpu[0].halted && netdev.tx_packets == n;
+    virtio_net_close();
+    _exit(r.ok ? 0 : 1);
+}
+
+static void bench_net(BenchResult *r) {
+    uint64_t n = 20000ull * scale / NET_WINDOW * NET_WINDOW;
+    r->metric = "pkts_per_s";
+    r->metric2 = "mb_per_s";
+
+    char path[64], spec[80];
+    snprintf(path, sizeof(path), "/tmp/rv-bench-net-%d.sock", getpid());
+    snprintf(spec, sizeof(spec), "listen:%s", path);
+    bus_register_mmio(&bus, VIRTIO_NET_BASE, VIRTIO_NET_SIZE, net_rd, net_wr, &netdev);
+
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("[bench] fork");
+        return;
+    }
+    if (pid == 0) net_sender(path, n);
+
+    if (virtio_net_init(spec) < 0) {
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        return;
+    }
+    net_ring_init(NET_RX_RING, DATA_ADDR, sizeof(virtio_net_hdr) + VIRTIO_NET_MAX_FRAME, VRING_DESC_F_WRITE);
+    net_ring_init(NET_TX_RING, DATA2_ADDR, sizeof(virtio_net_hdr) + NET_ACK_FRAME, 0);
+    net_frames_init(DATA2_ADDR, NET_ACK_FRAME);
+
+    // 接收端客户机不停机：每收满一个窗口回一个 ack，由宿主侧在最后一个 ack 发出后结束
+    Asm a;
+    asm_init(&a, host(CODE_ADDR), CODE_ADDR);
+    net_driver_init(&a);
+    LI(&a, S1, RING_AVAIL(NET_RX_RING));
+    LI(&a, S2, RING_USED(NET_RX_RING));
+    LI(&a, A0, RING_AVAIL(NET_TX_RING));
+    LI(&a, A1, VIRTIO_NET_TX_QUEUE);
+    LI(&a, A2, NET_WINDOW);             // 下一个 ack 时接收 used->idx 应到的值（16 位）
+    LI(&a, A3, 0);                      // 发送 avail->idx
+    LI(&a, T2, 0);
+    uint64_t loop = asm_label(&a);
+    net_rx_wait(&a, T2);
+    BNE(&a, T2, A2, loop);              // 发送端等 ack，used->idx 不会越过窗口边界
+    ADDI(&a, A2, A2, NET_WINDOW);
+    SLLI(&a, A2, A2, 48);
+    SRLI(&a, A2, A2, 48);
+    ADDI(&a, A3, A3, 1);
+    SH(&a, A3, A0, 2);
+    SW(&a, A1, S3, 0x050);              // QueueNotify(TX)
+    J(&a, loop);
+
+    cpu[0].bus = bus;
+    cpu_init(&cpu[0], 0);
+    cpu[0].pc = CODE_ADDR;
+    uint64_t i0 = 0;
+    double start = now_sec(), t0 = 0;
+    while (netdev.tx_packets < n / NET_WINDOW && now_sec() - start < 60) {
+        for (int i = 0; i < 4096; i++) {
+            cpu_step(&cpu[0], memory);
+            virtio_net_update();
+            check_and_handle_interrupts(&cpu[0]);
+        }
+        if (!t0 && netdev.rx_packets) {
+            t0 = now_sec();
+            i0 = cpu[0].inst_count;
+        }
+    }
+    r->secs = now_sec() - (t0 ? t0 : start);
+    r->insts = cpu[0].inst_count - i0;
+
+    int wstatus = 0;
+    waitpid(pid, &wstatus, 0);
+    virtio_net_close();
+
+    r->ok = WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0 && netdev.rx_packets == n && !netdev.rx_dropped;
+    if (!r->ok)
+        fprintf(stderr, "[bench] virtio_net_pair: %lu of %lu frames received (%lu dropped), sender exit status 0x%x\n",
+                netdev.rx_packets, n, netdev.rx_dropped, wstatus);
+    r->value = netdev.rx_packets / r->secs;
+    r->value2 = netdev.rx_bytes / r->secs / 1e6;
+}
+
+static const struct {
+    const char *name;
+    void (*fn)(BenchResult *);
+} benches[] = {
+    { "int_loop",         bench_int_loop },
+    { "memcpy",           bench_memcpy },
+    { "pointer_chase",    bench_pointer_chase },
+    { "trap_roundtrip",   bench_trap },
+    { "tlb_thrash",       bench_tlb_thrash },
+    { "virtio_blk_read",  bench_disk },
+    { "uart_tx",          bench_uart },
+    { "virtio_net_pair",  bench_net },
+};
+#define NBENCH (sizeof(benches) / sizeof(benches[0]))
+
+/* ---------- machine setup ---------- */
+
+// 设备的 MMIO 回调签名各不相同，统一成 bus_register_mmio 要的形式
+static uint64_t uart_rd(void *o, uint64_t off, unsigned sz) { return mmio_read(o, off, sz); }
+static void uart_wr(void *o, uint64_t off, uint64_t v, unsigned sz) { mmio_write(o, off, v, sz); }
+static uint64_t plic_rd(void *o, uint64_t off, unsigned sz) { return plic_read(o, off, sz); }
+static void plic_wr(void *o, uint64_t off, uint64_t v, unsigned sz) { plic_write(o, off, v, sz); }
+static uint64_t blk_rd(void *o, uint64_t off, unsigned sz) { return virtio_mmio_read(o, off, sz); }
+static void blk_wr(void *o, uint64_t off, uint64_t v, unsigned sz) { virtio_mmio_write(o, off, v, sz); }
+
+static void machine_init(void) {
+    memory = ram_alloc();
+    if (!memory) {
+        fprintf(stderr, "[bench] cannot allocate guest memory\n");
+        exit(1);
+    }
+
+    static RAMDevice ram;
+    ram.data = memory;
+    ram.size = MEMORY_SIZE;
+    bus_register_mmio(&bus, MEMORY_BASE, MEMORY_SIZE, ram_read, ram_write, &ram);
+
+    uart = uart_create(UART_BASE, &cpu, UART_IRQ_NUM, "null");
+    if (!uart) exit(1);
+    bus_register_mmio(&bus, UART_BASE, UART_SIZE, uart_rd, uart_wr, uart);
+
+    plic_init();
+    bus_register_mmio(&bus, PLIC_BASE, PLIC_SIZE, plic_rd, plic_wr, &plic);
+
+    // 8 MiB 临时磁盘镜像
+    snprintf(disk_path, sizeof(disk_path), "/tmp/rv-bench-%d.img", getpid());
+    FILE *f = fopen(disk_path, "w");
+    if (!f || ftruncate(fileno(f), 8 << 20) < 0) {
+        fprintf(stderr, "[bench] cannot create %s\n", disk_path);
+        exit(1);
+    }
+    fclose(f);
+    if (virtio_blk_init(disk_path, NULL) < 0) exit(1);
+    bus_register_mmio(&bus, VIRTIO_MMIO_BASE, VIRTIO_MMIO_SIZE, blk_rd, blk_wr, &dev);
+}
+
+static void machine_close(void) {
+    virtio_blk_close();
+    unlink(disk_path);
+    uart_destroy(uart);
+}
+
+/* ---------- output ---------- */
+
+static void write_json(FILE *f, BenchResult *res, int n) {
+    fprintf(f, "{\n  \"build_type\": \"%s\",\n  \"scale\": %d,\n  \"benchmarks\": [\n", RVEMU_BUILD_TYPE, scale);
+    for (int i = 0; i < n; i++) {
+        BenchResult *r = &res[i];
+        fprintf(f, "    {\"name\": \"%s\", \"ok\": %s, \"instructions\": %lu, \"seconds\": %.6f, \"mips\": %.3f",
+                r->name, r->ok ? "true" : "false", r->insts, r->secs, r->insts / r->secs / 1e6);
+        if (r->metric) fprintf(f, ", \"%s\": %.3f", r->metric, r->value);
+        if (r->metric2) fprintf(f, ", \"%s\": %.3f", r->metric2, r->value2);
+        fprintf(f, "}%s\n", i + 1 < n ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+// 读之前 write_json 的输出：每个基准一行，只取 name 和 mips
+static bool baseline_mips(const char *path, const char *name, double *mips) {
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+    char line[512], key[80];
+    snprintf(key, sizeof(key), "\"name\": \"%s\"", name);
+    bool found = false;
+    while (!found && fgets(line, sizeof(line), f)) {
+        char *p = strstr(line, key), *m;
+        if (p && (m = strstr(line, "\"mips\": "))) found = sscanf(m + 8, "%lf", mips) == 1;
+    }
+    fclose(f);
+    return found;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [-s scale] [-o out.json] [-c baseline.json] [name...]\n  benchmarks:", argv0);
+    for (size_t i = 0; i < NBENCH; i++) fprintf(stderr, " %s", benches[i].name);
+    fprintf(stderr, "\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    const char *out_path = NULL, *baseline = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:o:c:")) != -1) {
+        switch (opt) {
+            case 's': scale = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+            case 'o': out_path = optarg; break;
+            case 'c': baseline = optarg; break;
+            default: usage(argv[0]);
+        }
+    }
+    for (int i = optind; i < argc; i++) {
+        size_t k = 0;
+        while (k < NBENCH && strcmp(argv[i], benches[k].name) != 0) k++;
+        if (k == NBENCH) usage(argv[0]);
+    }
+
+    machine_init();
+
+    BenchResult res[NBENCH];
+    int n = 0;
+    bool all_ok = true;
+    for (size_t k = 0; k < NBENCH; k++) {
+        bool selected = optind == argc;
+        for (int i = optind; i < argc; i++) selected |= strcmp(argv[i], benches[k].name) == 0;
+        if (!selected) continue;
+
+        BenchResult *r = &res[n++];
+        memset(r, 0, sizeof(*r));
+        r->name = benches[k].name;
+        benches[k].fn(r);
+        all_ok &= r->ok;
+    }
+    machine_close();
+
+    // 人看的摘要写 stderr，JSON 写文件或 stdout
+    fprintf(stderr, "\n%-18s %12s %9s %10s  %s\n", "benchmark", "insts", "sec", "MIPS", "metric");
+    for (int i = 0; i < n; i++) {
+        BenchResult *r = &res[i];
+        double mips = r->insts / r->secs / 1e6, old;
+        fprintf(stderr, "%-18s %12lu %9.3f %10.2f", r->name, r->insts, r->secs, mips);
+        if (r->metric) fprintf(stderr, "  %s=%.2f", r->metric, r->value);
+        if (r->metric2) fprintf(stderr, " %s=%.2f", r->metric2, r->value2);
+        if (baseline && baseline_mips(baseline, r->name, &old))
+            fprintf(stderr, "  (%+.1f%% MIPS vs baseline)", (mips / old - 1) * 100);
+        fprintf(stderr, "%s\n", r->ok ? "" : "  FAILED");
+    }
+
+    FILE *f = out_path ? fopen(out_path, "w") : stdout;
+    if (!f) {
+        perror(out_path);
+        return 1;
+    }
+    write_json(f, res, n);
+    if (f != stdout) fclose(f);
+    return all_ok ? 0 : 1;
+}
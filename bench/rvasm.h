@@ -0,0 +1,109 @@
+// rvasm.h
+// 生成 benchmark 客户机代码用的最小 RV64 汇编器：只有用到的指令，只支持向后跳转
+#ifndef RVASM_H
+#define RVASM_H
+
+#include <stdint.h>
+#include <string.h>
+
+enum {
+    ZERO = 0, RA = 1, SP = 2, GP = 3, TP = 4, T0 = 5, T1 = 6, T2 = 7,
+    S0 = 8, S1 = 9, A0 = 10, A1 = 11, A2 = 12, A3 = 13, A4 = 14, A5 = 15,
+    A6 = 16, A7 = 17, S2 = 18, S3 = 19, T3 = 28, T4 = 29, T5 = 30, T6 = 31,
+};
+
+typedef struct {
+    uint8_t *mem;       // 客户机物理地址 base 对应的主机指针
+    uint64_t base;      // 代码起始的客户机地址
+    uint64_t pc;        // 下一条指令的客户机地址
+} Asm;
+
+static inline void asm_init(Asm *a, uint8_t *host, uint64_t guest_addr) {
+    a->mem = host;
+    a->base = a->pc = guest_addr;
+}
+
+static inline uint64_t asm_label(Asm *a) { return a->pc; }
+
+static inline void emit(Asm *a, uint32_t insn) {
+    memcpy(a->mem + (a->pc - a->base), &insn, 4);
+    a->pc += 4;
+}
+
+/* ---------- 编码格式 ---------- */
+
+static inline uint32_t enc_r(uint32_t f7, int rs2, int rs1, uint32_t f3, int rd, uint32_t op) {
+    return f7 << 25 | rs2 << 20 | rs1 << 15 | f3 << 12 | rd << 7 | op;
+}
+static inline uint32_t enc_i(int32_t imm, int rs1, uint32_t f3, int rd, uint32_t op) {
+    return (uint32_t)(imm & 0xfff) << 20 | rs1 << 15 | f3 << 12 | rd << 7 | op;
+}
+static inline uint32_t enc_s(int32_t imm, int rs2, int rs1, uint32_t f3, uint32_t op) {
+    return (uint32_t)((imm >> 5) & 0x7f) << 25 | rs2 << 20 | rs1 << 15 | f3 << 12 |
+           (uint32_t)(imm & 0x1f) << 7 | op;
+}
+static inline uint32_t enc_b(int32_t off, int rs2, int rs1, uint32_t f3) {
+    return (uint32_t)((off >> 12) & 1) << 31 | (uint32_t)((off >> 5) & 0x3f) << 25 |
+           rs2 << 20 | rs1 << 15 | f3 << 12 |
+           (uint32_t)((off >> 1) & 0xf) << 8 | (uint32_t)((off >> 11) & 1) << 7 | 0x63;
+}
+static inline uint32_t enc_j(int32_t off, int rd) {
+    return (uint32_t)((off >> 20) & 1) << 31 | (uint32_t)((off >> 1) & 0x3ff) << 21 |
+           (uint32_t)((off >> 11) & 1) << 20 | (uint32_t)((off >> 12) & 0xff) << 12 | rd << 7 | 0x6f;
+}
+
+/* ---------- 指令 ---------- */
+
+#define ADD(a, rd, rs1, rs2)    emit(a, enc_r(0x00, rs2, rs1, 0, rd, 0x33))
+#define SUB(a, rd, rs1, rs2)    emit(a, enc_r(0x20, rs2, rs1, 0, rd, 0x33))
+#define XOR(a, rd, rs1, rs2)    emit(a, enc_r(0x00, rs2, rs1, 4, rd, 0x33))
+#define AND(a, rd, rs1, rs2)    emit(a, enc_r(0x00, rs2, rs1, 7, rd, 0x33))
+#define MUL(a, rd, rs1, rs2)    emit(a, enc_r(0x01, rs2, rs1, 0, rd, 0x33))
+#define ADDI(a, rd, rs1, imm)   emit(a, enc_i(imm, rs1, 0, rd, 0x13))
+#define ANDI(a, rd, rs1, imm)   emit(a, enc_i(imm, rs1, 7, rd, 0x13))
+#define SLLI(a, rd, rs1, sh)    emit(a, enc_i((sh) & 0x3f, rs1, 1, rd, 0x13))
+#define SRLI(a, rd, rs1, sh)    emit(a, enc_i((sh) & 0x3f, rs1, 5, rd, 0x13))
+#define ADDIW(a, rd, rs1, imm)  emit(a, enc_i(imm, rs1, 0, rd, 0x1b))
+#define LUI(a, rd, imm20)       emit(a, (uint32_t)((imm20) & 0xfffff) << 12 | (rd) << 7 | 0x37)
+#define LD(a, rd, rs1, off)     emit(a, enc_i(off, rs1, 3, rd, 0x03))
+#define LW(a, rd, rs1, off)     emit(a, enc_i(off, rs1, 2, rd, 0x03))
+#define LBU(a, rd, rs1, off)    emit(a, enc_i(off, rs1, 4, rd, 0x03))
+#define LHU(a, rd, rs1, off)    emit(a, enc_i(off, rs1, 5, rd, 0x03))
+#define SD(a, rs2, rs1, off)    emit(a, enc_s(off, rs2, rs1, 3, 0x23))
+#define SW(a, rs2, rs1, off)    emit(a, enc_s(off, rs2, rs1, 2, 0x23))
+#define SH(a, rs2, rs1, off)    emit(a, enc_s(off, rs2, rs1, 1, 0x23))
+#define SB(a, rs2, rs1, off)    emit(a, enc_s(off, rs2, rs1, 0, 0x23))
+#define CSRW(a, csr, rs1)       emit(a, enc_i(csr, rs1, 1, 0, 0x73))
+#define CSRR(a, rd, csr)        emit(a, enc_i(csr, 0, 2, rd, 0x73))
+#define ECALL(a)                emit(a, 0x00000073)
+#define EBREAK(a)               emit(a, 0x00100073)
+#define MRET(a)                 emit(a, 0x30200073)
+#define SFENCE_VMA(a)           emit(a, 0x12000073)
+#define FENCE(a)                emit(a, 0x0ff0000f)
+
+// 跳到之前记下的 label
+#define BNE(a, rs1, rs2, l)     emit(a, enc_b((int32_t)((l) - (a)->pc), rs2, rs1, 1))
+#define BEQ(a, rs1, rs2, l)     emit(a, enc_b((int32_t)((l) - (a)->pc), rs2, rs1, 0))
+#define BLTU(a, rs1, rs2, l)    emit(a, enc_b((int32_t)((l) - (a)->pc), rs2, rs1, 6))
+#define J(a, l)                 emit(a, enc_j((int32_t)((l) - (a)->pc), 0))
+
+// 任意 64 位立即数：低 32 位用 lui + addiw，更高的部分递归后左移
+static inline void LI(Asm *a, int rd, int64_t v) {
+    if (v >= INT32_MIN && v <= INT32_MAX) {
+        int64_t lo = (int64_t)(v << 52) >> 52;
+        int64_t hi = (v - lo) >> 12;
+        if (hi) {
+            LUI(a, rd, hi);
+            if (lo) ADDIW(a, rd, rd, lo);
+        } else {
+            ADDI(a, rd, ZERO, lo);
+        }
+        return;
+    }
+    int64_t lo = (int64_t)((uint64_t)v << 52) >> 52;
+    LI(a, rd, (v - lo) >> 12);
+    SLLI(a, rd, rd, 12);
+    if (lo) ADDI(a, rd, rd, lo);
+}
+
+#endif
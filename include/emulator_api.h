@@ -1,9 +1,78 @@
 #ifndef EMULATOR_API_H
 #define EMULATOR_API_H
 
-//#include "common_types.h"
+#include <stdint.h>
+#include <stddef.h>
 
-// 模拟器接口
-//void write32(rtos_uint32_t addr, rtos_uint32_t val);
+/*
+ * 嵌入式使用的模拟器接口（libriscv-emu）
+ *
+ * 一个 Machine 是一台完整的虚拟机：RAM、hart、PLIC / CLINT、UART、virtio-console、VMCTL，
+ * 可选挂一块 virtio 磁盘。不带 virtio-net，也不带 profiler / trace / 快照等只在 rv-emulator 里打开的工具。
+ *
+ * 线程模型：每台 Machine 有自己的一份 CPU / 总线 / PLIC / 设备 / VMCTL 状态，没有进程级的锁。
+ * 不同的 Machine 可以在不同线程上同时运行；同一台 Machine 同一时刻只能被一个线程调用，
+ * 但可以换线程（例如线程池里被别的线程偷走），调用方自己保证两次调用之间有同步（锁、队列等）。
+ * 执行时机器的状态装在当前线程的线程局部变量里：同一线程连着跑同一台机器不拷贝，
+ * 换了机器或换了线程要拷一次 CPU / PLIC / 设备寄存器（几百 KiB），RAM 和磁盘不拷；
+ * 多台机器在一个线程里轮流跑时 machine_run 的 max_insns 取大一些（例如 10^6 以上），换入换出就可以忽略。
+ *
+ * UART 工作在确定性模式：后端读到的输入由 machine_run 在指令之间投递，不会叫醒别的机器。
+ * hart 执行 WFI 停下后 machine_run 返回 MACHINE_HALTED，由调用者决定继续等还是放弃。
+ */
 
-#endif
\ No newline at end of file
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define EMU_API __attribute__((visibility("default")))
+#else
+#define EMU_API
+#endif
+
+typedef struct Machine Machine;
+
+typedef struct {
+    const char *serial;     // UART 后端，同 RVEMU_SERIAL；NULL = "null"
+} MachineConfig;
+
+// machine_run 的返回值
+enum {
+    MACHINE_ERROR = -1,
+    MACHINE_LIMIT = 0,      // 跑满了 max_insns，还可以继续跑
+    MACHINE_EXITED,         // 客户机停止（写 VMCTL EXIT 等），退出码见 machine_exit_code
+    MACHINE_HALTED,         // hart 停着（WFI、ebreak、非法访问）
+    MACHINE_MARKER,         // 客户机写了 VMCTL MARKER，再调 machine_run 从下一条指令继续
+};
+
+EMU_API Machine *machine_create(const MachineConfig *cfg);     // cfg 可以为 NULL
+EMU_API void machine_destroy(Machine *m);
+
+// 加载 ELF 并把 pc 设为入口；磁盘在第一次 machine_run 之前挂上，overlay 可以为 NULL
+EMU_API int machine_load_elf(Machine *m, const char *path);
+EMU_API int machine_load_disk(Machine *m, const char *path, const char *overlay);
+
+EMU_API int machine_run(Machine *m, uint64_t max_insns);
+
+EMU_API uint64_t machine_get_pc(Machine *m);
+EMU_API void machine_set_pc(Machine *m, uint64_t pc);
+EMU_API uint64_t machine_get_reg(Machine *m, int reg);         // x0..x31
+EMU_API void machine_set_reg(Machine *m, int reg, uint64_t value);
+EMU_API uint64_t machine_get_csr(Machine *m, int csr);
+
+// 按物理地址读写 RAM，越界返回 -1
+EMU_API int machine_read_mem(Machine *m, uint64_t paddr, void *buf, size_t len);
+EMU_API int machine_write_mem(Machine *m, uint64_t paddr, const void *buf, size_t len);
+
+// 收到 MACHINE_MARKER 后调用：按 RVEMU_FUZZ 的约定把输入写到 MARKER 写的地址，客户机从 VMCTL INPUT_LEN 读长度
+EMU_API int machine_set_input(Machine *m, const void *data, size_t len);
+
+EMU_API uint64_t machine_inst_count(Machine *m);
+EMU_API int machine_exit_code(Machine *m);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
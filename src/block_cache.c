@@ -0,0 +1,226 @@
+// block_cache.c
+// 磁盘块缓存：组相联 + LRU，写回（write-back），脏块由后台线程或 FLUSH 请求批量写出
+#include "block_cache.h"
+#include <time.h>
+
+static BlockCacheEntry *lookup(BlockCache *bc, uint64_t blockno) {
+    BlockCacheEntry *set = bc->sets[blockno % BLK_CACHE_SETS];
+    for (int w = 0; w < BLK_CACHE_WAYS; w++) {
+        if (set[w].valid && set[w].blockno == blockno) return &set[w];
+    }
+    return NULL;
+}
+
+// 选择替换对象：优先空闲路，否则组内最久未使用的
+static BlockCacheEntry *pick_victim(BlockCache *bc, uint64_t blockno) {
+    BlockCacheEntry *set = bc->sets[blockno % BLK_CACHE_SETS];
+    BlockCacheEntry *victim = &set[0];
+    for (int w = 0; w < BLK_CACHE_WAYS; w++) {
+        if (!set[w].valid) return &set[w];
+        if (set[w].last_used < victim->last_used) victim = &set[w];
+    }
+    return victim;
+}
+
+// 调用者持有 bc->lock
+static BlockCacheEntry *get_block(BlockCache *bc, uint64_t blockno, int will_overwrite) {
+    BlockCacheEntry *e = lookup(bc, blockno);
+    if (e) {
+        bc->hits++;
+        e->last_used = ++bc->tick;
+        return e;
+    }
+    bc->misses++;
+
+    e = pick_victim(bc, blockno);
+    if (e->valid && e->dirty) {
+        // 淘汰脏块：先写出再复用，io_lock 保证不会被正在进行的批量回写用旧数据覆盖
+        pthread_mutex_lock(&bc->io_lock);
+        int r = disk_image_write(bc->disk, e->blockno * BSIZE, e->data, BSIZE);
+        pthread_mutex_unlock(&bc->io_lock);
+        if (r < 0) return NULL;
+        bc->evictions++;
+    }
+    e->valid = 0;
+    e->dirty = 0;
+
+    // 整块覆盖时不需要从磁盘读入旧内容
+    if (!will_overwrite && disk_image_read(bc->disk, blockno * BSIZE, e->data, BSIZE) < 0)
+        return NULL;
+
+    e->blockno = blockno;
+    e->valid = 1;
+    e->last_used = ++bc->tick;
+    return e;
+}
+
+static int cache_access(BlockCache *bc, uint64_t off, uint8_t *buf, uint32_t len, int is_write) {
+    pthread_mutex_lock(&bc->lock);
+    while (len > 0) {
+        uint64_t blockno = off / BSIZE;
+        uint32_t in_block = off % BSIZE;
+        uint32_t chunk = BSIZE - in_block;
+        if (chunk > len) chunk = len;
+
+        BlockCacheEntry *e = get_block(bc, blockno, is_write && chunk == BSIZE);
+        if (!e) {
+            pthread_mutex_unlock(&bc->lock);
+            return -1;
+        }
+        if (is_write) {
+            memcpy(&e->data[in_block], buf, chunk);
+            e->dirty = 1;
+            e->gen = ++bc->gen;
+        } else {
+            memcpy(buf, &e->data[in_block], chunk);
+        }
+
+        off += chunk;
+        buf += chunk;
+        len -= chunk;
+    }
+    pthread_mutex_unlock(&bc->lock);
+    return 0;
+}
+
+int block_cache_read(BlockCache *bc, uint64_t off, void *buf, uint32_t len) {
+    return cache_access(bc, off, buf, len, 0);
+}
+
+int block_cache_write(BlockCache *bc, uint64_t off, const void *buf, uint32_t len) {
+    return cache_access(bc, off, (uint8_t *)buf, len, 1);
+}
+
+typedef struct {
+    uint64_t blockno;
+    uint64_t gen;
+    bool written;
+    uint8_t data[BSIZE];
+} DirtyBlock;
+
+static int cmp_dirty(const void *a, const void *b) {
+    uint64_t x = ((const DirtyBlock *)a)->blockno;
+    uint64_t y = ((const DirtyBlock *)b)->blockno;
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * 批量写出所有脏块：
+ *   1. 持 lock 把脏块拷到临时数组（CPU 线程只被阻塞一次 memcpy 的时间），脏位先不清
+ *   2. 先拿 io_lock 再放 lock，保证之后的淘汰写出排在这批之后
+ *   3. 按块号排序，连续块合并成一次 disk_image_write
+ *   4. 放掉 io_lock 再拿 lock，写成功且拷贝之后没再被写过（gen 没变）的块才清脏位
+ * 写出期间块一直是脏的：被淘汰时淘汰路径会等这批写完再写一次，重新读入时磁盘上已经是新数据；
+ * 写失败的块保留脏位，下次再写。
+ */
+int block_cache_flush(BlockCache *bc) {
+    static DirtyBlock snap[BLK_CACHE_SETS * BLK_CACHE_WAYS];
+    static uint8_t run[BLK_CACHE_MAX_RUN * BSIZE];
+    static pthread_mutex_t snap_lock = PTHREAD_MUTEX_INITIALIZER;
+    int n = 0;
+    int ret = 0;
+
+    pthread_mutex_lock(&snap_lock);
+    pthread_mutex_lock(&bc->lock);
+    for (int s = 0; s < BLK_CACHE_SETS; s++) {
+        for (int w = 0; w < BLK_CACHE_WAYS; w++) {
+            BlockCacheEntry *e = &bc->sets[s][w];
+            if (!e->valid || !e->dirty) continue;
+            snap[n].blockno = e->blockno;
+            snap[n].gen = e->gen;
+            memcpy(snap[n].data, e->data, BSIZE);
+            n++;
+        }
+    }
+    pthread_mutex_lock(&bc->io_lock);
+    pthread_mutex_unlock(&bc->lock);
+
+    qsort(snap, n, sizeof(DirtyBlock), cmp_dirty);
+    for (int i = 0; i < n;) {
+        int len = 1;
+        memcpy(run, snap[i].data, BSIZE);
+        while (i + len < n && len < BLK_CACHE_MAX_RUN &&
+               snap[i + len].blockno == snap[i].blockno + len) {
+            memcpy(run + (uint64_t)len * BSIZE, snap[i + len].data, BSIZE);
+            len++;
+        }
+        bool ok = disk_image_write(bc->disk, snap[i].blockno * BSIZE, run, (uint64_t)len * BSIZE) == 0;
+        if (!ok) ret = -1;
+        for (int k = 0; k < len; k++) snap[i + k].written = ok;
+        bc->flush_writes++;
+        i += len;
+    }
+    pthread_mutex_unlock(&bc->io_lock);
+
+    pthread_mutex_lock(&bc->lock);
+    for (int i = 0; i < n; i++) {
+        if (!snap[i].written) continue;
+        BlockCacheEntry *e = lookup(bc, snap[i].blockno);
+        if (e && e->gen == snap[i].gen) e->dirty = 0;
+        bc->flushed_blocks++;
+    }
+    pthread_mutex_unlock(&bc->lock);
+    pthread_mutex_unlock(&snap_lock);
+    return ret;
+}
+
+static void *writeback_thread(void *arg) {
+    BlockCache *bc = arg;
+    pthread_mutex_lock(&bc->lock);
+    while (bc->running) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += bc->wb_interval_ms / 1000;
+        ts.tv_nsec += (long)(bc->wb_interval_ms % 1000) * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&bc->wb_cond, &bc->lock, &ts);
+        if (!bc->running) break;
+
+        pthread_mutex_unlock(&bc->lock);
+        block_cache_flush(bc);
+        pthread_mutex_lock(&bc->lock);
+    }
+    pthread_mutex_unlock(&bc->lock);
+    return NULL;
+}
+
+BlockCache *block_cache_create(DiskImage *disk, int wb_interval_ms) {
+    BlockCache *bc = calloc(1, sizeof(BlockCache));
+    if (!bc) return NULL;
+    bc->disk = disk;
+    bc->wb_interval_ms = wb_interval_ms;
+    pthread_mutex_init(&bc->lock, NULL);
+    pthread_mutex_init(&bc->io_lock, NULL);
+    pthread_cond_init(&bc->wb_cond, NULL);
+
+    if (wb_interval_ms > 0) {
+        bc->running = true;
+        if (pthread_create(&bc->wb_thread, NULL, writeback_thread, bc) != 0) {
+            perror("block cache writeback thread");
+            bc->running = false;
+        }
+    }
+    return bc;
+}
+
+// 停掉回写线程并写出剩余脏块
+void block_cache_destroy(BlockCache *bc) {
+    if (!bc) return;
+    if (bc->running) {
+        pthread_mutex_lock(&bc->lock);
+        bc->running = false;
+        pthread_cond_signal(&bc->wb_cond);
+        pthread_mutex_unlock(&bc->lock);
+        pthread_join(bc->wb_thread, NULL);
+    }
+    block_cache_flush(bc);
+    printf("[disk] cache: %lu hits, %lu misses, %lu evictions, %lu blocks flushed in %lu writes\n",
+           bc->hits, bc->misses, bc->evictions, bc->flushed_blocks, bc->flush_writes);
+    pthread_cond_destroy(&bc->wb_cond);
+    pthread_mutex_destroy(&bc->io_lock);
+    pthread_mutex_destroy(&bc->lock);
+    free(bc);
+}
@@ -0,0 +1,53 @@
+// block_cache.h
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include "common.h"
+#include "disk_image.h"
+
+#define BSIZE 1024
+
+// N 路组相联，组内 LRU 替换
+#define BLK_CACHE_SETS 64
+#define BLK_CACHE_WAYS 8
+
+#define BLK_CACHE_WB_INTERVAL_MS 1000  // 后台回写默认周期
+#define BLK_CACHE_MAX_RUN        64    // 一次合并写出的最大连续块数
+
+typedef struct {
+    uint64_t blockno;
+    uint64_t last_used;  // LRU 计数
+    uint64_t gen;        // 最后一次写入时的 bc->gen，回写完成后用来判断这期间有没有再被改过
+    int valid;
+    int dirty;           // 写出成功之前一直保持，回写中途被淘汰的块会由淘汰路径再写一次
+    uint8_t data[BSIZE];
+} BlockCacheEntry;
+
+typedef struct {
+    BlockCacheEntry sets[BLK_CACHE_SETS][BLK_CACHE_WAYS];
+    uint64_t tick;
+    uint64_t gen;             // 写入计数
+    DiskImage *disk;
+
+    pthread_mutex_t lock;     // 保护 sets
+    pthread_mutex_t io_lock;  // 串行化对 disk 的写出，保证回写顺序
+    pthread_cond_t  wb_cond;
+    pthread_t wb_thread;
+    int wb_interval_ms;       // 0 表示不启动后台线程，只在 FLUSH/淘汰时写出
+    bool running;
+
+    // 统计
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t flushed_blocks;
+    uint64_t flush_writes;    // 合并后的写调用次数
+} BlockCache;
+
+BlockCache *block_cache_create(DiskImage *disk, int wb_interval_ms);
+void block_cache_destroy(BlockCache *bc);
+int block_cache_read(BlockCache *bc, uint64_t off, void *buf, uint32_t len);
+int block_cache_write(BlockCache *bc, uint64_t off, const void *buf, uint32_t len);
+int block_cache_flush(BlockCache *bc);
+
+#endif
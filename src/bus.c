@@ -1,7 +1,11 @@
 
 #include "bus.h"
+#include "stats.h"
+#include "memory.h"
+
+extern VM_LOCAL uint8_t *memory;
+VM_LOCAL Bus bus;    // 全局系统总线，cpu_init 时拷贝到 cpu->bus
 
-extern uint8_t *memory;
 void bus_register_mmio(Bus *bus, uint64_t base, uint64_t size,
                        uint64_t (*read)(void*, uint64_t, unsigned),
                        void (*write)(void*, uint64_t, uint64_t, unsigned),
@@ -22,24 +26,25 @@ uint64_t bus_read(Bus *bus, uint64_t addr, unsigned size) {
         MMIORegion *r = &bus->regions[i];
         if (addr >= r->base && addr < r->base + r->size) {
             uint64_t offset = addr - r->base;
+            STAT_INC(bus_reads[i]);
            // printf("[bus_read] offset:0x%16lx,size:%d\n",offset,size);
             return r->read(r->opaque, offset, size);
         }
     }
 
-    
-    if(addr > MEMORY_BASE && addr + size - 1 < MEMORY_BASE + MEMORY_SIZE){
+    if(addr > MEMORY_BASE && addr + size - 1 < MEMORY_BASE + ram_size){
         uint64_t val = 0;
         memcpy(&val, &memory[addr - MEMORY_BASE], size);
         return val; 
     }
+    STAT_INC(bus_unmapped);
 
     //printf("[bus_read]addr:0x%16lx not in any mmio region\n",addr);
-    
+    return 0;
 }
 #include "cpu.h"
-extern int j;
-extern CPU_State cpu[MAX_CORES];
+extern VM_LOCAL int j;
+extern VM_LOCAL CPU_State cpu[MAX_CORES];
 
 void bus_write(Bus *bus, uint64_t addr, uint64_t val, unsigned size) {
         if(addr == 0x87f56000 && val == 0x8000000000087fff){
@@ -54,6 +59,7 @@ void bus_write(Bus *bus, uint64_t addr, uint64_t val, unsigned size) {
         MMIORegion *r = &bus->regions[i];
         if (addr >= r->base && addr < r->base + r->size) {
             uint64_t offset = addr - r->base;
+            STAT_INC(bus_writes[i]);
             r->write(r->opaque, offset, val, size);
             return;
         }
@@ -61,11 +67,14 @@ void bus_write(Bus *bus, uint64_t addr, uint64_t val, unsigned size) {
 
 
     // 默认写内存
-    if(addr >= MEMORY_BASE && addr + size - 1 < MEMORY_BASE + MEMORY_SIZE){
+    if(addr >= MEMORY_BASE && addr + size - 1 < MEMORY_BASE + ram_size){
         memcpy(&memory[addr - MEMORY_BASE], &val, size);
+        ram_mark_dirty(addr - MEMORY_BASE, size);
         return;
     }
+    STAT_INC(bus_unmapped);
 
     printf("[bus_write]addr:0x%16lx not in any mmio region\n",addr);
+    cpu_stop_fault(&cpu[0], EXC_STORE_ACCESS, addr);
     cpu[0].halted = true; // 遇到非法访问时停止 CPU
 }
@@ -0,0 +1,284 @@
+// char_backend.c
+#define _GNU_SOURCE     // posix_openpt / ptsname
+#include "char_backend.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <time.h>
+
+static void set_nonblock(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags >= 0) fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+// 标准输入是终端时切到原始模式：逐字符输入、不产生信号，输出保留 OPOST 以便正常换行
+static void stdio_raw(CharBackend *cb) {
+    if (!isatty(STDIN_FILENO)) return;
+
+    struct termios term;
+    tcgetattr(STDIN_FILENO, &cb->original_termios);
+    term = cb->original_termios;
+    cfmakeraw(&term);
+    term.c_oflag |= OPOST;
+    term.c_lflag &= ~ICANON;
+    term.c_cc[VMIN] = 0;
+    term.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSANOW, &term);
+    cb->terminal_configured = true;
+}
+
+// 主机串口：115200 8N1，原始输入输出
+static int tty_open(const char *dev) {
+    int fd = open(dev, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "[chr] cannot open %s: %s\n", dev, strerror(errno));
+        return -1;
+    }
+    struct termios options;
+    if (tcgetattr(fd, &options) == 0) {
+        cfsetispeed(&options, B115200);
+        cfsetospeed(&options, B115200);
+        options.c_cflag &= ~(PARENB | CSTOPB | CSIZE);
+        options.c_cflag |= CS8 | CLOCAL | CREAD;
+        options.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);
+        options.c_iflag &= ~(IXON | IXOFF | ICRNL);
+        options.c_oflag &= ~OPOST;
+        options.c_cc[VMIN]  = 0;
+        options.c_cc[VTIME] = 0;
+        tcsetattr(fd, TCSANOW, &options);
+    }
+    return fd;
+}
+
+// 新建伪终端，返回主端。调用方另外打开一次从端并一直持有：否则没有客户端时
+// 主端 poll 一直报 POLLHUP、读返回 EIO，输入线程会空转
+static int pty_open(char *slave, size_t len) {
+    int fd = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (fd < 0 || grantpt(fd) < 0 || unlockpt(fd) < 0) {
+        perror("[chr] posix_openpt");
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    const char *name = ptsname(fd);
+    snprintf(slave, len, "%s", name ? name : "?");
+
+    // 从端也设成原始模式，客户机看到的就是裸字节流
+    struct termios term;
+    if (tcgetattr(fd, &term) == 0) {
+        cfmakeraw(&term);
+        tcsetattr(fd, TCSANOW, &term);
+    }
+    return fd;
+}
+
+static int unix_listen(const char *path) {
+    struct sockaddr_un sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(sa.sun_path)) {
+        fprintf(stderr, "[chr] socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(sa.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("[chr] socket");
+        return -1;
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 || listen(fd, 1) < 0) {
+        fprintf(stderr, "[chr] cannot listen on %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    set_nonblock(fd);
+    return fd;
+}
+
+int char_backend_open(CharBackend *cb, const char *spec) {
+    memset(cb, 0, sizeof(*cb));
+    cb->in_fd = -1;
+    cb->out_fd = -1;
+    cb->listen_fd = -1;
+    cb->write_timeout_ms = -1;
+    pthread_mutex_init(&cb->lock, NULL);
+
+    if (!spec || !*spec || strcmp(spec, "stdio") == 0) {
+        cb->type = CHAR_BACKEND_STDIO;
+        cb->in_fd = STDIN_FILENO;
+        cb->out_fd = STDOUT_FILENO;
+        stdio_raw(cb);
+        set_nonblock(STDIN_FILENO);
+        return 0;
+    }
+
+    const char *arg = strchr(spec, ':');
+    arg = arg ? arg + 1 : "";
+    snprintf(cb->path, sizeof(cb->path), "%s", arg);
+
+    if (strcmp(spec, "null") == 0) {
+        cb->type = CHAR_BACKEND_NULL;
+    } else if (strncmp(spec, "file:", 5) == 0 && *arg) {
+        cb->out_fd = open(arg, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (cb->out_fd < 0) {
+            fprintf(stderr, "[chr] cannot open %s: %s\n", arg, strerror(errno));
+            return -1;
+        }
+        cb->type = CHAR_BACKEND_FILE;
+    } else if (strncmp(spec, "unix:", 5) == 0 && *arg) {
+        cb->listen_fd = unix_listen(arg);
+        if (cb->listen_fd < 0) return -1;
+        cb->type = CHAR_BACKEND_UNIX;
+        cb->write_timeout_ms = 100;
+    } else if (strcmp(spec, "pty") == 0) {
+        int fd = pty_open(cb->path, sizeof(cb->path));
+        if (fd < 0) return -1;
+        cb->listen_fd = open(cb->path, O_RDWR | O_NOCTTY | O_CLOEXEC);
+        set_nonblock(fd);
+        cb->in_fd = cb->out_fd = fd;
+        cb->type = CHAR_BACKEND_PTY;
+        cb->write_timeout_ms = 100;
+    } else if (strncmp(spec, "tty:", 4) == 0 && *arg) {
+        int fd = tty_open(arg);
+        if (fd < 0) return -1;
+        set_nonblock(fd);
+        cb->in_fd = cb->out_fd = fd;
+        cb->type = CHAR_BACKEND_TTY;
+    } else {
+        fprintf(stderr, "[chr] unknown backend '%s' (want stdio, file:<path>, unix:<path>, pty, tty:<dev> or null)\n", spec);
+        return -1;
+    }
+    fprintf(stderr, "[chr] backend %s%s%s\n", spec,
+            cb->type == CHAR_BACKEND_PTY ? " -> " : "",
+            cb->type == CHAR_BACKEND_PTY ? cb->path : "");
+    return 0;
+}
+
+// 输入线程要 poll 的 fd：unix 模式未连接时是监听 socket，没有输入时为 -1
+int char_backend_poll_fd(CharBackend *cb) {
+    if (cb->type == CHAR_BACKEND_UNIX && cb->in_fd < 0) return cb->listen_fd;
+    return cb->in_fd;
+}
+
+static void unix_drop_client(CharBackend *cb) {
+    pthread_mutex_lock(&cb->lock);
+    close(cb->in_fd);
+    cb->in_fd = cb->out_fd = -1;
+    pthread_mutex_unlock(&cb->lock);
+    fprintf(stderr, "[chr] client disconnected from %s\n", cb->path);
+}
+
+// 只在输入线程里调用，非阻塞。没有数据（包括 unix 模式下刚接受 / 断开连接）返回 -1 且 errno = EAGAIN，
+// 输入端真正结束返回 0
+ssize_t char_backend_read(CharBackend *cb, void *buf, size_t len) {
+    if (cb->type == CHAR_BACKEND_UNIX) {
+        if (cb->in_fd < 0) {
+            int fd = accept(cb->listen_fd, NULL, NULL);
+            if (fd >= 0) {
+                set_nonblock(fd);
+                pthread_mutex_lock(&cb->lock);
+                cb->in_fd = cb->out_fd = fd;
+                pthread_mutex_unlock(&cb->lock);
+                fprintf(stderr, "[chr] client connected on %s\n", cb->path);
+            }
+            errno = EAGAIN;
+            return -1;
+        }
+        ssize_t n = read(cb->in_fd, buf, len);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            unix_drop_client(cb);
+            errno = EAGAIN;
+            return -1;
+        }
+        return n;
+    }
+    if (cb->in_fd < 0) return 0;
+    return read(cb->in_fd, buf, len);
+}
+
+// 等 fd 可写，最多 timeout_ms（-1 一直等）。被信号打断（SIGPROF / SIGUSR1 / SIGUSR2）时按剩余时间重新等
+static bool wait_writable(int fd, int timeout_ms) {
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int left = timeout_ms;
+    for (;;) {
+        struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+        int r = poll(&pfd, 1, left);
+        if (r > 0) return true;
+        if (r == 0 || errno != EINTR) return false;
+        if (timeout_ms < 0) continue;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int64_t ms = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+        if (ms >= timeout_ms) return false;
+        left = timeout_ms - (int)ms;
+    }
+}
+
+// 写出整批 iovec，处理短写。非阻塞 fd 写满时按 write_timeout_ms 等待，超时或出错丢弃剩余部分，
+// 不让一个没人读的 pty / socket 卡住客户机。只在 UART 的 TX 线程里调用
+void char_backend_write(CharBackend *cb, struct iovec *iov, int iovcnt) {
+    bool locked = cb->type == CHAR_BACKEND_UNIX;
+    if (locked) pthread_mutex_lock(&cb->lock);
+    int fd = cb->out_fd;
+
+    for (int i = 0; fd >= 0 && i < iovcnt; ) {
+        ssize_t w;
+        if (cb->type == CHAR_BACKEND_UNIX) {
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = &iov[i];
+            msg.msg_iovlen = iovcnt - i;
+            w = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        } else {
+            w = writev(fd, &iov[i], iovcnt - i);
+        }
+        if (w < 0 && errno == EINTR) continue;
+        if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // stdout 和非阻塞的 stdin 共享同一个终端文件描述时也会走到这里
+            if (wait_writable(fd, cb->write_timeout_ms)) continue;
+            break;
+        }
+        if (w <= 0) break;
+        while (i < iovcnt && (size_t)w >= iov[i].iov_len) w -= iov[i++].iov_len;
+        if (i < iovcnt) {
+            iov[i].iov_base = (uint8_t *)iov[i].iov_base + w;
+            iov[i].iov_len -= w;
+        }
+    }
+    if (locked) pthread_mutex_unlock(&cb->lock);
+}
+
+// 恢复终端设置，可以在退出路径上提前调用，重复调用无害
+void char_backend_restore(CharBackend *cb) {
+    if (cb->terminal_configured) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &cb->original_termios);
+        cb->terminal_configured = false;
+    }
+}
+
+// 调用前输入输出线程都要已经退出
+void char_backend_close(CharBackend *cb) {
+    char_backend_restore(cb);
+    switch (cb->type) {
+        case CHAR_BACKEND_FILE:
+            close(cb->out_fd);
+            break;
+        case CHAR_BACKEND_UNIX:
+            if (cb->in_fd >= 0) close(cb->in_fd);
+            close(cb->listen_fd);
+            unlink(cb->path);
+            break;
+        case CHAR_BACKEND_PTY:
+            if (cb->listen_fd >= 0) close(cb->listen_fd);
+            close(cb->in_fd);
+            break;
+        case CHAR_BACKEND_TTY:
+            close(cb->in_fd);
+            break;
+        default:
+            break;
+    }
+    cb->in_fd = cb->out_fd = cb->listen_fd = -1;
+    pthread_mutex_destroy(&cb->lock);
+}
@@ -0,0 +1,52 @@
+// char_backend.h
+#ifndef CHAR_BACKEND_H
+#define CHAR_BACKEND_H
+
+#include "common.h"
+#include <sys/uio.h>
+
+/*
+ * 串口 / 控制台的主机侧字符后端
+ *
+ *   stdio          标准输入输出，终端时切到原始模式（默认）
+ *   file:<path>    输出追加写到文件，没有输入；无终端的批量 VM 用来收集控制台日志
+ *   unix:<path>    UNIX SOCK_STREAM，本端监听，一次一个客户端（socat/nc -U 连接），断开后可重连
+ *   pty            新建伪终端，从机路径打印到 stderr（screen/minicom 连接）
+ *   tty:<dev>      主机串口设备，配置成 115200 8N1 原始模式
+ *   null           输出丢弃，没有输入
+ *
+ * 写入只来自 UART 的 TX 线程：THR、virtio-console 和内置 SBI 的输出都先进 UART 的 TX 环，
+ * 攒批后整段交给 char_backend_write，CPU 线程不直接碰输出 fd。
+ */
+
+typedef enum {
+    CHAR_BACKEND_STDIO = 0,
+    CHAR_BACKEND_FILE,
+    CHAR_BACKEND_UNIX,
+    CHAR_BACKEND_PTY,
+    CHAR_BACKEND_TTY,
+    CHAR_BACKEND_NULL,
+} CharBackendType;
+
+typedef struct {
+    CharBackendType type;
+    int in_fd;              // 输入 fd（非阻塞），没有输入为 -1；unix 模式下是当前连接
+    int out_fd;             // 输出 fd，-1 表示丢弃；unix 模式下是当前连接
+    int listen_fd;          // unix 模式的监听 socket；pty 模式下自己持有的从端
+    int write_timeout_ms;   // 输出端写不进去时最多等多久再丢弃，-1 表示一直等（文件 / stdout 不丢日志）
+    char path[108];         // 文件 / socket / 设备路径，pty 时为从机路径
+    pthread_mutex_t lock;   // unix 模式下连接的建立 / 断开和写入互斥
+
+    // stdio 模式下终端原来的设置，关闭时恢复
+    struct termios original_termios;
+    bool terminal_configured;
+} CharBackend;
+
+int char_backend_open(CharBackend *cb, const char *spec);
+int char_backend_poll_fd(CharBackend *cb);
+ssize_t char_backend_read(CharBackend *cb, void *buf, size_t len);
+void char_backend_write(CharBackend *cb, struct iovec *iov, int iovcnt);
+void char_backend_restore(CharBackend *cb);
+void char_backend_close(CharBackend *cb);
+
+#endif
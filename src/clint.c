@@ -1,7 +1,9 @@
 #include "clint.h"
 #include "cpu.h"
 
-extern int j;
+extern VM_LOCAL int j;
+uint32_t clint_tick_period = CLINT_TICK_PERIOD;
+
 void clint_init(CLINT* clint) {
     if (!clint) return;
     
@@ -9,6 +11,7 @@ void clint_init(CLINT* clint) {
     clint->mtime = 0;
     clint->mtimecmp = 0;
     clint->msip = 0;
+    clint->tick_left = clint_tick_period;
     clint->timer_interrupt_callback = NULL;
     clint->software_interrupt_callback = NULL;
     clint->timer_interrupt_pending = false;
@@ -134,11 +137,11 @@ void clint_write(CLINT* clint, uint64_t addr, uint64_t value, uint32_t size) {
         return;
     }
 }
-extern int log_enable;
-extern CPU_State cpu[MAX_CORES];   
+extern VM_LOCAL CPU_State cpu[MAX_CORES];   
 void clint_update_interrupts(CLINT* clint) {
     if (!clint) return;
-    
+    // CSR time 就是 mtime，频率和设备树的 timebase-frequency 一致
+    cpu[0].csr[CSR_TIME] = clint->mtime;
 
     if(cpu[0].csr[CSR_MENVCFG] & (1L << 63)){ //sstc expanded timer support
     clint->stimecmp = cpu[0].csr[CSR_STIMECMP];
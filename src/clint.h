@@ -8,6 +8,7 @@ typedef struct {
     uint64_t mtimecmp;                  // 比较寄存器
     uint64_t stimecmp;                  // S模式定时器比较寄存器  sstc 
     uint32_t msip;                      // 软件中断待处理寄存器
+    uint32_t tick_left;                 // 距 mtime 下一次加一还剩的 CPU 周期
     
     // 回调函数指针（用于通知CPU中断）
     void (*timer_interrupt_callback)(void);    // 时钟中断回调
@@ -18,6 +19,10 @@ typedef struct {
     bool software_interrupt_pending;
 } CLINT;
 
+#define CLINT_TICK_PERIOD 100            // 默认 1GHz / 10MHz
+
+extern uint32_t clint_tick_period;      // mtime（也就是 CSR time）每隔多少个 CPU 周期加一，由 timebase 决定
+
 void clint_init(CLINT* clint);
 void clint_reset(CLINT* clint);
 
@@ -21,7 +21,15 @@
 
 #define RESET "\033[0m"
 
-#define MAX_MMIO_REGIONS 8
+#define MAX_MMIO_REGIONS 16
+
+// 每台虚拟机一份的全局状态（cpu、bus、设备寄存器等）。libriscv-emu 里是线程局部的，
+// 每个线程换入自己正在跑的 Machine，不同线程上的机器互不相干；rv-emulator 只有一台机器，就是普通全局变量
+#ifdef RVEMU_VM_TLS
+#define VM_LOCAL _Thread_local
+#else
+#define VM_LOCAL
+#endif
 
 #define NUM_GPR 32
 #define NUM_FGPR 32
@@ -105,7 +113,11 @@
 #define MIE_MEIE (1UL << 11)
 
 /* 异常代码（同步异常） */
+#define EXC_INST_ACCESS  1
+#define EXC_ILLEGAL_INST 2
 #define EXC_BREAKPOINT 3
+#define EXC_LOAD_ACCESS  5
+#define EXC_STORE_ACCESS 7
 #define EXC_ECALL_U    8
 #define EXC_ECALL_S    9
 #define EXC_ECALL_M    11
@@ -149,6 +161,7 @@ typedef enum {
 
 #define MEMORY_SIZE 0x40000000//(1024UL * 1024UL * 1024UL * 1) // 4GB
 #define MEMORY_BASE 0x80000000         // 内存基地址
+#define CPU_CYCLE_PS 1000              // 每个 CPU 周期的虚拟时间（皮秒），对应 DTB 里 clock-frequency = 1GHz
 
 #define MEMORY_POOL_SIZE 0x40000000  // 例如 256MB 内存池
 #define BLOCK_SIZE 0x1000            // 每块内存的大小，例如每块 4KB
@@ -255,8 +268,10 @@ typedef struct {
 #define PLIC_HART_OFFSET  0x2000    // 每个 hart 的寄存器空间
 
 /* ---------- Configuration ---------- */
-#define UART_TX_BUF_SIZE 1024
-#define UART_RX_BUF_SIZE 1024
+#define UART_TX_BUF_SIZE 16384  // 必须是 2 的幂（无锁环用掩码取下标）；virtio-console 的整批输出也经过它
+#define UART_RX_BUF_SIZE 1024   // 同上
+#define UART_TX_WAKE_LEVEL  (UART_TX_BUF_SIZE / 2)  // tx_buf 攒到这么多字节立即写出
+#define UART_TX_COALESCE_US 200                     // 否则最多攒这么久（微秒）
 
 /* Register offsets (per device base) */
 #define UART_REG_DATA       0x00
@@ -310,15 +325,43 @@ typedef struct {
 
 #define VIRTIO_MMIO_BASE    0x10001000ULL
 #define VIRTIO_MMIO_SIZE    0x1000
+#define VIRTIO_NET_BASE     0x10002000ULL
+#define VIRTIO_NET_SIZE     0x1000
+#define VIRTIO_NET_IRQ      NET_RX_IRQ      // virtio-mmio 只有一根中断线，收发完成共用，驱动靠 InterruptStatus 和各队列的 used 环区分
+#define VIRTIO_CONSOLE_BASE 0x10003000ULL
+#define VIRTIO_CONSOLE_SIZE 0x1000
+#define VIRTIO_CONSOLE_IRQ  2
+#define VMCTL_BASE          0x10004000ULL   // 模拟器控制设备：fork 分叉点 / 退出码（见 vmfork.h）
+#define VMCTL_SIZE          0x1000
 
 // virtio-blk 请求类型
 #define VIRTIO_BLK_T_IN     0   // 读
 #define VIRTIO_BLK_T_OUT    1   // 写
+#define VIRTIO_BLK_T_FLUSH  4   // 刷盘
+#define VIRTIO_BLK_T_GET_ID 8   // 读设备 ID
+
+// virtio-blk 状态字节
+#define VIRTIO_BLK_S_OK     0
+#define VIRTIO_BLK_S_IOERR  1
+#define VIRTIO_BLK_S_UNSUPP 2
+
+// virtio 特性位
+#define VIRTIO_BLK_F_RO              5   // 只读设备
+#define VIRTIO_BLK_F_FLUSH           9   // 支持 FLUSH 命令
+#define VIRTIO_RING_F_INDIRECT_DESC  28  // 支持间接描述符表
+#define VIRTIO_F_VERSION_1           32  // modern 设备
+#define VIRTIO_NET_F_MAC             5   // config 里提供 MAC 地址
+#define VIRTIO_NET_F_MRG_RXBUF       15  // 一个帧可以跨多个接收缓冲区
+#define VIRTIO_NET_F_STATUS          16  // config 里提供链路状态
+#define VIRTIO_NET_S_LINK_UP         1
+#define VIRTIO_CONSOLE_F_SIZE        0   // config 里提供 cols/rows
+#define VIRTIO_CONSOLE_F_EMERG_WRITE 2   // 支持 emerg_wr 早期输出
 
 // virtio 描述符标志位
 #define VRING_DESC_F_NEXT    1   // 描述符链中还有下一个
 #define VRING_DESC_F_WRITE   2   // 设备可写（用于数据方向）
 #define VRING_DESC_F_INDIRECT 4  // 描述符指向间接描述符表
+#define VRING_DESC_SIZE      16  // addr(8) + len(4) + flags(2) + next(2)
 #define DISK_LATENCY_CYCLES 1000  // 模拟磁盘延迟：1000个CPU周期
 
 #endif
\ No newline at end of file
@@ -0,0 +1,235 @@
+// config.c
+// 机器描述的解析，格式见 config.h
+#include "config.h"
+#include "dts.h"
+#include <ctype.h>
+
+void config_defaults(MachineDesc *d) {
+    memset(d, 0, sizeof(*d));
+    d->kernel = "kernel";
+    d->disk = "fs.img";
+    d->overlay = getenv("RVEMU_DISK_OVERLAY");
+    d->serial = getenv("RVEMU_SERIAL");
+    d->net = getenv("RVEMU_NET");
+    d->ram_size = MEMORY_SIZE;
+    d->timebase = DEFAULT_TIMEBASE;
+    d->harts = 1;
+    d->engine = ENGINE_INTERP;
+    d->devices = DEV_ALL;
+    d->dtb = true;
+}
+
+// 带 K/M/G 后缀的大小
+static int parse_size(const char *s, uint64_t *out) {
+    char *end;
+    uint64_t v = strtoull(s, &end, 0);
+    if (end == s) return -1;
+    switch (toupper((unsigned char)*end)) {
+    case 'K': v <<= 10; end++; break;
+    case 'M': v <<= 20; end++; break;
+    case 'G': v <<= 30; end++; break;
+    }
+    if (strcmp(end, "iB") != 0 && strcmp(end, "B") != 0 && *end) return -1;
+    *out = v;
+    return 0;
+}
+
+static int parse_devices(const char *s, unsigned *out) {
+    static const struct { const char *name; unsigned bit; } names[] = {
+        { "virtio-blk", DEV_VIRTIO_BLK },
+        { "virtio-net", DEV_VIRTIO_NET },
+        { "virtio-console", DEV_VIRTIO_CONSOLE },
+        { "vmctl", DEV_VMCTL },
+    };
+    unsigned devs = 0;
+    if (strcmp(s, "none") == 0) {
+        *out = 0;
+        return 0;
+    }
+    while (*s) {
+        size_t len = strcspn(s, ",");
+        size_t i;
+        for (i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+            if (strlen(names[i].name) == len && strncmp(s, names[i].name, len) == 0) break;
+        if (i == sizeof(names) / sizeof(names[0])) {
+            fprintf(stderr, "[config] unknown device '%.*s'\n", (int)len, s);
+            return -1;
+        }
+        devs |= names[i].bit;
+        s += len;
+        if (*s == ',') s++;
+    }
+    *out = devs;
+    return 0;
+}
+
+int config_set(MachineDesc *d, const char *key, const char *value) {
+    char *v = strdup(value);
+    const uint64_t cpu_hz = 1000000000000ULL / CPU_CYCLE_PS;
+
+    if (strcmp(key, "kernel") == 0) {
+        d->kernel = v;
+    } else if (strcmp(key, "disk") == 0) {
+        d->disk = strcmp(v, "none") == 0 ? NULL : v;
+    } else if (strcmp(key, "overlay") == 0) {
+        d->overlay = v;
+    } else if (strcmp(key, "serial") == 0) {
+        d->serial = v;
+    } else if (strcmp(key, "net") == 0) {
+        d->net = strcmp(v, "none") == 0 ? NULL : v;
+    } else if (strcmp(key, "bootargs") == 0) {
+        d->bootargs = v;
+    } else if (strcmp(key, "initrd") == 0) {
+        d->initrd = strcmp(v, "none") == 0 ? NULL : v;
+    } else if (strcmp(key, "sbi") == 0) {
+        if (strcmp(v, "builtin") != 0 && strcmp(v, "none") != 0) {
+            fprintf(stderr, "[config] sbi must be builtin or none\n");
+            return -1;
+        }
+        d->sbi_builtin = strcmp(v, "builtin") == 0;
+    } else if (strcmp(key, "dtb") == 0) {
+        d->dtb = strcmp(v, "off") != 0 && strcmp(v, "none") != 0;
+        d->dtb_file = d->dtb && strcmp(v, "on") != 0 ? v : NULL;
+    } else if (strcmp(key, "ram") == 0) {
+        // RAM 的后备内存是编译时定的 MEMORY_SIZE，这里只能往小了配
+        if (parse_size(v, &d->ram_size) < 0 || d->ram_size < DTB_MAX_SIZE * 2 ||
+            d->ram_size > MEMORY_SIZE || (d->ram_size & 0xfff)) {
+            fprintf(stderr, "[config] bad ram size '%s' (page aligned, at most %lu MiB)\n",
+                    v, (uint64_t)MEMORY_SIZE >> 20);
+            return -1;
+        }
+    } else if (strcmp(key, "harts") == 0) {
+        int n = atoi(v);
+        if (n < 1 || n > MAX_CORES) {
+            fprintf(stderr, "[config] harts must be 1..%d\n", MAX_CORES);
+            return -1;
+        }
+        // CLINT / PLIC 的中断投递和主循环都只有 hart 0
+        if (n > 1) {
+            fprintf(stderr, "[config] harts=%d: only hart 0 is emulated\n", n);
+            return -1;
+        }
+        d->harts = n;
+    } else if (strcmp(key, "engine") == 0) {
+        if (strcmp(v, "interp") != 0) {
+            fprintf(stderr, "[config] engine '%s' is not available, only interp is built\n", v);
+            return -1;
+        }
+        d->engine = ENGINE_INTERP;
+    } else if (strcmp(key, "timebase") == 0) {
+        if (parse_size(v, &d->timebase) < 0 || d->timebase == 0 || d->timebase > cpu_hz) {
+            fprintf(stderr, "[config] timebase must be 1..%lu Hz\n", cpu_hz);
+            return -1;
+        }
+        // mtime 每 cpu_hz / timebase 个周期加一，除不尽时按实际频率写进设备树
+        uint64_t actual = cpu_hz / (cpu_hz / d->timebase);
+        if (actual != d->timebase)
+            fprintf(stderr, "[config] timebase %lu Hz rounded to %lu Hz\n", d->timebase, actual);
+        d->timebase = actual;
+    } else if (strcmp(key, "devices") == 0) {
+        if (parse_devices(v, &d->devices) < 0) return -1;
+    } else {
+        fprintf(stderr, "[config] unknown key '%s'\n", key);
+        free(v);
+        return -1;
+    }
+    return 0;
+}
+
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) s++;
+    char *e = s + strlen(s);
+    while (e > s && isspace((unsigned char)e[-1])) *--e = '\0';
+    return s;
+}
+
+int config_load(MachineDesc *d, const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "[config] cannot open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    char line[1024];
+    int lineno = 0, r = 0;
+    while (r == 0 && fgets(line, sizeof(line), fp)) {
+        lineno++;
+        char *s = trim(line);
+        if (*s == '\0' || *s == '#') continue;
+        char *eq = strchr(s, '=');
+        if (!eq) {
+            fprintf(stderr, "[config] %s:%d: expected key = value\n", path, lineno);
+            r = -1;
+            break;
+        }
+        *eq = '\0';
+        r = config_set(d, trim(s), trim(eq + 1));
+        if (r < 0) fprintf(stderr, "[config] %s:%d: rejected\n", path, lineno);
+    }
+    fclose(fp);
+    return r;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-c machine.cfg] [--key=value ...] [kernel]\n"
+            "keys: kernel disk overlay ram harts engine timebase devices serial net dtb bootargs sbi initrd\n"
+            "see src/config.h\n", prog);
+}
+
+int config_parse_args(MachineDesc *d, int argc, char **argv) {
+    // 先读配置文件，命令行的其他参数再覆盖它
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            usage(argv[0]);
+            return -1;
+        }
+        if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--config") == 0) {
+            if (++i == argc) {
+                usage(argv[0]);
+                return -1;
+            }
+            if (config_load(d, argv[i]) < 0) return -1;
+        }
+    }
+
+    bool have_kernel = false;
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        if (strcmp(a, "-c") == 0 || strcmp(a, "--config") == 0) {
+            i++;
+            continue;
+        }
+        if (strncmp(a, "--", 2) != 0) {
+            if (have_kernel) {
+                usage(argv[0]);
+                return -1;
+            }
+            have_kernel = true;
+            if (config_set(d, "kernel", a) < 0) return -1;
+            continue;
+        }
+        char key[64];
+        const char *value;
+        const char *eq = strchr(a + 2, '=');
+        if (eq) {
+            snprintf(key, sizeof(key), "%.*s", (int)(eq - a - 2), a + 2);
+            value = eq + 1;
+        } else {
+            if (i + 1 == argc) {
+                usage(argv[0]);
+                return -1;
+            }
+            snprintf(key, sizeof(key), "%s", a + 2);
+            value = argv[++i];
+        }
+        if (config_set(d, key, value) < 0) return -1;
+    }
+
+    if (!d->disk) d->devices &= ~DEV_VIRTIO_BLK;
+    if (d->sbi_builtin && !d->bootargs) d->bootargs = "console=ttyS0 earlycon=sbi";
+    if (d->initrd && !d->dtb) {
+        fprintf(stderr, "[config] initrd needs dtb (the range is passed in /chosen)\n");
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+// config.h
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include "common.h"
+
+/*
+ * 机器描述：rv-emulator 的命令行和配置文件
+ *
+ *   rv-emulator [-c machine.cfg] [--key=value | --key value ...] [kernel]
+ *
+ * 配置文件每行一个 key = value，# 开头是注释；命令行在配置文件之后处理，可以覆盖文件里的值。
+ *
+ *   kernel=<elf>           固件 / 内核 ELF，默认 kernel
+ *   disk=<img>|none        virtio-blk 的磁盘镜像，默认 fs.img
+ *   overlay=<file>         磁盘写入落到的 delta 文件，默认 $RVEMU_DISK_OVERLAY
+ *   ram=<size>[K|M|G]      客户机看到的内存大小，默认也是最大 MEMORY_SIZE，更大的值报错
+ *   harts=<n>              hart 数，默认 1
+ *   engine=interp          执行引擎
+ *   timebase=<hz>          CLINT mtime 和 CSR time 的频率，默认 10000000
+ *   devices=<list>         virtio-blk,virtio-net,virtio-console,vmctl 里挑，逗号分隔；none 表示都不要
+ *   serial=<spec>          UART 后端，默认 $RVEMU_SERIAL
+ *   net=<spec>             virtio-net 后端，默认 $RVEMU_NET，不给就不挂网卡
+ *   dtb=on|off|<file>      生成设备树放在内存顶部，a0 = hartid，a1 = DTB 地址；给文件名时另外写一份
+ *   bootargs=<string>      写进 /chosen/bootargs；sbi=builtin 时默认 "console=ttyS0 earlycon=sbi"
+ *   sbi=none|builtin       builtin：kernel 是 Linux Image（或 S 模式 ELF），用内置 SBI 从 S 模式直接启动（见 sbi.h）；
+ *                          none（默认）：kernel 是 OpenSBI / xv6 这类从 M 模式开始跑的固件
+ *   initrd=<file>          装在内存顶部 DTB 下面，范围写进 /chosen/linux,initrd-start / end
+ *
+ * 设备只能开关，地址和中断号是固定的（见 common.h），设备树按最后的描述生成。
+ */
+
+#define DEV_VIRTIO_BLK      (1u << 0)
+#define DEV_VIRTIO_NET      (1u << 1)
+#define DEV_VIRTIO_CONSOLE  (1u << 2)
+#define DEV_VMCTL           (1u << 3)
+#define DEV_ALL             (DEV_VIRTIO_BLK | DEV_VIRTIO_NET | DEV_VIRTIO_CONSOLE | DEV_VMCTL)
+
+#define DEFAULT_TIMEBASE    10000000        // CPU 每 100 个周期 mtime 加一
+
+enum { ENGINE_INTERP };
+
+typedef struct MachineDesc {
+    const char *kernel;
+    const char *disk;           // NULL = 不挂磁盘
+    const char *overlay;
+    const char *serial;
+    const char *net;
+    const char *bootargs;
+    const char *dtb_file;       // 另外把 DTB 写到这个文件
+    const char *initrd;
+    uint64_t initrd_start;      // main 装入 initrd 后填写，生成设备树用
+    uint64_t initrd_end;
+    uint64_t ram_size;
+    uint64_t timebase;
+    int harts;
+    int engine;
+    unsigned devices;           // DEV_*
+    bool dtb;
+    bool sbi_builtin;
+} MachineDesc;
+
+void config_defaults(MachineDesc *d);
+int config_set(MachineDesc *d, const char *key, const char *value);
+int config_load(MachineDesc *d, const char *path);
+// 解析 main 的参数；出错或 --help 返回 -1
+int config_parse_args(MachineDesc *d, int argc, char **argv);
+
+#endif
@@ -1,20 +1,25 @@
 // src/cpu.c
 #include "cpu.h"
+#include "stats.h"
+#include "trace.h"
 #include "bus.h"
 #include "decode.h"
 #include "plic.h"
 
-extern uint8_t* memory;
-extern Bus bus;
-extern int log_enable;
-extern PLICState plic;
-extern int j;
-CPU_State cpu[MAX_CORES];
+extern VM_LOCAL uint8_t* memory;
+extern VM_LOCAL Bus bus;
+VM_LOCAL CPU_State cpu[MAX_CORES];
+VM_LOCAL int j = 0;      // 主循环执行过的指令数，调试打印用
 
 CPU_State* get_current_cpu(void) {
     return &cpu[0];
 }
 
+static void init_tables(void) {
+    init_instruction_table();
+    init_syscall();
+}
+
 void cpu_init(CPU_State* cpu, uint8_t core_id) {
   
     if (cpu == NULL) {
@@ -30,6 +35,7 @@ void cpu_init(CPU_State* cpu, uint8_t core_id) {
 
     cpu->use_relaxed_memory = 0;//use_relaxed;
     cpu->privilege = 3; // M-mode
+    cpu->hartid = core_id;
 
     clint_init(&cpu->clint);
     cpu->bus = bus;
@@ -37,9 +43,9 @@ void cpu_init(CPU_State* cpu, uint8_t core_id) {
     cpu->mip = cpu->csr[CSR_MIP];
     cpu->mie = cpu->csr[CSR_MIE];
 
-    // 初始化指令表
-    init_instruction_table();
-    init_syscall();
+    // 初始化指令表：进程里只有一份，多台机器共用，只填一次
+    static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+    pthread_once(&tables_once, init_tables);
  
     printf("CPU initialization complete\n");
 }
@@ -55,25 +61,24 @@ void cpu_step(CPU_State* cpu, uint8_t* memory) {
         printf("ERROR: Memory pointer is NULL in cpu_step!\n");
         return;
     }
-    
-    if(log_enable){
-        printf("Fetching instruction from " GREEN "pc:" RESET RED "0x%08lx" 
-          RESET  "," GREEN"j:" RESET RED"%ld\n" RESET, cpu->pc,j);
-    }
+
+    uint64_t pc = cpu->pc;
+    uint8_t priv = cpu->privilege;
 
     // 取指
+    cpu->mem_fault.valid = 0;
     uint64_t instruction = fetch_instruction(cpu, memory);
-    if(log_enable){
-    printf("Instruction: 0x%08x\n", instruction);
-    }
     // 解码和执行
     decode_and_execute(cpu, instruction);
+    trace_record(cpu, pc, instruction, priv);
+    // 取指或访存翻译出错的指令没有退休，不计数
+    if (!cpu->mem_fault.valid) STAT_INC(inst_by_priv[priv & 3]);
     
     cpu->cycle_count++;
-    if(cpu->cycle_count % 100 == 0){
+    if(--cpu->clint.tick_left == 0){
+        cpu->clint.tick_left = clint_tick_period;
         clint_tick(&cpu->clint, 1);
     }
-    cpu->csr[CSR_TIME] += 10;
     
     // 更新性能计数器
     cpu->inst_count++;
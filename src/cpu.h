@@ -138,6 +138,13 @@ typedef struct {
         uint64_t vaddr;
     }mem_fault;
 
+    // 没交给客户机、直接让 hart 停下的异常（非法指令、没有映射的访问），模糊测试据此判断崩溃
+    struct{
+        uint8_t valid;
+        uint8_t cause;      // EXC_*
+        uint64_t addr;
+    }stop_fault;
+
 
 } CPU_State;
 
@@ -149,6 +156,12 @@ void cpu_dump_registers(CPU_State* cpu);
 
 static inline uint64_t read_csr(CPU_State *cpu, unsigned id){ return cpu->csr[id & 0xfff]; }
 static inline void write_csr(CPU_State *cpu, unsigned id, uint64_t v){ cpu->csr[id & 0xfff] = v; }
+
+static inline void cpu_stop_fault(CPU_State *cpu, uint8_t cause, uint64_t addr){
+    cpu->stop_fault.valid = 1;
+    cpu->stop_fault.cause = cause;
+    cpu->stop_fault.addr = addr;
+}
 uint64_t get_cpu_cycle(CPU_State *cpu);
 void cpu_try_wakeup(CPU_State *cpu);
 
@@ -7,7 +7,6 @@
 #include "memory.h"
 #include "mmu.h"
 
-extern int log_enable;
 
 // 指令解码表
 
@@ -117,6 +116,7 @@ static void handle_opcode(CPU_State* cpu,uint32_t instruction){
         opcode_table[opcode](cpu, instruction);
     } else {
         printf("Unknown instruction: 0x%08x at PC: 0x%08x\n", instruction, cpu->pc);
+        cpu_stop_fault(cpu, EXC_ILLEGAL_INST, cpu->pc);
         cpu->running = false;
     }
     
@@ -203,6 +203,7 @@ uint32_t fetch_instruction(CPU_State* cpu, uint8_t* memory) {
 void decode_and_execute(CPU_State* cpu, uint32_t instruction) {
     if (instruction == 0) {
        // printf("ERROR: Invalid instruction (0) at PC: 0x%08x\n", cpu->pc);
+        cpu_stop_fault(cpu, EXC_ILLEGAL_INST, cpu->pc);
         cpu->running = false;
         return;
     }
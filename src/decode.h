@@ -8,6 +8,14 @@
 // 指令执行函数类型
 typedef void (*instruction_handler_t)(CPU_State* cpu, uint32_t instruction);
 
+// 分发表（decode.c）；instmix 打开时会替换 opcode_table 的表项
+extern instruction_handler_t opcode_table[255];
+extern instruction_handler_t r_type_instruction[1024];
+extern instruction_handler_t i_type_imm_instruction[8];
+extern instruction_handler_t system_table[0xFFF];
+extern instruction_handler_t b_type_instr[8];
+extern instruction_handler_t csr_instr[3];
+
 // 函数声明
 void init_instruction_table(void);
 uint32_t fetch_instruction(CPU_State* cpu, uint8_t* memory);
@@ -0,0 +1,295 @@
+// disk_image.c
+// 磁盘镜像后端：base 只读 mmap + 可选的写时复制 overlay 文件
+#include "disk_image.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static int overlay_create(DiskImage *img, const char *path) {
+    int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) return -1;
+
+    DiskOverlayHeader *h = &img->hdr;
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, DISK_COW_MAGIC, 8);
+    h->version = DISK_COW_VERSION;
+    h->block_size = DISK_COW_BLOCK_SIZE;
+    h->base_size = img->base_size;
+    h->nblocks = (img->base_size + DISK_COW_BLOCK_SIZE - 1) / DISK_COW_BLOCK_SIZE;
+    h->index_off = DISK_COW_HDR_SIZE;
+    // 数据区按块对齐，索引表之后开始
+    uint64_t index_bytes = h->nblocks * sizeof(uint32_t);
+    h->data_off = (h->index_off + index_bytes + DISK_COW_BLOCK_SIZE - 1) & ~(uint64_t)(DISK_COW_BLOCK_SIZE - 1);
+    h->used_blocks = 0;
+
+    // ftruncate 出来的索引区是空洞，不占磁盘空间
+    if (pwrite(fd, h, sizeof(*h), 0) != (ssize_t)sizeof(*h) ||
+        ftruncate(fd, h->data_off) < 0) {
+        perror("overlay create");
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    printf("[disk] created overlay %s (%lu blocks)\n", path, h->nblocks);
+    return fd;
+}
+
+static int overlay_open(DiskImage *img, const char *path) {
+    int fd = overlay_create(img, path);
+    if (fd >= 0) return fd;
+    if (errno != EEXIST) {
+        fprintf(stderr, "Cannot create overlay %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    fd = open(path, O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open overlay %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    DiskOverlayHeader *h = &img->hdr;
+    if (pread(fd, h, sizeof(*h), 0) != (ssize_t)sizeof(*h) ||
+        memcmp(h->magic, DISK_COW_MAGIC, 8) != 0 ||
+        h->version != DISK_COW_VERSION ||
+        h->block_size != DISK_COW_BLOCK_SIZE) {
+        fprintf(stderr, "%s: not a valid disk overlay\n", path);
+        close(fd);
+        return -1;
+    }
+    if (h->base_size != img->base_size) {
+        fprintf(stderr, "%s: overlay was made for a %lu byte base, got %lu\n",
+                path, h->base_size, img->base_size);
+        close(fd);
+        return -1;
+    }
+    printf("[disk] opened overlay %s (%lu/%lu blocks written)\n", path, h->used_blocks, h->nblocks);
+    return fd;
+}
+
+DiskImage *disk_image_open(const char *base_path, const char *overlay_path) {
+    DiskImage *img = calloc(1, sizeof(DiskImage));
+    if (!img) return NULL;
+    img->overlay_fd = -1;
+    pthread_mutex_init(&img->lock, NULL);
+
+    img->base_fd = open(base_path, O_RDONLY);
+    if (img->base_fd < 0) {
+        fprintf(stderr, "Cannot open disk image: %s\n", base_path);
+        free(img);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(img->base_fd, &st) < 0) {
+        fprintf(stderr, "Cannot stat disk image %s: %s\n", base_path, strerror(errno));
+        close(img->base_fd);
+        free(img);
+        return NULL;
+    }
+    img->base_size = st.st_size;
+    img->size = img->base_size;
+
+    // raw 模式用私有可写映射：guest 写入只在本进程可见，不落盘，也不需要启动时拷贝
+    int prot = overlay_path ? PROT_READ : (PROT_READ | PROT_WRITE);
+    img->base = mmap(NULL, img->base_size ? img->base_size : 1, prot, MAP_PRIVATE, img->base_fd, 0);
+    if (img->base == MAP_FAILED) {
+        perror("mmap disk");
+        close(img->base_fd);
+        free(img);
+        return NULL;
+    }
+
+    if (overlay_path) {
+        img->overlay_fd = overlay_open(img, overlay_path);
+        if (img->overlay_fd < 0) {
+            disk_image_close(img);
+            return NULL;
+        }
+        img->index_bytes = img->hdr.nblocks * sizeof(uint32_t);
+        // 索引表共享映射，分配记录直接写回 overlay 文件
+        img->index = mmap(NULL, img->index_bytes ? img->index_bytes : 1, PROT_READ | PROT_WRITE,
+                          MAP_SHARED, img->overlay_fd, img->hdr.index_off);
+        if (img->index == MAP_FAILED) {
+            perror("mmap overlay index");
+            img->index = NULL;
+            disk_image_close(img);
+            return NULL;
+        }
+    }
+    return img;
+}
+
+void disk_image_close(DiskImage *img) {
+    if (!img) return;
+    disk_image_flush(img);
+    if (img->index) munmap(img->index, img->index_bytes ? img->index_bytes : 1);
+    if (img->overlay_fd >= 0) close(img->overlay_fd);
+    if (img->base && img->base != MAP_FAILED) munmap(img->base, img->base_size ? img->base_size : 1);
+    if (img->base_fd >= 0) close(img->base_fd);
+    pthread_mutex_destroy(&img->lock);
+    free(img->dirty);
+    free(img);
+}
+
+// 从 base 读取，超出 base 的部分补 0
+static void base_read(DiskImage *img, uint64_t off, uint8_t *buf, uint64_t len) {
+    if (off >= img->base_size) {
+        memset(buf, 0, len);
+        return;
+    }
+    uint64_t avail = img->base_size - off;
+    uint64_t n = len < avail ? len : avail;
+    memcpy(buf, img->base + off, n);
+    if (n < len) memset(buf + n, 0, len - n);
+}
+
+static uint64_t block_file_off(DiskImage *img, uint32_t slot) {
+    return img->hdr.data_off + (uint64_t)(slot - 1) * DISK_COW_BLOCK_SIZE;
+}
+
+// 读写都持 img->lock：块缓存的回写线程和 CPU 线程（未命中读）会同时访问同一块
+int disk_image_read(DiskImage *img, uint64_t off, void *buf, uint64_t len) {
+    if (off + len > img->size) return -1;
+    uint8_t *p = buf;
+
+    pthread_mutex_lock(&img->lock);
+    if (img->overlay_fd < 0) {
+        memcpy(p, img->base + off, len);
+        pthread_mutex_unlock(&img->lock);
+        return 0;
+    }
+
+    while (len > 0) {
+        uint64_t blk = off / DISK_COW_BLOCK_SIZE;
+        uint64_t in_blk = off % DISK_COW_BLOCK_SIZE;
+        uint64_t chunk = DISK_COW_BLOCK_SIZE - in_blk;
+        if (chunk > len) chunk = len;
+
+        uint32_t slot = img->index[blk];
+        if (slot) {
+            if (pread(img->overlay_fd, p, chunk, block_file_off(img, slot) + in_blk) != (ssize_t)chunk) {
+                perror("overlay read");
+                pthread_mutex_unlock(&img->lock);
+                return -1;
+            }
+        } else {
+            base_read(img, off, p, chunk);
+        }
+        off += chunk;
+        p += chunk;
+        len -= chunk;
+    }
+    pthread_mutex_unlock(&img->lock);
+    return 0;
+}
+
+/*
+ * 新分配的块数据已经写进 slot 之后才登记：先更新文件头的 used_blocks，最后写索引。
+ * 中途失败或进程退出时最多漏掉一个没被索引引用的 slot，索引不会指向还没写好的数据。
+ */
+static int overlay_publish(DiskImage *img, uint64_t blk, uint32_t slot) {
+    img->hdr.used_blocks++;
+    if (pwrite(img->overlay_fd, &img->hdr, sizeof(img->hdr), 0) != (ssize_t)sizeof(img->hdr)) {
+        perror("overlay header");
+        img->hdr.used_blocks--;
+        return -1;
+    }
+    img->index[blk] = slot;
+    return 0;
+}
+
+// 第一次写某块时，从 base 拷出整块作为 delta 的初值
+static uint32_t overlay_alloc_block(DiskImage *img, uint64_t blk) {
+    uint8_t tmp[DISK_COW_BLOCK_SIZE];
+    base_read(img, blk * DISK_COW_BLOCK_SIZE, tmp, DISK_COW_BLOCK_SIZE);
+
+    uint32_t slot = (uint32_t)(img->hdr.used_blocks + 1);
+    if (pwrite(img->overlay_fd, tmp, DISK_COW_BLOCK_SIZE, block_file_off(img, slot)) != DISK_COW_BLOCK_SIZE) {
+        perror("overlay alloc");
+        return 0;
+    }
+    return overlay_publish(img, blk, slot) < 0 ? 0 : slot;
+}
+
+static void mark_dirty(DiskImage *img, uint64_t off, uint64_t len) {
+    if (!img->dirty || len == 0) return;
+    for (uint64_t blk = off / DISK_COW_BLOCK_SIZE; blk <= (off + len - 1) / DISK_COW_BLOCK_SIZE; blk++)
+        __atomic_fetch_or(&img->dirty[blk >> 6], 1ull << (blk & 63), __ATOMIC_RELAXED);
+}
+
+int disk_image_write(DiskImage *img, uint64_t off, const void *buf, uint64_t len) {
+    if (off + len > img->size) return -1;
+    const uint8_t *p = buf;
+    mark_dirty(img, off, len);
+
+    pthread_mutex_lock(&img->lock);
+    if (img->overlay_fd < 0) {
+        memcpy(img->base + off, p, len);
+        pthread_mutex_unlock(&img->lock);
+        return 0;
+    }
+
+    while (len > 0) {
+        uint64_t blk = off / DISK_COW_BLOCK_SIZE;
+        uint64_t in_blk = off % DISK_COW_BLOCK_SIZE;
+        uint64_t chunk = DISK_COW_BLOCK_SIZE - in_blk;
+        if (chunk > len) chunk = len;
+
+        uint32_t slot = img->index[blk];
+        if (!slot && chunk == DISK_COW_BLOCK_SIZE) {
+            // 整块覆盖，不必先拷 base：数据写进新 slot 后再登记
+            slot = (uint32_t)(img->hdr.used_blocks + 1);
+            if (pwrite(img->overlay_fd, p, chunk, block_file_off(img, slot)) != (ssize_t)chunk ||
+                overlay_publish(img, blk, slot) < 0) {
+                perror("overlay write");
+                pthread_mutex_unlock(&img->lock);
+                return -1;
+            }
+        } else {
+            if (!slot) slot = overlay_alloc_block(img, blk);
+            if (!slot ||
+                pwrite(img->overlay_fd, p, chunk, block_file_off(img, slot) + in_blk) != (ssize_t)chunk) {
+                perror("overlay write");
+                pthread_mutex_unlock(&img->lock);
+                return -1;
+            }
+        }
+        off += chunk;
+        p += chunk;
+        len -= chunk;
+    }
+    pthread_mutex_unlock(&img->lock);
+    return 0;
+}
+
+int disk_image_flush(DiskImage *img) {
+    if (!img || img->overlay_fd < 0) return 0;
+    if (img->index) msync(img->index, img->index_bytes ? img->index_bytes : 1, MS_SYNC);
+    return fdatasync(img->overlay_fd);
+}
+
+// 第 blk 块（DISK_COW_BLOCK_SIZE 字节）是否和 base 文件不同：
+// overlay 模式看索引表；raw 模式的写入在私有映射里，只能和文件原内容逐块比较
+int disk_image_block_dirty(DiskImage *img, uint64_t blk) {
+    uint64_t off = blk * DISK_COW_BLOCK_SIZE;
+    if (off >= img->size) return 0;
+    if (img->overlay_fd >= 0) return img->index[blk] != 0;
+
+    uint8_t tmp[DISK_COW_BLOCK_SIZE];
+    uint64_t len = img->size - off < DISK_COW_BLOCK_SIZE ? img->size - off : DISK_COW_BLOCK_SIZE;
+    if (pread(img->base_fd, tmp, len, off) != (ssize_t)len) return 1;
+    return memcmp(tmp, img->base + off, len) != 0;
+}
+
+static uint64_t dirty_words(DiskImage *img) {
+    uint64_t nblocks = (img->size + DISK_COW_BLOCK_SIZE - 1) / DISK_COW_BLOCK_SIZE;
+    return (nblocks + 63) / 64;
+}
+
+void disk_image_dirty_enable(DiskImage *img) {
+    if (!img->dirty) img->dirty = calloc(dirty_words(img) ? dirty_words(img) : 1, sizeof(uint64_t));
+}
+
+// 取出并清零第 word 组（64 块）的脏位
+uint64_t disk_image_dirty_take(DiskImage *img, uint64_t word) {
+    if (!img->dirty || word >= dirty_words(img)) return 0;
+    return __atomic_exchange_n(&img->dirty[word], 0, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,63 @@
+// disk_image.h
+#ifndef DISK_IMAGE_H
+#define DISK_IMAGE_H
+
+#include "common.h"
+
+/*
+ * 磁盘镜像后端
+ *
+ *  raw 模式:     只有 base，MAP_PRIVATE 映射，写入只留在本进程（与旧的 malloc+fread 语义一致，但不拷贝）
+ *  overlay 模式: base 只读映射 + 每个 VM 一个稀疏 delta 文件（写时复制）
+ *
+ * overlay 文件布局：
+ *   [0, 4096)            DiskOverlayHeader
+ *   [index_off, ...)     uint32_t index[nblocks]   0 = 未分配，否则为 slot + 1
+ *   [data_off, ...)      数据块，按写入顺序追加，每块 block_size 字节
+ */
+
+#define DISK_COW_MAGIC      "RVCOW001"
+#define DISK_COW_VERSION    1
+#define DISK_COW_BLOCK_SIZE 4096
+#define DISK_COW_HDR_SIZE   4096
+
+typedef struct {
+    char     magic[8];
+    uint32_t version;
+    uint32_t block_size;
+    uint64_t base_size;     // base 镜像大小（字节）
+    uint64_t nblocks;       // 逻辑块数
+    uint64_t index_off;     // 索引表在文件中的偏移
+    uint64_t data_off;      // 数据区偏移
+    uint64_t used_blocks;   // 已分配的数据块数
+} DiskOverlayHeader;
+
+typedef struct {
+    uint64_t size;          // 逻辑磁盘大小（字节）
+
+    // base 镜像
+    int base_fd;
+    uint8_t *base;          // mmap 映射
+    uint64_t base_size;
+
+    // overlay (可选)
+    int overlay_fd;         // -1 表示 raw 模式
+    DiskOverlayHeader hdr;
+    uint32_t *index;        // MAP_SHARED 映射的索引表
+    uint64_t index_bytes;
+    pthread_mutex_t lock;   // 读写都要拿：hdr、index 和 raw 模式的私有映射
+
+    // 自上次快照检查点以来写过的块，每块一位；NULL 表示没打开跟踪。块缓存的回写线程也会写，按原子操作置位
+    uint64_t *dirty;
+} DiskImage;
+
+DiskImage *disk_image_open(const char *base_path, const char *overlay_path);
+void disk_image_close(DiskImage *img);
+int disk_image_read(DiskImage *img, uint64_t off, void *buf, uint64_t len);
+int disk_image_write(DiskImage *img, uint64_t off, const void *buf, uint64_t len);
+int disk_image_flush(DiskImage *img);
+int disk_image_block_dirty(DiskImage *img, uint64_t blk);
+void disk_image_dirty_enable(DiskImage *img);
+uint64_t disk_image_dirty_take(DiskImage *img, uint64_t word);
+
+#endif
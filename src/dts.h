@@ -1,11 +1,12 @@
 #ifndef DTS_H
 #define DTS_H
 #include <stdint.h>
+#include "common.h"
 
 
 #define FDT_MAGIC 0xd00dfeed
 
-// 设备树头结构
+// 设备树头结构（所有字段大端）
 struct fdt_header {
     uint32_t magic;
     uint32_t totalsize;
@@ -26,20 +27,14 @@ struct fdt_header {
 #define FDT_NOP        0x00000004
 #define FDT_END        0x00000009
 
-// 内存范围
-#define MEMORY_BASE    0x80000000
-#define MEMORY_SIZE    0x100000000  // 4GB
+#define DTB_MAX_SIZE   0x10000      // 生成的 DTB 不会超过 64 KiB，放在内存顶部这么大的地方
 
-// 设备地址
-#define UART0_BASE     0x10000000
-#define RTC_BASE       0x10100000
-#define PLIC_BASE      0x0c000000
-#define CLINT_BASE     0x02000000
+struct MachineDesc;
 
 // 函数声明
 uint32_t cpu_to_fdt32(uint32_t x);
 uint64_t cpu_to_fdt64(uint64_t x);
-void create_complete_device_tree(uint8_t *memory, uint64_t dtb_addr);
-void verify_dtb_for_opensbi(uint8_t *memory, uint64_t dtb_addr);
+// 按机器描述生成 DTB 写进 buf，返回大小；cap 不够返回 0
+uint32_t create_complete_device_tree(const struct MachineDesc *desc, uint8_t *buf, uint32_t cap);
 
-#endif
\ No newline at end of file
+#endif
@@ -1,7 +1,11 @@
 // elf_loader.c  -- RV32 ELF loader (minimal, synchronous)
 #include "elf_load.h"
+#include "memory.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
 
-extern uint8_t* memory;
+extern VM_LOCAL uint8_t* memory;
 /*
  * load_elf32:
  *   path     : ELF 文件路径
@@ -296,52 +300,117 @@ void load_elf32_virt(CPU_State* cpu, const char *filename, uint32_t *entry_point
 }
 
 
-int load_elf64_SBI(const char *filename, uint64_t *entry_point) {
-  //  if (!filename || !entry_point || !cpu) return -1;
+// 只读映射整个文件；fd_out 不为 NULL 时把 fd 留给调用者（直接映射段用）
+static const uint8_t *map_file(const char *path, size_t *size, int *fd_out) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "open(%s) failed: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        fprintf(stderr, "%s: empty or unreadable file\n", path);
+        close(fd);
+        return NULL;
+    }
+    void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+        fprintf(stderr, "mmap(%s) failed: %s\n", path, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    *size = st.st_size;
+    if (fd_out) *fd_out = fd;
+    else close(fd);
+    return p;
+}
 
-    FILE *f = fopen(filename, "rb");
-    if (!f) {
-        fprintf(stderr, "fopen(%s) failed: %s\n", filename, strerror(errno));
-        return -1;
+static int pread_all(int fd, uint8_t *buf, uint64_t len, uint64_t off) {
+    while (len) {
+        ssize_t n = pread(fd, buf, len, off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        buf += n;
+        off += n;
+        len -= n;
     }
+    return 0;
+}
 
-    // 读取 ELF64 header
-    Elf64_Ehdr eh;
-    if (fread(&eh, 1, sizeof(eh), f) != sizeof(eh)) {
-        fprintf(stderr, "Failed to read ELF header: %s\n", strerror(errno));
-        fclose(f);
+// 直接映射之后，客户机没写过的页就是文件的页缓存：文件被改写会透到客户机里，被截短时访问那几页是 SIGBUS。
+// 所以默认只映射没有任何写权限位的普通文件；RVEMU_LOAD_MAP=1 对可写的普通文件也映射，=0 一律拷贝
+static bool can_map_into_ram(const struct stat *st) {
+    if (!S_ISREG(st->st_mode)) return false;
+    const char *force = getenv("RVEMU_LOAD_MAP");
+    if (force) return atoi(force) != 0;
+    return !(st->st_mode & (S_IWUSR | S_IWGRP | S_IWOTH));
+}
+
+// 文件 [file_off, file_off+len) 装到 RAM 的 ram_off 处；map 为真、文件允许直接映射且两边都页对齐时整页直接映射，
+// 剩下的用 pread 拷贝。*mapped 返回直接映射的字节数；文件比打开时短了（加载期间被截短）返回 -1
+static int place_in_ram(int fd, uint64_t file_off, uint64_t ram_off, uint64_t len, bool map, uint64_t *mapped) {
+    uint64_t done = 0;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (uint64_t)st.st_size < file_off + len) {
+        fprintf(stderr, "[elf] file shrank while loading (0x%lx bytes at 0x%lx)\n", len, file_off);
+        return -1;
+    }
+    if (map && ((ram_off | file_off) & (RAM_PAGE_SIZE - 1)) == 0 && can_map_into_ram(&st)) {
+        uint64_t whole = len & ~(RAM_PAGE_SIZE - 1);
+        if (whole && mmap(memory + ram_off, whole, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+                          fd, file_off) != MAP_FAILED)
+            done = whole;
+    }
+    errno = 0;
+    if (pread_all(fd, memory + ram_off + done, len - done, file_off + done) < 0) {
+        fprintf(stderr, "[elf] read 0x%lx bytes at 0x%lx: %s\n", len - done, file_off + done,
+                errno ? strerror(errno) : "short read");
         return -1;
     }
+    if (mapped) *mapped = done;
+    return 0;
+}
 
-    // 验证 ELF 魔数和类型 & 机器
-    if (memcmp(eh.e_ident, ELFMAG, SELFMAG) != 0) {
+/*
+ * 把 ELF64 的 PT_LOAD 段装进客户机 RAM，返回装入的段数，出错返回 -1。
+ *
+ * 文件整个 mmap 进来解析头，段内容用 pread 一次拷完。不可写的段（代码、只读数据）文件偏移和加载地址都页对齐、
+ * 文件本身又允许直接映射时（见 can_map_into_ram），整页部分直接 MAP_PRIVATE | MAP_FIXED 映射到 RAM 上，不拷贝，
+ * 客户机写到哪页才复制哪页。BSS 交给 ram_zero，整页部分不碰内存。
+ */
+int load_elf64_SBI(const char *filename, uint64_t *entry_point) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    size_t fsize;
+    int fd;
+    const uint8_t *img = map_file(filename, &fsize, &fd);
+    if (!img) return -1;
+
+    int r = -1;
+    Elf64_Ehdr eh;
+    if (fsize < sizeof(eh) || memcmp(img, ELFMAG, SELFMAG) != 0) {
         fprintf(stderr, "Not an ELF file: %s\n", filename);
-        fclose(f);
-        return -1;
+        goto out;
     }
+    memcpy(&eh, img, sizeof(eh));
     if (eh.e_ident[EI_CLASS] != ELFCLASS64) {
         fprintf(stderr, "ELF is not 64-bit\n");
-        fclose(f);
-        return -1;
+        goto out;
     }
     if (eh.e_machine != EM_RISCV) {
         fprintf(stderr, "ELF is not RISC-V (e_machine=0x%x)\n", eh.e_machine);
-        fclose(f);
-        return -1;
+        goto out;
+    }
+    if (eh.e_phentsize < sizeof(Elf64_Phdr) || eh.e_phoff > fsize ||
+        (uint64_t)eh.e_phnum * eh.e_phentsize > fsize - eh.e_phoff) {
+        fprintf(stderr, "%s: program headers out of file\n", filename);
+        goto out;
     }
-
-    printf("=== openSBI ELF文件信息 ===\n");
-    printf("程序头数量: %" PRIu16 "\n", eh.e_phnum);
-    printf("程序头偏移: 0x%lx\n", (unsigned long)eh.e_phoff);
-    printf("程序头大小: %u\n", eh.e_phentsize);
-    printf("入口点: 0x%lx\n", (unsigned long)eh.e_entry);
-
-    // 选择加载基址（对于 fw_dynamic.elf 推荐 0x80000000）
-   // const uint64_t load_base = 0x80000000ULL;
 
     uint64_t load_base = 0;// 根据 ELF 类型动态处理
     // 计算并设置 entry point：
-    // - 对于 ET_DYN（PIE），entry 通常为相对地址或0，需加上 load_base
+    // - 对于 ET_DYN（PIE，如 fw_dynamic.elf），entry 通常为相对地址或0，需加上 load_base
     // - 对于 ET_EXEC，entry 是绝对虚拟地址
     if (eh.e_type == ET_DYN) {
         load_base = 0x80000000ULL;
@@ -355,95 +424,251 @@ int load_elf64_SBI(const char *filename, uint64_t *entry_point) {
     }
 
     int segments_loaded = 0;
+    uint64_t copied = 0, mapped = 0, zeroed = 0;
 
-    // 逐个 program header
-    printf("en.e_phnum:%d",eh.e_phnum);
     for (uint16_t i = 0; i < eh.e_phnum; ++i) {
-        // 定位到第 i 个 program header
-        off_t ph_off = (off_t)eh.e_phoff + (off_t)i * (off_t)eh.e_phentsize;
-        if (fseeko(f, ph_off, SEEK_SET) != 0) {
-            fprintf(stderr, "fseeko phdr failed: %s\n", strerror(errno));
+        Elf64_Phdr ph;
+        memcpy(&ph, img + eh.e_phoff + (uint64_t)i * eh.e_phentsize, sizeof(ph));
+        if (ph.p_type != PT_LOAD) continue;
+
+        // 加载地址当作物理地址（M 模式下虚拟==物理）：openSBI 加 load_base，xv6 / Linux 直接用 p_vaddr
+        uint64_t phys_addr = eh.e_type == ET_DYN ? ph.p_vaddr + load_base : ph.p_vaddr;
+
+        // 检查内存边界
+        if (phys_addr < MEMORY_BASE || ph.p_memsz > ram_size ||
+            phys_addr - MEMORY_BASE > ram_size - ph.p_memsz) {
+            fprintf(stderr, "Segment %u out of memory range: 0x%lx - 0x%lx (membase 0x%lx size 0x%lx)\n",
+                    i, (unsigned long)phys_addr, (unsigned long)(phys_addr + ph.p_memsz),
+                    (unsigned long)MEMORY_BASE, (unsigned long)ram_size);
             continue;
         }
-
-        Elf64_Phdr ph;
-        if (fread(&ph, 1, sizeof(ph), f) != sizeof(ph)) {
-            fprintf(stderr, "Failed to read phdr %u\n", i);
+        if (ph.p_filesz > ph.p_memsz || ph.p_offset > fsize || ph.p_filesz > fsize - ph.p_offset) {
+            fprintf(stderr, "Segment %u extends past end of file\n", i);
             continue;
         }
 
-        // 只处理 PT_LOAD 段
-        printf("ph.p_type:%d",ph.p_type);
-        if (ph.p_type != PT_LOAD) continue;
+        uint64_t off = phys_addr - MEMORY_BASE;
+        uint64_t done = 0;
+        if (place_in_ram(fd, ph.p_offset, off, ph.p_filesz, !(ph.p_flags & PF_W), &done) < 0) goto out;
+        ram_zero(off + ph.p_filesz, ph.p_memsz - ph.p_filesz);
 
+        mapped += done;
+        copied += ph.p_filesz - done;
+        zeroed += ph.p_memsz - ph.p_filesz;
+        segments_loaded++;
+    }
 
-        // 计算最终加载的虚拟地址（并把它当作物理地址使用）
-        
-        uint64_t virt_addr = 0;
-        if(eh.e_type == ET_DYN){
-            virt_addr = ph.p_vaddr + load_base; //openSBI
-        }else{
-            virt_addr = ph.p_vaddr; //xv6
-        }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("[elf] %s: %d segments, %.2f MiB copied, %.2f MiB mapped, %.2f MiB bss, %.2f ms\n",
+           filename, segments_loaded, copied / 1048576.0, mapped / 1048576.0, zeroed / 1048576.0,
+           (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+    r = segments_loaded;
 
-        uint64_t phys_addr = virt_addr; // 在你的模拟器中，M 模式下虚拟==物理 (或你将其视为直接物理地址)
+out:
+    munmap((void *)img, fsize);
+    close(fd);
+    return r;
+}
 
-        printf("\n--- LOAD 段 %u ---\n", i);
-        printf("orig p_vaddr: 0x%lx  offset: 0x%lx  filesz: 0x%lx  memsz: 0x%lx  flags: 0x%x\n",
-               (unsigned long)ph.p_vaddr, (unsigned long)ph.p_offset,
-               (unsigned long)ph.p_filesz, (unsigned long)ph.p_memsz, ph.p_flags);
-        printf("mapped virt -> phys: 0x%lx -> 0x%lx\n", (unsigned long)virt_addr, (unsigned long)phys_addr);
+/*
+ * 直接启动用的 Linux RISC-V Image（arch/riscv/boot/Image，头格式见内核文档 boot-image-header）：
+ * 装在 MEMORY_BASE + text_offset，入口就是装入地址；image_size 超出文件的部分是 BSS，清零。
+ * 文件是 ELF 时交给 load_elf64_SBI（按物理地址链接的 S 模式程序）。*end 返回内核占用的末地址。
+ * 文件允许直接映射时整个 MAP_PRIVATE 映射进 RAM，内核写到哪页才复制哪页，否则拷贝。
+ */
+int load_linux_image(const char *path, uint64_t *entry, uint64_t *end) {
+    size_t fsize;
+    int fd;
+    const uint8_t *img = map_file(path, &fsize, &fd);
+    if (!img) return -1;
+    if (fsize >= SELFMAG && memcmp(img, ELFMAG, SELFMAG) == 0) {
+        munmap((void *)img, fsize);
+        close(fd);
+        *end = MEMORY_BASE;
+        return load_elf64_SBI(path, entry) < 0 ? -1 : 0;
+    }
 
-        // 检查内存边界
-        if (phys_addr < MEMORY_BASE || (phys_addr + ph.p_memsz) > (MEMORY_BASE + MEMORY_SIZE)) {
-            fprintf(stderr, "Segment %u out of memory range: 0x%lx - 0x%lx (membase 0x%lx size 0x%lx)\n",
-                    i, (unsigned long)phys_addr, (unsigned long)(phys_addr + ph.p_memsz),
-                    (unsigned long)MEMORY_BASE, (unsigned long)MEMORY_SIZE);
-            continue;
-        }
+    int r = -1;
+    LinuxImageHeader h;
+    if (fsize < sizeof(h)) goto bad;
+    memcpy(&h, img, sizeof(h));
+    if (h.magic2 != LINUX_IMAGE_MAGIC2) goto bad;
+    uint64_t text_offset = h.text_offset ? h.text_offset : LINUX_TEXT_OFFSET;
+    uint64_t size = h.image_size > fsize ? h.image_size : fsize;
+    if ((text_offset & (RAM_PAGE_SIZE - 1)) || text_offset > ram_size || size > ram_size - text_offset) {
+        fprintf(stderr, "%s: image of 0x%lx bytes at offset 0x%lx does not fit in RAM\n", path, size, text_offset);
+        goto out;
+    }
+    uint64_t mapped = 0;
+    if (place_in_ram(fd, 0, text_offset, fsize, true, &mapped) < 0) goto out;
+    ram_zero(text_offset + fsize, size - fsize);
+    *entry = MEMORY_BASE + text_offset;
+    *end = *entry + size;
+    printf("[image] %s: 0x%lx - 0x%lx, %.2f MiB mapped\n", path, *entry, *end, mapped / 1048576.0);
+    r = 0;
+    goto out;
+bad:
+    fprintf(stderr, "%s: not a RISC-V Linux Image or ELF\n", path);
+out:
+    munmap((void *)img, fsize);
+    close(fd);
+    return r;
+}
 
-        // 将文件数据读取到内存
-        if (ph.p_filesz > 0) {
-            if (fseeko(f, (off_t)ph.p_offset, SEEK_SET) != 0) {
-                fprintf(stderr, "fseeko to file offset failed: %s\n", strerror(errno));
-                continue;
-            }
+// initrd：原样装在 [lo, hi) 里尽量靠上的位置，起点页对齐，范围通过 start / end 返回
+int load_initrd(const char *path, uint64_t lo, uint64_t hi, uint64_t *start, uint64_t *end) {
+    size_t fsize;
+    int fd;
+    const uint8_t *img = map_file(path, &fsize, &fd);
+    if (!img) return -1;
+    int r = -1;
+    uint64_t addr = (hi - fsize) & ~(RAM_PAGE_SIZE - 1);
+    if (lo < MEMORY_BASE || hi > MEMORY_BASE + ram_size || fsize > hi - lo || addr < lo) {
+        fprintf(stderr, "%s: 0x%zx bytes do not fit in 0x%lx - 0x%lx\n", path, fsize, lo, hi);
+    } else if (place_in_ram(fd, 0, addr - MEMORY_BASE, fsize, true, NULL) == 0) {
+        *start = addr;
+        *end = addr + fsize;
+        printf("[initrd] %s: 0x%lx - 0x%lx\n", path, *start, *end);
+        r = 0;
+    }
+    munmap((void *)img, fsize);
+    close(fd);
+    return r;
+}
 
-            size_t to_read = (size_t)ph.p_filesz;
-            uint8_t *dst = memory + (size_t)(phys_addr - MEMORY_BASE);
-            size_t read = fread(dst, 1, to_read, f);
-            if (read != to_read) {
-                fprintf(stderr, "Warning: read %zu of %zu bytes for segment %u\n", read, to_read, i);
-            }
+/* ---------- symbols ---------- */
+
+static int sym_cmp(const void *a, const void *b) {
+    const ElfSym *x = a, *y = b;
+    return x->addr < y->addr ? -1 : x->addr > y->addr;
+}
+
+/*
+ * 读取 ELF（32 / 64 位）的 .symtab 和它链接的字符串表，只保留有地址的 STT_FUNC 符号。
+ * 文件 mmap 进来直接解析，只拷贝字符串表（符号名指向它）。
+ * 没有 .symtab（被 strip）时返回 -1，tab 为空表。
+ */
+int elf_load_symbols(const char *path, ElfSymtab *tab) {
+    memset(tab, 0, sizeof(*tab));
+    size_t fsize;
+    const uint8_t *img = map_file(path, &fsize, NULL);
+    if (!img) return -1;
+
+    if (fsize < sizeof(Elf64_Ehdr) || memcmp(img, ELFMAG, SELFMAG) != 0) {
+        fprintf(stderr, "%s: not an ELF file\n", path);
+        goto fail;
+    }
+    bool is64 = img[EI_CLASS] == ELFCLASS64;
+
+    // 统一成 64 位的节头
+    uint64_t shoff, shnum, shentsize;
+    if (is64) {
+        const Elf64_Ehdr *eh = (const Elf64_Ehdr *)img;
+        shoff = eh->e_shoff; shnum = eh->e_shnum; shentsize = eh->e_shentsize;
+    } else {
+        const Elf32_Ehdr *eh = (const Elf32_Ehdr *)img;
+        shoff = eh->e_shoff; shnum = eh->e_shnum; shentsize = eh->e_shentsize;
+    }
+    if (!shoff || !shnum || shentsize < (is64 ? sizeof(Elf64_Shdr) : sizeof(Elf32_Shdr)) ||
+        shoff > fsize || shnum * shentsize > fsize - shoff)
+        goto fail;
+
+    Elf64_Shdr *sh = calloc(shnum, sizeof(Elf64_Shdr));
+    if (!sh) goto fail;
+    for (uint64_t i = 0; i < shnum; i++) {
+        const uint8_t *p = img + shoff + i * shentsize;
+        if (is64) {
+            memcpy(&sh[i], p, sizeof(Elf64_Shdr));
+        } else {
+            Elf32_Shdr s32;
+            memcpy(&s32, p, sizeof(s32));
+            sh[i].sh_type = s32.sh_type;
+            sh[i].sh_link = s32.sh_link;
+            sh[i].sh_offset = s32.sh_offset;
+            sh[i].sh_size = s32.sh_size;
+            sh[i].sh_entsize = s32.sh_entsize;
         }
+    }
 
-        // 若 memsz > filesz，需要将剩余部分清零（bss）
-        if (ph.p_memsz > ph.p_filesz) {
-            uint8_t *dst = memory + (size_t)(phys_addr - MEMORY_BASE + ph.p_filesz);
-            size_t zero_sz = (size_t)(ph.p_memsz - ph.p_filesz);
-            memset(dst, 0, zero_sz);
+    uint64_t symidx = shnum;
+    for (uint64_t i = 0; i < shnum; i++)
+        if (sh[i].sh_type == SHT_SYMTAB) { symidx = i; break; }
+    if (symidx == shnum || sh[symidx].sh_link >= shnum) {
+        fprintf(stderr, "%s: no .symtab\n", path);
+        free(sh);
+        goto fail;
+    }
+
+    Elf64_Shdr *ss = &sh[symidx], *st = &sh[ss->sh_link];
+    uint64_t entsize = ss->sh_entsize ? ss->sh_entsize : (is64 ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym));
+    if (ss->sh_offset > fsize || ss->sh_size > fsize - ss->sh_offset ||
+        st->sh_offset > fsize || st->sh_size > fsize - st->sh_offset ||
+        entsize < (is64 ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym))) {
+        fprintf(stderr, "%s: .symtab out of file\n", path);
+        free(sh);
+        goto fail;
+    }
+    const uint8_t *raw = img + ss->sh_offset;
+    uint64_t nsym = ss->sh_size / entsize;
+    tab->strtab = malloc(st->sh_size + 1);
+    tab->syms = calloc(nsym ? nsym : 1, sizeof(ElfSym));
+    if (!tab->strtab || !tab->syms) {
+        free(sh);
+        elf_symtab_free(tab);
+        goto fail;
+    }
+    memcpy(tab->strtab, img + st->sh_offset, st->sh_size);
+    tab->strtab[st->sh_size] = '\0';
+
+    for (uint64_t i = 0; i < nsym; i++) {
+        uint64_t value, size;
+        uint32_t name;
+        unsigned char info;
+        if (is64) {
+            Elf64_Sym s;
+            memcpy(&s, raw + i * entsize, sizeof(s));
+            value = s.st_value; size = s.st_size; name = s.st_name; info = s.st_info;
+        } else {
+            Elf32_Sym s;
+            memcpy(&s, raw + i * entsize, sizeof(s));
+            value = s.st_value; size = s.st_size; name = s.st_name; info = s.st_info;
         }
+        if (ELF64_ST_TYPE(info) != STT_FUNC || !value || name >= st->sh_size) continue;
+        ElfSym *e = &tab->syms[tab->count++];
+        e->addr = value;
+        e->size = size;
+        e->name = tab->strtab + name;
+    }
+    free(sh);
+    munmap((void *)img, fsize);
 
-        // 建立 vaddr->paddr 映射（如果你的模拟器有页表或映射逻辑）
-        uint32_t flags = 0;
-        if (ph.p_flags & PF_R) flags |= (1<<0); // 你原来的 PTE_R 等常量替换或保持
-        if (ph.p_flags & PF_W) flags |= (1<<1);
-        if (ph.p_flags & PF_X) flags |= (1<<2);
-        // 注意：这里 flags 的具体位要与你 map_vaddr_to_paddr 的实现对应
+    qsort(tab->syms, tab->count, sizeof(ElfSym), sym_cmp);
+    printf("[elf] %zu function symbols from %s\n", tab->count, path);
+    return 0;
 
-        // 调用映射函数（如果需要）；如果不需要，可以注释掉
-        //map_vaddr_to_paddr(cpu, virt_addr, phys_addr, ph.p_memsz, flags, cpu->asid);
+fail:
+    munmap((void *)img, fsize);
+    return -1;
+}
 
-        printf("✅ 加载段 %u 到 0x%lx (memsz 0x%lx)\n", i, (unsigned long)phys_addr, (unsigned long)ph.p_memsz);
-        segments_loaded++;
+// 找包含 addr 的函数；符号没有大小（汇编入口）时取地址不超过 addr 的最近一个
+const ElfSym *elf_symtab_lookup(const ElfSymtab *tab, uint64_t addr) {
+    size_t lo = 0, hi = tab->count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (tab->syms[mid].addr <= addr) lo = mid + 1;
+        else hi = mid;
     }
+    if (lo == 0) return NULL;
+    const ElfSym *s = &tab->syms[lo - 1];
+    if (s->size && addr >= s->addr + s->size) return NULL;
+    return s;
+}
 
-    printf("\n=== 加载完成 ===\n");
-    printf("成功加载 %d 个段\n", segments_loaded);
-    printf("程序入口: 0x%lx\n", (unsigned long)*entry_point);
-
-    fclose(f);
-    return segments_loaded;
+void elf_symtab_free(ElfSymtab *tab) {
+    free(tab->syms);
+    free(tab->strtab);
+    memset(tab, 0, sizeof(*tab));
 }
 
 /* Example main: 测试用 */
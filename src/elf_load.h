@@ -8,5 +8,49 @@
 int load_elf32_bare(const char *path, uint8_t *mem, size_t mem_size, uint32_t mem_base, CPU_State *cpu);
 void load_elf32_virt(CPU_State* cpu,const char *filename, uint32_t *entry_point);
 
+/*
+ * 内核 / Image / initrd 的整页部分可以直接 MAP_PRIVATE 映射进客户机 RAM（不拷贝，客户机写到哪页才复制哪页）。
+ * 映射之后客户机没写过的页就是文件的页缓存：运行期间改写文件会透进客户机，截短文件会让模拟器 SIGBUS。
+ * 所以默认只对没有写权限位的普通文件直接映射，其余用 pread 拷贝；装载时文件变短了报错。
+ *   RVEMU_LOAD_MAP=1   可写的普通文件也直接映射（确定运行期间没人动它）
+ *   RVEMU_LOAD_MAP=0   一律拷贝
+ */
 int load_elf64_SBI(const char *filename, uint64_t *entry_point) ;
+
+// Linux RISC-V Image 的 64 字节头
+typedef struct {
+    uint32_t code0, code1;
+    uint64_t text_offset;   // 相对 RAM 起始的装入偏移
+    uint64_t image_size;    // 含 BSS 的大小
+    uint64_t flags;
+    uint32_t version;
+    uint32_t res1;
+    uint64_t res2;
+    uint64_t magic;         // "RISCV\0\0\0"，已废弃
+    uint32_t magic2;        // "RSC\x05"
+    uint32_t res3;
+} LinuxImageHeader;
+
+#define LINUX_IMAGE_MAGIC2  0x05435352
+#define LINUX_TEXT_OFFSET   0x200000        // 头里 text_offset 为 0 时用的默认值（RV64 按 2 MiB 对齐）
+
+int load_linux_image(const char *path, uint64_t *entry, uint64_t *end);
+int load_initrd(const char *path, uint64_t lo, uint64_t hi, uint64_t *start, uint64_t *end);
+
+// .symtab 里的函数符号，按地址排序（给 profiler 等做符号化用）
+typedef struct {
+    uint64_t addr;
+    uint64_t size;
+    const char *name;   // 指向 ElfSymtab.strtab
+} ElfSym;
+
+typedef struct {
+    ElfSym *syms;
+    size_t count;
+    char *strtab;
+} ElfSymtab;
+
+int elf_load_symbols(const char *path, ElfSymtab *tab);
+const ElfSym *elf_symtab_lookup(const ElfSymtab *tab, uint64_t addr);
+void elf_symtab_free(ElfSymtab *tab);
 #endif
\ No newline at end of file
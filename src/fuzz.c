@@ -0,0 +1,257 @@
+// fuzz.c
+// 从内存快照反复运行客户机的持久化模糊测试，见 fuzz.h
+#include "fuzz.h"
+#include "cpu.h"
+#include "uart.h"
+#include "trap.h"
+#include "memory.h"
+#include "snapshot.h"
+#include "virtio_blk.h"
+#include "virtio_net.h"
+#include "block_cache.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/shm.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+
+extern VM_LOCAL uint8_t *memory;
+extern VM_LOCAL CPU_State cpu[MAX_CORES];
+extern VM_LOCAL virtio_blk_device dev;
+
+uint8_t *fuzz_cov;
+bool fuzz_armed;
+
+static struct {
+    const char *input;
+    int64_t buf;            // -1 = 用写 MARKER 的值
+    int64_t sector;         // -1 = 写内存
+    uint32_t max_len;
+    uint64_t max_insns;
+    uint64_t insns;         // 上一轮执行的指令数
+    bool afl;
+    UARTDevice *uart;
+    MemSnapshot *snap;
+    uint8_t *data;
+} fz;
+
+int fuzz_init(const char *input, UARTDevice *uart) {
+    fz.uart = uart;
+    if (!input) return 0;
+    if (getenv("RVEMU_FORK")) {
+        fprintf(stderr, "[fuzz] RVEMU_FUZZ and RVEMU_FORK both use the marker, pick one\n");
+        return -1;
+    }
+    fz.input = input;
+
+    const char *v = getenv("RVEMU_FUZZ_BUF");
+    fz.buf = v ? (int64_t)strtoull(v, NULL, 0) : -1;
+    v = getenv("RVEMU_FUZZ_SECTOR");
+    fz.sector = v ? (int64_t)strtoull(v, NULL, 0) : -1;
+    v = getenv("RVEMU_FUZZ_MAX_LEN");
+    fz.max_len = v && atoi(v) > 0 ? atoi(v) : 4096;
+    v = getenv("RVEMU_FUZZ_MAX_INSNS");
+    fz.max_insns = v && strtoull(v, NULL, 0) ? strtoull(v, NULL, 0) : 10000000;
+
+    if (fz.sector >= 0 && !dev.disk) {
+        fprintf(stderr, "[fuzz] RVEMU_FUZZ_SECTOR needs a virtio disk\n");
+        return -1;
+    }
+    if (netdev.running) {
+        fprintf(stderr, "[fuzz] cannot reset virtio-net backends between runs, unset RVEMU_NET\n");
+        return -1;
+    }
+    fz.data = malloc(fz.max_len);
+
+    // afl-fuzz 会设 __AFL_SHM_ID 并把控制管道接在 198 上
+    fz.afl = getenv("__AFL_SHM_ID") && fcntl(FUZZ_FORKSRV_FD, F_GETFD) != -1;
+    // 每轮在 fork 出来的子进程里跑：raw 镜像是私有映射，子进程写了不影响下一轮；overlay 是共享文件，会
+    if (fz.afl && dev.disk && dev.disk->overlay_fd >= 0) {
+        fprintf(stderr, "[fuzz] afl-fuzz runs each input in a forked child, use a raw disk image without overlay\n");
+        return -1;
+    }
+    fuzz_armed = true;
+    printf("[fuzz] input %s%s, waiting for marker\n", input, fz.afl ? " (afl-fuzz)" : "");
+    return 0;
+}
+
+static uint32_t read_input(const char *path) {
+    int fd = strcmp(path, "-") == 0 ? 0 : open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    if (fd == 0) lseek(0, 0, SEEK_SET);   // afl-fuzz 每轮重写同一个文件
+    uint32_t len = 0;
+    while (len < fz.max_len) {
+        ssize_t n = read(fd, fz.data + len, fz.max_len - len);
+        if (n <= 0) break;
+        len += n;
+    }
+    if (fd != 0) close(fd);
+    return len;
+}
+
+static void inject(uint32_t len) {
+    if (fz.sector >= 0) {
+        uint64_t off = (uint64_t)fz.sector * 512;
+        if (off >= dev.disk->size) return;
+        if (len > dev.disk->size - off) len = dev.disk->size - off;
+        if (dev.cache) block_cache_write(dev.cache, off, fz.data, len);
+        else disk_image_write(dev.disk, off, fz.data, len);
+        return;
+    }
+    uint64_t off = fz.buf - MEMORY_BASE;
+    memcpy(memory + off, fz.data, len);
+    ram_mark_dirty(off, len);
+}
+
+// 一轮：复位、注入、运行；崩溃时返回对应的信号，正常结束返回 0
+static int run_one(uint32_t len) {
+    CPU_State *c = &cpu[0];
+    snapshot_reset(fz.snap, fz.uart);
+    inject(len);
+    vmctl_input_len = len;
+    vmctl_exit_code = 0;
+    vmfork_pending = 0;
+    c->stop_fault.valid = 0;
+
+    uint64_t end = c->inst_count + fz.max_insns;
+    while (c->running && !c->halted && c->inst_count < end) {
+        cpu_step(c, memory);
+        virtio_disk_update(&c->cycle_count);
+        if (fz.uart && fz.uart->baud_emulation) uart_update(fz.uart, c->cycle_count * CPU_CYCLE_PS);
+        check_and_handle_interrupts(c);
+    }
+    fz.insns = c->inst_count - (end - fz.max_insns);
+    // 停在 wfi / ebreak 是正常结束，只有没交给客户机处理的异常才算崩溃
+    if (c->stop_fault.valid) return c->stop_fault.cause == EXC_ILLEGAL_INST ? SIGILL : SIGSEGV;
+    if (!c->running && vmctl_exit_code) return SIGABRT;
+    return 0;
+}
+
+// fork server 的子进程：跑一轮，崩溃时用对应的信号结束自己，afl-fuzz 从 wait 状态里看到
+static void afl_child(void) {
+    close(FUZZ_FORKSRV_FD);
+    close(FUZZ_FORKSRV_FD + 1);
+    if (fz.uart && uart_resume(fz.uart, NULL) < 0) _exit(125);
+    if (dev.disk) dev.cache = block_cache_create(dev.disk, 0);
+    int sig = run_one(read_input(fz.input));
+    if (fz.uart) uart_pause(fz.uart);   // 写完串口输出
+    if (sig) {
+        signal(sig, SIG_DFL);
+        raise(sig);
+    }
+    _exit(0);
+}
+
+// fork server 协议：先回 4 字节问候，之后每轮读 4 字节开始信号，回 pid 和 wait 状态。
+// 每轮从停在 MARKER 的这个进程 fork 一个子进程来跑，报给 afl-fuzz 的是子进程的 pid：
+// 超时时 afl-fuzz 杀掉的是子进程，fork server 还在
+static void afl_loop(void) {
+    // 停掉主机线程，fork 只复制当前线程；块缓存在子进程里重建
+    if (fz.uart) uart_pause(fz.uart);
+    if (dev.cache) {
+        block_cache_destroy(dev.cache);
+        dev.cache = NULL;
+    }
+    fflush(NULL);
+
+    uint32_t msg = 0;
+    if (write(FUZZ_FORKSRV_FD + 1, &msg, 4) != 4) {
+        fprintf(stderr, "[fuzz] afl-fuzz status pipe is gone\n");
+        exit(1);
+    }
+    for (;;) {
+        if (read(FUZZ_FORKSRV_FD, &msg, 4) != 4) exit(0);   // afl-fuzz 退出了
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("[fuzz] fork");
+            exit(1);
+        }
+        if (pid == 0) afl_child();
+        uint32_t child = pid;
+        if (write(FUZZ_FORKSRV_FD + 1, &child, 4) != 4) exit(1);
+        int status;
+        if (waitpid(pid, &status, 0) < 0) {
+            perror("[fuzz] waitpid");
+            exit(1);
+        }
+        if (write(FUZZ_FORKSRV_FD + 1, &status, 4) != 4) exit(1);
+    }
+}
+
+static int skip_dots(const struct dirent *d) {
+    return d->d_name[0] != '.';
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// 不在 afl-fuzz 下：跑一个文件或整个语料目录
+static void replay(void) {
+    struct stat st;
+    struct dirent **names = NULL;
+    int n = 1;
+    if (strcmp(fz.input, "-") != 0 && stat(fz.input, &st) == 0 && S_ISDIR(st.st_mode)) {
+        n = scandir(fz.input, &names, skip_dots, alphasort);
+        if (n < 0) {
+            perror("[fuzz] scandir");
+            exit(1);
+        }
+    }
+
+    int crashes = 0;
+    double t0 = now_sec();
+    for (int i = 0; i < n; i++) {
+        char path[4096];
+        if (names) snprintf(path, sizeof(path), "%s/%s", fz.input, names[i]->d_name);
+        else snprintf(path, sizeof(path), "%s", fz.input);
+        free(names ? names[i] : NULL);
+
+        uint32_t len = read_input(path);
+        int status = run_one(len);
+        if (status) crashes++;
+        printf("[fuzz] %s: %u bytes, %s, %lu instructions\n", path, len,
+               status == SIGILL ? "illegal instruction" : status == SIGSEGV ? "access fault" :
+               status ? "crash" : "ok", fz.insns);
+    }
+    free(names);
+    double dt = now_sec() - t0;
+
+    uint64_t edges = 0;
+    for (uint32_t i = 0; i < FUZZ_MAP_SIZE; i++) edges += fuzz_cov[i] != 0;
+    printf("[fuzz] %d inputs, %d crashes, %lu edges, %.0f execs/s\n",
+           n, crashes, edges, dt > 0 ? n / dt : 0.0);
+    if (fz.uart) uart_destroy(fz.uart);
+    exit(crashes ? 1 : 0);
+}
+
+void fuzz_run(void) {
+    fuzz_armed = false;
+    vmfork_pending = 0;
+    if (fz.buf < 0) fz.buf = vmctl_marker_value;
+    if (fz.sector < 0 && (fz.buf < MEMORY_BASE || fz.buf + fz.max_len > MEMORY_BASE + MEMORY_SIZE)) {
+        fprintf(stderr, "[fuzz] input buffer 0x%lx+%u is not in RAM\n", fz.buf, fz.max_len);
+        exit(1);
+    }
+
+    if (fz.afl) {
+        fuzz_cov = shmat(atoi(getenv("__AFL_SHM_ID")), NULL, 0);
+        if (fuzz_cov == (void *)-1) {
+            perror("[fuzz] shmat");
+            exit(1);
+        }
+    } else {
+        fuzz_cov = calloc(1, FUZZ_MAP_SIZE);
+    }
+
+    printf("[fuzz] marker reached at pc=0x%lx after %lu instructions, input at %s 0x%lx\n",
+           cpu[0].pc, cpu[0].inst_count, fz.sector >= 0 ? "sector" : "paddr",
+           fz.sector >= 0 ? (uint64_t)fz.sector : (uint64_t)fz.buf);
+    fz.snap = snapshot_take(fz.uart);
+    if (fz.afl) afl_loop();
+    replay();
+}
@@ -0,0 +1,55 @@
+// fuzz.h
+#ifndef FUZZ_H
+#define FUZZ_H
+
+#include "common.h"
+#include "vmfork.h"
+
+/*
+ * 持久化模糊测试
+ *
+ * 客户机把被测代码准备好之后写 VMCTL 的 MARKER，模拟器在这里把整机状态存进内存（snapshot_take），
+ * 之后每一轮：复位到快照（只拷回上一轮改过的内存页和磁盘块）、把输入写进客户机缓冲区或磁盘扇区、
+ * 从 MARKER 之后的下一条指令跑起，客户机读 VMCTL 的 INPUT_LEN 得到长度，处理完写 EXIT 结束本轮。
+ * EXIT 写非 0 算崩溃（SIGABRT）；非法指令算 SIGILL，没有映射的访问算 SIGSEGV；
+ * hart 停在 wfi / ebreak 和跑满 RVEMU_FUZZ_MAX_INSNS 条指令都算正常结束。
+ *
+ * 覆盖率：跳转成立的条件分支和 jal / jalr（含压缩指令）各记一条边 (from, to)，
+ * 按 AFL 的方式在 64 KiB 位图里计数，MARKER 之前不记。
+ * 在 afl-fuzz 下运行时位图是 __AFL_SHM_ID 指向的共享内存，每一轮由 fork server 管道（fd 198/199）驱动：
+ * 停在 MARKER 的进程每轮 fork 一个子进程跑这一轮，崩溃时子进程被对应的信号结束，报给 afl-fuzz 的是子进程的 pid，
+ * 超时被杀的也只是子进程。子进程里的写不会带到下一轮，磁盘只能用不带 overlay 的 raw 镜像。
+ *
+ *   RVEMU_FUZZ=<path>           输入文件，afl-fuzz 下每轮重读（- 为 stdin，afl-fuzz 不带 @@ 时用）；
+ *                               不在 afl-fuzz 下时可以是单个文件或语料目录，逐个跑完打印结果和覆盖到的边数
+ *   RVEMU_FUZZ_BUF=<paddr>      输入写到这个物理地址，默认用写 MARKER 的值
+ *   RVEMU_FUZZ_SECTOR=<n>       改为写进 virtio 磁盘第 n 个扇区开始的位置
+ *   RVEMU_FUZZ_MAX_LEN=<bytes>  输入截断到这个长度，默认 4096
+ *   RVEMU_FUZZ_MAX_INSNS=<N>    每一轮的指令上限，默认 10000000
+ */
+
+#define FUZZ_MAP_SIZE       (1 << 16)
+#define FUZZ_FORKSRV_FD     198     // afl-fuzz 写控制，199 回状态
+
+extern uint8_t *fuzz_cov;           // 覆盖率位图，NULL = 不记
+extern bool fuzz_armed;             // 打开了模糊测试，还没到 MARKER
+
+struct UARTDevice;
+int fuzz_init(const char *input, struct UARTDevice *uart);
+void fuzz_run(void);
+
+// 分支 / 跳转成立时调用
+static inline void fuzz_edge(uint64_t from, uint64_t to) {
+    if (__builtin_expect(fuzz_cov != NULL, 0)) {
+        uint64_t a = (from >> 1) ^ (from >> 17);   // 指令 2 字节对齐
+        uint64_t b = (to >> 1) ^ (to >> 17);
+        fuzz_cov[(b ^ (a >> 1)) & (FUZZ_MAP_SIZE - 1)]++;
+    }
+}
+
+// 主循环调用：打开模糊测试时 MARKER 进入 fuzz_run，不再返回
+static inline void fuzz_poll(void) {
+    if (__builtin_expect(fuzz_armed && vmfork_pending, 0)) fuzz_run();
+}
+
+#endif
@@ -0,0 +1,212 @@
+// instmix.c
+#include "instmix.h"
+#include "instructions.h"
+#include "decode.h"
+
+// 打开前 opcode_table 的原表项，计数后从这里分发
+static instruction_handler_t opcode_table_orig[128];
+static bool instmix_on;
+static char instmix_path[256];
+
+static struct {
+    instruction_handler_t fn;
+    uint64_t count;
+} handler_slots[INSTMIX_HANDLER_SLOTS];
+static uint64_t handler_overflow;
+
+// 压缩指令：quadrant * 8 + funct3，后面接 funct3 = 100 的细分
+enum {
+    RVC_Q1_ALU = 24,    // c.srli c.srai c.andi c.sub c.xor c.or c.and c.subw c.addw
+    RVC_Q2_MISC = 33,   // c.jr c.mv c.ebreak c.jalr c.add
+    RVC_KEYS = 38,
+};
+static uint64_t rvc_counts[RVC_KEYS];
+static uint64_t opcode_counts[128];
+
+static const char *rvc_names[RVC_KEYS] = {
+    "c.addi4spn", "c.fld", "c.lw", "c.ld", "c.q0-100", "c.fsd", "c.sw", "c.sd",
+    "c.addi", "c.addiw", "c.li", "c.addi16sp/c.lui", "c.q1-100", "c.j", "c.beqz", "c.bnez",
+    "c.slli", "c.fldsp", "c.lwsp", "c.ldsp", "c.q2-100", "c.fsdsp", "c.swsp", "c.sdsp",
+    "c.srli", "c.srai", "c.andi", "c.sub", "c.xor", "c.or", "c.and", "c.subw", "c.addw",
+    "c.jr", "c.mv", "c.ebreak", "c.jalr", "c.add",
+};
+
+static const char *opcode_names[128] = {
+    [0x00] = "C0", [0x01] = "C1", [0x02] = "C2",
+    [0x03] = "LOAD", [0x07] = "LOAD-FP", [0x0f] = "MISC-MEM", [0x13] = "OP-IMM",
+    [0x17] = "AUIPC", [0x1b] = "OP-IMM-32", [0x23] = "STORE", [0x27] = "STORE-FP",
+    [0x2f] = "AMO", [0x33] = "OP", [0x37] = "LUI", [0x3b] = "OP-32",
+    [0x53] = "OP-FP", [0x63] = "BRANCH", [0x67] = "JALR", [0x6f] = "JAL", [0x73] = "SYSTEM",
+};
+
+#define H(f) { (instruction_handler_t)(f), #f }
+static const struct {
+    instruction_handler_t fn;
+    const char *name;
+} handler_names[] = {
+    H(exec_lui), H(exec_auipc), H(exec_jal), H(exec_jalr),
+    H(exec_ecall), H(exec_addi), H(exec_sub), H(exec_add), H(exec_mul), H(exec_sfencevma),
+    H(exec_store), H(exec_ebreak), H(exec_load), H(exec_sltu), H(exec_bltu), H(exec_beq),
+    H(exec_bne), H(exec_bge), H(exec_blt), H(exec_bgeu), H(exec_slli), H(exec_slti),
+    H(exec_sltiu), H(exec_si), H(exec_ori), H(exec_andi), H(exec_xori), H(exec_or),
+    H(exec_and), H(exec_xor), H(exec_div), H(exec_divu), H(exec_remu), H(exec_srl),
+    H(exec_csr), H(exec_mret), H(exec_sret), H(exec_wfi), H(exec_amo), H(exec_iw),
+    H(exec_fence), H(exec_float), H(exec_3b),
+};
+#undef H
+
+// 和 decode.c 的二级分发保持一致，找出这条指令最终会进哪个处理函数
+static instruction_handler_t leaf_handler(uint32_t insn) {
+    uint8_t opcode = insn & 0x7f;
+    uint8_t funct3 = (insn >> 12) & 0x7;
+    switch (opcode) {
+        case 0x13: return i_type_imm_instruction[funct3];
+        case 0x33: return r_type_instruction[((insn >> 25) & 0x7f) << 3 | funct3];
+        case 0x63: return b_type_instr[funct3];
+        case 0x73: {
+            if (funct3) return csr_instr[0x1];
+            uint32_t imm12 = (insn >> 20) & 0xfff;
+            if (((insn >> 25) & 0x3f) == 0x09) return system_table[0x09];
+            if (imm12 == 0x302) return system_table[0xA];
+            if (imm12 <= 1 || imm12 == 0x102 || imm12 == 0x105) return system_table[imm12];
+            return NULL;
+        }
+        default:
+            return opcode_table_orig[opcode];
+    }
+}
+
+static int rvc_key(uint32_t insn) {
+    int quadrant = insn & 0x3;
+    int funct3 = (insn >> 13) & 0x7;
+    if (quadrant == 1 && funct3 == 4) {
+        int op = (insn >> 10) & 0x3;
+        if (op < 3) return RVC_Q1_ALU + op;                         // srli srai andi
+        int sub = ((insn >> 5) & 0x3) | ((insn >> 10) & 0x4);       // bit12:bit6:5
+        return sub < 6 ? RVC_Q1_ALU + 3 + (sub & 3) + (sub >> 2) * 4 : RVC_Q1_ALU + 3;
+    }
+    if (quadrant == 2 && funct3 == 4) {
+        bool bit12 = (insn >> 12) & 1;
+        int rs1 = (insn >> 7) & 0x1f, rs2 = (insn >> 2) & 0x1f;
+        if (!bit12) return RVC_Q2_MISC + (rs2 ? 1 : 0);             // c.mv / c.jr
+        if (!rs1 && !rs2) return RVC_Q2_MISC + 2;                   // c.ebreak
+        return RVC_Q2_MISC + (rs2 ? 4 : 3);                         // c.add / c.jalr
+    }
+    return quadrant * 8 + funct3;
+}
+
+static void count_handler(instruction_handler_t fn) {
+    uint32_t i = ((uintptr_t)fn >> 4) & (INSTMIX_HANDLER_SLOTS - 1);
+    for (int probe = 0; probe < INSTMIX_HANDLER_SLOTS; probe++, i = (i + 1) & (INSTMIX_HANDLER_SLOTS - 1)) {
+        if (handler_slots[i].fn == fn) {
+            handler_slots[i].count++;
+            return;
+        }
+        if (!handler_slots[i].fn) {
+            handler_slots[i].fn = fn;
+            handler_slots[i].count = 1;
+            return;
+        }
+    }
+    handler_overflow++;
+}
+
+// 打开后 opcode_table 的每个非空表项都指向这里
+static void instmix_dispatch(CPU_State *cpu, uint32_t insn) {
+    uint8_t opcode = (insn & 0x3) == 0x3 ? insn & 0x7f : insn & 0x3;
+    opcode_counts[opcode]++;
+    if (opcode <= 0x02) {
+        rvc_counts[rvc_key(insn)]++;
+    } else {
+        instruction_handler_t fn = leaf_handler(insn);
+        if (fn) count_handler(fn);
+    }
+    opcode_table_orig[opcode](cpu, insn);
+}
+
+int instmix_enable(const char *out_path) {
+    if (instmix_on) return 0;
+    snprintf(instmix_path, sizeof(instmix_path), "%s", out_path ? out_path : "-");
+    for (int i = 0; i < 128; i++) {
+        opcode_table_orig[i] = opcode_table[i];
+        if (opcode_table[i]) opcode_table[i] = instmix_dispatch;
+    }
+    instmix_on = true;
+    printf("[instmix] counting enabled\n");
+    return 0;
+}
+
+void instmix_set_clone(int id) {
+    if (strcmp(instmix_path, "-") == 0) return;
+    size_t n = strlen(instmix_path);
+    snprintf(instmix_path + n, sizeof(instmix_path) - n, ".clone-%d", id);
+}
+
+/* ---------- report ---------- */
+
+typedef struct {
+    const char *name;
+    uint64_t count;
+} MixRow;
+
+static int row_cmp(const void *a, const void *b) {
+    const MixRow *x = a, *y = b;
+    return x->count < y->count ? 1 : x->count > y->count ? -1 : 0;
+}
+
+static void print_rows(FILE *f, const char *title, MixRow *rows, int n, uint64_t total) {
+    qsort(rows, n, sizeof(MixRow), row_cmp);
+    fprintf(f, "\n# %s\n# %14s %7s %7s  %s\n", title, "count", "%", "cum%", "name");
+    uint64_t cum = 0;
+    for (int i = 0; i < n && rows[i].count; i++) {
+        cum += rows[i].count;
+        fprintf(f, "  %14lu %6.2f%% %6.2f%%  %s\n", rows[i].count,
+                100.0 * rows[i].count / total, 100.0 * cum / total, rows[i].name);
+    }
+}
+
+static const char *handler_name(instruction_handler_t fn) {
+    for (size_t i = 0; i < sizeof(handler_names) / sizeof(handler_names[0]); i++)
+        if (handler_names[i].fn == fn) return handler_names[i].name;
+    return "?";
+}
+
+void instmix_dump(void) {
+    if (!instmix_on) return;
+
+    uint64_t total = 0;
+    for (int i = 0; i < 128; i++) total += opcode_counts[i];
+    if (!total) return;
+
+    FILE *f = strcmp(instmix_path, "-") == 0 ? stderr : fopen(instmix_path, "w");
+    if (!f) {
+        fprintf(stderr, "[instmix] cannot write %s: %s\n", instmix_path, strerror(errno));
+        return;
+    }
+    fprintf(f, "# instruction mix: %lu instructions\n", total);
+
+    // 处理函数表：32 位指令按 exec_*，压缩指令按 c.xxx 细分
+    MixRow rows[INSTMIX_HANDLER_SLOTS + RVC_KEYS];
+    int n = 0;
+    for (int i = 0; i < INSTMIX_HANDLER_SLOTS; i++)
+        if (handler_slots[i].fn)
+            rows[n++] = (MixRow){ handler_name(handler_slots[i].fn), handler_slots[i].count };
+    for (int i = 0; i < RVC_KEYS; i++)
+        if (rvc_counts[i]) rows[n++] = (MixRow){ rvc_names[i], rvc_counts[i] };
+    print_rows(f, "by handler", rows, n, total);
+
+    char names[128][24];
+    n = 0;
+    for (int i = 0; i < 128; i++) {
+        if (!opcode_counts[i]) continue;
+        snprintf(names[i], sizeof(names[i]), "0x%02x %s", i, opcode_names[i] ? opcode_names[i] : "?");
+        rows[n++] = (MixRow){ names[i], opcode_counts[i] };
+    }
+    print_rows(f, "by major opcode", rows, n, total);
+
+    uint64_t rvc = opcode_counts[0] + opcode_counts[1] + opcode_counts[2];
+    fprintf(f, "\n# compressed: %lu (%.2f%%)\n", rvc, 100.0 * rvc / total);
+    if (handler_overflow) fprintf(f, "# handler table overflow: %lu\n", handler_overflow);
+
+    if (f != stderr) fclose(f);
+}
@@ -0,0 +1,21 @@
+// instmix.h
+#ifndef INSTMIX_H
+#define INSTMIX_H
+
+#include "common.h"
+
+/*
+ * 指令组合直方图：按最终执行的 exec_* 处理函数（压缩指令再按 c.xxx 细分）
+ * 和主操作码统计动态执行次数。
+ *
+ * 打开时把 opcode_table 里的每个表项换成计数分发函数，原表项另存一份；
+ * 关闭时分发路径和原来完全一样，没有额外的判断。
+ */
+
+#define INSTMIX_HANDLER_SLOTS 256   // 按处理函数指针散列，2 的幂
+
+int instmix_enable(const char *out_path);
+void instmix_dump(void);
+void instmix_set_clone(int id);
+
+#endif
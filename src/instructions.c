@@ -6,11 +6,13 @@
 #include "trap_vector.h"
 #include "mmu.h"
 #include "bus.h"
+#include "vmfork.h"
+#include "fuzz.h"
+#include "sbi.h"
 
 
-extern uint8_t* memory;
-extern int log_enable;
-extern int j;
+extern VM_LOCAL uint8_t* memory;
+extern VM_LOCAL int j;
 
 static inline print_all_gpr(CPU_State* cpu){
     fprintf(stderr,"x0~x31 value=========================\n");
@@ -50,10 +52,6 @@ void exec_c0(CPU_State* cpu,uint16_t instr){
                 cpu->gpr[rd] = cpu->gpr[2] + imm10;
             }               
             cpu->pc += 2;
-            if(log_enable){
-            fprintf(stderr,"[c.addi4spn] sp:0x%16lx + imm:0x%16lx,x[%d]:0x%16lx\n",
-                        cpu->gpr[2],imm10,rd,cpu->gpr[rd]);
-            }
             break;
         }
     case 0b010://c.lw
@@ -71,9 +69,6 @@ void exec_c0(CPU_State* cpu,uint16_t instr){
                  
                 cpu->gpr[rd] = (int64_t)(int32_t)bus_read(&cpu->bus,pa,4);
             }
-            if(log_enable){
-                fprintf(stderr,"[c.lw] x[%d]:0x%08lx,addr:0x%16lx, pa:0x%08lx\n",rd,cpu->gpr[rd],addr,pa);
-            }
             cpu->pc += 2;
             break;
         }
@@ -88,8 +83,6 @@ void exec_c0(CPU_State* cpu,uint16_t instr){
         uint64_t addr = cpu->gpr[rs1] + imm;      
         uint64_t pa = get_pa(cpu,addr,ACC_STORE);
         bus_write(&cpu->bus,pa,cpu->gpr[rs2],4);
-        if(log_enable)
-            fprintf(stderr,"[c.sw after] imm:0x%08lx,pa:0x%08x,rs2 val:%d 0x%08x\n",imm,pa,rs2,cpu->gpr[rs2]);
         cpu->pc += 2;
         break;
     }
@@ -106,11 +99,6 @@ void exec_c0(CPU_State* cpu,uint16_t instr){
       
         bus_write(&cpu->bus,pa,cpu->gpr[rs2],8);
         cpu->pc += 2;
-        if(log_enable){
-        fprintf(stderr,"[c.sd ] vaddr:0x%16lx,pa:0x%16lx\n",addr,pa);
-        fprintf(stderr,"[c.sd] x[%d]:0x%16lx,pa:0x%16lx,x[%d]:0x%16lx\n",
-            rs1,cpu->gpr[rs1],pa,rs2,cpu->gpr[rs2]);
-        }
         break;
     }
     case 0b011: //c.ld
@@ -130,11 +118,6 @@ void exec_c0(CPU_State* cpu,uint16_t instr){
         
         cpu->gpr[rd] = val;
         cpu->pc += 2;
-        if(log_enable){
-            fprintf(stderr,"[c.ld] vaddr:0x%16lx\n",vaddr);
-            fprintf(stderr,"[c.ld load 64bits] x[%d]:0x%16lx = load from pa:0x%16lx\n",
-                rd,cpu->gpr[rd],pa);
-        }
         break;
     }
     
@@ -167,9 +150,6 @@ void exec_c1(CPU_State* cpu,uint16_t instr){
                 cpu->gpr[rd] += imm;
             }
 
-            if(log_enable){
-            fprintf(stderr,"[c.addi] x[%d]:0x%16lx,imm:0x%16lx\n",rd,cpu->gpr[rd],imm);
-            }
                
             cpu->pc += 2;  // 压缩指令 PC +2   
         break;
@@ -182,15 +162,9 @@ void exec_c1(CPU_State* cpu,uint16_t instr){
             uint32_t imm6 = ((instr >> 12) & 0x1) << 5 |
                             ((instr >> 2) & 0x1F);
             int32_t imm = ((int32_t)imm6 << 26) >>26;
-            if(log_enable){
-            fprintf(stderr,"[before c.addiw] x[%d]:0x%16lx,imm:0x%08x\n",rd,cpu->gpr[rd],imm);
-            }
             int64_t result = (int64_t)((int64_t)cpu->gpr[rd] + imm);
             cpu->gpr[rd] = result;
             cpu->pc += 2;
-            if(log_enable){
-            fprintf(stderr,"[c.addiw] x[%d]:0x%16lx,imm:0x%08x\n",rd,cpu->gpr[rd],imm);
-            }
         }
         else //c.jal
         {
@@ -218,9 +192,6 @@ void exec_c1(CPU_State* cpu,uint16_t instr){
             cpu->gpr[rd] = imm;
         }
 
-        if(log_enable){
-        fprintf(stderr,"[c.li] x[%d]:0x%16lx = imm:0x%16lx\n",rd,cpu->gpr[rd],imm);
-        }
         cpu->pc += 2;
         break;
     }
@@ -235,9 +206,6 @@ void exec_c1(CPU_State* cpu,uint16_t instr){
                 imm = (int64_t)(((int32_t)imm18 << 14) >> 14);
                 if(rd != 0 && rd != 0x2)
                     cpu->gpr[rd] = imm;
-                if(log_enable){
-                fprintf(stderr,"[c.lui] x[%d]:0x%016lx\n",rd,cpu->gpr[rd]);
-                }
                 cpu->pc += 2;
             }else{ // c.addi16sp
                 uint32_t imm6 = ((instr >> 2) & 0x1) << 5 |
@@ -248,16 +216,8 @@ void exec_c1(CPU_State* cpu,uint16_t instr){
                
 
                 int64_t imm = (int64_t)((int32_t)(imm6 << 22) >> 22);
-                if(log_enable){
-                    fprintf(stderr,"[before c.addi16sp] x[2]:0x%08lx,imm:%d\n",cpu->gpr[2],imm);
-                    fprintf(stderr,"[imm6] imm6:0x%08lx\n",imm6);
-                }
                 cpu->gpr[rd] += imm; 
                 cpu->pc += 2;
-                if(log_enable){
-                    fprintf(stderr,"[c.addi16sp] x[rd:%d]:0x%08lx,imm:0x%16lx\n",
-                        rd,cpu->gpr[rd],imm);
-                }
 
             }
             break;
@@ -274,23 +234,13 @@ void exec_c1(CPU_State* cpu,uint16_t instr){
                             ((instr >> 12) & 0x1) << 5;
             cpu->gpr[rd] >>= shamt;
             cpu->pc += 2;
-            if(log_enable){
-            fprintf(stderr,"[c.srli] x[%d]:0x%16lx\n",rd,cpu->gpr[rd]);
-            }
             
         }else if(funct2_10_11 == 0b01){//c.srai c.srai64
             uint8_t shamt = (instr >> 2) & 0x1F | 
                             (((instr >> 12) & 0x1) << 5);
-             if(log_enable){
-                fprintf(stderr,"[before c.srai] x[%d]:0x%08lx,shamt:%d\n",rd,cpu->gpr[rd],shamt);
-            }
 
 
             cpu->gpr[rd] = (int64_t)cpu->gpr[rd] >> shamt;
-            if(log_enable){
-                fprintf(stderr,"[after c.srai] x[%d]:0x%08lx,shamt:%d\n",rd,cpu->gpr[rd],shamt);
-
-            }
 
             cpu->pc += 2;
 
@@ -300,9 +250,6 @@ void exec_c1(CPU_State* cpu,uint16_t instr){
             int32_t imm = (int32_t)(imm6 << 26) >> 26;
             cpu->gpr[rd] &= imm;
 
-            if(log_enable){
-                fprintf(stderr,"x[%d]:0x%08lx,imm:0x%08lx\n",rd,cpu->gpr[rd],imm);
-            }
 
             cpu->pc += 2;
 
@@ -310,38 +257,18 @@ void exec_c1(CPU_State* cpu,uint16_t instr){
             if(funct2_56 == 0b11){ // c.and
                 cpu->gpr[rd] &= cpu->gpr[rs2];
                 cpu->pc += 2; 
-                if(log_enable){
-                fprintf(stderr,"[c.and] x[%d]:0x%16lx,x[%d]:0x%16lx\n",rd,cpu->gpr[rd],
-                rs2,cpu->gpr[rs2]);
-                }
             }else if(funct2_56 == 0b10){ //c.or
                 cpu->gpr[rd] |= cpu->gpr[rs2];
-                if(log_enable){
-                    fprintf(stderr,"[c.or] x[%d]:0x%16lx |= x[%d]:0x%16lx\n",
-                        rd,cpu->gpr[rd],rs2,cpu->gpr[rs2]);
-                }
 
                 cpu->pc += 2;
             }else if(funct2_56 == 0b00){ //c.sub
                 cpu->gpr[rd] -= cpu->gpr[rs2];
                 cpu->pc += 2;
-                if(log_enable){
-                    fprintf(stderr,"[c.sub] x[rd:%d]:0x%08lx,x[rs2:%d]:0x%08lx\n",rd,
-                        cpu->gpr[rd],rs2,cpu->gpr[rs2]);
-                }
             }else if(funct2_56 == 0b01){ //c.addw
-            if(log_enable){
-                    fprintf(stderr,"[before c.addw] x[%d]:0x%16lx , x[%d]:0x%16lx\n",
-                        rd,cpu->gpr[rd],rs2,cpu->gpr[rs2]);
-                }
 
                 int32_t sum = (int32_t)cpu->gpr[rd] + (int32_t)cpu->gpr[rs2];
                 cpu->gpr[rd] = (int32_t)sum;
                 cpu->pc += 2;
-                if(log_enable){
-                    fprintf(stderr,"[c.addw] x[%d]:0x%16lx = x[%d]:0x%16lx + x[%d]:0x%16lx\n",
-                        rd,cpu->gpr[rd],rd,cpu->gpr[rd],rs2,cpu->gpr[rs2]);
-                }
             }
         }
         break;
@@ -357,10 +284,8 @@ void exec_c1(CPU_State* cpu,uint16_t instr){
                         ((instr >> 11) & 0x1) << 4 |
                         ((instr >> 12) & 0x1) << 11; 
             int64_t imm = (int64_t)(((int32_t)imm11 << 20) >> 20);
+            fuzz_edge(cpu->pc, cpu->pc + imm);
             cpu->pc += imm;
-            if(log_enable){
-            fprintf(stderr,"[c.j] imm:0x%16lx\n",imm);
-            }
             break;
         }
     case 0b111://c.bnez  not equal to 0,jump to (pc+imm)
@@ -375,13 +300,11 @@ void exec_c1(CPU_State* cpu,uint16_t instr){
         //fprintf(stderr,"-----a5:0x%08x\n",cpu->gpr[15]);
 
         if(cpu->gpr[rs1] != 0){
+            fuzz_edge(cpu->pc, cpu->pc + imm);
             cpu->pc += imm;
         }else{
             cpu->pc += 2;
         }
-        if(log_enable){
-        fprintf(stderr,"[c.bnez not equal to 0,jump]x[%d]:0x%16lx,imm:0x%16lx\n",rs1,cpu->gpr[rs1],imm);
-        }
 
         break;
     }
@@ -395,13 +318,11 @@ void exec_c1(CPU_State* cpu,uint16_t instr){
         int64_t imm = (int64_t) (((int32_t)imm8 << 23) >> 23);
         uint8_t rs1 = ((instr >> 7) & 0x7) + 8;
         if(cpu->gpr[rs1] == 0){
+            fuzz_edge(cpu->pc, cpu->pc + imm);
             cpu->pc += imm;
         }else{
             cpu->pc += 2;
         }
-        if(log_enable){
-        fprintf(stderr,"[c.beqz rs1==0 jump]x[%d]:0x%16lx, imm:0x%16lx\n",rs1,cpu->gpr[rs1],imm);
-        }
 
         break;
     }
@@ -429,9 +350,6 @@ void exec_c2(CPU_State* cpu,uint16_t instr){
             cpu->gpr[rd] = cpu->gpr[rd] << shamt;
         }
         cpu->pc += 2;
-        if(log_enable){
-        fprintf(stderr,"[c.slli] shamt:0x%08x, x[%d]:0x%16lx\n",shamt,rd,cpu->gpr[rd]);
-        }
 
 
         break;
@@ -448,9 +366,6 @@ void exec_c2(CPU_State* cpu,uint16_t instr){
         if(rd != 0){
             cpu->gpr[rd] = bus_read(&cpu->bus,pa,4);
         }
-        if(log_enable){
-            fprintf(stderr,"[c.lwsp]imm:0x%08x,pa:0x%08x,ra:0x%08x\n",imm,pa,cpu->gpr[rd]);
-        }
         cpu->pc += 2;
         break;
     }
@@ -460,9 +375,6 @@ void exec_c2(CPU_State* cpu,uint16_t instr){
                         ((instr >> 5) & 0x3) << 3 |
                         ((instr >> 12) & 0x1) << 5;
         uint64_t imm = (uint64_t)(uint32_t)imm6;
-        if(log_enable){
-            printf("[before c.ldsp]x[2]:0x%16lx ,imm:0x%16lx\n",cpu->gpr[2],imm);
-        }
 
         uint64_t vaddr = cpu->gpr[2] + imm;
         int64_t val = 0;
@@ -472,10 +384,6 @@ void exec_c2(CPU_State* cpu,uint16_t instr){
         val = bus_read(&cpu->bus,pa,8);
         cpu->gpr[rd] = val;
         cpu->pc += 2;
-        if(log_enable){
-            fprintf(stderr,"[c.ldsp] x[%d]:0x%16lx,vaddr:0x%16lx,pa:0x%08lx\n",
-                                        rd,cpu->gpr[rd],vaddr,pa);
-        }
         break;
     }
 
@@ -490,9 +398,6 @@ void exec_c2(CPU_State* cpu,uint16_t instr){
         uint64_t pa = get_pa(cpu,addr,ACC_STORE);
 
         bus_write(&cpu->bus,pa,cpu->gpr[rs2],4);
-        if(log_enable){
-            fprintf(stderr,"c.swsp pa : 0x%08x ,rs2 val:%d 0x%08x\n",pa,rs2,cpu->gpr[rs2]);
-        }
         cpu->pc += 2;
         break;
     }
@@ -503,27 +408,19 @@ void exec_c2(CPU_State* cpu,uint16_t instr){
             if(instr12 == 0){ //c.jr
                 if(rs1 != 0){
                     //fprintf(stderr,"c.jr rs1:0x%08x\n",cpu->gpr[rs1]);
+                    fuzz_edge(cpu->pc, cpu->gpr[rs1]);
                     cpu->pc = cpu->gpr[rs1];
                 }
-                if(log_enable){
-                fprintf(stderr,"[c.jr c.ret] pc = x[%d]:0x%16lx\n",rs1,cpu->gpr[rs1]);
-                }
+            }else if(rs1 == 0){ //c.ebreak
+                exec_ebreak(cpu, instr);
             }else{ //c.jalr   
 
-                if(log_enable){
-                    fprintf(stderr,"[before c.jalr or c.ret] x[15] = 0x%16lx\n",
-                        cpu->gpr[rs1]);
-                }
 
                 cpu->gpr[0x1] = cpu->pc+2;
                 if(rs1 != 0){
+                    fuzz_edge(cpu->pc, cpu->gpr[rs1] & ~1ULL);
                     cpu->pc = (cpu->gpr[rs1] & ~1ULL); // 将最低位置0
                 }
-                if(log_enable){
-                    printf("x[rs1:%d]:0x%16lx\n",rs1,cpu->gpr[rs1]);
-                fprintf(stderr,"[c.jalr or c.ret] x[0x1]:0x%16lx,pc = 0x%16lx\n",
-                        cpu->gpr[0x1],cpu->pc);
-                } 
 
             }
         }else if(rs1 != 0){
@@ -531,21 +428,9 @@ void exec_c2(CPU_State* cpu,uint16_t instr){
                 cpu->gpr[rs1] = cpu->gpr[rs2];
                 cpu->pc += 2;
 
-            if(log_enable){
-            fprintf(stderr,"[c.mv] x[%d]:0x%16lx,x[%d]:0x%16lx\n",rs1,cpu->gpr[rs1],
-                    rs2,cpu->gpr[rs2]);
-            }
             }else{ //c.add
-                if(log_enable){
-                fprintf(stderr,"[before c.add] x[%d]:0x%16lx,x[%d]:0x%16lx,x[%d]:0x%16lx\n",
-                rd,cpu->gpr[rd],rs1,cpu->gpr[rs1],rs2,cpu->gpr[rs2]);
-                }
                 cpu->gpr[rd] = cpu->gpr[rs1] + cpu->gpr[rs2];
                 cpu->pc += 2;
-            if(log_enable){
-            fprintf(stderr,"[c.add] x[%d]:0x%16lx,x[%d]:0x%16lx,x[%d]:0x%16lx\n",
-                rd,cpu->gpr[rd],rs1,cpu->gpr[rs1],rs2,cpu->gpr[rs2]);
-            }
             }
         }
         
@@ -558,26 +443,14 @@ void exec_c2(CPU_State* cpu,uint16_t instr){
         uint64_t imm = (uint64_t)imm6;
         uint64_t vaddr = cpu->gpr[2] + imm;
 
-        if(log_enable){
-
-            printf("[c.sdsp] x[2]:0x%16lx, imm:0x%16lx\n",cpu->gpr[2],imm);
-        }
 
         int64_t val = 0;
-        if(log_enable){
-            fprintf(stderr,"[before c.sdsp] x[%d]:0x%16lx,vaddr:0x%16lx,imm:0x%08lx\n",
-                rs2,cpu->gpr[rs2],vaddr,imm);
-        }
 
         uint64_t pa = get_pa(cpu,vaddr,ACC_STORE);
 
         bus_write(&cpu->bus,pa,cpu->gpr[rs2],8);
         
         cpu->pc += 2;
-        if(log_enable){
-        fprintf(stderr,"[c.sdsp] addr:0x%16lx,pa:0x%08lx,x[%d]:0x%16lx\n",
-                                        vaddr,pa,rs2,cpu->gpr[rs2]);
-        }
 
         
     }
@@ -617,10 +490,6 @@ void exec_addi(CPU_State* cpu,uint32_t instruction){
     if(rd != 0){
         cpu->gpr[rd] = cpu->gpr[rs1] + imm;
     }
-    if(log_enable){
-    fprintf(stderr,"[addi] x[%d]:0x%16lx = x[%d]:0x%16lx + imm:0x%16lx\n",
-            rd,cpu->gpr[rd],rs1,cpu->gpr[rs1],imm);
-    }
     
     cpu->pc += 4;
    
@@ -640,9 +509,6 @@ void exec_lui(CPU_State* cpu, uint32_t instruction) {
     if (rd != 0) {
         cpu->gpr[rd] = imm;
     }
-    if(log_enable){
-    fprintf(stderr,"[lui] x[%d] = imm:0x%16lx\n",rd,cpu->gpr[rd]);
-    }
 
     cpu->pc += 4;
 }
@@ -661,10 +527,6 @@ void exec_auipc(CPU_State* cpu, uint32_t instruction) {
         cpu->gpr[rd] = cpu->pc + imm;
     }
     
-    if(log_enable){
-    fprintf(stderr,"[auipc] x[%d]:0x%16lx,imm:0x%08x\n",rd,cpu->gpr[rd],imm);
-
-    }
 
     cpu->pc += 4;
     
@@ -690,10 +552,7 @@ void exec_jal(CPU_State* cpu, uint32_t instruction) {
         cpu->gpr[rd] = cpu->pc + 4;
     }
 
-    if(log_enable){
-    fprintf(stderr,"[jal] x[%d]:0x%16lx\n",rd,cpu->pc+4);
-
-    }
+    fuzz_edge(cpu->pc, cpu->pc + imm);
     cpu->pc += imm;
 }
 
@@ -719,10 +578,8 @@ void exec_jalr(CPU_State* cpu, uint32_t instruction){
         cpu->gpr[rd] = cpu->pc + 4;
     } 
 
-    if(log_enable){
-    fprintf(stderr,"[jalr/jr] x[%d]:0x%16lx,pa:0x%16lx\n",rd,cpu->gpr[rd],addr);
-    }
 
+    fuzz_edge(cpu->pc, addr);
     cpu->pc = addr;
     //c.ret = jalr x0 ,0(ra)
 }
@@ -737,10 +594,6 @@ void exec_add(CPU_State* cpu, uint32_t instruction) {
         cpu->gpr[rd] = (uint64_t)(cpu->gpr[rs1] + cpu->gpr[rs2]);
     }
 
-    if(log_enable){
-        fprintf(stderr,"[add] x[%d]:0x%16lx = x[%d]:0x%16lx + x[%d]:0x%16lx\n",
-                    rd,cpu->gpr[rd],rs1,cpu->gpr[rs1],rs2,cpu->gpr[rs2]);
-    }
 
     cpu->pc += 4;
 }
@@ -752,10 +605,6 @@ void exec_xor(CPU_State* cpu,uint32_t instr){
     if(rd != 0){
         cpu->gpr[rd] = cpu->gpr[rs1] ^ cpu->gpr[rs2];
     }
-    if(log_enable){
-        fprintf(stderr,"[xor] x[%d]:0x%16lx = x[%d]:0x%16lx + x[%d]:0x%16lx\n",
-                    rd,cpu->gpr[rd],rs1,cpu->gpr[rs1],rs2,cpu->gpr[rs2]);
-    }
     cpu->pc += 4;
 }
 
@@ -767,10 +616,6 @@ void exec_xori(CPU_State* cpu,uint32_t instr){
     if(rd != 0){
         cpu->gpr[rd] = cpu->gpr[rs1] ^ imm;
     }
-    if(log_enable){
-        printf("[xori] x[rd:%d]:0x%16lx,x[rs1:%d]:0x%16lx,imm:0x%16lx\n",
-                rd,cpu->gpr[rd],rs1,cpu->gpr[rs1,imm]);
-    }
     cpu->pc += 4;
 }
 
@@ -782,10 +627,6 @@ void exec_sub(CPU_State* cpu, uint32_t instruction){
     if (rd != 0) {
         cpu->gpr[rd] = (uint64_t)((int64_t)cpu->gpr[rs1] - (int64_t)cpu->gpr[rs2]);
     }
-    if(log_enable){
-    fprintf(stderr,"[sub] x[%d]:0x%16lx = x[%d]:0x%16lx - x[%d]:0x%16lx\n",
-            rd,cpu->gpr[rd],rs1,cpu->gpr[rs1],rs2,cpu->gpr[rs2]);
-    }
 
     cpu->pc += 4;
 
@@ -800,10 +641,6 @@ void exec_sltu(CPU_State* cpu,uint32_t instruction){
         cpu->gpr[rd] = ((uint64_t)cpu->gpr[rs1] < (uint64_t)cpu->gpr[rs2]) ? 1 : 0;
     }
 
-    if(log_enable){
-        fprintf(stderr,"[sltu] x[%d]:0x%16lx = x[%d]:0x%16lx < x[%d]:0x%16lx ?\n",
-                    rd,cpu->gpr[rd],rs1,cpu->gpr[rs1],rs2,cpu->gpr[rs2]);
-    }
 
     cpu->pc += 4;
 }
@@ -819,11 +656,8 @@ void exec_bge(CPU_State* cpu,uint32_t instr){
     
     int64_t imm = (int64_t)(((int32_t)imm12 << 19) >> 19);
 
+    if (cpu->gpr[rs1] >= cpu->gpr[rs2]) fuzz_edge(cpu->pc, cpu->pc + imm);
     cpu->pc = cpu->gpr[rs1] >= cpu->gpr[rs2] ? cpu->pc + imm :cpu->pc + 4;
-    if(log_enable){
-        fprintf(stderr,"[bge]x[rs1:%d]:0x%08lx >= x[rs2:%d]:0x%08lx? imm:0x%08lx\n",
-         rs1,cpu->gpr[rs1],rs2,cpu->gpr[rs2],imm);
-    }
 
     //fprintf(stderr,"-------- a5:0x%08x a4:0x%08x\n",cpu->gpr[rs1],cpu->gpr[rs2]);
 }
@@ -835,30 +669,14 @@ void exec_bgeu(CPU_State* cpu,uint32_t instr){
                     ((instr >> 8) & 0xF) << 1|
                     ((instr >> 25) & 0x3F) << 5 |
                     ((instr >> 31) & 0x1) << 12 ;
-    uint32_t m12 = ((instr >> 31) & 0x1) << 12;
-    uint32_t m11 = ((instr >> 7 )) & 0x1;
-    uint32_t m10_5 = ((instr >> 25) & 0x3F) << 5;
-    uint32_t m4_1 = ((instr >> 8) & 0xF) << 1;
-
-    uint32_t m = m12 | m11 | m10_5 | m4_1;
-    if(log_enable){
-    fprintf(stderr,"m12:0x%16lx,m11:0x%16lx,m10_5:0x%16lx,m4_1:0x%16lx,m:0x%16lx\n",
-            m12,m11,m10_5,m4_1,m);
-    }
-
     int64_t imm = (int64_t)(((int32_t)imm12 << 19) >> 19);
     
     if((uint64_t)cpu->gpr[rs1] >= (uint64_t)cpu->gpr[rs2]){
+        fuzz_edge(cpu->pc, cpu->pc + imm);
         cpu->pc += imm;
     }else{
         cpu->pc += 4;
     }
-    if(log_enable){
-    fprintf(stderr,"[bgeu] x[%d]:0x%16lx >= x[%d]:0x%16lx\n ",rs1,cpu->gpr[rs1],rs2,cpu->gpr[rs2]);
-    fprintf(stderr,"[bgeu] imm12:0x%08x,imm:0x%16lx\n",imm12,imm);
-    fprintf(stderr,"[bgeu >= jmp] pc:0x%16lx\n",cpu->pc);
-
-    }
 }
 
 void exec_blt(CPU_State* cpu,uint32_t instr){
@@ -870,12 +688,8 @@ void exec_blt(CPU_State* cpu,uint32_t instr){
                 ((instr >> 8 ) & 0xF) << 1 |
                 ((instr >> 7) & 0x1) << 11;
     int64_t imm = (int64_t)( ((int32_t)imm12 << 20) >> 20);
+    if ((int64_t)cpu->gpr[rs1] < (int64_t)cpu->gpr[rs2]) fuzz_edge(cpu->pc, cpu->pc + imm);
     cpu->pc = ((int64_t)cpu->gpr[rs1] < (int64_t)cpu->gpr[rs2]) ? cpu->pc+imm:cpu->pc+4;
-    if(log_enable){
-    fprintf(stderr,"[blt] x[%d]:0x%16lx < x[%d]:0x%16lx\n",rs1,cpu->gpr[rs1],rs2,cpu->gpr[rs2]);
-    printf("[blt] imm12:0x%08x,imm:0x%16lx\n",imm12,imm);
-    printf("[blt < jmp] pc:0x%16lx\n",cpu->pc);
-    }
 
 }
 
@@ -897,11 +711,9 @@ void exec_bltu(CPU_State* cpu,uint32_t instr){
 
     int64_t imm = (int64_t)( ((int32_t)imm12 << 19) >> 19);
   
+    if ((uint64_t)cpu->gpr[rs1] < (uint64_t)cpu->gpr[rs2]) fuzz_edge(cpu->pc, cpu->pc + imm);
     cpu->pc = ((uint64_t)cpu->gpr[rs1] < (uint64_t)cpu->gpr[rs2]) ? cpu->pc+imm:cpu->pc+4;
    
-    if(log_enable){
-        fprintf(stderr,"x[%d]:0x%08lx < x[%d]:0x%08lx ? \n",rs1,cpu->gpr[rs1],rs2,cpu->gpr[rs2]);
-    }
 
 }
 
@@ -920,14 +732,11 @@ void exec_bne(CPU_State* cpu,uint32_t instr){
     int64_t imm = (int64_t)(((int32_t)imm12 << 19) >> 19);
     
     if(cpu->gpr[rs1] != cpu->gpr[rs2]){
+        fuzz_edge(cpu->pc, cpu->pc + imm);
         cpu->pc += imm; 
     }else{
         cpu->pc += 4;
     }
-    if(log_enable){
-    fprintf(stderr,"[bne not equal jal to pc+=imm] x[%d]:0x%16lx != x[%d]:0x%16lx\n",rs1,cpu->gpr[rs1],rs2,cpu->gpr[rs2]);
-    fprintf(stderr,"[bne] old pc:0x%16lx + imm: 0x%16lx]\n",cpu->pc,imm);
-    }
 
 
 }
@@ -949,14 +758,11 @@ void exec_beq(CPU_State* cpu,uint32_t instr){
     int64_t imm = (int64_t)(((int32_t)imm12 << 19) >> 19);
 
     if(cpu->gpr[rs1] == cpu->gpr[rs2]){
+        fuzz_edge(cpu->pc, cpu->pc + imm);
         cpu->pc += imm; //2B align
     }else{
         cpu->pc += 4;
     }
-    if(log_enable){
-    fprintf(stderr,"[beq equal jal to pc+=imm] x[%d]:0x%16lx == x[%d]:0x%16lx\n",
-        rs1,cpu->gpr[rs1],rs2,cpu->gpr[rs2]);
-    }
 
 }
 
@@ -994,10 +800,6 @@ void exec_div(CPU_State* cpu,uint32_t instr){
         cpu->gpr[rd] = result;
     }
     cpu->pc += 4;
-    if(log_enable){
-    fprintf(stderr,"[div] x[%d]:0x%16lx = x[%d]:0x%16lx / x[%d]:0x%16lx\n",
-        rd,cpu->gpr[rd],rs1,cpu->gpr[rs1],rs2,cpu->gpr[rs2]);
-    }
 }
 
 
@@ -1052,18 +854,11 @@ void exec_store(CPU_State* cpu,uint32_t instructions){
     case 0x0: //SB
     {
         cpu_store8_pa(cpu, pa, (uint8_t)(value & 0xFF));
-        if(log_enable){
-        fprintf(stderr,"[Sb store 1 byte] x[%d]:0x%16lx + imm:0x%16lx = pa:0x%16lx,value = x[%d]:0x%16lx\n",
-               rs1,cpu->gpr[rs1],imm,pa,rs2,cpu->gpr[rs2] );
-        }
         break;
     }
     case 0x1: //SH
        
         cpu_store16_pa(cpu, pa, (uint16_t)(value & 0xFFFF));
-        if(log_enable){
-            fprintf(stderr,"[sh] pa:0x%08lx,val:0x%08lx\n",pa,(uint16_t)(value & 0xFFFF));
-        }
         break;
     case 0x2://SW
         cpu_store32_pa(cpu, pa, value & 0xFFFFFFFF);
@@ -1071,24 +866,12 @@ void exec_store(CPU_State* cpu,uint32_t instructions){
             printf("occur sw to 0x%08lx,value:0x%16lx\n",pa,value);
         }
 
-        if(log_enable){
-            fprintf(stderr,"[exec_sw] pa:0x%08x,value:0x%08x,x[%d]:0x%16lx\n",pa,value,rs2,cpu->gpr[rs2]);
-        }
         break;
 
     case 0b11://SD
     {
-        if(log_enable){
-            printf("[exec_sd] x[%d]:0x%16lx\n",
-               rs2,cpu->gpr[rs2] );
-        }
      
         cpu_store64_pa(cpu, pa, (uint64_t)value);
-        if(log_enable){
-        fprintf(stderr,"[sd store 8bytes] x[%d]:0x%16lx,x[%d]:0x%16lx,imm:0x%16lx\n",
-                rs1,cpu->gpr[rs1],rs2,cpu->gpr[rs2],imm);
-        fprintf(stderr,"[sd 8 bytes] pa:0x%08lx\n",pa);
-        }
         break;
     }
     default:
@@ -1107,6 +890,13 @@ void exec_ecall(CPU_State* cpu, uint32_t instruction) {
     // 这里可以处理系统调用
     /* 选择是从 U/S/M 发出的 ECALL：根据当前 privilege 设置 cause */
  
+    // 内置 SBI：S 模式的 ecall 在主机上处理（见 sbi.h）
+    if (sbi_builtin && cpu->privilege == 1) {
+        sbi_ecall(cpu);
+        cpu->pc += 4;
+        return;
+    }
+
     uint32_t cause = (cpu->privilege == 0 ? EXC_ECALL_U :
                     cpu->privilege == 1 ? EXC_ECALL_S : EXC_ECALL_M);
     /* 简单模式：在 emulator 中直接处理 syscall（host 接管），或把异常交给 guest */
@@ -1121,6 +911,11 @@ void exec_ecall(CPU_State* cpu, uint32_t instruction) {
 
 //ebreak
 void exec_ebreak(CPU_State* cpu,uint32_t instructions){
+    if (vmfork_ebreak_armed) {   // RVEMU_FORK_AT=ebreak：作为分叉点，不停机
+        vmfork_pending = 1;
+        cpu->pc += (instructions & 3) == 3 ? 4 : 2;   // c.ebreak 只有 2 字节
+        return;
+    }
     cpu->halted = true;
 }
 
@@ -1140,9 +935,6 @@ void exec_mret(CPU_State* cpu,uint32_t instr){
     uint64_t mpp = (cpu->csr[CSR_MSTATUS] >> 11) & 0x3;//进入机器模式异常之前的特权级别
 
 
-    if(log_enable){
-        fprintf(stderr,"mpp:%d,mstatus:0x%08lx\n",mpp,cpu->csr[CSR_MSTATUS]);
-    }
 
     uint64_t mstatus = cpu->csr[CSR_MSTATUS];
 
@@ -1168,9 +960,6 @@ void exec_mret(CPU_State* cpu,uint32_t instr){
         break;
     }
 
-    if(log_enable){
-        fprintf(stderr,"mpp:%d,cpu->privilege:%d\n",mpp,cpu->privilege);
-    }
 
     mstatus &= ~MSTATUS_MPP_MASK; 
     mstatus |= (0 << MSTATUS_MPP_SHIFT);
@@ -1237,9 +1026,6 @@ static void load_lbu(CPU_State* cpu,uint64_t addr,uint8_t rd){
     if(rd != 0){
         cpu->gpr[rd] = val; 
     }
-    if(log_enable){
-        fprintf(stderr,"[lbu] x[%d]:0x%16lx,val:0x%16lx,addr:0x%08lx\n",rd,cpu->gpr[rd],val,addr);
-    }
 }
 
 static void load_lw(CPU_State* cpu,uint64_t addr,uint8_t rd){
@@ -1250,10 +1036,6 @@ static void load_lw(CPU_State* cpu,uint64_t addr,uint8_t rd){
     if(rd != 0){
         cpu->gpr[rd] = val;
     }
-    if(log_enable){
-        fprintf(stderr,"[lw] x[rd:%d]:0x%08lx,va:0x%08lx,pa:0x%08lx\n",
-            rd,cpu->gpr[rd],addr,addr);
-    }
 
 }
 
@@ -1272,10 +1054,6 @@ void exec_load(CPU_State *cpu,uint32_t instruction){
 
     uint64_t addr = cpu->gpr[rs1] + imm;
 
-    if(log_enable){
-        printf("[before transmit] rs1: x[%d]:0x%16lx, imm:0x%16lx, addr:0x%16lx\n",
-                rs1,cpu->gpr[rs1],imm,addr);
-    }
 
     addr = get_pa(cpu,addr,ACC_LOAD);
 
@@ -1288,9 +1066,6 @@ void exec_load(CPU_State *cpu,uint32_t instruction){
         break;
     case 0x1: //lh
         load_lh(cpu,addr,rd);
-        if(log_enable){
-        fprintf(stderr,"[lh load 2 bytes] x[%d]:0x%16lx,addr:0x%16lx\n",rd,cpu->gpr[rd],addr);
-        }
         break;
     case 0x2:
     {
@@ -1309,11 +1084,6 @@ void exec_load(CPU_State *cpu,uint32_t instruction){
             cpu->gpr[rd] = val;
         }
         
-        if(log_enable){
-        fprintf(stderr,"[ld load 8 bytes] x[%d]:0x%16lx,addr:0x%16lx\n",rd,
-        cpu->gpr[rd],addr);
-        fprintf(stderr,"[ld] rs1:%d,0x%16lx\n",rs1,cpu->gpr[rs1]);
-        }
         break;
     }
     case 0b100:
@@ -1327,10 +1097,6 @@ void exec_load(CPU_State *cpu,uint32_t instruction){
         if(rd != 0){
             cpu->gpr[rd] = val;
         }
-        if(log_enable){
-            fprintf(stderr,"[lhu] x[rd:%d]:0x%08lx,addr:0x%08lx\n",rd,cpu->gpr[rd],addr
-            );
-        }
         break;
     case 0b110: //lwu
     {
@@ -1360,10 +1126,6 @@ void exec_slli(CPU_State* cpu,uint32_t instr){
     if(rd != 0){
         cpu->gpr[rd] = cpu->gpr[rs1] << shamt;
     }
-    if(log_enable){
-          fprintf(stderr,"[slli] x[%d]:0x%16lx = x[%d]:0x%16lx << shamt:0x%08lx\n",
-                    rd,cpu->gpr[rd],rs1,cpu->gpr[rs1],shamt);
-    }
 
     cpu->pc += 4;
 }
@@ -1378,11 +1140,6 @@ void exec_slti(CPU_State* cpu,uint32_t instr){
         cpu->gpr[rd] = ((int64_t)cpu->gpr[rs1] < (int64_t)imm)? 1:0;
     }
 
-    if(log_enable){
-    fprintf(stderr,"[slti] x[%d]:0x%16lx,x[%d]:0x%16lx,imm:0x%16lx\n",
-            rd,cpu->gpr[rd],rs1,cpu->gpr[rs1],imm);
-
-    }
     cpu->pc += 4;
 
 }
@@ -1397,11 +1154,6 @@ void exec_sltiu(CPU_State* cpu,uint32_t instr){
         cpu->gpr[rd] = ((uint64_t)cpu->gpr[rs1] < (uint64_t)imm)? 1:0;
     }
 
-    if(log_enable){
-    fprintf(stderr,"[sltiU] x[%d]:0x%16lx,x[%d]:0x%16lx,imm:0x%16lx\n",
-            rd,cpu->gpr[rd],rs1,cpu->gpr[rs1],imm);
-
-    }
     cpu->pc += 4;
 }
 
@@ -1417,9 +1169,6 @@ void exec_si(CPU_State* cpu,uint32_t instr){
     case 0x0:
         if(rd != 0){
             cpu->gpr[rd] = (uint64_t)cpu->gpr[rs1] >> shamt; // 逻辑右移 SRLI
-        if(log_enable){
-            fprintf(stderr,"[srli] x[%d]:0x%16lx,x[%d]:0x%16lx\n",rd,cpu->gpr[rd],rs1,cpu->gpr[rs1]);
-        }
         }
         break;
     case 0b010000:
@@ -1442,10 +1191,6 @@ void exec_and(CPU_State* cpu,uint32_t instr){
     if(rd != 0){
         cpu->gpr[rd] = cpu->gpr[rs1] & cpu->gpr[rs2];
     }
-    if(log_enable){
-        fprintf(stderr,"[and] x[%d]:0x%16lx = x[%d]:0x%16lx + x[%d]:0x%16lx\n",
-                    rd,cpu->gpr[rd],rs1,cpu->gpr[rs1],rs2,cpu->gpr[rs2]);
-    }
 
     cpu->pc += 4;
     cpu->gpr[0] = 0;
@@ -1467,10 +1212,6 @@ void exec_or(CPU_State* cpu,uint32_t instr){
     cpu->pc += 4;
     cpu->gpr[0] = 0;
 
-    if(log_enable){
-        fprintf(stderr,"[or] x[%d]:0x%08lx = x[%d]:0x%08lx | x[%d]:0x%08lx\n",
-                rd,cpu->gpr[rd],rs1,cpu->gpr[rs1],rs2,cpu->gpr[rs2]);
-    }
 
 }
 
@@ -1493,10 +1234,6 @@ void exec_ori(CPU_State* cpu,uint32_t instr){
     
     cpu->pc += 4;
 
-    if(log_enable){
-        fprintf(stderr,"[ori] x[%d]:0x%08lx = x[%d]:0x%08lx | imm:0x%08lx\n",
-                rd,cpu->gpr[rd],rs1,cpu->gpr[rs1],imm);
-    }
 
 }
 
@@ -1513,10 +1250,6 @@ void exec_andi(CPU_State* cpu,uint32_t instr){ //zext.b  &0xff
     if(rd != 0){
         cpu->gpr[rd] = cpu->gpr[rs1] & imm;
     }
-    if(log_enable){
-    fprintf(stderr,"[andi] x[%d]:0x%16lx,x[%d]:0x%16lx,imm:0x%16lx\n",rd,cpu->gpr[rd],
-            rs1,cpu->gpr[rs1],imm);
-    }
 
 
     cpu->pc += 4;
@@ -1547,10 +1280,6 @@ void exec_csr(CPU_State* cpu,uint32_t instr){
                 cpu->gpr[rd] = old;
             }
             
-            if(log_enable){
-            fprintf(stderr,"[csrrw] x[rd:%d]:0x%16lx,x[rs1:%d]:0x%16lx,csr[0x%08x]:0x%16lx\n",
-                        rd,cpu->gpr[rd],rs1,cpu->gpr[rs1],csr,cpu->csr[csr]);
-            }
          
             break;
             }
@@ -1561,10 +1290,6 @@ void exec_csr(CPU_State* cpu,uint32_t instr){
             if(rs1 != 0){
                 cpu->csr[csr] |= cpu->gpr[rs1];
             }
-            if(log_enable){
-            fprintf(stderr,"[csrrs] x[rd:%d]:0x%16lx,csr[0x%08x] |= x[rs1:%d]:0x%16lx,val = 0x%16lx\n ",
-                            rd,cpu->gpr[rd],csr,rs1,cpu->gpr[rs1],cpu->csr[csr]);
-            }
 
             break;
         case 0b011: //csrrc
@@ -1572,10 +1297,6 @@ void exec_csr(CPU_State* cpu,uint32_t instr){
                 cpu->gpr[rd] = cpu->csr[csr];
             }
             cpu->csr[csr] &= ~cpu->gpr[rs1];
-            if(log_enable){
-            fprintf(stderr,"[csrrc] x[%d]:0x%16lx,csr[0x%08x] |= x[%d]:0x%16lx,val = 0x%16lx\n ",
-                            rd,cpu->gpr[rd],csr,rs1,cpu->gpr[rs1],cpu->csr[csr]);
-            }
 
             break;
         case 0b101://csrrwi
@@ -1587,10 +1308,16 @@ void exec_csr(CPU_State* cpu,uint32_t instr){
             }
 
             write_csr(cpu,csr,imm5);
-            if(log_enable){
-            fprintf(stderr,"[csrrwi] x[%d]:0x%16lx,csr[0x%08x]:0x%16lx\n ",
-                            rd,cpu->gpr[rd],csr,cpu->csr[csr]);
+            break;
+        }
+        case 0b110://csrrsi
+        {
+            uint8_t imm5 = (instr >> 15) & 0x1F;
+            uint64_t old_value = read_csr(cpu,csr);
+            if(rd != 0){
+                cpu->gpr[rd] = old_value;
             }
+            write_csr(cpu,csr,old_value | imm5);
             break;
         }
         case 0b111://csrrci
@@ -1602,10 +1329,6 @@ void exec_csr(CPU_State* cpu,uint32_t instr){
                 cpu->gpr[rd] = old_value;
             }
             write_csr(cpu,csr,old_value & imm );
-            if(log_enable){
-            fprintf(stderr,"[csrrci] x[%d]:0x%16lx,new value:0x%16lx\n",rd,cpu->gpr[rd],
-                        cpu->csr[csr]);
-            }
         }
         default:
             break;
@@ -1631,38 +1354,22 @@ void exec_iw(CPU_State* cpu,uint32_t instr){
         if(rd != 0){
             cpu->gpr[rd] = (int64_t)((int32_t)cpu->gpr[rs1] + imm);//sext.w
         }
-        if(log_enable){
-            fprintf(stderr,"[addiw]x[%d]:0x%16lx,x[%d]:0x%16lx,imm:0x%08x\n",
-            rd,cpu->gpr[rd],rs1,cpu->gpr[rs1],imm);
-        }
         break;
     case 0b001: // slliw
 
         if(rd != 0){
             cpu->gpr[rd] = (int64_t)((int32_t)cpu->gpr[rs1] << shamt); 
         }
-        if(log_enable){
-            fprintf(stderr,"[slliw] x[rd:%d]:0x%16lx,x[rs1:%d]:0x%16lx,shamt:0x%08lx\n",
-                        rd,cpu->gpr[rd],rs1,cpu->gpr[rs1],shamt);
-        }
         break;
     case 0b101: 
         if(funct7 == 0b0000000){//srliw
             if(rd != 0){
                 cpu->gpr[rd] = (int64_t)(int32_t)((uint32_t)cpu->gpr[rs1] >> shamt); 
             }
-            if(log_enable){
-                fprintf(stderr,"[srliw] x[rd:%d]:0x%16lx,x[rs1:%d]:0x%16lx,shamt:0x%08lx\n",
-                            rd,cpu->gpr[rd],rs1,cpu->gpr[rs1],shamt);
-            }
         }else if(funct7 == 0b0100000){ //sraiw
             if(rd != 0){
                 cpu->gpr[rd] = (int64_t)((int32_t)cpu->gpr[rs1] >> shamt); 
             }
-            if(log_enable){
-                fprintf(stderr,"[sraiw] x[rd:%d]:0x%16lx,x[rs1:%d]:0x%16lx,shamt:0x%08lx\n",
-                            rd,cpu->gpr[rd],rs1,cpu->gpr[rs1],shamt);
-            }
         }
         break;
     default:
@@ -1699,10 +1406,6 @@ void exec_amo(CPU_State* cpu,uint32_t instr){
 
                 write_gpr(cpu,rd,tmp);
                 cpu->pc += 4;
-                if(log_enable){
-                fprintf(stderr,"[AMOSWAP.W] x[%d]:0x%16lx,x[%d]:0x%16lx,x[%d]:0x%16lx,tmp:0x%08x",
-                        rd,cpu->gpr[rd],rs1,cpu->gpr[rs1],rs2,cpu->gpr[rs2],tmp);
-                }
             
             break;
             }
@@ -1802,10 +1505,6 @@ void exec_float(CPU_State* cpu,uint32_t instr){
             uint32_t float_bits = cpu->fgpr[rs1] & 0xFFFFFFFF;
             int64_t float_datas = (int64_t)((int32_t)float_bits);
             cpu->gpr[rd] = float_datas;
-        if(log_enable){
-        fprintf(stderr,"[fmv.x.w] x[%d]:0x%16lx,f[%d]:0x%16lx\n",rd,cpu->gpr[rd],
-                    rs1,cpu->fgpr[rs1]);
-        }
             }
         break;
         }
@@ -1814,10 +1513,6 @@ void exec_float(CPU_State* cpu,uint32_t instr){
         if(rs2 == 0 && funct3 == 0){
             uint32_t origin_bits = cpu->gpr[rs1] & 0xFFFFFFFF;
             cpu->fgpr[rd] = origin_bits;
-        if(log_enable){
-        fprintf(stderr,"[fmv.w.x] x[%d]:0x%16lx,f[%d]:0x%16lx\n",rd,cpu->gpr[rd],
-                    rs1,cpu->fgpr[rs1]);
-        }
         }
         break;
     }
@@ -1825,10 +1520,6 @@ void exec_float(CPU_State* cpu,uint32_t instr){
     {
         if(rs2 == 0 && funct3 == 0){
             cpu->gpr[rd] = cpu->fgpr[rs1];
-            if(log_enable){
-            fprintf(stderr,"[fmv.x.d] x[%d]:0x%16lx,f[%d]:0x%16lx\n",rd,cpu->gpr[rd],
-                        rs1,cpu->fgpr[rs1]);
-            }
         }
         break;
     }
@@ -1836,10 +1527,6 @@ void exec_float(CPU_State* cpu,uint32_t instr){
     {
         if(rs2 == 0 && funct3 == 0){
             cpu->fgpr[rd] = cpu->gpr[rs1];
-            if(log_enable){
-            fprintf(stderr,"[fmv.d.x] x[%d]:0x%16lx,f[%d]:0x%16lx\n",rd,cpu->gpr[rd],
-                        rs1,cpu->fgpr[rs1]);
-            }
         }
         break;
     }
@@ -1852,7 +1539,7 @@ void exec_float(CPU_State* cpu,uint32_t instr){
 
 void exec_wfi(CPU_State* cpu,uint32_t instr){
 
-    static bool is_wfi = false;
+    static VM_LOCAL bool is_wfi = false;
     cpu->pc += 4;
     pthread_mutex_lock(&cpu->lock);
     cpu->halted = true;
@@ -1878,10 +1565,6 @@ void exec_3b(CPU_State* cpu,uint32_t instr){
 
         cpu->gpr[rd] = (int64_t)imm;
         cpu->pc += 4;
-        if(log_enable){
-        fprintf(stderr,"[sllw] x[%d]:0x%08lx,x[%d]:0x%08lx,imm:0x%16x\n",
-               rs1,cpu->gpr[rs1],rs2,cpu->gpr[rs2],imm);
-        }
     }else if(funct7 == 1 && funct3 == 7 ){//0b111 //remuw
         uint32_t divided = (uint32_t)(cpu->gpr[rs1]);
         uint32_t divisor = (uint32_t)(cpu->gpr[rs2]);
@@ -1899,10 +1582,6 @@ void exec_3b(CPU_State* cpu,uint32_t instr){
         }
         cpu->pc += 4;
 
-        if(log_enable){
-            fprintf(stderr,"[remuw] divided(rs1:%d):0x%08lx divisor(rs2:%d):0x%08lx,val(rd:%d):0x%08lx\n",
-                rs1,cpu->gpr[rs1],rs2,cpu->gpr[rs2],rd,result);
-        }
     }else if(funct7 == 1 && funct3 == 5){//0b101 //divuw
         uint32_t divided = (uint32_t)(cpu->gpr[rs1]);
         uint32_t divisor = (uint32_t)(cpu->gpr[rs2]);
@@ -1920,10 +1599,6 @@ void exec_3b(CPU_State* cpu,uint32_t instr){
         }
         cpu->pc += 4;
 
-        if(log_enable){
-            fprintf(stderr,"[divuw] divided(rs1:%d):0x%08lx divisor(rs2:%d):0x%08lx,val(rd:%d):0x%08lx\n",
-                rs1,cpu->gpr[rs1],rs2,cpu->gpr[rs2],rd,result);
-        }
     }else if(funct7 == 0 && funct3 == 0){ //addw
         int32_t rs1_val = (int32_t)cpu->gpr[rs1];
         int32_t rs2_val = (int32_t)cpu->gpr[rs2];
@@ -1961,10 +1636,6 @@ void exec_srl(CPU_State* cpu,uint32_t instr){
         cpu->gpr[rd] = (uint64_t)cpu->gpr[rs1] >> shamt ;
     }
     cpu->pc += 4;
-    if(log_enable){
-    fprintf(stderr,"[srl] x[%d]:0x%16lx,shamt:0x%08x,x[%d]:0x%16lx\n",
-           rs1,cpu->gpr[rs1],shamt,rd,cpu->gpr[rd] );
-    }
 }
 
 
@@ -1982,11 +1653,6 @@ void exec_remu(CPU_State *cpu,uint32_t instr){
     }
 
     cpu->pc += 4;
-    if(log_enable){
-    fprintf(stderr,"[remu] x[%d]:0x%016lx,x[%d]:0x%016lx,x[%d]:0x%016lx\n",
-            rd,cpu->gpr[rd],rs1,cpu->gpr[rs2],rd,cpu->gpr[rs2]
-    );
-    }
 
 }
 
@@ -2005,11 +1671,6 @@ void exec_divu(CPU_State *cpu,uint32_t instr){
     }
 
     cpu->pc += 4;
-    if(log_enable){
-    fprintf(stderr,"[remu] x[%d]:0x%016lx,x[%d]:0x%016lx,x[%d]:0x%016lx\n",
-            rd,cpu->gpr[rd],rs1,cpu->gpr[rs2],rd,cpu->gpr[rs2]
-    );
-    }
 
 }
 
@@ -2028,9 +1689,6 @@ void exec_sret(CPU_State *cpu,uint32_t instr){
         return ;
     }
 
-    if(log_enable){
-        fprintf(stderr,"[sret] sepc:0x%16lx\n",sepc);
-    }
 
     cpu->pc = sepc;
 
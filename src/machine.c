@@ -0,0 +1,284 @@
+// machine.c
+// libriscv-emu 的 Machine：每台机器一份完整状态，执行时换进当前线程的 VM_LOCAL 全局变量，见 emulator_api.h
+#include <stdatomic.h>
+#include "emulator_api.h"
+#include "cpu.h"
+#include "memory.h"
+#include "elf_load.h"
+#include "mmu.h"
+#include "trap.h"
+#include "uart.h"
+#include "plic.h"
+#include "clint.h"
+#include "virtio_blk.h"
+#include "virtio_console.h"
+#include "vmfork.h"
+
+extern VM_LOCAL uint8_t *memory;
+extern VM_LOCAL Bus bus;
+extern VM_LOCAL CPU_State cpu[MAX_CORES];
+extern VM_LOCAL virtio_blk_device dev;
+extern VM_LOCAL struct disk_op_list pending_ops;
+
+struct Machine {
+    // 机器的状态以这里为准；每次会改状态的调用结束时从线程的全局变量存回来，RAM 和磁盘只存指针
+    uint8_t *memory;
+    uint64_t *ram_dirty;
+    Bus bus;
+    CPU_State cpu[MAX_CORES];
+    PLICState plic;
+    virtio_blk_device dev;
+    struct disk_operation *ops;     // pending_ops 的第一个元素
+    virtio_console_device con;
+    int exit_code;
+    int marker;
+    uint64_t marker_value;
+    uint32_t input_len;
+    uint64_t version;               // 每次存回换一个新的，线程里缓存的旧状态就认不出来了
+
+    RAMDevice ram;                  // 总线上 RAM 区的 opaque，地址要稳定
+    UARTDevice *uart;
+};
+
+static _Atomic uint64_t next_version = 1;
+static VM_LOCAL uint64_t loaded;    // 当前线程的全局变量里装的是哪个版本，0 = 没有
+
+static void save(Machine *m) {
+    m->memory = memory;
+    m->ram_dirty = ram_dirty;
+    m->bus = bus;
+    memcpy(m->cpu, cpu, sizeof(m->cpu));
+    m->plic = plic;
+    m->dev = dev;
+    m->ops = LIST_FIRST(&pending_ops);
+    m->con = condev;
+    m->exit_code = vmctl_exit_code;
+    m->marker = vmfork_pending;
+    m->marker_value = vmctl_marker_value;
+    m->input_len = vmctl_input_len;
+}
+
+static void load(Machine *m) {
+    memory = m->memory;
+    ram_dirty = m->ram_dirty;
+    bus = m->bus;
+    memcpy(cpu, m->cpu, sizeof(cpu));
+    plic = m->plic;
+    dev = m->dev;
+    // 链表头换了地址，第一个元素的 le_prev 要跟着改
+    LIST_INIT(&pending_ops);
+    if (m->ops) {
+        pending_ops.lh_first = m->ops;
+        m->ops->entriess.le_prev = &pending_ops.lh_first;
+    }
+    condev = m->con;
+    vmctl_exit_code = m->exit_code;
+    vmfork_pending = m->marker;
+    vmctl_marker_value = m->marker_value;
+    vmctl_input_len = m->input_len;
+}
+
+// 把 m 换进当前线程；上一次就是这个线程跑的、之后没人改过就不用拷
+static void enter(Machine *m) {
+    if (loaded != m->version) {
+        load(m);
+        loaded = m->version;
+    }
+}
+
+// 改完状态存回 m，换一个版本号：别的线程里缓存的这台机器从此作废
+static void leave(Machine *m) {
+    save(m);
+    m->version = atomic_fetch_add(&next_version, 1);
+    loaded = m->version;
+}
+
+// 直接改了 m 里的状态（没经过全局变量），各线程的缓存都要作废
+static void touched(Machine *m) {
+    m->version = atomic_fetch_add(&next_version, 1);
+}
+
+// 设备的 MMIO 回调签名各不相同，统一成 bus_register_mmio 要的形式。
+// 总线随机器换到别的线程上，opaque 不能指向某个线程的 VM_LOCAL 变量，PLIC / CLINT 在调用时取当前线程的
+static uint64_t uart_rd(void *o, uint64_t off, unsigned sz) { return mmio_read(o, off, sz); }
+static void uart_wr(void *o, uint64_t off, uint64_t v, unsigned sz) { mmio_write(o, off, v, sz); }
+static uint64_t plic_rd(void *o, uint64_t off, unsigned sz) { (void)o; return plic_read(&plic, off, sz); }
+static void plic_wr(void *o, uint64_t off, uint64_t v, unsigned sz) { (void)o; plic_write(&plic, off, v, sz); }
+static uint64_t blk_rd(void *o, uint64_t off, unsigned sz) { return virtio_mmio_read(o, off, sz); }
+static void blk_wr(void *o, uint64_t off, uint64_t v, unsigned sz) { virtio_mmio_write(o, off, v, sz); }
+static uint64_t clint_rd(void *o, uint64_t off, unsigned sz) { (void)o; return clint_read(&cpu[0].clint, off, sz); }
+static void clint_wr(void *o, uint64_t off, uint64_t v, unsigned sz) { (void)o; clint_write(&cpu[0].clint, off, v, sz); }
+
+Machine *machine_create(const MachineConfig *cfg) {
+    Machine *m = calloc(1, sizeof(Machine));
+    if (!m) return NULL;
+    m->memory = ram_alloc();
+    // UART 没有 cpu_opaque：RX 线程只暂存输入，由 machine_run 投递
+    m->uart = m->memory ? uart_create(UART_BASE, NULL, UART_IRQ_NUM, cfg && cfg->serial ? cfg->serial : "null") : NULL;
+    if (!m->uart) {
+        ram_free(m->memory);
+        free(m);
+        return NULL;
+    }
+    uart_set_deterministic(m->uart);
+    m->ram.data = m->memory;
+    m->ram.size = MEMORY_SIZE;
+
+    // m 里除了 RAM 都是零，装进来就是一套全新的状态，在上面搭这台机器
+    load(m);
+
+    bus_register_mmio(&bus, MEMORY_BASE, MEMORY_SIZE, ram_read, ram_write, &m->ram);
+    bus_register_mmio(&bus, UART_BASE, UART_SIZE, uart_rd, uart_wr, m->uart);
+    plic_init();
+    bus_register_mmio(&bus, PLIC_BASE, PLIC_SIZE, plic_rd, plic_wr, NULL);
+    virtio_console_init(m->uart);
+    bus_register_mmio(&bus, VIRTIO_CONSOLE_BASE, VIRTIO_CONSOLE_SIZE,
+                      virtio_console_mmio_read, virtio_console_mmio_write, NULL);
+    bus_register_mmio(&bus, VMCTL_BASE, VMCTL_SIZE, vmctl_read, vmctl_write, NULL);
+    bus_register_mmio(&bus, CLINT_BASE_ADDR, CLINT_SIZE, clint_rd, clint_wr, NULL);
+
+    cpu_init(&cpu[0], 0);
+    cpu[0].uart_table[UART_IRQ_NUM] = (uint8_t *)m->uart;
+    tlb_flush(&cpu[0]);
+    cpu[0].pc = MEMORY_BASE;
+    leave(m);
+    return m;
+}
+
+void machine_destroy(Machine *m) {
+    if (!m) return;
+    enter(m);
+    if (dev.disk) virtio_blk_close();
+    while (!LIST_EMPTY(&pending_ops)) {
+        struct disk_operation *op = LIST_FIRST(&pending_ops);
+        LIST_REMOVE(op, entriess);
+        free(op);
+    }
+    uart_destroy(m->uart);
+    ram_free(memory);
+    free(ram_dirty);
+    memory = NULL;
+    ram_dirty = NULL;
+    loaded = 0;
+    free(m);
+}
+
+int machine_load_elf(Machine *m, const char *path) {
+    uint64_t entry;
+    enter(m);
+    int r = load_elf64_SBI(path, &entry);
+    if (r >= 0) cpu[0].pc = entry;
+    leave(m);
+    return r < 0 ? -1 : 0;
+}
+
+int machine_load_disk(Machine *m, const char *path, const char *overlay) {
+    enter(m);
+    int r = -1;
+    if (dev.disk) {
+        fprintf(stderr, "[machine] disk already attached\n");
+    } else if (virtio_blk_init(path, overlay) == 0) {
+        bus_register_mmio(&bus, VIRTIO_MMIO_BASE, VIRTIO_MMIO_SIZE, blk_rd, blk_wr, NULL);
+        cpu[0].bus = bus;   // cpu_init 时拷过一份总线
+        r = 0;
+    }
+    leave(m);
+    return r;
+}
+
+// 投递 UART 后端读到的输入；RX 中断经 PLIC 会把 WFI 里的 hart 叫醒
+static void uart_deliver(UARTDevice *u) {
+    uint8_t buf[UART_RX_BUF_SIZE];
+    uint32_t n = uart_rx_take(u, buf, sizeof(buf));
+    if (n) uart_rx_inject(u, buf, n);
+}
+
+int machine_run(Machine *m, uint64_t max_insns) {
+    enter(m);
+    CPU_State *c = &cpu[0];
+    UARTDevice *u = m->uart;
+    if (c->halted && uart_rx_staged(u)) uart_deliver(u);
+
+    uint64_t end = c->inst_count + max_insns;
+    while (c->running && !c->halted && !vmfork_pending && c->inst_count < end) {
+        cpu_step(c, memory);
+        virtio_disk_update(&c->cycle_count);
+        if (uart_rx_staged(u)) uart_deliver(u);
+        if (u->baud_emulation) uart_update(u, c->cycle_count * CPU_CYCLE_PS);
+        check_and_handle_interrupts(c);
+    }
+
+    int r = MACHINE_LIMIT;
+    if (!c->running) r = MACHINE_EXITED;
+    else if (c->halted) r = MACHINE_HALTED;
+    else if (vmfork_pending) r = MACHINE_MARKER;
+    vmfork_pending = 0;
+    leave(m);
+    return r;
+}
+
+// 下面只读写一两个字段，直接用 m 里存着的状态
+uint64_t machine_get_pc(Machine *m) {
+    return m->cpu[0].pc;
+}
+
+void machine_set_pc(Machine *m, uint64_t pc) {
+    m->cpu[0].pc = pc;
+    touched(m);
+}
+
+uint64_t machine_get_reg(Machine *m, int reg) {
+    return reg > 0 && reg < 32 ? m->cpu[0].gpr[reg] : 0;
+}
+
+void machine_set_reg(Machine *m, int reg, uint64_t value) {
+    if (reg <= 0 || reg >= 32) return;
+    m->cpu[0].gpr[reg] = value;
+    touched(m);
+}
+
+uint64_t machine_get_csr(Machine *m, int csr) {
+    return read_csr(&m->cpu[0], csr);
+}
+
+static bool in_ram(uint64_t paddr, size_t len) {
+    return paddr >= MEMORY_BASE && len <= MEMORY_SIZE && paddr - MEMORY_BASE <= MEMORY_SIZE - len;
+}
+
+// 按 m->ram_dirty 记脏页（ram_mark_dirty 用的是当前线程的全局变量）
+static void mark_dirty(Machine *m, uint64_t off, uint64_t len) {
+    if (!m->ram_dirty || len == 0) return;
+    for (uint64_t pg = off >> RAM_DIRTY_SHIFT; pg <= (off + len - 1) >> RAM_DIRTY_SHIFT; pg++)
+        m->ram_dirty[pg >> 6] |= 1ull << (pg & 63);
+}
+
+int machine_read_mem(Machine *m, uint64_t paddr, void *buf, size_t len) {
+    if (!in_ram(paddr, len)) return -1;
+    memcpy(buf, m->memory + (paddr - MEMORY_BASE), len);
+    return 0;
+}
+
+int machine_write_mem(Machine *m, uint64_t paddr, const void *buf, size_t len) {
+    if (!in_ram(paddr, len)) return -1;
+    memcpy(m->memory + (paddr - MEMORY_BASE), buf, len);
+    mark_dirty(m, paddr - MEMORY_BASE, len);
+    return 0;
+}
+
+int machine_set_input(Machine *m, const void *data, size_t len) {
+    uint64_t buf = m->marker_value;
+    if (len > UINT32_MAX || !in_ram(buf, len)) return -1;
+    memcpy(m->memory + (buf - MEMORY_BASE), data, len);
+    mark_dirty(m, buf - MEMORY_BASE, len);
+    m->input_len = len;
+    touched(m);
+    return 0;
+}
+
+uint64_t machine_inst_count(Machine *m) {
+    return m->cpu[0].inst_count;
+}
+
+int machine_exit_code(Machine *m) {
+    return m->exit_code;
+}
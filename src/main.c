@@ -14,8 +14,22 @@
 #include "plic.h"
 #include "decode.h"
 #include "virtio_blk.h"
+#include "virtio_net.h"
+#include "virtio_console.h"
 #include "clint.h"
 #include "trap.h"
+#include "profiler.h"
+#include "stats.h"
+#include "instmix.h"
+#include "trace.h"
+#include "perfmap.h"
+#include "snapshot.h"
+#include "vmfork.h"
+#include "fuzz.h"
+#include "replay.h"
+#include "config.h"
+#include "dts.h"
+#include "sbi.h"
 
 // x1: returen address
 // x2: stack pointer
@@ -30,13 +44,12 @@
 // x28~x31: temp register
 
 
-extern uint8_t* memory;
-extern virtio_blk_device dev;
-Bus bus;
-extern CPU_State cpu[MAX_CORES];
-int log_enable = 0;
+extern VM_LOCAL uint8_t* memory;
+extern VM_LOCAL virtio_blk_device dev;
+extern VM_LOCAL Bus bus;
+extern VM_LOCAL CPU_State cpu[MAX_CORES];
 
-int j,m = 0;
+extern VM_LOCAL int j;
 
 
 
@@ -46,11 +59,41 @@ static uint64_t get_real_time_us() {
     return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
 }
 
-int main() {
+// 设备树放在内存顶部，写一份到 desc->dtb_file；返回 DTB 的物理地址，失败返回 0
+static uint64_t place_dtb(const MachineDesc *desc) {
+    uint64_t addr = MEMORY_BASE + desc->ram_size - DTB_MAX_SIZE;
+    uint8_t *blob = memory + (addr - MEMORY_BASE);
+    uint32_t size = create_complete_device_tree(desc, blob, DTB_MAX_SIZE);
+    if (size == 0) {
+        fprintf(stderr, "device tree does not fit in %u bytes\n", DTB_MAX_SIZE);
+        return 0;
+    }
+    if (desc->dtb_file) {
+        FILE *fp = fopen(desc->dtb_file, "wb");
+        if (!fp || fwrite(blob, 1, size, fp) != size) {
+            fprintf(stderr, "cannot write %s: %s\n", desc->dtb_file, strerror(errno));
+            if (fp) fclose(fp);
+            return 0;
+        }
+        fclose(fp);
+    }
+    printf("dtb: %u bytes at 0x%08lx\n", size, addr);
+    return addr;
+}
+
+int main(int argc, char **argv) {
     setbuf(stdout, NULL);
+
+    // 命令行 / 配置文件描述机器（见 config.h）
+    MachineDesc desc;
+    config_defaults(&desc);
+    if (config_parse_args(&desc, argc, argv) < 0) return 2;
+    clint_tick_period = 1000000000000ULL / CPU_CYCLE_PS / desc.timebase;
+    ram_size = desc.ram_size;
+
     printf("Initializing RISC-V emulator...\n");
-    printf("Memory size: %ld GB, Base address: 0x%08x\n", 
-           MEMORY_SIZE / (1024 * 1024 * 1024), MEMORY_BASE);
+    printf("Memory size: %lu MiB, Base address: 0x%08x, timebase: %lu Hz\n",
+           desc.ram_size >> 20, MEMORY_BASE, desc.timebase);
     
     init_memory();
 
@@ -60,7 +103,7 @@ int main() {
 
     RAMDevice ram;
     ram.data = memory;
-    ram.size = MEMORY_SIZE;
+    ram.size = desc.ram_size;
     
     // 初始化挂起操作缓冲区
     ram.pending.load_capacity = 16;
@@ -72,23 +115,43 @@ int main() {
                                    sizeof(*ram.pending.store_ops));
     ram.pending.store_count = 0;
 
-    uint64_t entry_addr;
-    if(load_elf64_SBI("kernel",&entry_addr) < 0){
-        printf("load openSBI error\n");
+    // RVEMU_SNAPSHOT_LOAD=<file>：从快照恢复整机，内存由快照填充，不再加载 ELF
+    const char *snap_load = getenv("RVEMU_SNAPSHOT_LOAD");
+
+    // RVEMU_LOAD_MAP=0|1：内核 / initrd 是否直接映射进 RAM，默认只映射只读文件（见 elf_load.h）
+    uint64_t entry_addr = MEMORY_BASE, kernel_end = MEMORY_BASE;
+    if (snap_load) {
+        printf("restoring from snapshot %s\n", snap_load);
+    } else if (desc.sbi_builtin ? load_linux_image(desc.kernel, &entry_addr, &kernel_end) < 0
+                                : load_elf64_SBI(desc.kernel, &entry_addr) < 0) {
+        fprintf(stderr, "load openSBI error: %s\n", desc.kernel);
+        return 1;
     }else{
         printf("entry addr:0x%08lx\n",entry_addr);
     }
 
-    virtio_blk_init("fs.img");
-    printf("=====init driveraddr:0x%16lx\n",dev.avail_ring);
+    // initrd 放在 DTB 下面，不能压到内核
+    if (desc.initrd && !snap_load &&
+        load_initrd(desc.initrd, kernel_end, MEMORY_BASE + desc.ram_size - DTB_MAX_SIZE,
+                    &desc.initrd_start, &desc.initrd_end) < 0)
+        return 1;
+
+    // overlay=<file>（默认 RVEMU_DISK_OVERLAY）: 磁盘镜像只读共享，本 VM 的写入落在该 delta 文件
+    if (desc.devices & DEV_VIRTIO_BLK) {
+        if (virtio_blk_init(desc.disk, desc.overlay) < 0) return 1;
+        printf("=====init driveraddr:0x%16lx\n",dev.avail_ring);
+    }
 
     bus_register_mmio(&bus, 
-                    MEMORY_BASE, MEMORY_SIZE, 
+                    MEMORY_BASE, desc.ram_size, 
                     ram_read, 
                     ram_write, 
                     &ram);
 
-    UARTDevice *uart = uart_create(UART_BASE, &cpu, UART_IRQ_NUM);
+    // serial=（默认 RVEMU_SERIAL）stdio | file:<path> | unix:<path> | pty | tty:<dev> | null
+    UARTDevice *uart = uart_create(UART_BASE, &cpu, UART_IRQ_NUM, desc.serial);
+    if (!uart) return 1;
+    if (desc.sbi_builtin) sbi_init(uart);
     
     printf("TX thread tid=%ld\n", uart->tx_thread);
     cpu->uart_table[UART_IRQ_NUM] = uart;
@@ -106,11 +169,31 @@ int main() {
                     plic_write,
                     &plic);          
                     
-    bus_register_mmio(&bus,VIRTIO_MMIO_BASE,
-                    VIRTIO_MMIO_SIZE,
-                    virtio_mmio_read,
-                    virtio_mmio_write,
-                    &dev);
+    if (desc.devices & DEV_VIRTIO_BLK)
+        bus_register_mmio(&bus,VIRTIO_MMIO_BASE,
+                        VIRTIO_MMIO_SIZE,
+                        virtio_mmio_read,
+                        virtio_mmio_write,
+                        &dev);
+
+    if (desc.devices & DEV_VIRTIO_CONSOLE) {
+        virtio_console_init(uart);
+        bus_register_mmio(&bus, VIRTIO_CONSOLE_BASE, VIRTIO_CONSOLE_SIZE,
+                          virtio_console_mmio_read,
+                          virtio_console_mmio_write,
+                          &condev);
+    }
+
+    // net=（默认 RVEMU_NET）listen:<path> | connect:<path> | tap:<ifname>
+    if ((desc.devices & DEV_VIRTIO_NET) && desc.net && virtio_net_init(desc.net) == 0) {
+        bus_register_mmio(&bus, VIRTIO_NET_BASE, VIRTIO_NET_SIZE,
+                          virtio_net_mmio_read,
+                          virtio_net_mmio_write,
+                          &netdev);
+    }
+
+    if (desc.devices & DEV_VMCTL)
+        bus_register_mmio(&bus, VMCTL_BASE, VMCTL_SIZE, vmctl_read, vmctl_write, NULL);
 
     bus_register_mmio(&bus,CLINT_BASE_ADDR,
                          CLINT_SIZE,         
@@ -118,12 +201,43 @@ int main() {
                         clint_write,
                         &cpu->clint);
     
+    // RVEMU_PROF=<N> | timer:<hz>：客户机 PC 采样，退出时写 RVEMU_PROF_OUT.{flat,folded}
+    const char *prof_spec = getenv("RVEMU_PROF");
+    if (prof_spec) prof_init(prof_spec, desc.kernel, getenv("RVEMU_PROF_OUT"));
+
+    // RVEMU_STATS=<file>：退出时把内部计数器以 JSON 写到该文件；任何时候 kill -USR1 都会导出一次
+    const char *stats_path = getenv("RVEMU_STATS");
+    stats_init(&bus, uart, stats_path);
+
+    // RVEMU_INSTMIX=<file>|-：按处理函数 / 主操作码统计指令组合，退出时写出
+    const char *instmix_path = getenv("RVEMU_INSTMIX");
+
+    // RVEMU_TRACE=<N>：每个 hart 保留最近 N 条指令的二进制轨迹，退出 / SIGUSR2 / 崩溃时写 RVEMU_TRACE_OUT
+    const char *trace_spec = getenv("RVEMU_TRACE");
+    if (trace_spec && trace_init(trace_spec, getenv("RVEMU_TRACE_OUT"), 1) < 0) return 1;
+
+    // RVEMU_PERFMAP=map|jitdump|map,jitdump：按客户机函数生成跳板，主机 perf 里能看到客户机函数（见 perfmap.h）
+    const char *perfmap_spec = getenv("RVEMU_PERFMAP");
+    if (perfmap_spec && perfmap_init(perfmap_spec, desc.kernel) < 0) return 1;
+
+    // RVEMU_SNAPSHOT_SAVE=<file> [RVEMU_SNAPSHOT_AT=<N> | RVEMU_SNAPSHOT_EVERY=<sec>]：
+    // 退出时 / 第 N 条指令时保存整机快照，或每隔 sec 秒写增量检查点（见 snapshot.h）
+    snapshot_init(getenv("RVEMU_SNAPSHOT_SAVE"), getenv("RVEMU_SNAPSHOT_AT"),
+                  getenv("RVEMU_SNAPSHOT_EVERY"), uart);
+
+    // RVEMU_FORK=<N>：客户机到达分叉点后 fork 出 N 个克隆各自运行（见 vmfork.h）
+    if (vmfork_init(getenv("RVEMU_FORK"), uart) < 0) return 1;
+
+    // RVEMU_FUZZ=<input>：到达 MARKER 后从内存快照反复跑输入，记录分支覆盖率（见 fuzz.h）
+    if (fuzz_init(getenv("RVEMU_FUZZ"), uart) < 0) return 1;
+
     static uint64_t last__v = 0;
 
     for(int i = 0; i< 1;i++){
         cpu[i].bus = bus;
         
         cpu_init(&cpu[i],i);
+        if (instmix_path) instmix_enable(instmix_path);   // 分发表在 cpu_init 里才填好
         cpu[i].cycle_count = 0;
         tlb_flush(&cpu);
         // 运行模拟器
@@ -131,6 +245,18 @@ int main() {
         printf("Only cpu 0\n");
      
         cpu[i].pc = entry_addr;
+        // 按 OpenSBI / Linux 的启动约定：a0 = hartid，a1 = 设备树地址
+        if (desc.dtb && !snap_load) {
+            uint64_t dtb_addr = place_dtb(&desc);
+            if (!dtb_addr) return 1;
+            cpu[i].gpr[10] = i;
+            cpu[i].gpr[11] = dtb_addr;
+        }
+        // sbi=builtin：跳过固件，从 S 模式进入内核
+        if (desc.sbi_builtin && !snap_load) sbi_boot(&cpu[i], entry_addr, cpu[i].gpr[11]);
+        if (snap_load && snapshot_load(snap_load, uart) < 0) return 1;
+        // RVEMU_RECORD=<file> | RVEMU_REPLAY=<file>：录制 / 回放 UART 和网络输入（见 replay.h）
+        if (rr_init(getenv("RVEMU_RECORD"), getenv("RVEMU_REPLAY"), uart) < 0) return 1;
         printf("pc[%d]:0x%08lx\n",i,cpu[i].pc);
             
             
@@ -155,18 +281,9 @@ int main() {
         { 
            
             j++;
-            if(cpu[0].pc == 0x80001d98 && j > 431961660){
-                m = j;
-                printf("j:%d,cycle:%d,pc:0x%08lx\n",j,m,cpu->pc  );
-            }
-
-            if(j > m && j < m + 10){
-                log_enable = 1;
-            }else{
-                log_enable = 0;
-            }
-           
 
+            rr_halt_poll(&cpu[i]);
+            sbi_halt_poll(&cpu[i]);
             if(cpu[0].running == false){
                 break;
             }
@@ -179,13 +296,25 @@ int main() {
 
             pthread_mutex_unlock(&cpu->lock);
                 
-            cpu_step(&cpu[i],memory);
+            perfmap_cpu_step(&cpu[i], memory);
+            prof_tick(&cpu[i]);
+            stats_poll();
+            snapshot_poll(&cpu[i]);
+            fuzz_poll();
+            int fork_status = vmfork_poll();
+            if (fork_status >= 0) {   // 父进程：克隆都跑完了
+                vmctl_exit_code = fork_status;
+                break;
+            }
             
             if(cpu[0].gpr[0] != 0){
                 printf("j:%d pc:0x%08lx\n",j,cpu[0].pc);
                 cpu[0].halted = true;
             }
             virtio_disk_update(&cpu[i].cycle_count);
+            virtio_net_update();
+            rr_poll(&cpu[i]);
+            if (uart->baud_emulation) uart_update(uart, cpu[i].cycle_count * CPU_CYCLE_PS);
         
             check_and_handle_interrupts(&cpu[i]);
             
@@ -197,6 +326,17 @@ int main() {
         //cpu_dump_registers(&cpu[i]);
         
         printf("Cleaning up...\n");
+        prof_dump();
+        if (stats_path) stats_dump();
+        instmix_dump();
+        trace_dump();
+        perfmap_close();
+        snapshot_dump();
+        rr_close(&cpu[i]);
+        virtio_blk_close();
+        virtio_net_close();
+        virtio_console_close();
+        uart_destroy(uart);   // 写出剩余输出、恢复终端设置
         
         //free(memory);
         printf("Emulator finished j:%ld,pc:0x%08lx\n",j,cpu[0].pc);
@@ -249,5 +389,5 @@ int main() {
 
    // init_tasks();
 
-    return 0;
+    return vmctl_exit_code;
 }
\ No newline at end of file
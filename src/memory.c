@@ -3,32 +3,55 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/mman.h>
 #include "emulator_api.h"
 #include "cpu.h"
 
-uint8_t* memory = NULL;
-extern int log_enable;
+VM_LOCAL uint8_t* memory = NULL;
+VM_LOCAL uint64_t *ram_dirty = NULL;
+uint64_t ram_size = MEMORY_SIZE;
 
-void init_memory(){
+void ram_dirty_enable(void) {
+    if (!ram_dirty) ram_dirty = calloc(RAM_DIRTY_PAGES / 64, sizeof(uint64_t));
+}
 
-     memory = (uint8_t*)malloc(MEMORY_SIZE);
+// 客户机 RAM 是一段页对齐的匿名映射：按需映射零页，不用先把整块内存写一遍；
+// ELF 加载器可以把只读段直接映射进来，也可以用 ram_zero 把整页换回零页
+uint8_t *ram_alloc(void) {
+    void *p = mmap(NULL, MEMORY_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return p == MAP_FAILED ? NULL : p;
+}
+
+void ram_free(uint8_t *ram) {
+    if (ram) munmap(ram, MEMORY_SIZE);
+}
+
+// 把 RAM [off, off+len) 清零：首尾不满一页的部分 memset，中间整页重新映射成零页，第一次访问时才分配
+void ram_zero(uint64_t off, uint64_t len) {
+    uint64_t start = (off + RAM_PAGE_SIZE - 1) & ~(RAM_PAGE_SIZE - 1);
+    uint64_t end = (off + len) & ~(RAM_PAGE_SIZE - 1);
+    if (start >= end) {
+        memset(memory + off, 0, len);
+        return;
+    }
+    memset(memory + off, 0, start - off);
+    memset(memory + end, 0, off + len - end);
+    if (mmap(memory + start, end - start, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0) == MAP_FAILED)
+        memset(memory + start, 0, end - start);
+}
 
-   // memory = (uint8_t*)aligned_alloc(4096, MEMORY_SIZE);
+void init_memory(){
+
+    memory = ram_alloc();
     if (!memory) {
         printf("Failed to allocate %ld GB memory\n", MEMORY_SIZE / (1024 * 1024 * 1024));
         return ;
     }
-    
-    if (!memory) {
-        printf("Failed to allocate aligned memory\n");
-        return;
-    }
-
-    printf("Zeroing memory...\n");
-    memset(memory, 0, MEMORY_SIZE);
 }
-extern CPU_State cpu[MAX_CORES];
-extern int j;
+extern VM_LOCAL CPU_State cpu[MAX_CORES];
+extern VM_LOCAL int j;
 uint64_t memory_read(uint8_t* memory, uint64_t address, size_t size) {
     if (memory == NULL) {
         printf("Read ERROR: memory pointer is NULL!\n");
@@ -50,6 +73,7 @@ uint64_t memory_read(uint8_t* memory, uint64_t address, size_t size) {
         printf("fetch Read ERROR: Memory read out of bounds: address=0x%08x, offset=0x%08x, size=%zu\n", 
                address, offset, size);
         printf("j:%ld\n",j);
+        cpu_stop_fault(&cpu[0], EXC_INST_ACCESS, address);
         cpu[0].halted = true;
         return 0;
     }
@@ -85,7 +109,7 @@ void memory_write(uint8_t* memory, uint64_t address, uint64_t value, size_t size
         return;
     }
     memcpy(memory + phys_addr, &value, size);
-    
+    ram_mark_dirty(phys_addr, size);
 }
 
 void memory_load_binary(uint8_t* memory, const char* filename, uint64_t load_address) {
@@ -154,6 +178,7 @@ void ram_write(void *opaque, uint64_t offset, uint64_t value, unsigned size) {
         ram->data[offset+i] = val;
       //  printf("ram->data[0x%08lx]:0x%08lx\n",offset+i,val);
     }
+    ram_mark_dirty(offset, size);
     
     COMPILER_BARRIER();
 }
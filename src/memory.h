@@ -27,8 +27,17 @@ typedef struct {
 } RAMDevice;
 
 
+#define RAM_PAGE_SIZE 4096ULL
+
+// 客户机看得到的 RAM 大小（ram=，不超过 MEMORY_SIZE，后面的部分只是没用上的后备内存）；
+// 总线回退、物理地址检查和加载器都按它判断越界，和设备树里的 memory 节点一致
+extern uint64_t ram_size;
+
 // 内存操作函数
 void init_memory();
+uint8_t *ram_alloc(void);
+void ram_free(uint8_t *ram);
+void ram_zero(uint64_t off, uint64_t len);
 void write32(uint64_t addr,uint64_t val);
 uint64_t memory_read(uint8_t* memory, uint64_t address, size_t size);
 void memory_write(uint8_t* memory, uint64_t address, uint64_t value, size_t size);
@@ -50,6 +59,22 @@ void memory_sync_read(void *opaque, uint64_t addr);
 void memory_sync_write(void *opaque, uint64_t addr, uint64_t value);
 void memory_synchronize(void* opaque);
 
+// 客户机内存脏页位图，每 4 KiB 一位，快照的增量检查点用（见 snapshot.h）。
+// 所有写客户机内存的路径（ram_write / bus_write 回退 / memory_write / virtio DMA）都要调用 ram_mark_dirty；
+// 没有打开跟踪时 ram_dirty 为 NULL，只多一次判断
+#define RAM_DIRTY_SHIFT 12
+#define RAM_DIRTY_PAGES (MEMORY_SIZE >> RAM_DIRTY_SHIFT)
+
+extern VM_LOCAL uint64_t *ram_dirty;
+
+static inline void ram_mark_dirty(uint64_t off, uint64_t len) {
+    if (__builtin_expect(ram_dirty == NULL, 1) || len == 0) return;
+    for (uint64_t pg = off >> RAM_DIRTY_SHIFT; pg <= (off + len - 1) >> RAM_DIRTY_SHIFT; pg++)
+        ram_dirty[pg >> 6] |= 1ull << (pg & 63);
+}
+
+void ram_dirty_enable(void);
+
 
 
 #endif // MEMORY_H
\ No newline at end of file
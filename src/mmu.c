@@ -1,6 +1,8 @@
 #include "mmu.h"
-extern int j ;
-extern int log_enable;
+#include "stats.h"
+#include "trace.h"
+#include "memory.h"
+extern VM_LOCAL int j ;
 
 // fault codes returned by translate
 
@@ -32,7 +34,7 @@ static inline void handle_fault(CPU_State *cpu, FaultCtx *f)
 static inline int phys_ok(CPU_State *cpu, uint64_t pa, uint64_t len) {
     // bounds check (you can hook platform-specific PMA checks here)
 
-    if ((uint64_t)pa + len > MEMORY_BASE + MEMORY_SIZE) return 0;
+    if ((uint64_t)pa + len > MEMORY_BASE + ram_size) return 0;
     return 1;
 }
 
@@ -114,6 +116,7 @@ int sv39_translate(CPU_State* cpu,uint64_t va,int acc_type,uint64_t *out_pa,uint
         return FAULT_NONE;
     }
 
+    STAT_INC(page_walks);
     uint64_t satp_ppn = cpu->satp & (( 1ULL << 44 ) - 1 );
     uint64_t table_addr = (satp_ppn << 12);
     
@@ -532,10 +535,16 @@ uint64_t get_pa(CPU_State *cpu,uint64_t vaddr,int acc_type){
     uint64_t satp = cpu->csr[CSR_SATP];
     uint8_t flags = 0;
 
+    trace_note_mem(cpu, vaddr, acc_type);
     if (((satp >> 60) & 0xF) == 0){
         return vaddr;
     }
     int result = tlb_lookup(cpu,vaddr,acc_type,&pa,cpu->asid);
+    if (acc_type == ACC_FETCH) {
+        if (result == TLB_MISS) STAT_INC(itlb_misses); else if (result == TLB_OK) STAT_INC(itlb_hits);
+    } else {
+        if (result == TLB_MISS) STAT_INC(dtlb_misses); else if (result == TLB_OK) STAT_INC(dtlb_hits);
+    }
 
     if(result == TLB_OK){
         return pa;
@@ -553,6 +562,7 @@ uint64_t get_pa(CPU_State *cpu,uint64_t vaddr,int acc_type){
 
     result = sv39_translate(cpu,vaddr,acc_type,&pa,&flags);
     if(result != MMU_OK){
+        STAT_INC(page_walk_faults);
         FaultCtx f = {
             .src = result,
             .acc_type = acc_type,
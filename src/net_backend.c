@@ -0,0 +1,161 @@
+// net_backend.c
+#include "net_backend.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/ioctl.h>
+#include <poll.h>
+#ifdef __linux__
+#include <linux/if.h>
+#include <linux/if_tun.h>
+#endif
+
+static int unix_addr(struct sockaddr_un *sa, const char *path) {
+    memset(sa, 0, sizeof(*sa));
+    sa->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(sa->sun_path)) {
+        fprintf(stderr, "[net] socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(sa->sun_path, path);
+    return 0;
+}
+
+static int tap_open(const char *ifname) {
+#ifdef __linux__
+    int fd = open("/dev/net/tun", O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        perror("[net] open /dev/net/tun");
+        return -1;
+    }
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+    if (ioctl(fd, TUNSETIFF, &ifr) < 0) {
+        perror("[net] TUNSETIFF");
+        close(fd);
+        return -1;
+    }
+    return fd;
+#else
+    (void)ifname;
+    fprintf(stderr, "[net] tap backend is only available on Linux\n");
+    return -1;
+#endif
+}
+
+int net_backend_open(NetBackend *nb, const char *spec) {
+    memset(nb, 0, sizeof(*nb));
+    nb->fd = -1;
+    nb->listen_fd = -1;
+    pthread_mutex_init(&nb->lock, NULL);
+
+    const char *arg = strchr(spec, ':');
+    if (!arg || !arg[1]) {
+        fprintf(stderr, "[net] bad backend spec '%s' (want listen:<path>, connect:<path> or tap:<if>)\n", spec);
+        return -1;
+    }
+    arg++;
+    snprintf(nb->path, sizeof(nb->path), "%s", arg);
+
+    if (strncmp(spec, "listen:", 7) == 0) {
+        struct sockaddr_un sa;
+        if (unix_addr(&sa, arg) < 0) return -1;
+        nb->listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (nb->listen_fd < 0) {
+            perror("[net] socket");
+            return -1;
+        }
+        unlink(arg);
+        if (bind(nb->listen_fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 ||
+            listen(nb->listen_fd, 1) < 0) {
+            fprintf(stderr, "[net] cannot listen on %s: %s\n", arg, strerror(errno));
+            close(nb->listen_fd);
+            nb->listen_fd = -1;
+            return -1;
+        }
+        nb->type = NET_BACKEND_LISTEN;
+    } else if (strncmp(spec, "connect:", 8) == 0) {
+        nb->type = NET_BACKEND_CONNECT;   // 真正的 connect 在 net_backend_wait_ready 里做
+    } else if (strncmp(spec, "tap:", 4) == 0) {
+        nb->fd = tap_open(arg);
+        if (nb->fd < 0) return -1;
+        nb->type = NET_BACKEND_TAP;
+    } else {
+        fprintf(stderr, "[net] unknown backend '%s'\n", spec);
+        return -1;
+    }
+    printf("[net] backend %s\n", spec);
+    return 0;
+}
+
+// 在接收线程里调用：建立连接（accept 或重试 connect），成功返回 0，running 被清掉时返回 -1
+int net_backend_wait_ready(NetBackend *nb, const bool *running) {
+    if (nb->fd >= 0) return 0;
+
+    while (*running) {
+        int fd = -1;
+        if (nb->type == NET_BACKEND_LISTEN) {
+            struct pollfd pfd = { .fd = nb->listen_fd, .events = POLLIN };
+            if (poll(&pfd, 1, 100) <= 0) continue;
+            fd = accept(nb->listen_fd, NULL, NULL);
+        } else if (nb->type == NET_BACKEND_CONNECT) {
+            struct sockaddr_un sa;
+            if (unix_addr(&sa, nb->path) < 0) return -1;
+            fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+            if (fd >= 0 && connect(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+                close(fd);
+                fd = -1;
+                usleep(100000);
+                continue;
+            }
+        } else {
+            return -1;
+        }
+        if (fd < 0) continue;
+
+        pthread_mutex_lock(&nb->lock);
+        nb->fd = fd;
+        pthread_mutex_unlock(&nb->lock);
+        printf("[net] peer connected on %s\n", nb->path);
+        return 0;
+    }
+    return -1;
+}
+
+// 发送一个帧；连接尚未建立或对端拥塞时丢弃（与真实网卡一致，由上层协议重传）
+ssize_t net_backend_send(NetBackend *nb, const struct iovec *iov, int iovcnt) {
+    pthread_mutex_lock(&nb->lock);
+    int fd = nb->fd;
+    pthread_mutex_unlock(&nb->lock);
+    if (fd < 0) return 0;
+
+    if (nb->type == NET_BACKEND_TAP)
+        return writev(fd, iov, iovcnt);
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = (struct iovec *)iov;
+    msg.msg_iovlen = iovcnt;
+    ssize_t n = sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+    return n;
+}
+
+// 阻塞接收一个帧；对端关闭返回 0
+ssize_t net_backend_recv(NetBackend *nb, void *buf, size_t len) {
+    if (nb->type == NET_BACKEND_TAP)
+        return read(nb->fd, buf, len);
+    return recv(nb->fd, buf, len, 0);
+}
+
+void net_backend_close(NetBackend *nb) {
+    if (nb->fd >= 0) close(nb->fd);
+    if (nb->listen_fd >= 0) {
+        close(nb->listen_fd);
+        unlink(nb->path);
+    }
+    nb->fd = -1;
+    nb->listen_fd = -1;
+    pthread_mutex_destroy(&nb->lock);
+}
@@ -0,0 +1,39 @@
+// net_backend.h
+#ifndef NET_BACKEND_H
+#define NET_BACKEND_H
+
+#include "common.h"
+#include <sys/uio.h>
+
+/*
+ * virtio-net 的主机侧后端
+ *
+ *   listen:<path>   UNIX SOCK_SEQPACKET，本端监听，等待另一个模拟器连接
+ *   connect:<path>  UNIX SOCK_SEQPACKET，连接到 listen 端（对端未启动时后台重试）
+ *   tap:<ifname>    Linux tap 设备（IFF_TAP | IFF_NO_PI）
+ *
+ * SEQPACKET 保留报文边界，一个 send 对应一个以太网帧。
+ */
+
+typedef enum {
+    NET_BACKEND_NONE = 0,
+    NET_BACKEND_LISTEN,
+    NET_BACKEND_CONNECT,
+    NET_BACKEND_TAP,
+} NetBackendType;
+
+typedef struct {
+    NetBackendType type;
+    int fd;             // 收发用的 fd，连接建立前为 -1
+    int listen_fd;      // listen 模式的监听 socket
+    char path[108];     // sun_path 或 tap 接口名
+    pthread_mutex_t lock;
+} NetBackend;
+
+int net_backend_open(NetBackend *nb, const char *spec);
+int net_backend_wait_ready(NetBackend *nb, const bool *running);
+ssize_t net_backend_send(NetBackend *nb, const struct iovec *iov, int iovcnt);
+ssize_t net_backend_recv(NetBackend *nb, void *buf, size_t len);
+void net_backend_close(NetBackend *nb);
+
+#endif
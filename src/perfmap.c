@@ -0,0 +1,230 @@
+// perfmap.c
+#include "perfmap.h"
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// jitdump 格式见 linux tools/perf/Documentation/jitdump-specification.txt
+#define JITDUMP_MAGIC       0x4A695444
+#define JITDUMP_VERSION     1
+#define JIT_CODE_LOAD       0
+
+#define STUB_SIZE           32      // 每个跳板占的字节，多出来的填 int3
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t total_size;
+    uint32_t elf_mach;
+    uint32_t pad1;
+    uint32_t pid;
+    uint64_t timestamp;
+    uint64_t flags;
+} JitHeader;
+
+typedef struct {
+    uint32_t id;
+    uint32_t total_size;
+    uint64_t timestamp;
+} JitRecordHeader;
+
+typedef struct {
+    JitRecordHeader p;
+    uint32_t pid;
+    uint32_t tid;
+    uint64_t vma;
+    uint64_t code_addr;
+    uint64_t code_size;
+    uint64_t code_index;
+    // 后面跟以 \0 结尾的名字和 code_size 字节的代码
+} JitCodeLoad;
+
+typedef void (*StepFn)(CPU_State *cpu, uint8_t *memory);
+
+bool perfmap_on;
+
+static struct {
+    FILE *map;
+    FILE *jit;
+    void *jit_marker;       // perf record 靠这次可执行 mmap 发现 jitdump 文件
+    long page_size;
+    uint64_t code_index;
+    ElfSymtab symtab;
+
+    uint8_t *stubs;         // symtab.count + 1 个跳板，最后一个给不在符号里的 pc
+    size_t stubs_size;
+
+    // 上一条指令所在的函数 [lo, hi) 和它的跳板，顺序执行时不用每次查表
+    uint64_t lo, hi;
+    StepFn fn;
+} pm;
+
+static uint64_t timestamp_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int open_jitdump(void) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/jit-%d.dump", getpid());
+    int fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0666);
+    if (fd < 0) {
+        fprintf(stderr, "[perfmap] cannot create %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    pm.page_size = sysconf(_SC_PAGESIZE);
+    pm.jit_marker = mmap(NULL, pm.page_size, PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, 0);
+    if (pm.jit_marker == MAP_FAILED) {
+        fprintf(stderr, "[perfmap] mmap %s: %s\n", path, strerror(errno));
+        pm.jit_marker = NULL;
+        close(fd);
+        return -1;
+    }
+    pm.jit = fdopen(fd, "w+");
+
+    JitHeader h = {
+        .magic = JITDUMP_MAGIC,
+        .version = JITDUMP_VERSION,
+        .total_size = sizeof(JitHeader),
+        .elf_mach = EM_X86_64,
+        .pid = getpid(),
+        .timestamp = timestamp_ns(),
+    };
+    fwrite(&h, sizeof(h), 1, pm.jit);
+    return 0;
+}
+
+// 跳板：push rbp; mov rbp, rsp; movabs rax, cpu_step; call rax; pop rbp; ret
+// 参数寄存器 rdi / rsi 原样传给 cpu_step；建了帧，perf 按帧指针展开时这一帧就是客户机函数
+static void emit_stub(uint8_t *p) {
+    static const uint8_t head[] = { 0x55, 0x48, 0x89, 0xe5, 0x48, 0xb8 };
+    static const uint8_t tail[] = { 0xff, 0xd0, 0x5d, 0xc3 };
+    uint64_t target = (uintptr_t)cpu_step;
+    memset(p, 0xcc, STUB_SIZE);
+    memcpy(p, head, sizeof(head));
+    memcpy(p + sizeof(head), &target, 8);
+    memcpy(p + sizeof(head) + 8, tail, sizeof(tail));
+}
+
+static void announce(const uint8_t *code, const char *name) {
+    if (pm.map) fprintf(pm.map, "%lx %x %s\n", (uintptr_t)code, STUB_SIZE, name);
+
+    if (pm.jit) {
+        size_t name_len = strlen(name) + 1;
+        JitCodeLoad r = {
+            .p.id = JIT_CODE_LOAD,
+            .p.total_size = sizeof(r) + name_len + STUB_SIZE,
+            .p.timestamp = timestamp_ns(),
+            .pid = getpid(),
+            .tid = syscall(SYS_gettid),
+            .vma = (uintptr_t)code,
+            .code_addr = (uintptr_t)code,
+            .code_size = STUB_SIZE,
+            .code_index = pm.code_index++,
+        };
+        fwrite(&r, sizeof(r), 1, pm.jit);
+        fwrite(name, name_len, 1, pm.jit);
+        fwrite(code, STUB_SIZE, 1, pm.jit);
+    }
+}
+
+static int build_stubs(void) {
+    size_t n = pm.symtab.count + 1;
+    pm.stubs_size = (n * STUB_SIZE + pm.page_size - 1) & ~(size_t)(pm.page_size - 1);
+    pm.stubs = mmap(NULL, pm.stubs_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pm.stubs == MAP_FAILED) {
+        pm.stubs = NULL;
+        fprintf(stderr, "[perfmap] mmap stubs: %s\n", strerror(errno));
+        return -1;
+    }
+    for (size_t i = 0; i < n; i++) emit_stub(pm.stubs + i * STUB_SIZE);
+    if (mprotect(pm.stubs, pm.stubs_size, PROT_READ | PROT_EXEC) < 0) {
+        fprintf(stderr, "[perfmap] mprotect stubs: %s\n", strerror(errno));
+        return -1;
+    }
+
+    char name[256];
+    for (size_t i = 0; i < pm.symtab.count; i++) {
+        snprintf(name, sizeof(name), "guest:%s", pm.symtab.syms[i].name);
+        announce(pm.stubs + i * STUB_SIZE, name);
+    }
+    announce(pm.stubs + pm.symtab.count * STUB_SIZE, "guest:[unknown]");
+    if (pm.map) fflush(pm.map);
+    if (pm.jit) fflush(pm.jit);
+    return 0;
+}
+
+int perfmap_init(const char *spec, const char *elf_path) {
+    bool want_map = false, want_jit = false, bad = false;
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%s", spec);
+    for (char *save, *tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        if (strcmp(tok, "map") == 0)          want_map = true;
+        else if (strcmp(tok, "jitdump") == 0) want_jit = true;
+        else                                  bad = true;
+    }
+    if (bad || (!want_map && !want_jit)) {
+        fprintf(stderr, "[perfmap] bad RVEMU_PERFMAP '%s' (want map, jitdump or map,jitdump)\n", spec);
+        return -1;
+    }
+#if !defined(__x86_64__)
+    fprintf(stderr, "[perfmap] RVEMU_PERFMAP needs an x86-64 host\n");
+    return -1;
+#endif
+
+    pm.page_size = sysconf(_SC_PAGESIZE);
+    if (want_map) {
+        char path[64];
+        snprintf(path, sizeof(path), "/tmp/perf-%d.map", getpid());
+        pm.map = fopen(path, "w");
+        if (!pm.map) {
+            fprintf(stderr, "[perfmap] cannot create %s: %s\n", path, strerror(errno));
+            return -1;
+        }
+    }
+    if (want_jit && open_jitdump() < 0) return -1;
+
+    if (elf_path) elf_load_symbols(elf_path, &pm.symtab);
+    if (build_stubs() < 0) return -1;
+    pm.lo = pm.hi = 0;
+    perfmap_on = true;
+    printf("[perfmap] %zu guest functions, %s%s%s\n", pm.symtab.count, pm.map ? "perf map" : "",
+           pm.map && pm.jit ? " + " : "", pm.jit ? "jitdump" : "");
+    return 0;
+}
+
+// pc 离开上一个函数时重新查符号，定下新的 [lo, hi) 和跳板
+static void lookup(uint64_t pc) {
+    const ElfSym *s = elf_symtab_lookup(&pm.symtab, pc);
+    size_t i = s ? (size_t)(s - pm.symtab.syms) : pm.symtab.count;
+    pm.fn = (StepFn)(uintptr_t)(pm.stubs + i * STUB_SIZE);
+    if (!s) {
+        pm.lo = pc;
+        pm.hi = pc + 1;
+    } else {
+        pm.lo = s->addr;
+        pm.hi = s->size ? s->addr + s->size
+              : i + 1 < pm.symtab.count ? pm.symtab.syms[i + 1].addr : s->addr + 1;
+    }
+}
+
+void perfmap_step(CPU_State *cpu, uint8_t *memory) {
+    if (cpu->pc - pm.lo >= pm.hi - pm.lo) lookup(cpu->pc);
+    pm.fn(cpu, memory);
+}
+
+void perfmap_close(void) {
+    if (pm.map) fclose(pm.map);
+    if (pm.jit) fclose(pm.jit);
+    if (pm.jit_marker) munmap(pm.jit_marker, pm.page_size);
+    // 跳板不释放：close 之后主循环可能还会再执行一条指令
+    elf_symtab_free(&pm.symtab);
+    perfmap_on = false;
+    pm.map = NULL;
+    pm.jit = NULL;
+    pm.jit_marker = NULL;
+}
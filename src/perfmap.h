@@ -0,0 +1,35 @@
+// perfmap.h
+#ifndef PERFMAP_H
+#define PERFMAP_H
+
+#include "common.h"
+#include "cpu.h"
+#include "elf_load.h"
+
+/*
+ * 让主机 perf 看到客户机函数
+ *
+ * 解释器执行的客户机代码在 perf 看来全是 cpu_step / exec_* 等模拟器自身的函数。
+ * RVEMU_PERFMAP 打开后，给内核 ELF 的每个函数符号生成一小段主机跳板代码（只做一次 call cpu_step），
+ * 主循环按当前 pc 所在的函数经对应的跳板执行这条指令。于是 perf record -g 的调用栈里
+ * cpu_step 上面多一帧 "guest:<sym>"，火焰图按客户机函数分开；不在任何符号里的 pc 走 "guest:[unknown]"。
+ * 跳板的名字写到：
+ *   map       /tmp/perf-<pid>.map，perf report / perf script 直接读取
+ *   jitdump   /tmp/jit-<pid>.dump，配合 perf record -k mono 和 perf inject --jit 使用
+ * RVEMU_PERFMAP=map | jitdump | map,jitdump。跳板是 x86-64 机器码，别的主机上报错退出。
+ * perf 要用帧指针展开（--call-graph fp），模拟器最好带 -fno-omit-frame-pointer 编译。
+ */
+
+extern bool perfmap_on;
+
+int perfmap_init(const char *spec, const char *elf_path);
+void perfmap_step(CPU_State *cpu, uint8_t *memory);
+void perfmap_close(void);
+
+// 主循环里代替 cpu_step；关闭时只多一个几乎不跳转的分支
+static inline void perfmap_cpu_step(CPU_State *cpu, uint8_t *memory) {
+    if (__builtin_expect(perfmap_on, 0)) perfmap_step(cpu, memory);
+    else cpu_step(cpu, memory);
+}
+
+#endif
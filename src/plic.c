@@ -2,8 +2,8 @@
 #include "cpu.h"
 #include "memory.h"
 
-extern CPU_State cpu[MAX_CORES];
-extern int log_enable;
+VM_LOCAL PLICState plic;
+extern VM_LOCAL CPU_State cpu[MAX_CORES];
 // 验证 IRQ 号是否有效
 static int plic_is_valid_irq(int irq) {
     return (irq >= 1 && irq < MAX_IRQS);
@@ -148,9 +148,6 @@ void plic_complete(int cpu_id, uint32_t irq) {
 
     cpu[cpu_id].csr[CSR_MIP] &= ~MIP_MEIP;
     
-    if(log_enable){
-        printf("[completed]cpu_id:%d, csr_mip:0x%16lx\n",cpu_id,cpu[cpu_id].csr[CSR_MIP]);
-    }
     // 只更新该 cpu 的中断状态
     plic_update(cpu_id);
 }
@@ -188,16 +185,12 @@ void plic_update(int cpu_id) {
         cpu[cpu_id].csr[CSR_MIP] |= MIP_MEIP;
         plic.current_irq[cpu_id] = max_irq;
         cpu_try_wakeup(&cpu[cpu_id]);
-        printf("[update] cpu_id:%d,csr_mip:0x%16lx\n",cpu_id,cpu[cpu_id].csr[CSR_MIP]);
     }else{
         cpu[cpu_id].csr[CSR_MIP] &= ~MIP_MEIP;
         plic.current_irq[cpu_id] = 0;
     }
     plic.irq_pending[cpu_id] = (max_irq > 0);
 
-    if(log_enable){
-        printf("[update] cpu_id:%d,csr_mip:0x%16lx\n",cpu_id,cpu[cpu_id].csr[CSR_MIP]);
-    }
 }
 
 uint64_t plic_read(void* opaque,uint64_t offset, int size) {
@@ -309,7 +302,7 @@ int plic_select_target_cpu_affinity(int irq) {
     // 比如：轮询、固定分配、基于负载等
     
     // 简单实现：轮询选择
-    static int next_cpu = 0;
+    static VM_LOCAL int next_cpu = 0;
     for (int i = 0; i < 1; i++) {
         int cpu_id = (next_cpu + i) % 1;
         if (plic_is_enabled(irq, cpu_id)) {
@@ -404,6 +397,10 @@ void plic_init_enables() {
     }
 }
 
+PLICState *plic_get_state(void) {
+    return &plic;
+}
+
 void plic_init(void) {
    // PLICState *plic = malloc(sizeof(PLICState));
     memset(&plic, 0, sizeof(PLICState));
@@ -25,7 +25,7 @@ typedef struct {
 
 } PLICState;
 
-static PLICState plic;
+extern VM_LOCAL PLICState plic;      // 定义在 plic.c
 
 
 uint64_t plic_read(void *opaque,uint64_t addr, int size);
@@ -33,4 +33,5 @@ void plic_write(void *opaque,uint64_t addr, uint64_t value, int size);
 void plic_set_irq(int irq, int level) ;
 void plic_init(void);
 void plic_set_irq_to_hart( int irq, int level, int target_hart);
+PLICState *plic_get_state(void);
 #endif
\ No newline at end of file
@@ -0,0 +1,344 @@
+// profiler.c
+#include "profiler.h"
+#include <signal.h>
+#include <sys/time.h>
+
+extern VM_LOCAL uint8_t* memory;
+
+Profiler prof = { .countdown = UINT64_MAX };
+
+static const char *priv_name[4] = { "U", "S", "?", "M" };
+
+/* ---------- guest memory (无副作用) ---------- */
+
+static bool phys_read_u64_raw(uint64_t pa, uint64_t *v) {
+    if (pa < MEMORY_BASE || pa - MEMORY_BASE > MEMORY_SIZE - 8) return false;
+    memcpy(v, &memory[pa - MEMORY_BASE], 8);
+    return true;
+}
+
+// 只读的 sv39 查表：不查 / 不填 TLB、不置 A/D、不产生异常，采样不能改变客户机状态
+static bool prof_translate(CPU_State *cpu, uint64_t va, uint64_t *pa) {
+    uint64_t satp = cpu->csr[CSR_SATP];
+    if (cpu->privilege == 3 || (satp >> 60) != 8) {
+        *pa = va;
+        return true;
+    }
+    uint64_t table = (satp & ((1ULL << 44) - 1)) << 12;
+    for (int i = 2; i >= 0; i--) {
+        uint64_t pte;
+        if (!phys_read_u64_raw(table + ((va >> (12 + 9 * i)) & 0x1ff) * 8, &pte)) return false;
+        if (!(pte & PTE_V)) return false;
+        uint64_t ppn = (pte >> 10) & ((1ULL << 44) - 1);
+        if (pte & (PTE_R | PTE_X)) {
+            uint64_t mask = (1ULL << (12 + 9 * i)) - 1;   // 大页时保留更多低位
+            *pa = ((ppn << 12) & ~mask) | (va & mask);
+            return true;
+        }
+        table = ppn << 12;
+    }
+    return false;
+}
+
+static bool guest_read_u64(CPU_State *cpu, uint64_t va, uint64_t *v) {
+    uint64_t pa;
+    return (va & 7) == 0 && prof_translate(cpu, va, &pa) && phys_read_u64_raw(pa, v);
+}
+
+static bool is_code(uint64_t pc) {
+    return elf_symtab_lookup(&prof.symtab, pc) != NULL;
+}
+
+/*
+ * 沿帧指针回溯：RISC-V 的帧记录在 s0 下方，ra 在 fp-8，上一个 fp 在 fp-16。
+ * 叶子函数不保存 ra，fp-8 里放的就是上一个 fp，这时调用者从 x1 里取。
+ * 只在 pc 能符号化时回溯（用户态程序没有符号，栈上的值无从校验）。
+ */
+static int unwind(CPU_State *cpu, uint64_t *frames) {
+    int depth = 0;
+    frames[depth++] = cpu->pc;
+    if (!is_code(cpu->pc)) return depth;
+
+    uint64_t fp = cpu->gpr[8];
+    while (depth < PROF_MAX_DEPTH) {
+        uint64_t ra, next;
+        if (!guest_read_u64(cpu, fp - 8, &ra)) break;
+        if (!is_code(ra)) {
+            // 叶子帧：fp-8 读到的是上一个 fp，返回地址还在 x1
+            if (depth != 1 || !is_code(cpu->gpr[1])) break;
+            next = ra;
+            ra = cpu->gpr[1];
+        } else if (!guest_read_u64(cpu, fp - 16, &next)) {
+            break;
+        }
+        frames[depth++] = ra;
+        // 栈向下增长，调用者的帧在更高地址；不满足说明帧链已经断了
+        if (next <= fp) break;
+        fp = next;
+    }
+    return depth;
+}
+
+/* ---------- tables ---------- */
+
+static inline uint32_t hash64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return (uint32_t)x;
+}
+
+static void pc_insert(ProfPcEntry *tab, uint32_t buckets, uint64_t pc, uint64_t count) {
+    uint32_t i = hash64(pc) & (buckets - 1);
+    while (tab[i].count && tab[i].pc != pc) i = (i + 1) & (buckets - 1);
+    tab[i].pc = pc;
+    tab[i].count += count;
+}
+
+static void pc_grow(void) {
+    uint32_t nb = prof.pc_buckets * 2;
+    ProfPcEntry *nt = calloc(nb, sizeof(ProfPcEntry));
+    if (!nt) return;
+    for (uint32_t i = 0; i < prof.pc_buckets; i++)
+        if (prof.pcs[i].count) pc_insert(nt, nb, prof.pcs[i].pc, prof.pcs[i].count);
+    free(prof.pcs);
+    prof.pcs = nt;
+    prof.pc_buckets = nb;
+}
+
+static void pc_count(uint64_t pc) {
+    uint32_t i = hash64(pc) & (prof.pc_buckets - 1);
+    while (prof.pcs[i].count && prof.pcs[i].pc != pc) i = (i + 1) & (prof.pc_buckets - 1);
+    if (!prof.pcs[i].count) {
+        prof.pcs[i].pc = pc;
+        prof.pc_used++;
+    }
+    prof.pcs[i].count++;
+    if (prof.pc_used * 2 > prof.pc_buckets) pc_grow();
+}
+
+static void stack_count(const uint64_t *frames, int depth, int priv) {
+    uint32_t h = priv;
+    for (int i = 0; i < depth; i++) h = h * 31 + hash64(frames[i]);
+
+    uint32_t i = h & (PROF_STACK_MAX - 1);
+    for (uint32_t probe = 0; probe < PROF_STACK_MAX; probe++, i = (i + 1) & (PROF_STACK_MAX - 1)) {
+        ProfStack *s = &prof.stacks[i];
+        if (!s->count) {
+            // 留一点空位，避免探测链过长
+            if (prof.stack_used >= PROF_STACK_MAX - PROF_STACK_MAX / 8) break;
+            s->hash = h;
+            s->depth = depth;
+            s->priv = priv;
+            memcpy(s->frames, frames, depth * sizeof(uint64_t));
+            s->count = 1;
+            prof.stack_used++;
+            return;
+        }
+        if (s->hash == h && s->depth == depth && s->priv == priv &&
+            memcmp(s->frames, frames, depth * sizeof(uint64_t)) == 0) {
+            s->count++;
+            return;
+        }
+    }
+    prof.stack_overflow++;
+}
+
+/* ---------- sampling ---------- */
+
+static void prof_sigprof(int sig) {
+    (void)sig;
+    // 让主循环下一条指令就采样；和主循环的递减偶尔冲突丢一个样本没有关系
+    __atomic_store_n(&prof.countdown, 1, __ATOMIC_RELAXED);
+}
+
+void prof_sample(CPU_State *cpu) {
+    prof.countdown = prof.period ? prof.period : UINT64_MAX;
+    if (!prof.enabled) return;
+
+    uint64_t frames[PROF_MAX_DEPTH];
+    int depth = unwind(cpu, frames);
+    int priv = cpu->privilege & 3;
+
+    prof.samples++;
+    prof.samples_by_priv[priv]++;
+    pc_count(cpu->pc);
+    stack_count(frames, depth, priv);
+}
+
+static void prof_arm_timer(void) {
+    struct itimerval it;
+    it.it_interval.tv_sec = prof.timer_us / 1000000;
+    it.it_interval.tv_usec = prof.timer_us % 1000000;
+    it.it_value = it.it_interval;
+    setitimer(ITIMER_PROF, &it, NULL);
+}
+
+/*
+ * spec: "<N>" 每 N 条指令一次；"timer:<hz>" 主机 SIGPROF
+ * elf_path: 用来符号化的客户机 ELF（可以为 NULL，只输出地址）
+ */
+int prof_init(const char *spec, const char *elf_path, const char *out_prefix) {
+    memset(&prof, 0, sizeof(prof));
+    prof.countdown = UINT64_MAX;
+    snprintf(prof.out_prefix, sizeof(prof.out_prefix), "%s", out_prefix ? out_prefix : "rvemu-prof");
+
+    long hz = 0;
+    long long period = 0;
+    if (strncmp(spec, "timer:", 6) == 0) {
+        hz = atol(spec + 6);
+        if (hz <= 0 || hz > 100000) {
+            fprintf(stderr, "[prof] bad sampling rate '%s'\n", spec);
+            return -1;
+        }
+    } else {
+        period = atoll(spec);
+        if (period <= 0) {
+            fprintf(stderr, "[prof] bad sampling period '%s'\n", spec);
+            return -1;
+        }
+    }
+
+    prof.pc_buckets = PROF_PC_BUCKETS;
+    prof.pcs = calloc(prof.pc_buckets, sizeof(ProfPcEntry));
+    prof.stacks = calloc(PROF_STACK_MAX, sizeof(ProfStack));
+    if (!prof.pcs || !prof.stacks) {
+        fprintf(stderr, "[prof] out of memory\n");
+        free(prof.pcs);
+        free(prof.stacks);
+        return -1;
+    }
+    if (elf_path) elf_load_symbols(elf_path, &prof.symtab);
+
+    if (hz) {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = prof_sigprof;
+        sa.sa_flags = SA_RESTART;
+        sigaction(SIGPROF, &sa, NULL);
+        prof.timer_us = 1000000 / hz;
+        prof_arm_timer();
+        prof.period = 0;
+        printf("[prof] sampling on SIGPROF at %ld Hz\n", hz);
+    } else {
+        prof.period = period;
+        prof.countdown = period;
+        printf("[prof] sampling every %lld instructions\n", period);
+    }
+    prof.enabled = true;
+    return 0;
+}
+
+/* ---------- output ---------- */
+
+typedef struct {
+    const char *name;
+    uint64_t addr;
+    uint64_t count;
+} FlatRow;
+
+static int flat_cmp(const void *a, const void *b) {
+    const FlatRow *x = a, *y = b;
+    return x->count < y->count ? 1 : x->count > y->count ? -1 : 0;
+}
+
+// 一帧的名字：有符号用函数名，否则用地址
+static const char *frame_name(uint64_t pc, char *buf, size_t len) {
+    const ElfSym *s = elf_symtab_lookup(&prof.symtab, pc);
+    if (s) return s->name;
+    snprintf(buf, len, "0x%lx", pc);
+    return buf;
+}
+
+static void dump_flat(FILE *out) {
+    // 每个符号一行，没有符号的 pc 各自一行
+    size_t nrows = prof.symtab.count + prof.pc_used;
+    FlatRow *rows = calloc(nrows ? nrows : 1, sizeof(FlatRow));
+    if (!rows) return;
+    for (size_t i = 0; i < prof.symtab.count; i++) {
+        rows[i].name = prof.symtab.syms[i].name;
+        rows[i].addr = prof.symtab.syms[i].addr;
+    }
+    size_t n = prof.symtab.count;
+    for (uint32_t i = 0; i < prof.pc_buckets; i++) {
+        ProfPcEntry *e = &prof.pcs[i];
+        if (!e->count) continue;
+        const ElfSym *s = elf_symtab_lookup(&prof.symtab, e->pc);
+        if (s) {
+            rows[s - prof.symtab.syms].count += e->count;
+        } else {
+            rows[n].name = NULL;
+            rows[n].addr = e->pc;
+            rows[n].count = e->count;
+            n++;
+        }
+    }
+    qsort(rows, n, sizeof(FlatRow), flat_cmp);
+
+    fprintf(out, "# %lu samples (M %lu, S %lu, U %lu)\n", prof.samples,
+            prof.samples_by_priv[3], prof.samples_by_priv[1], prof.samples_by_priv[0]);
+    fprintf(out, "# %8s %7s %7s  %-18s %s\n", "samples", "self%", "cum%", "address", "symbol");
+    uint64_t cum = 0;
+    for (size_t i = 0; i < n && rows[i].count; i++) {
+        cum += rows[i].count;
+        fprintf(out, "  %8lu %6.2f%% %6.2f%%  0x%016lx %s\n", rows[i].count,
+                100.0 * rows[i].count / prof.samples, 100.0 * cum / prof.samples,
+                rows[i].addr, rows[i].name ? rows[i].name : "?");
+    }
+    free(rows);
+}
+
+static void dump_folded(FILE *out) {
+    char buf[32];
+    for (uint32_t i = 0; i < PROF_STACK_MAX; i++) {
+        ProfStack *s = &prof.stacks[i];
+        if (!s->count) continue;
+        // 根在前：特权级作为最外层一帧，方便在火焰图里区分 M/S/U
+        fprintf(out, "[%s]", priv_name[s->priv]);
+        for (int d = s->depth - 1; d >= 0; d--)
+            fprintf(out, ";%s", frame_name(s->frames[d], buf, sizeof(buf)));
+        fprintf(out, " %lu\n", s->count);
+    }
+    if (prof.stack_overflow)
+        fprintf(out, "[stack-table-full] %lu\n", prof.stack_overflow);
+}
+
+// fork 出的克隆：样本从分叉点开始累计在父进程的计数上，输出写到 <prefix>.clone-<id>.*
+void prof_set_clone(int id) {
+    if (!prof.enabled) return;
+    size_t n = strlen(prof.out_prefix);
+    snprintf(prof.out_prefix + n, sizeof(prof.out_prefix) - n, ".clone-%d", id);
+    if (!prof.period) prof_arm_timer();
+}
+
+void prof_dump(void) {
+    if (!prof.enabled) return;
+    prof.enabled = false;
+    if (!prof.period) {
+        struct itimerval it;
+        memset(&it, 0, sizeof(it));
+        setitimer(ITIMER_PROF, &it, NULL);
+    }
+
+    char path[300];
+    snprintf(path, sizeof(path), "%s.flat", prof.out_prefix);
+    FILE *f = fopen(path, "w");
+    if (f) {
+        dump_flat(f);
+        fclose(f);
+    }
+    snprintf(path, sizeof(path), "%s.folded", prof.out_prefix);
+    f = fopen(path, "w");
+    if (f) {
+        dump_folded(f);
+        fclose(f);
+    }
+    fprintf(stderr, "[prof] %lu samples, %u distinct pcs, %u stacks -> %s.{flat,folded}\n",
+            prof.samples, prof.pc_used, prof.stack_used, prof.out_prefix);
+
+    free(prof.pcs);
+    free(prof.stacks);
+    prof.pcs = NULL;
+    prof.stacks = NULL;
+    elf_symtab_free(&prof.symtab);
+}
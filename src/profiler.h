@@ -0,0 +1,74 @@
+// profiler.h
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "common.h"
+#include "cpu.h"
+#include "elf_load.h"
+
+/*
+ * 客户机 PC 采样 profiler
+ *
+ * 两种触发方式（RVEMU_PROF）：
+ *   <N>          每执行 N 条指令采样一次（确定性，和主机负载无关）
+ *   timer:<hz>   主机 SIGPROF 定时器，每秒 hz 次（按主机 CPU 时间分布）
+ *
+ * 每个样本记录 pc 和沿 s0 帧指针回溯的调用栈（客户机用 -fno-omit-frame-pointer 编译时有效，
+ * 否则只有叶子一层）。退出时用客户机 ELF 的 .symtab 符号化，写出
+ *   <prefix>.flat     按函数汇总的平铺 profile
+ *   <prefix>.folded   折叠栈，可直接交给 flamegraph.pl
+ */
+
+#define PROF_MAX_DEPTH   32         // 回溯的最大栈深
+#define PROF_PC_BUCKETS  (1u << 16) // pc 直方图初始桶数（2 的幂，满一半时翻倍）
+#define PROF_STACK_MAX   (1u << 16) // 不同调用栈的上限，超过后只计入 flat
+
+typedef struct {
+    uint64_t pc;
+    uint64_t count;
+} ProfPcEntry;
+
+typedef struct {
+    uint32_t hash;
+    uint8_t depth;
+    uint8_t priv;
+    uint64_t count;
+    uint64_t frames[PROF_MAX_DEPTH];   // frames[0] 是叶子
+} ProfStack;
+
+typedef struct {
+    // 主循环每条指令递减一次，减到 0 时采样；关闭时为 UINT64_MAX，相当于永不触发
+    uint64_t countdown;
+    uint64_t period;        // 指令计数模式的采样间隔，定时器模式为 0
+    long timer_us;          // 定时器模式的间隔，fork 出的子进程要重新设置（定时器不继承）
+    bool enabled;
+
+    ProfPcEntry *pcs;
+    uint32_t pc_buckets;
+    uint32_t pc_used;
+
+    ProfStack *stacks;      // 开放寻址，PROF_STACK_MAX 个槽
+    uint32_t stack_used;
+
+    uint64_t samples;
+    uint64_t samples_by_priv[4];
+    uint64_t stack_overflow;    // 栈表满了没记录调用栈的样本
+
+    ElfSymtab symtab;
+    char out_prefix[256];
+} Profiler;
+
+extern Profiler prof;
+
+int prof_init(const char *spec, const char *elf_path, const char *out_prefix);
+void prof_sample(CPU_State *cpu);
+void prof_dump(void);
+void prof_set_clone(int id);
+
+// 主循环每执行一条指令调用一次；关闭时只是一次递减加一个几乎不跳转的分支
+static inline void prof_tick(CPU_State *cpu) {
+    if (__builtin_expect(--prof.countdown == 0, 0))
+        prof_sample(cpu);
+}
+
+#endif
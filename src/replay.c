@@ -0,0 +1,178 @@
+// replay.c
+// 不确定输入的录制与回放，格式见 replay.h
+#include "replay.h"
+#include "virtio_net.h"
+
+#define RR_MAX_EVENT 65536
+
+extern VM_LOCAL CPU_State cpu[MAX_CORES];
+
+int rr_mode;
+uint64_t rr_next_insn = UINT64_MAX;
+UARTDevice *rr_uart;
+
+static FILE *rr_file;
+static const char *rr_path;
+static RREvent next;                // 回放：已经读出来的下一个事件
+static uint8_t *next_data;
+static uint64_t nevents;
+static bool diverged;
+
+static void log_event(uint64_t insn, uint32_t type, const void *data, uint32_t len) {
+    RREvent e = { .insn = insn, .type = type, .len = len };
+    fwrite(&e, sizeof(e), 1, rr_file);
+    if (len) fwrite(data, len, 1, rr_file);
+    nevents++;
+}
+
+// virtio-net 在 CPU 线程里投递帧时回调，这时 hart 0 停在两条指令之间
+static void record_net(const uint8_t *data, uint32_t len) {
+    log_event(cpu[0].inst_count, RR_EV_NET_RX, data, len);
+}
+
+// 录制时没有正常退出的日志没有 END：读到头之后不再注入，客户机自由运行
+static void read_next(void) {
+    if (fread(&next, sizeof(next), 1, rr_file) == 1 && next.len <= RR_MAX_EVENT &&
+        (!next.len || fread(next_data, next.len, 1, rr_file) == 1)) {
+        rr_next_insn = next.insn;
+        return;
+    }
+    fprintf(stderr, "[replay] %s: truncated after %lu events, running on without input\n", rr_path, nevents);
+    rr_next_insn = UINT64_MAX;
+}
+
+int rr_init(const char *record_path, const char *replay_path, UARTDevice *uart) {
+    if (!record_path && !replay_path) return 0;
+    if (record_path && replay_path) {
+        fprintf(stderr, "[replay] RVEMU_RECORD and RVEMU_REPLAY are exclusive\n");
+        return -1;
+    }
+    if (getenv("RVEMU_FORK") || getenv("RVEMU_FUZZ")) {
+        fprintf(stderr, "[replay] cannot record or replay together with RVEMU_FORK / RVEMU_FUZZ\n");
+        return -1;
+    }
+    rr_path = record_path ? record_path : replay_path;
+    rr_file = fopen(rr_path, record_path ? "wb" : "rb");
+    if (!rr_file) {
+        fprintf(stderr, "[replay] cannot open %s: %s\n", rr_path, strerror(errno));
+        return -1;
+    }
+    setvbuf(rr_file, NULL, _IOFBF, 1 << 20);
+
+    RRFileHeader h;
+    if (record_path) {
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, RR_MAGIC, sizeof(h.magic));
+        h.start_insn = cpu[0].inst_count;
+        fwrite(&h, sizeof(h), 1, rr_file);
+        netdev.rx_record = record_net;
+        rr_mode = RR_RECORD;
+    } else {
+        if (fread(&h, sizeof(h), 1, rr_file) != 1 || memcmp(h.magic, RR_MAGIC, sizeof(h.magic)) != 0) {
+            fprintf(stderr, "[replay] %s: not a recording\n", rr_path);
+            return -1;
+        }
+        if (h.start_insn != cpu[0].inst_count) {
+            fprintf(stderr, "[replay] %s: recorded from instruction %lu, machine is at %lu\n",
+                    rr_path, h.start_insn, cpu[0].inst_count);
+            return -1;
+        }
+        next_data = malloc(RR_MAX_EVENT);
+        netdev.rx_replay = true;
+        rr_mode = RR_REPLAY;
+        read_next();
+    }
+    rr_uart = uart;
+    if (uart) uart_set_deterministic(uart);
+    printf("[replay] %s %s\n", record_path ? "recording to" : "replaying", rr_path);
+    return 0;
+}
+
+static void record_tick(CPU_State *c, uint32_t flags) {
+    uint8_t buf[UART_RX_BUF_SIZE];
+    uint32_t n = uart_rx_take(rr_uart, buf, sizeof(buf));
+    if (!n) return;
+    log_event(c->inst_count, RR_EV_UART_RX | flags, buf, n);
+    uart_rx_inject(rr_uart, buf, n);
+}
+
+static void diverge(CPU_State *c, const char *what) {
+    if (diverged) return;
+    diverged = true;
+    fprintf(stderr, "[replay] diverged at %lu instructions: %s (event for %lu)\n", c->inst_count, what, next.insn);
+}
+
+// 同一条指令处、同一个注入点的事件一起注入，网络帧整批只发一次中断
+static void replay_tick(CPU_State *c, bool halted) {
+    uint8_t drop[UART_RX_BUF_SIZE];
+    if (rr_uart) while (uart_rx_take(rr_uart, drop, sizeof(drop))) ;   // 回放时主机输入不进客户机
+
+    bool net = false, end = false;
+    while (!end && c->inst_count >= rr_next_insn) {
+        bool at_halt = next.type & RR_EV_HALTED;
+        if (next.type != RR_EV_END && at_halt != halted && next.insn == c->inst_count) break;
+        if (next.insn != c->inst_count) diverge(c, "missed the instruction");
+        switch (next.type & ~RR_EV_HALTED) {
+            case RR_EV_END:
+                end = true;
+                break;
+            case RR_EV_UART_RX:
+                if (rr_uart) uart_rx_inject(rr_uart, next_data, next.len);
+                break;
+            case RR_EV_NET_RX:
+                if (virtio_net_rx_inject(next_data, next.len)) net = true;
+                else diverge(c, "no rx buffer for a recorded frame");
+                break;
+            default:
+                diverge(c, "unknown event");
+                break;
+        }
+        nevents++;
+        if (!end) read_next();
+    }
+    if (net) virtio_net_rx_publish();
+    if (end) {
+        printf("[replay] end of recording at %lu instructions\n", c->inst_count);
+        rr_next_insn = UINT64_MAX;
+        c->running = false;
+    }
+}
+
+void rr_tick(CPU_State *c) {
+    if (rr_mode == RR_RECORD) record_tick(c, 0);
+    else replay_tick(c, false);
+}
+
+// hart 停在 WFI 里：录制时等 RX 线程送来输入再投递，投递引起的中断会清掉 halted；
+// 回放时指令数不会再走，这条指令处的事件注入完还叫不醒就说明录制到这里就结束了
+void rr_halted(CPU_State *c) {
+    if (rr_mode == RR_REPLAY) {
+        if (c->inst_count >= rr_next_insn) replay_tick(c, true);
+        if (c->halted && c->running) {
+            diverge(c, "hart halted with no recorded input to wake it");
+            c->running = false;
+        }
+        return;
+    }
+    while (rr_uart) {
+        pthread_mutex_lock(&c->lock);
+        while (c->halted && c->running && !uart_rx_staged(rr_uart))
+            pthread_cond_wait(&c->cond, &c->lock);
+        pthread_mutex_unlock(&c->lock);
+        if (!c->halted || !c->running) return;
+        record_tick(c, RR_EV_HALTED);
+    }
+}
+
+void rr_close(CPU_State *c) {
+    if (rr_mode == RR_OFF) return;
+    if (rr_mode == RR_RECORD) {
+        log_event(c->inst_count, RR_EV_END, NULL, 0);
+        printf("[replay] recorded %lu events over %lu instructions to %s\n",
+               nevents - 1, c->inst_count, rr_path);
+    } else {
+        printf("[replay] replayed %lu events%s\n", nevents, diverged ? " (diverged)" : "");
+    }
+    if (fclose(rr_file) != 0) fprintf(stderr, "[replay] write %s failed\n", rr_path);
+    rr_mode = RR_OFF;
+}
@@ -0,0 +1,74 @@
+// replay.h
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "common.h"
+#include "cpu.h"
+#include "uart.h"
+
+/*
+ * 确定性录制 / 回放
+ *
+ * 模拟器里客户机能看到的不确定输入只有主机线程送进来的数据：UART 的 RX、virtio-net 收到的帧，
+ * 以及 TX 环满时主机写出的快慢（THRE）。CLINT 的 mtime、CSR time 和磁盘完成时间都按周期数推进，本来就是确定的，不用记。
+ *
+ * 录制：UART 进入确定性模式，RX 线程读到的字节先暂存，由 CPU 线程在主循环里投递并记下当时 hart 0 的指令数；
+ * virtio-net 每投递一帧记一次。退出时写 END 记下最后的指令数。
+ * 回放：不投递主机来的输入，到了记录的指令数就把同样的字节 / 帧注入进去，到 END 停止。
+ * 回放不依赖主机时序，可以在 profiler / trace 下反复跑同一次执行。
+ *
+ * hart 在 WFI 里停着时指令数不走：录制时 RX 线程叫醒 CPU 线程，在 rr_halted 里投递并打上 RR_EV_HALTED，
+ * 回放时同样在 rr_halted 里注入，投递引起的中断照常把 hart 唤醒。
+ * 回放要用同样的启动方式（同一个 ELF / 快照、同样的 RVEMU_NET 设备）；
+ * 网络后端收到的帧在回放时丢弃，客户机发出的帧照常发出去。
+ *
+ * 文件：RRFileHeader，之后是若干 { RREvent, len 字节数据 }，以 RR_EV_END 结束。
+ *
+ *   RVEMU_RECORD=<file>   录制
+ *   RVEMU_REPLAY=<file>   回放
+ */
+
+#define RR_MAGIC    "RVRR0001"
+
+enum { RR_OFF, RR_RECORD, RR_REPLAY };
+
+enum {
+    RR_EV_END = 0,
+    RR_EV_UART_RX,          // 投递到 UART RX 环的字节
+    RR_EV_NET_RX,           // 投递给 virtio-net 的一帧
+};
+
+#define RR_EV_HALTED 0x100u     // 在 rr_halted 里（hart 停着）投递的，回放时也要在那里注入
+
+typedef struct {
+    char     magic[8];
+    uint64_t start_insn;    // 开始录制时 hart 0 的指令数（从快照启动时不是 0）
+} RRFileHeader;
+
+typedef struct {
+    uint64_t insn;          // hart 0 的指令数
+    uint32_t type;
+    uint32_t len;
+} RREvent;
+
+extern int rr_mode;
+extern uint64_t rr_next_insn;       // 回放：下一个事件的指令数
+extern UARTDevice *rr_uart;
+
+int rr_init(const char *record_path, const char *replay_path, UARTDevice *uart);
+void rr_tick(CPU_State *cpu);
+void rr_halted(CPU_State *cpu);
+void rr_close(CPU_State *cpu);
+
+// 主循环每步调用（virtio_net_update 之后）
+static inline void rr_poll(CPU_State *cpu) {
+    if (__builtin_expect(rr_mode == RR_OFF, 1)) return;
+    if (cpu->inst_count >= rr_next_insn || (rr_uart && uart_rx_staged(rr_uart))) rr_tick(cpu);
+}
+
+// 主循环在等 hart 被唤醒之前调用，见 rr_halted
+static inline void rr_halt_poll(CPU_State *cpu) {
+    if (__builtin_expect(rr_mode != RR_OFF, 0) && cpu->halted) rr_halted(cpu);
+}
+
+#endif
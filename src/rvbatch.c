@@ -0,0 +1,406 @@
+// rvbatch.c
+// 批量跑客户机：rvbatch [-j workers] [-s slots] [-q quantum] [-b budget] [-o results.jsonl] [-v] manifest.jsonl
+//
+// manifest 每行一个任务，平铺的 JSON 对象：
+//   {"id": "boot-1", "kernel": "kernel", "disk": "fs.img", "overlay": "boot-1.cow",
+//    "input": "in.bin", "serial": "file:boot-1.log", "budget": 500000000}
+// 只有 kernel 是必需的。input 在客户机写 VMCTL MARKER 时写进它给的缓冲区（和 RVEMU_FUZZ 一样），
+// serial 是 UART 后端（默认 null），budget 是指令上限（默认 -b）。几个任务共用一个 disk 时各自给 overlay。
+//
+// 设计：一个进程里 -j 个 worker 线程（默认主机核数），libriscv-emu 的 Machine 各有各的状态，
+// 不同线程上的机器同时跑（见 emulator_api.h）。任务先按顺序均分给各 worker，每个 worker 有自己的任务区间 [lo, hi)，
+// 由各自的互斥锁保护；自己的做完了去剩得最多的 worker 那里偷后一半（work stealing），
+// 平时每个线程只碰自己的锁，没有全局的任务队列。
+// 每个 worker 同时挂着最多 -s 台机器，每台跑 -q 条指令就换下一台，长任务不会堵住后面的短任务；
+// 同一线程里换机器要拷一次 CPU / 设备状态，-q 不要太小。
+// 结果每个任务一行 JSONL，secs 是从建机器到结束的墙钟时间（含轮到别的机器时的等待）。
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "emulator_api.h"
+
+#define MAX_WORKERS 256
+#define MAX_SLOTS   64
+
+typedef struct {
+    char *id, *kernel, *disk, *overlay, *input, *serial;
+    uint64_t budget;
+} Job;
+
+// worker 各自的任务区间 [lo, hi)，别的 worker 偷任务时也会改，读写都要加锁
+typedef struct {
+    pthread_mutex_t lock;
+    int lo, hi;
+} Range;
+
+static Job *jobs;
+static int njobs;
+static Range ranges[MAX_WORKERS];
+static uint64_t total_insns;        // 所有任务执行的指令数
+static pthread_mutex_t out_lock = PTHREAD_MUTEX_INITIALIZER;
+static int nworkers = 1, nslots = 4;
+static uint64_t quantum = 1000000, default_budget = 1000000000;
+static int out_fd = 1;
+static bool verbose;
+
+/* ---------- manifest ---------- */
+
+// 平铺对象里取一个字段：字符串返回 malloc 的拷贝，数字以字符串形式返回；没有返回 NULL
+static char *json_field(const char *line, const char *key) {
+    char pat[64];
+    snprintf(pat, sizeof(pat), "\"%s\"", key);
+    const char *p = strstr(line, pat);
+    if (!p) return NULL;
+    p += strlen(pat);
+    while (*p == ' ' || *p == '\t') p++;
+    if (*p++ != ':') return NULL;
+    while (*p == ' ' || *p == '\t') p++;
+
+    char *out = malloc(strlen(p) + 1), *o = out;
+    if (*p == '"') {
+        for (p++; *p && *p != '"'; p++) {
+            if (*p == '\\' && p[1]) p++;
+            *o++ = *p;
+        }
+    } else {
+        while (*p && *p != ',' && *p != '}' && *p != ' ' && *p != '\n') *o++ = *p++;
+    }
+    *o = 0;
+    return out;
+}
+
+static int load_manifest(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    char *line = NULL;
+    size_t cap = 0;
+    int lineno = 0, cap_jobs = 0;
+    while (getline(&line, &cap, f) > 0) {
+        lineno++;
+        if (!strchr(line, '{')) continue;   // 空行
+        if (njobs == cap_jobs) {
+            cap_jobs = cap_jobs ? cap_jobs * 2 : 64;
+            jobs = realloc(jobs, cap_jobs * sizeof(Job));
+        }
+        Job *j = &jobs[njobs];
+        memset(j, 0, sizeof(*j));
+        j->kernel = json_field(line, "kernel");
+        if (!j->kernel) {
+            fprintf(stderr, "%s:%d: no kernel\n", path, lineno);
+            return -1;
+        }
+        j->id = json_field(line, "id");
+        if (!j->id) {
+            j->id = malloc(16);
+            snprintf(j->id, 16, "%d", lineno);
+        }
+        j->disk = json_field(line, "disk");
+        j->overlay = json_field(line, "overlay");
+        j->input = json_field(line, "input");
+        j->serial = json_field(line, "serial");
+        char *b = json_field(line, "budget");
+        j->budget = b ? strtoull(b, NULL, 0) : default_budget;
+        free(b);
+        njobs++;
+    }
+    free(line);
+    fclose(f);
+    return 0;
+}
+
+/* ---------- 结果 ---------- */
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// id 里的引号和反斜杠转义，其余原样
+static void put_str(char **p, const char *s) {
+    *(*p)++ = '"';
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') *(*p)++ = '\\';
+        *(*p)++ = *s;
+    }
+    *(*p)++ = '"';
+}
+
+// 一行一次 write，加锁：各 worker 的行不会交错
+static void emit_result(const Job *j, const char *status, int exit_code, uint64_t insns,
+                        uint64_t slices, double secs, int worker) {
+    char buf[4096 + 2 * 256];
+    char *p = buf;
+    p += sprintf(p, "{\"id\": ");
+    char id[256];
+    snprintf(id, sizeof(id), "%s", j->id);
+    put_str(&p, id);
+    p += sprintf(p, ", \"status\": \"%s\", \"exit_code\": %d, \"insns\": %lu, \"slices\": %lu, "
+                    "\"secs\": %.3f, \"worker\": %d}\n",
+                 status, exit_code, insns, slices, secs, worker);
+    pthread_mutex_lock(&out_lock);
+    if (write(out_fd, buf, p - buf) < 0) perror("[rvbatch] write results");
+    pthread_mutex_unlock(&out_lock);
+}
+
+/* ---------- 任务分配 ---------- */
+
+static int take_own(int w) {
+    Range *r = &ranges[w];
+    int i = -1;
+    pthread_mutex_lock(&r->lock);
+    if (r->lo < r->hi) i = r->lo++;
+    pthread_mutex_unlock(&r->lock);
+    return i;
+}
+
+static int range_left(Range *r) {
+    pthread_mutex_lock(&r->lock);
+    int left = r->hi - r->lo;
+    pthread_mutex_unlock(&r->lock);
+    return left;
+}
+
+// 找剩得最多的 worker，拿走它后一半（至少一个）
+static bool steal(int w) {
+    for (;;) {
+        int victim = -1, most = 0;
+        for (int v = 0; v < nworkers; v++) {
+            if (v == w) continue;
+            int left = range_left(&ranges[v]);   // 只是挑人，下面拿的时候再确认
+            if (left > most) {
+                most = left;
+                victim = v;
+            }
+        }
+        if (victim < 0) return false;
+
+        Range *r = &ranges[victim];
+        int lo = 0, hi = 0;
+        pthread_mutex_lock(&r->lock);
+        if (r->lo < r->hi) {
+            hi = r->hi;
+            lo = r->hi - (r->hi - r->lo + 1) / 2;
+            r->hi = lo;
+        }
+        pthread_mutex_unlock(&r->lock);
+        if (lo == hi) continue;   // 被别人抢先了，重新找
+
+        Range *own = &ranges[w];
+        pthread_mutex_lock(&own->lock);
+        own->lo = lo;
+        own->hi = hi;
+        pthread_mutex_unlock(&own->lock);
+        return true;
+    }
+}
+
+static int next_job(int w) {
+    int i;
+    while ((i = take_own(w)) < 0)
+        if (!steal(w)) return -1;
+    return i;
+}
+
+/* ---------- worker ---------- */
+
+typedef struct {
+    int job;                // -1 = 空
+    Machine *m;
+    uint8_t *input;
+    size_t input_len;
+    uint64_t slices;
+    double t0;
+} Slot;
+
+static uint8_t *read_file(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    struct stat st;
+    if (fstat(fileno(f), &st) < 0) {
+        fclose(f);
+        return NULL;
+    }
+    uint8_t *data = malloc(st.st_size ? st.st_size : 1);
+    if (data && fread(data, 1, st.st_size, f) != (size_t)st.st_size) {
+        free(data);
+        data = NULL;
+    }
+    if (data) *len = st.st_size;
+    fclose(f);
+    return data;
+}
+
+static void finish(Slot *s, const char *status, int w) {
+    const Job *j = &jobs[s->job];
+    uint64_t insns = s->m ? machine_inst_count(s->m) : 0;
+    int code = s->m ? machine_exit_code(s->m) : 0;
+    emit_result(j, status, code, insns, s->slices, now_sec() - s->t0, w);
+    __atomic_fetch_add(&total_insns, insns, __ATOMIC_RELAXED);
+    machine_destroy(s->m);
+    free(s->input);
+    memset(s, 0, sizeof(*s));
+    s->job = -1;
+}
+
+// 建机器、加载内核和磁盘；失败直接记结果
+static bool start(Slot *s, int i, int w) {
+    const Job *j = &jobs[i];
+    memset(s, 0, sizeof(*s));
+    s->job = i;
+    s->t0 = now_sec();
+
+    MachineConfig cfg = { .serial = j->serial };
+    s->m = machine_create(&cfg);
+    if (!s->m || machine_load_elf(s->m, j->kernel) < 0 ||
+        (j->disk && machine_load_disk(s->m, j->disk, j->overlay) < 0)) {
+        fprintf(stderr, "[rvbatch] %s: cannot set up machine\n", j->id);
+        finish(s, "error", w);
+        return false;
+    }
+    if (j->input && !(s->input = read_file(j->input, &s->input_len))) {
+        fprintf(stderr, "[rvbatch] %s: cannot read input %s\n", j->id, j->input);
+        finish(s, "error", w);
+        return false;
+    }
+    return true;
+}
+
+static void *worker(void *arg) {
+    int w = (int)(intptr_t)arg;
+    Slot slots[MAX_SLOTS];
+    for (int k = 0; k < nslots; k++) slots[k].job = -1;
+    bool more = true;
+    int active = 0;
+
+    while (more || active) {
+        for (int k = 0; k < nslots && more; k++) {
+            if (slots[k].job >= 0) continue;
+            int i = next_job(w);
+            if (i < 0) more = false;
+            else if (start(&slots[k], i, w)) active++;
+        }
+
+        // 轮流给每台机器一个时间片
+        for (int k = 0; k < nslots; k++) {
+            Slot *s = &slots[k];
+            if (s->job < 0) continue;
+            const Job *j = &jobs[s->job];
+            uint64_t done = machine_inst_count(s->m);
+            uint64_t left = j->budget > done ? j->budget - done : 0;
+            int r = left ? machine_run(s->m, left < quantum ? left : quantum) : MACHINE_LIMIT;
+            s->slices++;
+
+            const char *status = NULL;
+            if (r == MACHINE_MARKER) {
+                if (s->input && machine_set_input(s->m, s->input, s->input_len) < 0) {
+                    fprintf(stderr, "[rvbatch] %s: marker buffer is not in RAM\n", j->id);
+                    status = "error";
+                }
+            } else if (r == MACHINE_EXITED) {
+                status = "exit";
+            } else if (r == MACHINE_HALTED) {
+                status = "halt";
+            } else if (r == MACHINE_ERROR) {
+                status = "error";
+            } else if (machine_inst_count(s->m) >= j->budget) {
+                status = "budget";
+            }
+            if (status) {
+                finish(s, status, w);
+                active--;
+            }
+        }
+    }
+    return NULL;
+}
+
+/* ---------- main ---------- */
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [-j workers] [-s slots] [-q quantum] [-b budget] [-o results.jsonl] [-v] manifest.jsonl\n",
+            argv0);
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    const char *out_path = NULL;
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    nworkers = ncpu > 0 ? ncpu : 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "j:s:q:b:o:v")) != -1) {
+        switch (opt) {
+            case 'j': nworkers = atoi(optarg); break;
+            case 's': nslots = atoi(optarg); break;
+            case 'q': quantum = strtoull(optarg, NULL, 0); break;
+            case 'b': default_budget = strtoull(optarg, NULL, 0); break;
+            case 'o': out_path = optarg; break;
+            case 'v': verbose = true; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1 || nworkers <= 0 || nslots <= 0 || nslots > MAX_SLOTS || !quantum) usage(argv[0]);
+    if (load_manifest(argv[optind]) < 0) return 1;
+    if (nworkers > njobs) nworkers = njobs;
+    if (nworkers > MAX_WORKERS) nworkers = MAX_WORKERS;
+    if (!njobs) return 0;
+
+    if (out_path) {
+        out_fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+        if (out_fd < 0) {
+            perror(out_path);
+            return 1;
+        }
+    } else {
+        out_fd = dup(1);
+    }
+
+    for (int w = 0; w < nworkers; w++) {
+        pthread_mutex_init(&ranges[w].lock, NULL);
+        ranges[w].lo = (int)((int64_t)njobs * w / nworkers);
+        ranges[w].hi = (int)((int64_t)njobs * (w + 1) / nworkers);
+    }
+
+    fprintf(stderr, "[rvbatch] %d jobs, %d workers x %d slots, quantum %lu\n", njobs, nworkers, nslots, quantum);
+    fflush(NULL);
+    // 加载 ELF、打开磁盘时的打印不进结果（结果写的是上面 dup 出来的 out_fd）
+    int null = open("/dev/null", O_WRONLY);
+    if (!verbose && null >= 0) dup2(null, 1);
+
+    double t0 = now_sec();
+    pthread_t tids[MAX_WORKERS];
+    bool alive[MAX_WORKERS] = { false };
+    int started = 0;
+    for (int w = 0; w < nworkers; w++) {
+        int err = pthread_create(&tids[w], NULL, worker, (void *)(intptr_t)w);
+        if (err) {
+            // 没起来的 worker 的任务区间留着，别的 worker 会偷走
+            fprintf(stderr, "[rvbatch] cannot start worker %d: %s\n", w, strerror(err));
+            continue;
+        }
+        alive[w] = true;
+        started++;
+    }
+    if (!started) return 1;
+    for (int w = 0; w < nworkers; w++)
+        if (alive[w]) pthread_join(tids[w], NULL);
+    fflush(stdout);
+
+    double dt = now_sec() - t0;
+    fprintf(stderr, "[rvbatch] %d jobs in %.2fs, %lu instructions (%.1f MIPS)\n",
+            njobs, dt, total_insns, dt > 0 ? total_insns / dt / 1e6 : 0.0);
+    return 0;
+}
@@ -0,0 +1,112 @@
+// rvtrace.c
+// 解码 RVEMU_TRACE 写出的二进制轨迹：rvtrace [-n N] [-h hart] trace.bin
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+static const char *opcode_names[128] = {
+    [0x03] = "load", [0x07] = "load-fp", [0x0f] = "fence", [0x13] = "op-imm",
+    [0x17] = "auipc", [0x1b] = "op-imm-32", [0x23] = "store", [0x27] = "store-fp",
+    [0x2f] = "amo", [0x33] = "op", [0x37] = "lui", [0x3b] = "op-32",
+    [0x53] = "op-fp", [0x63] = "branch", [0x67] = "jalr", [0x6f] = "jal", [0x73] = "system",
+};
+
+static const char *reg_names[32] = {
+    "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2",
+    "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+    "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7",
+    "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6"
+};
+
+static const char priv_names[4] = { 'U', 'S', '?', 'M' };
+
+static void print_rec(uint64_t seq, const TraceRec *e) {
+    bool rvc = (e->insn & 0x3) != 0x3;
+    const char *cls = rvc ? (const char *[]){ "c0", "c1", "c2" }[e->insn & 0x3]
+                          : opcode_names[e->insn & 0x7f];
+
+    printf("%12lu %c %016lx  ", seq, priv_names[e->priv & 3], e->pc);
+    if (rvc) printf("    %04x", e->insn);
+    else     printf("%08x", e->insn);
+    printf("  %-9s", cls ? cls : "?");
+
+    if (e->flags & TRACE_F_EXC)
+        printf("  exception %u", e->cause);
+    else if (e->rd)
+        printf("  %-4s= %016lx", reg_names[e->rd & 31], e->rd_val);
+    else if (e->flags & (TRACE_F_LOAD | TRACE_F_STORE))
+        printf("  %-4s  %16s", "", "");
+
+    if (e->flags & (TRACE_F_LOAD | TRACE_F_STORE)) {
+        const char *dir = (e->flags & TRACE_F_LOAD) && (e->flags & TRACE_F_STORE) ? "rw"
+                        : (e->flags & TRACE_F_LOAD) ? "r" : "w";
+        printf("  [%s %016lx]", dir, e->mem_addr);
+    }
+    printf("\n");
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [-n last-N] [-h hart] trace.bin\n", argv0);
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    uint64_t last = 0;
+    int only_hart = -1;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:h:")) != -1) {
+        switch (opt) {
+            case 'n': last = strtoull(optarg, NULL, 0); break;
+            case 'h': only_hart = atoi(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1) usage(argv[0]);
+
+    FILE *f = fopen(argv[optind], "rb");
+    if (!f) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    TraceFileHeader fh;
+    if (fread(&fh, sizeof(fh), 1, f) != 1 || memcmp(fh.magic, TRACE_MAGIC, sizeof(fh.magic)) != 0) {
+        fprintf(stderr, "%s: not a trace file\n", argv[optind]);
+        return 1;
+    }
+    if (fh.rec_size != sizeof(TraceRec)) {
+        fprintf(stderr, "%s: record size %u, expected %zu\n", argv[optind], fh.rec_size, sizeof(TraceRec));
+        return 1;
+    }
+
+    for (uint32_t h = 0; h < fh.nharts; h++) {
+        TraceHartHeader hh;
+        if (fread(&hh, sizeof(hh), 1, f) != 1) {
+            fprintf(stderr, "%s: truncated at hart %u\n", argv[optind], h);
+            return 1;
+        }
+        bool show = only_hart < 0 || (uint32_t)only_hart == hh.hart;
+        uint64_t skip = last && last < hh.count ? hh.count - last : 0;
+        if (show)
+            printf("# hart %u: %lu instructions traced, %lu kept, showing %lu\n",
+                   hh.hart, hh.total, hh.count, hh.count - skip);
+
+        // 第一条记录的全局序号
+        uint64_t seq = hh.total - hh.count;
+        for (uint64_t i = 0; i < hh.count; i++, seq++) {
+            TraceRec e;
+            if (fread(&e, sizeof(e), 1, f) != 1) {
+                fprintf(stderr, "%s: truncated in hart %u\n", argv[optind], hh.hart);
+                return 1;
+            }
+            if (show && i >= skip) print_rec(seq, &e);
+        }
+    }
+    fclose(f);
+    return 0;
+}
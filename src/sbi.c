@@ -0,0 +1,183 @@
+// sbi.c
+// 内置 SBI，见 sbi.h
+#include "sbi.h"
+#include "clint.h"
+#include "mmu.h"
+#include "vmfork.h"
+#include "memory.h"
+
+extern VM_LOCAL uint8_t *memory;
+
+bool sbi_builtin = false;
+static UARTDevice *sbi_uart;
+
+void sbi_init(UARTDevice *uart) {
+    sbi_builtin = true;
+    sbi_uart = uart;
+}
+
+void sbi_boot(CPU_State *cpu, uint64_t entry, uint64_t dtb) {
+    cpu->privilege = 1;
+    cpu->pc = entry;
+    cpu->gpr[10] = (uint64_t)cpu->hartid;
+    cpu->gpr[11] = dtb;
+    cpu->csr[CSR_SATP] = 0;
+    // 软件 / 定时器 / 外部中断和所有异常都交给 S 模式
+    cpu->csr[CSR_MIDELEG] = (1 << 1) | (1 << 5) | (1 << 9);
+    cpu->csr[CSR_MEDELEG] = 0xb1ff;
+    // S 模式可以读 cycle / time / instret；打开 Sstc，定时器比较走 CSR_STIMECMP
+    cpu->csr[CSR_MCOUNTERN] = 0x7;
+    cpu->csr[CSR_MENVCFG] |= 1ULL << 63;
+    cpu->csr[CSR_STIMECMP] = UINT64_MAX;
+    clint_update_interrupts(&cpu->clint);
+}
+
+static void set_timer(CPU_State *cpu, uint64_t when) {
+    cpu->csr[CSR_STIMECMP] = when;
+    clint_update_interrupts(&cpu->clint);
+}
+
+// hart_mask / hart_mask_base 里有没有 hart 0；有别的 hart 返回 false
+static bool ipi_targets(uint64_t mask, uint64_t base, bool *self) {
+    *self = base == UINT64_MAX || (base == 0 && (mask & 1));
+    return base == UINT64_MAX || (base == 0 ? mask <= 1 : mask == 0);
+}
+
+static bool ram_range(uint64_t pa, uint64_t len) {
+    return pa >= MEMORY_BASE && len <= ram_size && pa - MEMORY_BASE <= ram_size - len;
+}
+
+static int64_t base_call(uint64_t fid, uint64_t arg, uint64_t *value) {
+    switch (fid) {
+    case 0: *value = SBI_SPEC_VERSION; break;
+    case 1: *value = SBI_IMPL_ID; break;
+    case 2: *value = 1; break;
+    case 3:
+        *value = arg == SBI_EXT_BASE || arg == SBI_EXT_TIME || arg == SBI_EXT_IPI ||
+                 arg == SBI_EXT_RFENCE || arg == SBI_EXT_HSM || arg == SBI_EXT_SRST ||
+                 arg == SBI_EXT_DBCN || arg <= SBI_LEGACY_MAX;
+        break;
+    case 4: case 5: case 6: *value = 0; break;      // mvendorid / marchid / mimpid
+    default: return SBI_ERR_NOT_SUPPORTED;
+    }
+    return SBI_SUCCESS;
+}
+
+static int64_t dbcn_call(uint64_t fid, uint64_t *a, uint64_t *value) {
+    uint64_t len = a[0], pa = a[1];
+    if (fid == 2) {
+        uart_putc(sbi_uart, a[0] & 0xff);
+        return SBI_SUCCESS;
+    }
+    if (fid > 1) return SBI_ERR_NOT_SUPPORTED;
+    if (a[2] || !ram_range(pa, len)) return SBI_ERR_INVALID_PARAM;
+    uint8_t *p = memory + (pa - MEMORY_BASE);
+    uint64_t n = 0;
+    if (fid == 0) {
+        while (n < len && uart_putc(sbi_uart, p[n])) n++;
+    } else {
+        int c;
+        while (n < len && (c = uart_getc(sbi_uart)) >= 0) p[n++] = c;
+        ram_mark_dirty(pa - MEMORY_BASE, n);
+    }
+    *value = n;
+    return SBI_SUCCESS;
+}
+
+// 旧版调用（v0.1）：只返回 a0
+static int64_t legacy_call(CPU_State *cpu, uint64_t eid, uint64_t *a) {
+    switch (eid) {
+    case 0x00: set_timer(cpu, a[0]); return 0;
+    case 0x01: uart_putc(sbi_uart, a[0] & 0xff); return 0;
+    case 0x02: return uart_getc(sbi_uart);
+    case 0x03: cpu->csr[CSR_MIP] &= ~MIP_MSIP; return 0;
+    case 0x04: cpu->csr[CSR_MIP] |= MIP_MSIP; return 0;    // hart_mask 是客户机虚拟地址，只有 hart 0，不用读
+    case 0x05: return 0;
+    case 0x06: case 0x07: tlb_flush(cpu); return 0;
+    case 0x08:
+        vmctl_exit_code = 0;
+        cpu->running = false;
+        return 0;
+    }
+    return SBI_ERR_NOT_SUPPORTED;
+}
+
+void sbi_ecall(CPU_State *cpu) {
+    uint64_t eid = cpu->gpr[17], fid = cpu->gpr[16];
+    uint64_t *a = &cpu->gpr[10];
+    uint64_t value = 0;
+    int64_t err = SBI_ERR_NOT_SUPPORTED;
+    bool self;
+
+    if (eid <= SBI_LEGACY_MAX) {
+        a[0] = legacy_call(cpu, eid, a);
+        return;
+    }
+
+    switch (eid) {
+    case SBI_EXT_BASE:
+        err = base_call(fid, a[0], &value);
+        break;
+    case SBI_EXT_TIME:
+        if (fid == 0) {
+            set_timer(cpu, a[0]);
+            err = SBI_SUCCESS;
+        }
+        break;
+    case SBI_EXT_IPI:
+        if (fid != 0) break;
+        if (!ipi_targets(a[0], a[1], &self)) {
+            err = SBI_ERR_INVALID_PARAM;
+            break;
+        }
+        if (self) cpu->csr[CSR_MIP] |= MIP_MSIP;
+        err = SBI_SUCCESS;
+        break;
+    case SBI_EXT_RFENCE:
+        if (fid > 2) break;     // hfence 没有 H 扩展
+        if (!ipi_targets(a[0], a[1], &self)) {
+            err = SBI_ERR_INVALID_PARAM;
+            break;
+        }
+        if (self && fid != 0) tlb_flush(cpu);   // remote_fence_i：没有指令缓存
+        err = SBI_SUCCESS;
+        break;
+    case SBI_EXT_HSM:
+        if (fid == 0) err = a[0] == (uint64_t)cpu->hartid ? SBI_ERR_ALREADY_AVAILABLE : SBI_ERR_INVALID_PARAM;
+        else if (fid == 1) err = SBI_ERR_DENIED;        // 唯一的 hart 停下就再也没人能叫醒它
+        else if (fid == 2) {
+            err = a[0] == (uint64_t)cpu->hartid ? SBI_SUCCESS : SBI_ERR_INVALID_PARAM;
+            value = SBI_HSM_STARTED;
+        }
+        break;
+    case SBI_EXT_SRST:
+        if (fid != 0) break;
+        if (a[0] > 2) {
+            err = SBI_ERR_INVALID_PARAM;
+            break;
+        }
+        printf("[sbi] system reset type %lu reason %lu\n", a[0], a[1]);
+        vmctl_exit_code = a[1] != 0;
+        cpu->running = false;
+        err = SBI_SUCCESS;
+        break;
+    case SBI_EXT_DBCN:
+        err = dbcn_call(fid, a, &value);
+        break;
+    }
+    a[0] = err;
+    if (err == SBI_SUCCESS) a[1] = value;
+}
+
+void sbi_idle(CPU_State *cpu) {
+    uint64_t cmp = cpu->csr[CSR_STIMECMP];
+    if (!(cpu->csr[CSR_SIE] & SIE_STIE) || cmp == UINT64_MAX) return;
+    if (cpu->clint.mtime < cmp) {
+        cpu->clint.mtime = cmp;
+        cpu->clint.tick_left = clint_tick_period;
+    }
+    clint_update_interrupts(&cpu->clint);
+    pthread_mutex_lock(&cpu->lock);
+    cpu->halted = false;
+    pthread_mutex_unlock(&cpu->lock);
+}
@@ -0,0 +1,62 @@
+// sbi.h
+#ifndef SBI_H
+#define SBI_H
+
+#include "common.h"
+#include "cpu.h"
+#include "uart.h"
+
+/*
+ * 内置 SBI：直接启动 Linux Image，不在模拟器里跑 OpenSBI（sbi=builtin，见 config.h）
+ *
+ * hart 0 从 S 模式进入内核（a0 = hartid，a1 = DTB），S 模式的 ecall 不进客户机的陷阱，
+ * 由 sbi_ecall 在主机上处理，返回 a0 = 错误码，a1 = 值：
+ *
+ *   BASE   规范版本 2.0、实现 ID、probe_extension、mvendorid / marchid / mimpid
+ *   TIME   set_timer：写 stimecmp，比较沿用 CLINT 里 Sstc 的路径
+ *   IPI    send_ipi：只有 hart 0，置软件中断
+ *   RFNC   remote_fence_i / remote_sfence_vma(_asid)：冲 TLB
+ *   HSM    hart_start / hart_stop / hart_get_status：hart 0 一直是 STARTED
+ *   SRST   system_reset：结束模拟，reason 非 0 时退出码为 1
+ *   DBCN   console_write / read / write_byte，字节直接进出 UART 的环
+ *   legacy 0x00..0x08（set_timer、console_putchar / getchar、clear_ipi、send_ipi、remote_fence*、shutdown）
+ *
+ * hart 停在 WFI 里而 S 定时器已经设好时，sbi_idle 把 mtime 直接拨到 stimecmp，不空转也不睡。
+ * 从快照恢复时要用同样的 sbi= 配置。
+ */
+
+#define SBI_EXT_BASE    0x10
+#define SBI_EXT_TIME    0x54494D45
+#define SBI_EXT_IPI     0x735049
+#define SBI_EXT_RFENCE  0x52464E43
+#define SBI_EXT_HSM     0x48534D
+#define SBI_EXT_SRST    0x53525354
+#define SBI_EXT_DBCN    0x4442434E
+#define SBI_LEGACY_MAX  0x08
+
+#define SBI_SUCCESS                 0
+#define SBI_ERR_FAILED              -1
+#define SBI_ERR_NOT_SUPPORTED       -2
+#define SBI_ERR_INVALID_PARAM       -3
+#define SBI_ERR_DENIED              -4
+#define SBI_ERR_INVALID_ADDRESS     -5
+#define SBI_ERR_ALREADY_AVAILABLE   -6
+
+#define SBI_SPEC_VERSION    (2u << 24)      // v2.0
+#define SBI_IMPL_ID         0x7276          // "rv"，不在 SBI 规范登记的实现 ID 里
+#define SBI_HSM_STARTED     0
+
+extern bool sbi_builtin;
+
+void sbi_init(UARTDevice *uart);
+// 按 SBI 的启动约定让 hart 从 S 模式进入 entry
+void sbi_boot(CPU_State *cpu, uint64_t entry, uint64_t dtb);
+void sbi_ecall(CPU_State *cpu);
+void sbi_idle(CPU_State *cpu);
+
+// 主循环在等 hart 被唤醒之前调用
+static inline void sbi_halt_poll(CPU_State *cpu) {
+    if (__builtin_expect(sbi_builtin, 0) && cpu->halted) sbi_idle(cpu);
+}
+
+#endif
@@ -0,0 +1,660 @@
+// snapshot.c
+// 整机快照的保存与恢复，格式见 snapshot.h
+#include "snapshot.h"
+#include "plic.h"
+#include "virtio_blk.h"
+#include "virtio_net.h"
+#include "virtio_console.h"
+#include "disk_image.h"
+#include "block_cache.h"
+#include "memory.h"
+#include <time.h>
+
+extern VM_LOCAL uint8_t *memory;
+extern VM_LOCAL CPU_State cpu[MAX_CORES];
+extern VM_LOCAL virtio_blk_device dev;
+extern VM_LOCAL struct disk_op_list pending_ops;
+
+// UART 里属于客户机可见状态的部分（环形缓冲、线程、后端不算）
+typedef struct {
+    uint8_t rbr, thr, ier, fcr, iir, lcr, mcr, lsr, msr, scr, dll, dlm;
+    uint8_t fifo_enable, dma_mode, rx_trigger_level;
+    uint8_t tx_in_progress;
+    uint32_t baud_rate;
+    uint32_t ctrl;
+    uint32_t irq_status;
+    int32_t irq_pending;
+    uint64_t bit_time_ps;
+    uint64_t tx_next_bit_time;
+} SnapUart;
+
+// virtio-net / virtio-console 共有的 mmio 状态，两者结构体开头字段一致
+typedef struct {
+    int32_t status;
+    uint32_t interrupt_status;
+    uint32_t device_features_sel;
+    uint32_t driver_features_sel;
+    uint64_t driver_features;
+    uint32_t queue_sel;
+    virtio_queue vq[2];
+} SnapVirtio;
+
+typedef struct {
+    uint16_t head_desc_idx;
+    uint16_t pad;
+    int32_t completed;
+    uint32_t type;
+    uint32_t pad2;
+    uint64_t start_time;
+    uint64_t completion_time;
+    uint64_t sector;
+    uint64_t data_phys_addr;
+} SnapDiskOp;
+
+#define VIRTIO_SNAP(d) ((SnapVirtio){                                   \
+    .status = (d).status, .interrupt_status = (d).interrupt_status,     \
+    .device_features_sel = (d).device_features_sel,                    \
+    .driver_features_sel = (d).driver_features_sel,                    \
+    .driver_features = (d).driver_features, .queue_sel = (d).queue_sel, \
+    .vq = { (d).vq[0], (d).vq[1] } })
+
+#define VIRTIO_UNSNAP(d, s) do {                                        \
+    (d).status = (s).status; (d).interrupt_status = (s).interrupt_status; \
+    (d).device_features_sel = (s).device_features_sel;                  \
+    (d).driver_features_sel = (s).driver_features_sel;                  \
+    (d).driver_features = (s).driver_features;                          \
+    (d).queue_sel = (s).queue_sel;                                      \
+    (d).vq[0] = (s).vq[0]; (d).vq[1] = (s).vq[1];                       \
+} while (0)
+
+uint64_t snapshot_next_check;       // 0 = 没有按指令数 / 定时的保存
+static const char *save_path;
+static UARTDevice *save_uart;
+static bool save_at_exit;
+static uint64_t save_at;            // RVEMU_SNAPSHOT_AT
+static uint64_t every_ns;           // RVEMU_SNAPSHOT_EVERY
+static uint64_t last_ckpt_ns;
+static unsigned ckpt_seq;
+static char *last_snap;             // 最近一次保存 / 恢复的快照，下一个增量检查点的 parent
+
+/* ---------- 保存 ---------- */
+
+static SnapUart snap_uart(const UARTDevice *uart) {
+    return (SnapUart){
+        .rbr = uart->rbr, .thr = uart->thr, .ier = uart->ier, .fcr = uart->fcr,
+        .iir = uart->iir, .lcr = uart->lcr, .mcr = uart->mcr, .lsr = uart->lsr,
+        .msr = uart->msr, .scr = uart->scr, .dll = uart->dll, .dlm = uart->dlm,
+        .fifo_enable = uart->fifo_enable, .dma_mode = uart->dma_mode,
+        .rx_trigger_level = uart->rx_trigger_level,
+        .tx_in_progress = uart->tx_in_progress,
+        .baud_rate = uart->baud_rate, .ctrl = uart->ctrl,
+        .irq_status = uart->irq_status, .irq_pending = uart->irq_pending,
+        .bit_time_ps = uart->bit_time_ps, .tx_next_bit_time = uart->tx_next_bit_time,
+    };
+}
+
+// 还没完成的磁盘请求，按链表顺序
+static SnapDiskOp *snap_vblk_ops(uint64_t *n) {
+    *n = 0;
+    for (struct disk_operation *op = LIST_FIRST(&pending_ops); op; op = LIST_NEXT(op, entriess)) (*n)++;
+    SnapDiskOp *ops = calloc(*n + 1, sizeof(SnapDiskOp));
+    uint64_t i = 0;
+    for (struct disk_operation *op = LIST_FIRST(&pending_ops); op; op = LIST_NEXT(op, entriess), i++) {
+        ops[i] = (SnapDiskOp){
+            .head_desc_idx = op->head_desc_idx, .completed = op->completed, .type = op->type,
+            .start_time = op->start_time, .completion_time = op->completion_time,
+            .sector = op->sector, .data_phys_addr = op->data_phys_addr,
+        };
+    }
+    return ops;
+}
+
+static long sec_begin(FILE *f, uint32_t id) {
+    SnapSection s = { .id = id };
+    long off = ftell(f);
+    fwrite(&s, sizeof(s), 1, f);
+    return off;
+}
+
+// 回填段长度
+static void sec_end(FILE *f, long off, uint32_t id) {
+    long end = ftell(f);
+    SnapSection s = { .id = id, .len = end - off - sizeof(SnapSection) };
+    fseek(f, off, SEEK_SET);
+    fwrite(&s, sizeof(s), 1, f);
+    fseek(f, end, SEEK_SET);
+}
+
+static void sec_write(FILE *f, uint32_t id, const void *data, uint64_t len) {
+    SnapSection s = { .id = id, .len = len };
+    fwrite(&s, sizeof(s), 1, f);
+    if (len) fwrite(data, len, 1, f);   // SNAP_SEC_END、空的 VBLK_OPS 没有数据，data 可能是 NULL
+}
+
+static bool page_is_zero(const uint8_t *p) {
+    const uint64_t *w = (const uint64_t *)p;
+    for (int i = 0; i < SNAP_PAGE / 8; i += 8) {
+        if (w[i] | w[i + 1] | w[i + 2] | w[i + 3] | w[i + 4] | w[i + 5] | w[i + 6] | w[i + 7])
+            return false;
+    }
+    return true;
+}
+
+static void write_page(FILE *f, uint64_t pg) {
+    fwrite(&pg, sizeof(pg), 1, f);
+    fwrite(memory + pg * SNAP_PAGE, SNAP_PAGE, 1, f);
+}
+
+// 完整：所有非零页；增量：脏页位图里的页，不管是不是零。两种都把位图清零
+static uint64_t save_ram(FILE *f, bool incremental) {
+    uint64_t n = 0;
+    long off = sec_begin(f, SNAP_SEC_RAM);
+    if (incremental) {
+        for (uint64_t w = 0; w < RAM_DIRTY_PAGES / 64; w++) {
+            for (uint64_t bits = ram_dirty[w]; bits; bits &= bits - 1, n++)
+                write_page(f, w * 64 + __builtin_ctzll(bits));
+            ram_dirty[w] = 0;
+        }
+    } else {
+        for (uint64_t pg = 0; pg < MEMORY_SIZE / SNAP_PAGE; pg++) {
+            if (page_is_zero(memory + pg * SNAP_PAGE)) continue;
+            write_page(f, pg);
+            n++;
+        }
+        if (ram_dirty) memset(ram_dirty, 0, RAM_DIRTY_PAGES / 8);
+    }
+    sec_end(f, off, SNAP_SEC_RAM);
+    return n;
+}
+
+static void write_block(FILE *f, uint64_t blk) {
+    uint8_t buf[DISK_COW_BLOCK_SIZE];
+    uint64_t pos = blk * DISK_COW_BLOCK_SIZE;
+    uint64_t len = dev.disk->size - pos < DISK_COW_BLOCK_SIZE ? dev.disk->size - pos : DISK_COW_BLOCK_SIZE;
+    memset(buf, 0, sizeof(buf));
+    disk_image_read(dev.disk, pos, buf, len);
+    fwrite(&blk, sizeof(blk), 1, f);
+    fwrite(buf, sizeof(buf), 1, f);
+}
+
+// 完整：和 base 不同的块；增量：脏块位图里的块
+static uint64_t save_disk(FILE *f, bool incremental) {
+    if (!dev.disk) return 0;
+    // 写回缓存里的脏块，之后 DiskImage 就是完整的磁盘内容
+    if (dev.cache) block_cache_flush(dev.cache);
+
+    uint64_t nblocks = (dev.disk->size + DISK_COW_BLOCK_SIZE - 1) / DISK_COW_BLOCK_SIZE;
+    uint64_t n = 0;
+    long off = sec_begin(f, SNAP_SEC_DISK);
+    for (uint64_t w = 0; w < (nblocks + 63) / 64; w++) {
+        uint64_t bits = disk_image_dirty_take(dev.disk, w);
+        if (!incremental) continue;
+        for (; bits; bits &= bits - 1, n++)
+            write_block(f, w * 64 + __builtin_ctzll(bits));
+    }
+    for (uint64_t blk = 0; !incremental && blk < nblocks; blk++) {
+        if (!disk_image_block_dirty(dev.disk, blk)) continue;
+        write_block(f, blk);
+        n++;
+    }
+    sec_end(f, off, SNAP_SEC_DISK);
+    return n;
+}
+
+// parent 非空时写增量检查点
+static int save_file(const char *path, const char *parent, UARTDevice *uart) {
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "[snapshot] cannot create %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    setvbuf(f, NULL, _IOFBF, 1 << 20);
+
+    SnapFileHeader h = {
+        .version = SNAP_VERSION,
+        .nharts = MAX_CORES,
+        .mem_base = MEMORY_BASE,
+        .mem_size = MEMORY_SIZE,
+        .disk_size = dev.disk ? dev.disk->size : 0,
+        .cpu_state_size = sizeof(CPU_State),
+        .plic_state_size = sizeof(PLICState),
+        .vblk_size = sizeof(virtio_blk_device),
+        .flags = parent ? SNAP_F_INCREMENTAL : 0,
+    };
+    memcpy(h.magic, SNAP_MAGIC, sizeof(h.magic));
+    fwrite(&h, sizeof(h), 1, f);
+    if (parent) sec_write(f, SNAP_SEC_PARENT, parent, strlen(parent));
+
+    for (int i = 0; i < MAX_CORES; i++)
+        sec_write(f, SNAP_SEC_CPU, &cpu[i], sizeof(CPU_State));
+    sec_write(f, SNAP_SEC_PLIC, plic_get_state(), sizeof(PLICState));
+
+    if (uart) {
+        SnapUart u = snap_uart(uart);
+        sec_write(f, SNAP_SEC_UART, &u, sizeof(u));
+    }
+
+    sec_write(f, SNAP_SEC_VBLK, &dev, sizeof(dev));
+    uint64_t nops;
+    SnapDiskOp *ops = snap_vblk_ops(&nops);
+    sec_write(f, SNAP_SEC_VBLK_OPS, ops, nops * sizeof(SnapDiskOp));
+    free(ops);
+
+    SnapVirtio v = VIRTIO_SNAP(netdev);
+    sec_write(f, SNAP_SEC_VNET, &v, sizeof(v));
+    v = VIRTIO_SNAP(condev);
+    sec_write(f, SNAP_SEC_VCON, &v, sizeof(v));
+
+    uint64_t pages = save_ram(f, parent != NULL);
+    uint64_t blocks = save_disk(f, parent != NULL);
+    sec_write(f, SNAP_SEC_END, NULL, 0);
+
+    // 位图已经清了，下一个增量只能接在这份后面；写失败就退回完整快照
+    free(last_snap);
+    last_snap = NULL;
+    int err = ferror(f);
+    if (fclose(f) != 0 || err) {
+        fprintf(stderr, "[snapshot] write %s failed\n", path);
+        return -1;
+    }
+    last_snap = strdup(path);
+    printf("[snapshot] saved %s%s: pc=0x%lx, %lu pages, %lu disk blocks\n",
+           path, parent ? " (incremental)" : "", cpu[0].pc, pages, blocks);
+    return 0;
+}
+
+int snapshot_save(const char *path, UARTDevice *uart) {
+    return save_file(path, NULL, uart);
+}
+
+// 有 parent（上一次保存或恢复的快照）且打开了脏页跟踪时写增量，否则写完整快照
+int snapshot_checkpoint(const char *path, UARTDevice *uart) {
+    bool incremental = last_snap && ram_dirty && (!dev.disk || dev.disk->dirty);
+    char *parent = incremental ? strdup(last_snap) : NULL;
+    int rc = save_file(path, parent, uart);
+    free(parent);
+    return rc;
+}
+
+/* ---------- 恢复 ---------- */
+
+static int read_exact(FILE *f, void *buf, uint64_t len) {
+    return fread(buf, 1, len, f) == len ? 0 : -1;
+}
+
+// 整体覆盖 CPU_State，只保留本进程里的指针、锁和回调
+static void restore_cpu(CPU_State *c, const CPU_State *s) {
+    CPU_State live = *c;
+    *c = *s;
+    c->lock = live.lock;
+    c->cond = live.cond;
+    c->mem = live.mem;
+    c->bus = live.bus;
+    memcpy(c->uart_table, live.uart_table, sizeof(c->uart_table));
+    c->clint.timer_interrupt_callback = live.clint.timer_interrupt_callback;
+    c->clint.software_interrupt_callback = live.clint.software_interrupt_callback;
+}
+
+static void restore_uart(UARTDevice *uart, const SnapUart *u) {
+    uart->rbr = u->rbr; uart->thr = u->thr; uart->ier = u->ier; uart->fcr = u->fcr;
+    uart->iir = u->iir; uart->lcr = u->lcr; uart->mcr = u->mcr; uart->lsr = u->lsr;
+    uart->msr = u->msr; uart->scr = u->scr; uart->dll = u->dll; uart->dlm = u->dlm;
+    uart->fifo_enable = u->fifo_enable;
+    uart->dma_mode = u->dma_mode;
+    uart->rx_trigger_level = u->rx_trigger_level;
+    uart->tx_in_progress = u->tx_in_progress;
+    uart->baud_rate = u->baud_rate;
+    uart->ctrl = u->ctrl;
+    uart->irq_status = u->irq_status;
+    uart->irq_pending = u->irq_pending;
+    uart->bit_time_ps = u->bit_time_ps;
+    uart->tx_next_bit_time = u->tx_next_bit_time;
+}
+
+static void restore_vblk(const virtio_blk_device *s) {
+    DiskImage *disk = dev.disk;
+    BlockCache *cache = dev.cache;
+    uint64_t sectors = dev.disk_size_sectors;
+    dev = *s;
+    dev.disk = disk;
+    dev.cache = cache;
+    dev.disk_size_sectors = sectors;
+}
+
+// 清掉当前的待处理请求，换成 ops；链表是头插的，倒着插回去保持原顺序
+static void restore_vblk_ops(const SnapDiskOp *ops, uint64_t n) {
+    while (!LIST_EMPTY(&pending_ops)) {
+        struct disk_operation *op = LIST_FIRST(&pending_ops);
+        LIST_REMOVE(op, entriess);
+        free(op);
+    }
+    for (uint64_t i = n; i-- > 0;) {
+        struct disk_operation *op = calloc(1, sizeof(*op));
+        op->head_desc_idx = ops[i].head_desc_idx;
+        op->completed = ops[i].completed;
+        op->type = ops[i].type;
+        op->start_time = ops[i].start_time;
+        op->completion_time = ops[i].completion_time;
+        op->sector = ops[i].sector;
+        op->data_phys_addr = ops[i].data_phys_addr;
+        LIST_INSERT_HEAD(&pending_ops, op, entriess);
+    }
+}
+
+static int load_vblk_ops(FILE *f, uint64_t len) {
+    uint64_t n = len / sizeof(SnapDiskOp);
+    SnapDiskOp *ops = malloc(n * sizeof(SnapDiskOp) + 1);
+    if (!ops || read_exact(f, ops, n * sizeof(SnapDiskOp)) < 0) {
+        free(ops);
+        return -1;
+    }
+    restore_vblk_ops(ops, n);
+    free(ops);
+    return 0;
+}
+
+static int restore_ram(FILE *f, uint64_t len, uint64_t *pages) {
+    for (; len >= sizeof(uint64_t) + SNAP_PAGE; len -= sizeof(uint64_t) + SNAP_PAGE) {
+        uint64_t pg;
+        if (read_exact(f, &pg, sizeof(pg)) < 0 || pg >= MEMORY_SIZE / SNAP_PAGE) return -1;
+        if (read_exact(f, memory + pg * SNAP_PAGE, SNAP_PAGE) < 0) return -1;
+        (*pages)++;
+    }
+    return len ? -1 : 0;
+}
+
+// 经由块缓存写回，缓存里不会留下恢复前的旧内容
+static int restore_disk(FILE *f, uint64_t len, uint64_t *blocks) {
+    uint8_t buf[DISK_COW_BLOCK_SIZE];
+    for (; len >= sizeof(uint64_t) + sizeof(buf); len -= sizeof(uint64_t) + sizeof(buf)) {
+        uint64_t blk;
+        if (read_exact(f, &blk, sizeof(blk)) < 0 || read_exact(f, buf, sizeof(buf)) < 0) return -1;
+        if (!dev.disk) continue;
+        uint64_t pos = blk * DISK_COW_BLOCK_SIZE;
+        if (pos >= dev.disk->size) return -1;
+        uint64_t n = dev.disk->size - pos < sizeof(buf) ? dev.disk->size - pos : sizeof(buf);
+        if (block_cache_write(dev.cache, pos, buf, n) < 0) return -1;
+        (*blocks)++;
+    }
+    return len ? -1 : 0;
+}
+
+static int load_file(const char *path, UARTDevice *uart, int depth) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "[snapshot] cannot open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    setvbuf(f, NULL, _IOFBF, 1 << 20);
+
+    SnapFileHeader h;
+    if (read_exact(f, &h, sizeof(h)) < 0 || memcmp(h.magic, SNAP_MAGIC, sizeof(h.magic)) != 0 ||
+        h.version != SNAP_VERSION) {
+        fprintf(stderr, "[snapshot] %s: not a snapshot file\n", path);
+        fclose(f);
+        return -1;
+    }
+    if (h.nharts != MAX_CORES || h.mem_base != MEMORY_BASE || h.mem_size != MEMORY_SIZE ||
+        h.cpu_state_size != sizeof(CPU_State) || h.plic_state_size != sizeof(PLICState) ||
+        h.vblk_size != sizeof(virtio_blk_device)) {
+        fprintf(stderr, "[snapshot] %s: made by a different emulator build\n", path);
+        fclose(f);
+        return -1;
+    }
+    if (dev.disk && h.disk_size != dev.disk->size) {
+        fprintf(stderr, "[snapshot] %s: disk is %lu bytes, snapshot expects %lu\n",
+                path, dev.disk->size, h.disk_size);
+        fclose(f);
+        return -1;
+    }
+
+    int hart = 0, rc = 0;
+    uint64_t pages = 0, blocks = 0;
+
+    // 增量检查点：先把 parent 链恢复好
+    if (h.flags & SNAP_F_INCREMENTAL) {
+        SnapSection s;
+        char parent[4096];
+        if (read_exact(f, &s, sizeof(s)) < 0 || s.id != SNAP_SEC_PARENT || s.len >= sizeof(parent) ||
+            read_exact(f, parent, s.len) < 0) {
+            fprintf(stderr, "[snapshot] %s: incremental snapshot without parent\n", path);
+            fclose(f);
+            return -1;
+        }
+        parent[s.len] = 0;
+        if (depth >= 4096 || load_file(parent, uart, depth + 1) < 0) {
+            fprintf(stderr, "[snapshot] %s: cannot restore parent %s\n", path, parent);
+            fclose(f);
+            return -1;
+        }
+    }
+
+    for (;;) {
+        SnapSection s;
+        if (read_exact(f, &s, sizeof(s)) < 0) { rc = -1; break; }
+        if (s.id == SNAP_SEC_END) break;
+
+        switch (s.id) {
+            case SNAP_SEC_CPU: {
+                CPU_State *tmp = malloc(sizeof(CPU_State));
+                if (s.len != sizeof(CPU_State) || hart >= MAX_CORES || read_exact(f, tmp, s.len) < 0) rc = -1;
+                else restore_cpu(&cpu[hart++], tmp);
+                free(tmp);
+                break;
+            }
+            case SNAP_SEC_PLIC:
+                if (s.len != sizeof(PLICState) || read_exact(f, plic_get_state(), s.len) < 0) rc = -1;
+                break;
+            case SNAP_SEC_UART: {
+                SnapUart u;
+                if (s.len != sizeof(u) || read_exact(f, &u, s.len) < 0) rc = -1;
+                else if (uart) restore_uart(uart, &u);
+                break;
+            }
+            case SNAP_SEC_VBLK: {
+                virtio_blk_device d;
+                if (s.len != sizeof(d) || read_exact(f, &d, s.len) < 0) rc = -1;
+                else restore_vblk(&d);
+                break;
+            }
+            case SNAP_SEC_VBLK_OPS:
+                if (s.len % sizeof(SnapDiskOp) || load_vblk_ops(f, s.len) < 0) rc = -1;
+                break;
+            case SNAP_SEC_VNET:
+            case SNAP_SEC_VCON: {
+                SnapVirtio v;
+                if (s.len != sizeof(v) || read_exact(f, &v, s.len) < 0) rc = -1;
+                else if (s.id == SNAP_SEC_VNET) VIRTIO_UNSNAP(netdev, v);
+                else VIRTIO_UNSNAP(condev, v);
+                break;
+            }
+            case SNAP_SEC_RAM:
+                rc = restore_ram(f, s.len, &pages);
+                break;
+            case SNAP_SEC_DISK:
+                rc = restore_disk(f, s.len, &blocks);
+                break;
+            default:
+                // 新版本加的段，跳过
+                if (fseek(f, s.len, SEEK_CUR) != 0) rc = -1;
+                break;
+        }
+        if (rc < 0) break;
+    }
+    fclose(f);
+
+    if (rc < 0) {
+        fprintf(stderr, "[snapshot] %s: truncated or corrupt\n", path);
+        return -1;
+    }
+    printf("[snapshot] restored %s%s: pc=0x%lx, %lu pages, %lu disk blocks\n",
+           path, h.flags & SNAP_F_INCREMENTAL ? " (incremental)" : "", cpu[0].pc, pages, blocks);
+    return 0;
+}
+
+int snapshot_load(const char *path, UARTDevice *uart) {
+    if (load_file(path, uart, 0) < 0) return -1;
+
+    // 恢复出来的状态就是下一个增量检查点的基准：恢复磁盘时经块缓存写的块先落下去，再清位图
+    if (dev.cache) block_cache_flush(dev.cache);
+    if (dev.disk) {
+        uint64_t nblocks = (dev.disk->size + DISK_COW_BLOCK_SIZE - 1) / DISK_COW_BLOCK_SIZE;
+        for (uint64_t w = 0; w < (nblocks + 63) / 64; w++) disk_image_dirty_take(dev.disk, w);
+    }
+    if (ram_dirty) memset(ram_dirty, 0, RAM_DIRTY_PAGES / 8);
+    free(last_snap);
+    last_snap = strdup(path);
+    return 0;
+}
+
+/* ---------- 内存里的快照 ---------- */
+
+struct MemSnapshot {
+    CPU_State cpu[MAX_CORES];
+    PLICState plic;
+    bool has_uart;
+    SnapUart uart;
+    virtio_blk_device vblk;
+    SnapDiskOp *ops;
+    uint64_t nops;
+    SnapVirtio vnet, vcon;
+    uint8_t **pages;        // 每页一个指针，NULL = 全零页
+    uint8_t **blocks;       // 每个磁盘块一个指针，同上
+    uint64_t nblocks;
+};
+
+MemSnapshot *snapshot_take(UARTDevice *uart) {
+    MemSnapshot *s = calloc(1, sizeof(MemSnapshot));
+    memcpy(s->cpu, cpu, sizeof(s->cpu));
+    s->plic = *plic_get_state();
+    s->has_uart = uart != NULL;
+    if (uart) s->uart = snap_uart(uart);
+    s->vblk = dev;
+    s->ops = snap_vblk_ops(&s->nops);
+    s->vnet = VIRTIO_SNAP(netdev);
+    s->vcon = VIRTIO_SNAP(condev);
+
+    // 之后只有脏页 / 脏块需要拷回
+    ram_dirty_enable();
+    memset(ram_dirty, 0, RAM_DIRTY_PAGES / 8);
+    s->pages = calloc(MEMORY_SIZE / SNAP_PAGE, sizeof(uint8_t *));
+    for (uint64_t pg = 0; pg < MEMORY_SIZE / SNAP_PAGE; pg++) {
+        if (page_is_zero(memory + pg * SNAP_PAGE)) continue;
+        s->pages[pg] = malloc(SNAP_PAGE);
+        memcpy(s->pages[pg], memory + pg * SNAP_PAGE, SNAP_PAGE);
+    }
+
+    if (dev.disk) {
+        if (dev.cache) block_cache_flush(dev.cache);
+        disk_image_dirty_enable(dev.disk);
+        s->nblocks = (dev.disk->size + DISK_COW_BLOCK_SIZE - 1) / DISK_COW_BLOCK_SIZE;
+        s->blocks = calloc(s->nblocks, sizeof(uint8_t *));
+        uint8_t buf[DISK_COW_BLOCK_SIZE];
+        for (uint64_t blk = 0; blk < s->nblocks; blk++) {
+            uint64_t pos = blk * DISK_COW_BLOCK_SIZE;
+            uint64_t n = dev.disk->size - pos < sizeof(buf) ? dev.disk->size - pos : sizeof(buf);
+            memset(buf, 0, sizeof(buf));
+            disk_image_read(dev.disk, pos, buf, n);
+            if (page_is_zero(buf)) continue;   // 磁盘块和内存页一样是 4 KiB
+            s->blocks[blk] = malloc(sizeof(buf));
+            memcpy(s->blocks[blk], buf, sizeof(buf));
+        }
+        for (uint64_t w = 0; w < (s->nblocks + 63) / 64; w++) disk_image_dirty_take(dev.disk, w);
+    }
+    return s;
+}
+
+// 磁盘：先把缓存里的脏块写下去，脏块位图就是全部改动；拷回原内容后再写一次，清掉这次写入自己置的位
+static void reset_disk(MemSnapshot *s) {
+    static const uint8_t zero[DISK_COW_BLOCK_SIZE];
+    if (dev.cache) block_cache_flush(dev.cache);
+    for (uint64_t w = 0; w < (s->nblocks + 63) / 64; w++) {
+        for (uint64_t bits = disk_image_dirty_take(dev.disk, w); bits; bits &= bits - 1) {
+            uint64_t blk = w * 64 + __builtin_ctzll(bits);
+            uint64_t pos = blk * DISK_COW_BLOCK_SIZE;
+            uint64_t n = dev.disk->size - pos < sizeof(zero) ? dev.disk->size - pos : sizeof(zero);
+            const uint8_t *data = s->blocks[blk] ? s->blocks[blk] : zero;
+            if (dev.cache) block_cache_write(dev.cache, pos, data, n);
+            else disk_image_write(dev.disk, pos, data, n);
+        }
+    }
+    if (dev.cache) block_cache_flush(dev.cache);
+    for (uint64_t w = 0; w < (s->nblocks + 63) / 64; w++) disk_image_dirty_take(dev.disk, w);
+}
+
+void snapshot_reset(MemSnapshot *s, UARTDevice *uart) {
+    for (uint64_t w = 0; w < RAM_DIRTY_PAGES / 64; w++) {
+        for (uint64_t bits = ram_dirty[w]; bits; bits &= bits - 1) {
+            uint64_t pg = w * 64 + __builtin_ctzll(bits);
+            if (s->pages[pg]) memcpy(memory + pg * SNAP_PAGE, s->pages[pg], SNAP_PAGE);
+            else memset(memory + pg * SNAP_PAGE, 0, SNAP_PAGE);
+        }
+        ram_dirty[w] = 0;
+    }
+    if (dev.disk) reset_disk(s);
+
+    for (int i = 0; i < MAX_CORES; i++) restore_cpu(&cpu[i], &s->cpu[i]);
+    *plic_get_state() = s->plic;
+    if (uart && s->has_uart) restore_uart(uart, &s->uart);
+    restore_vblk(&s->vblk);
+    restore_vblk_ops(s->ops, s->nops);
+    VIRTIO_UNSNAP(netdev, s->vnet);
+    VIRTIO_UNSNAP(condev, s->vcon);
+}
+
+void snapshot_free(MemSnapshot *s) {
+    if (!s) return;
+    for (uint64_t pg = 0; pg < MEMORY_SIZE / SNAP_PAGE; pg++) free(s->pages[pg]);
+    for (uint64_t blk = 0; blk < s->nblocks; blk++) free(s->blocks[blk]);
+    free(s->pages);
+    free(s->blocks);
+    free(s->ops);
+    free(s);
+}
+
+/* ---------- 触发 ---------- */
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void snapshot_init(const char *path, const char *at_spec, const char *every_spec, UARTDevice *uart) {
+    save_path = path;
+    save_uart = uart;
+    if (!path) return;
+    if (at_spec) save_at = strtoull(at_spec, NULL, 0);
+    if (every_spec) every_ns = (uint64_t)(strtod(every_spec, NULL) * 1e9);
+    if (every_ns) {
+        ram_dirty_enable();
+        if (dev.disk) disk_image_dirty_enable(dev.disk);
+        last_ckpt_ns = now_ns();
+    }
+    save_at_exit = !save_at && !every_ns;
+    snapshot_next_check = save_at ? save_at : every_ns ? SNAP_CHECK_INSNS : 0;
+}
+
+void snapshot_tick(CPU_State *c) {
+    if (save_at && c->inst_count >= save_at) {
+        save_at = 0;
+        snapshot_save(save_path, save_uart);
+    }
+    if (every_ns && now_ns() - last_ckpt_ns >= every_ns) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s.%u", save_path, ckpt_seq++);
+        snapshot_checkpoint(path, save_uart);
+        last_ckpt_ns = now_ns();
+    }
+
+    snapshot_next_check = save_at;
+    if (every_ns && (!save_at || c->inst_count + SNAP_CHECK_INSNS < save_at))
+        snapshot_next_check = c->inst_count + SNAP_CHECK_INSNS;
+}
+
+// 退出时：没有指定 RVEMU_SNAPSHOT_AT / EVERY 的话在这里保存
+void snapshot_dump(void) {
+    if (!save_at_exit) return;
+    save_at_exit = false;
+    snapshot_save(save_path, save_uart);
+}
@@ -0,0 +1,98 @@
+// snapshot.h
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "common.h"
+#include "cpu.h"
+#include "uart.h"
+
+/*
+ * 整机快照
+ *
+ * 保存 / 恢复所有 hart 的 CPU_State（含 CSR、CLINT、TLB）、客户机内存（跳过全零页）、PLIC、
+ * UART 寄存器、virtio-blk / net / console 的队列状态、还没完成的磁盘请求，以及和 base 镜像不同的磁盘块。
+ * CI 从开机后的快照起跑，每个用例不用再走一遍启动。
+ *
+ * 文件：SnapFileHeader + 若干段（SnapSection 头 + len 字节），以 SNAP_SEC_END 结束。
+ * 结构体按内存布局原样写入，只在同一份可执行文件之间通用，头里记下的结构体大小用来拦住不匹配的文件。
+ * 主机侧的东西不保存：指针、线程、锁、字符 / 网络后端，以及 UART 里还没发出去的输出和还没被读走的输入。
+ *
+ * snapshot_load 要在设备初始化和 cpu_init 之后、主循环之前调用；
+ * 快照里没有的内存页按 0 处理，所以内存必须是 init_memory 刚清零的状态（main 在恢复时跳过 ELF 加载）。
+ *
+ * 增量检查点：打开 RVEMU_SNAPSHOT_EVERY 后，内存写路径维护脏页位图（memory.h 的 ram_mark_dirty），
+ * 磁盘写维护脏块位图（DiskImage.dirty），每次保存后清零。之后的检查点带 SNAP_F_INCREMENTAL，
+ * 第一段 SNAP_SEC_PARENT 记着上一份快照的路径，只写这期间改过的页（含变回全零的页）和块；
+ * 恢复时先沿 parent 链恢复到底，再按顺序叠加。
+ *
+ * 内存快照（snapshot_take / snapshot_reset）：同样的状态留在本进程内存里，打开脏页 / 脏块跟踪，
+ * 复位时只拷回之后改过的页和块，给模糊测试每一轮用（见 fuzz.h）。
+ *
+ *   RVEMU_SNAPSHOT_LOAD=<file>   启动时恢复
+ *   RVEMU_SNAPSHOT_SAVE=<file>   退出时保存
+ *   RVEMU_SNAPSHOT_AT=<N>        配合 SAVE：hart 0 退休第 N 条指令时保存，然后继续运行
+ *   RVEMU_SNAPSHOT_EVERY=<sec>   配合 SAVE：每隔 sec 秒写检查点 <file>.0, <file>.1, ...，
+ *                                第一份是完整快照（从快照启动时以它为 parent），其余为增量
+ */
+
+#define SNAP_MAGIC   "RVSNAP01"
+#define SNAP_VERSION 3
+#define SNAP_PAGE    4096
+
+#define SNAP_F_INCREMENTAL  1u       // 只有相对 parent 的变化
+#define SNAP_CHECK_INSNS    (1u << 20)  // 定时检查点：每隔这么多条指令看一次时钟
+
+enum {
+    SNAP_SEC_END = 0,
+    SNAP_SEC_CPU,           // 每个 hart 一段，CPU_State
+    SNAP_SEC_PLIC,          // PLICState
+    SNAP_SEC_UART,          // SnapUart
+    SNAP_SEC_VBLK,          // virtio_blk_device
+    SNAP_SEC_VBLK_OPS,      // SnapDiskOp[]
+    SNAP_SEC_VNET,          // SnapVirtio
+    SNAP_SEC_VCON,          // SnapVirtio
+    SNAP_SEC_RAM,           // { uint64_t page; uint8_t data[SNAP_PAGE]; }...
+    SNAP_SEC_DISK,          // { uint64_t blk; uint8_t data[DISK_COW_BLOCK_SIZE]; }...
+    SNAP_SEC_PARENT,        // 增量检查点的 parent 路径（不含结尾 0），必须是第一段
+};
+
+typedef struct {
+    char     magic[8];
+    uint32_t version;
+    uint32_t nharts;
+    uint64_t mem_base;
+    uint64_t mem_size;
+    uint64_t disk_size;
+    uint32_t cpu_state_size;    // sizeof(CPU_State) 等，布局变了就拒绝恢复
+    uint32_t plic_state_size;
+    uint32_t vblk_size;
+    uint32_t flags;             // SNAP_F_*
+} SnapFileHeader;
+
+typedef struct {
+    uint32_t id;
+    uint32_t pad;
+    uint64_t len;
+} SnapSection;
+
+typedef struct MemSnapshot MemSnapshot;
+
+extern uint64_t snapshot_next_check;
+
+void snapshot_init(const char *save_path, const char *at_spec, const char *every_spec, UARTDevice *uart);
+int snapshot_save(const char *path, UARTDevice *uart);
+int snapshot_checkpoint(const char *path, UARTDevice *uart);
+int snapshot_load(const char *path, UARTDevice *uart);
+void snapshot_tick(CPU_State *cpu);
+void snapshot_dump(void);
+MemSnapshot *snapshot_take(UARTDevice *uart);
+void snapshot_reset(MemSnapshot *s, UARTDevice *uart);
+void snapshot_free(MemSnapshot *s);
+
+// 主循环调用：hart 0 的指令数到了 snapshot_next_check 再去看要不要保存
+static inline void snapshot_poll(CPU_State *cpu) {
+    if (__builtin_expect(snapshot_next_check != 0, 0) && cpu->inst_count >= snapshot_next_check)
+        snapshot_tick(cpu);
+}
+
+#endif
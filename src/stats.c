@@ -0,0 +1,144 @@
+// stats.c
+#include "stats.h"
+#include "uart.h"
+#include "virtio_blk.h"
+#include "virtio_net.h"
+#include "virtio_console.h"
+
+extern VM_LOCAL virtio_blk_device dev;
+
+VM_LOCAL EmuStats emu_stats;
+volatile sig_atomic_t stats_dump_pending;
+
+static Bus *stats_bus;
+static UARTDevice *stats_uart;
+static char stats_path[256];
+
+// 总线区间按基址起名，没有列出的用基址本身
+static const struct {
+    uint64_t base;
+    const char *name;
+} region_names[] = {
+    { MEMORY_BASE,         "ram" },
+    { UART_BASE,           "uart" },
+    { PLIC_BASE,           "plic" },
+    { CLINT_BASE_ADDR,     "clint" },
+    { VIRTIO_MMIO_BASE,    "virtio-blk" },
+    { VIRTIO_NET_BASE,     "virtio-net" },
+    { VIRTIO_CONSOLE_BASE, "virtio-console" },
+    { VMCTL_BASE,          "vmctl" },
+};
+
+static void on_sigusr1(int sig) {
+    (void)sig;
+    stats_dump_pending = 1;
+}
+
+void stats_init(Bus *bus, struct UARTDevice *uart, const char *out_path) {
+    stats_bus = bus;
+    stats_uart = uart;
+    snprintf(stats_path, sizeof(stats_path), "%s", out_path ? out_path : "");
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sigusr1;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &sa, NULL);
+}
+
+// fork 出的克隆各写各的文件；输出到 stderr 时不用改
+void stats_set_clone(int id) {
+    size_t n = strlen(stats_path);
+    if (n) snprintf(stats_path + n, sizeof(stats_path) - n, ".clone-%d", id);
+}
+
+static void dump_causes(FILE *f, const char *key, const uint64_t *counts) {
+    fprintf(f, "    \"%s\": {", key);
+    const char *sep = "";
+    for (int i = 0; i < STATS_MAX_CAUSE; i++) {
+        if (!counts[i]) continue;
+        fprintf(f, "%s\"%d\": %lu", sep, i, counts[i]);
+        sep = ", ";
+    }
+    fprintf(f, "}");
+}
+
+static void dump_json(FILE *f) {
+    EmuStats *s = &emu_stats;
+    uint64_t inst = s->inst_by_priv[0] + s->inst_by_priv[1] + s->inst_by_priv[3];
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"instructions\": {\"total\": %lu, \"M\": %lu, \"S\": %lu, \"U\": %lu},\n",
+            inst, s->inst_by_priv[3], s->inst_by_priv[1], s->inst_by_priv[0]);
+
+    fprintf(f, "  \"mmu\": {\n");
+    fprintf(f, "    \"itlb\": {\"hits\": %lu, \"misses\": %lu},\n", s->itlb_hits, s->itlb_misses);
+    fprintf(f, "    \"dtlb\": {\"hits\": %lu, \"misses\": %lu},\n", s->dtlb_hits, s->dtlb_misses);
+    fprintf(f, "    \"page_walks\": %lu,\n", s->page_walks);
+    fprintf(f, "    \"page_walk_faults\": %lu\n", s->page_walk_faults);
+    fprintf(f, "  },\n");
+
+    fprintf(f, "  \"bus\": {\n");
+    for (int i = 0; stats_bus && i < stats_bus->region_count; i++) {
+        MMIORegion *r = &stats_bus->regions[i];
+        const char *name = NULL;
+        for (size_t k = 0; k < sizeof(region_names) / sizeof(region_names[0]); k++)
+            if (region_names[k].base == r->base) name = region_names[k].name;
+        if (name) fprintf(f, "    \"%s\": ", name);
+        else      fprintf(f, "    \"0x%lx\": ", r->base);
+        fprintf(f, "{\"base\": \"0x%lx\", \"reads\": %lu, \"writes\": %lu},\n",
+                r->base, s->bus_reads[i], s->bus_writes[i]);
+    }
+    fprintf(f, "    \"unmapped\": %lu\n", s->bus_unmapped);
+    fprintf(f, "  },\n");
+
+    fprintf(f, "  \"traps\": {\n");
+    dump_causes(f, "exceptions", s->exceptions);
+    fprintf(f, ",\n");
+    dump_causes(f, "interrupts", s->interrupts);
+    fprintf(f, "\n  },\n");
+
+    fprintf(f, "  \"virtio_blk\": {\"reads\": %lu, \"writes\": %lu, \"flushes\": %lu, \"errors\": %lu, "
+               "\"bytes_read\": %lu, \"bytes_written\": %lu",
+            dev.reqs_in, dev.reqs_out, dev.reqs_flush, dev.reqs_err, dev.bytes_in, dev.bytes_out);
+    if (dev.cache) {
+        BlockCache *bc = dev.cache;
+        fprintf(f, ",\n    \"cache\": {\"hits\": %lu, \"misses\": %lu, \"evictions\": %lu, "
+                   "\"flushed_blocks\": %lu, \"flush_writes\": %lu}",
+                bc->hits, bc->misses, bc->evictions, bc->flushed_blocks, bc->flush_writes);
+    }
+    fprintf(f, "},\n");
+
+    fprintf(f, "  \"virtio_net\": {\"rx_packets\": %lu, \"rx_bytes\": %lu, \"rx_dropped\": %lu, \"rx_batches\": %lu, "
+               "\"tx_packets\": %lu, \"tx_bytes\": %lu, \"tx_dropped\": %lu, \"tx_batches\": %lu},\n",
+            netdev.rx_packets, netdev.rx_bytes, netdev.rx_dropped, netdev.rx_batches,
+            netdev.tx_packets, netdev.tx_bytes, netdev.tx_dropped, netdev.tx_batches);
+
+    fprintf(f, "  \"virtio_console\": {\"tx_bytes\": %lu, \"tx_buffers\": %lu, \"tx_writes\": %lu},\n",
+            condev.tx_bytes, condev.tx_chains, condev.tx_writes);
+
+    if (stats_uart)
+        fprintf(f, "  \"uart\": {\"tx_bytes\": %lu, \"tx_writes\": %lu, \"tx_dropped\": %lu, \"rx_bytes\": %lu}\n",
+                stats_uart->tx_bytes, stats_uart->tx_writes, stats_uart->tx_dropped, stats_uart->rx_bytes);
+    else
+        fprintf(f, "  \"uart\": null\n");
+    fprintf(f, "}\n");
+}
+
+// 每次导出覆盖整个文件，外部脚本随时读到的都是一份完整的 JSON
+void stats_dump(void) {
+    if (!stats_path[0]) {
+        dump_json(stderr);
+        return;
+    }
+    char tmp[300];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", stats_path);
+    FILE *f = fopen(tmp, "w");
+    if (!f) {
+        fprintf(stderr, "[stats] cannot write %s: %s\n", tmp, strerror(errno));
+        return;
+    }
+    dump_json(f);
+    fclose(f);
+    rename(tmp, stats_path);
+}
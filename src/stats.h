@@ -0,0 +1,53 @@
+// stats.h
+#ifndef STATS_H
+#define STATS_H
+
+#include "common.h"
+#include "bus.h"
+#include <signal.h>
+
+/*
+ * 模拟器内部计数器
+ *
+ * CPU / MMU / 总线 / trap 的计数直接在热路径上自增（只有 CPU 线程写，不加锁）；
+ * 各设备已有的统计（virtio、块缓存、UART）在导出时从设备结构体里读。
+ * 退出时或收到 SIGUSR1 时以 JSON 写到 RVEMU_STATS 指定的文件（未设置时写 stderr）。
+ */
+
+#define STATS_MAX_CAUSE 64
+
+typedef struct {
+    uint64_t inst_by_priv[4];       // 按特权级（0=U 1=S 3=M）退休的指令数，取指 / 访存出错的不算
+
+    uint64_t itlb_hits, itlb_misses;    // 取指翻译；命中只算翻译成功的，权限不符的 TLB 项两边都不算
+    uint64_t dtlb_hits, dtlb_misses;    // 读写翻译
+    uint64_t page_walks;                // sv39_translate 的页表遍历次数
+    uint64_t page_walk_faults;
+
+    uint64_t bus_reads[MAX_MMIO_REGIONS];   // 按 bus_register_mmio 的注册顺序
+    uint64_t bus_writes[MAX_MMIO_REGIONS];
+    uint64_t bus_unmapped;                  // 既不在任何区间也不在内存里的访问
+
+    uint64_t exceptions[STATS_MAX_CAUSE];   // 按 cause 编号
+    uint64_t interrupts[STATS_MAX_CAUSE];
+} EmuStats;
+
+extern VM_LOCAL EmuStats emu_stats;
+extern volatile sig_atomic_t stats_dump_pending;
+
+#define STAT_INC(field) (emu_stats.field++)
+
+struct UARTDevice;
+void stats_init(Bus *bus, struct UARTDevice *uart, const char *out_path);
+void stats_dump(void);
+void stats_set_clone(int id);
+
+// 主循环调用：SIGUSR1 只置标志，真正的导出在 CPU 线程里做
+static inline void stats_poll(void) {
+    if (__builtin_expect(stats_dump_pending, 0)) {
+        stats_dump_pending = 0;
+        stats_dump();
+    }
+}
+
+#endif
@@ -0,0 +1,191 @@
+// trace.c
+#include "trace.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+bool trace_on;
+TraceRing trace_rings[MAX_CORES];
+volatile sig_atomic_t trace_dump_pending;
+
+static int trace_nharts;
+static char trace_path[256];
+
+// 按编码找出指令写回的整数寄存器；不写整数寄存器的（store、branch、浮点等）返回 0
+static uint8_t insn_rd(uint32_t insn) {
+    uint8_t rd = (insn >> 7) & 0x1f;
+    uint8_t rd_c = ((insn >> 2) & 0x7) + 8;     // rd'（Q0）
+    uint8_t rs1_c = ((insn >> 7) & 0x7) + 8;    // rd'/rs1'（Q1 的 100）
+    uint8_t funct3 = (insn >> 13) & 0x7;
+
+    switch (insn & 0x3) {
+        case 0x0:
+            return (funct3 == 0 || funct3 == 2 || funct3 == 3) ? rd_c : 0;   // c.addi4spn c.lw c.ld
+        case 0x1:
+            if (funct3 <= 3) return rd;         // c.addi c.addiw c.li c.lui/c.addi16sp
+            if (funct3 == 4) return rs1_c;
+            return 0;                           // c.j c.beqz c.bnez
+        case 0x2:
+            if (funct3 == 0 || funct3 == 2 || funct3 == 3) return rd;       // c.slli c.lwsp c.ldsp
+            if (funct3 == 4) {
+                uint8_t rs2 = (insn >> 2) & 0x1f;
+                if (rs2) return rd;                                         // c.mv c.add
+                return (insn >> 12) & 1 ? (rd ? 1 : 0) : 0;                 // c.jalr / c.jr c.ebreak
+            }
+            return 0;
+    }
+
+    switch (insn & 0x7f) {
+        case 0x03: case 0x13: case 0x17: case 0x1b: case 0x2f:
+        case 0x33: case 0x37: case 0x3b: case 0x67: case 0x6f:
+            return rd;
+        case 0x73:
+            return ((insn >> 12) & 0x7) ? rd : 0;    // csr*
+        case 0x53: {
+            // fmv.x / fcvt 到整数 / 比较 / fclass 写整数寄存器
+            uint8_t funct5 = insn >> 27;
+            return (funct5 == 0x14 || funct5 == 0x18 || funct5 == 0x1c) ? rd : 0;
+        }
+        default:
+            return 0;
+    }
+}
+
+void trace_record_slow(CPU_State *cpu, uint64_t pc, uint32_t insn, uint8_t priv) {
+    TraceRing *r = &trace_rings[cpu->hartid];
+    uint64_t h = r->head;
+    TraceRec *e = &r->buf[h & r->mask];
+
+    if ((insn & 0x3) != 0x3) insn &= 0xffff;
+    e->pc = pc;
+    e->insn = insn;
+    e->priv = priv;
+    e->rd = insn_rd(insn);
+    e->flags = r->flags;
+    e->cause = r->cause;
+    e->rd_val = cpu->gpr[e->rd];
+    e->mem_addr = r->mem_addr;
+    r->flags = 0;
+    r->cause = 0;
+    r->mem_addr = 0;
+    __atomic_store_n(&r->head, h + 1, __ATOMIC_RELEASE);
+
+    if (__builtin_expect(trace_dump_pending, 0)) {
+        trace_dump_pending = 0;
+        trace_dump();
+    }
+}
+
+/* ---------- output ---------- */
+
+// 只用 write，信号处理函数里也能调
+static int write_all(int fd, const void *buf, size_t len) {
+    const char *p = buf;
+    while (len) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int write_trace(int fd) {
+    TraceFileHeader fh = { .rec_size = sizeof(TraceRec), .nharts = trace_nharts };
+    memcpy(fh.magic, TRACE_MAGIC, sizeof(fh.magic));
+    if (write_all(fd, &fh, sizeof(fh)) < 0) return -1;
+
+    for (int i = 0; i < trace_nharts; i++) {
+        TraceRing *r = &trace_rings[i];
+        uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        uint64_t cap = r->mask + 1;
+        uint64_t count = head < cap ? head : cap;
+        TraceHartHeader hh = { .hart = i, .total = head, .count = count };
+        if (write_all(fd, &hh, sizeof(hh)) < 0) return -1;
+
+        // 最旧的一条在 head - count，环绕时分两段写
+        uint64_t start = (head - count) & r->mask;
+        uint64_t first = count < cap - start ? count : cap - start;
+        if (write_all(fd, &r->buf[start], first * sizeof(TraceRec)) < 0) return -1;
+        if (write_all(fd, r->buf, (count - first) * sizeof(TraceRec)) < 0) return -1;
+    }
+    return 0;
+}
+
+void trace_dump(void) {
+    if (!trace_on) return;
+    int fd = open(trace_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "[trace] cannot write %s: %s\n", trace_path, strerror(errno));
+        return;
+    }
+    if (write_trace(fd) < 0)
+        fprintf(stderr, "[trace] write %s: %s\n", trace_path, strerror(errno));
+    close(fd);
+    fprintf(stderr, "[trace] %lu instructions written to %s\n",
+            __atomic_load_n(&trace_rings[0].head, __ATOMIC_RELAXED), trace_path);
+}
+
+static void on_sigusr2(int sig) {
+    (void)sig;
+    trace_dump_pending = 1;
+}
+
+// 模拟器自己崩溃：把轨迹写出去再按默认动作退出
+static void on_fatal(int sig) {
+    int fd = open(trace_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        write_trace(fd);
+        close(fd);
+    }
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+int trace_init(const char *spec, const char *out_path, int nharts) {
+    char *end;
+    unsigned long n = strtoul(spec, &end, 0);
+    if (*end || n == 0 || n > TRACE_MAX_ENTRIES) {
+        fprintf(stderr, "[trace] bad RVEMU_TRACE '%s' (want entries per hart, 1..%u)\n",
+                spec, TRACE_MAX_ENTRIES);
+        return -1;
+    }
+    uint64_t cap = 1;
+    while (cap < n) cap <<= 1;
+
+    if (nharts > MAX_CORES) nharts = MAX_CORES;
+    for (int i = 0; i < nharts; i++) {
+        trace_rings[i].buf = calloc(cap, sizeof(TraceRec));
+        if (!trace_rings[i].buf) {
+            fprintf(stderr, "[trace] cannot allocate %lu entries\n", cap);
+            return -1;
+        }
+        trace_rings[i].mask = cap - 1;
+    }
+    trace_nharts = nharts;
+    snprintf(trace_path, sizeof(trace_path), "%s", out_path ? out_path : "trace.bin");
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sigusr2;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGUSR2, &sa, NULL);
+
+    sa.sa_handler = on_fatal;
+    sa.sa_flags = SA_RESETHAND | SA_NODEFER;
+    sigaction(SIGSEGV, &sa, NULL);
+    sigaction(SIGBUS, &sa, NULL);
+    sigaction(SIGFPE, &sa, NULL);
+    sigaction(SIGABRT, &sa, NULL);
+
+    trace_on = true;
+    printf("[trace] %lu entries per hart -> %s\n", cap, trace_path);
+    return 0;
+}
+
+void trace_set_clone(int id) {
+    size_t n = strlen(trace_path);
+    snprintf(trace_path + n, sizeof(trace_path) - n, ".clone-%d", id);
+}
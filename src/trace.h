@@ -0,0 +1,99 @@
+// trace.h
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "common.h"
+#include "cpu.h"
+#include <signal.h>
+
+/*
+ * 二进制执行轨迹
+ *
+ * 每个 hart 一个定长环形缓冲，每条退休的指令写一条 TraceRec（pc、指令字、
+ * 目的寄存器写回值、访存虚拟地址），满了覆盖最旧的。只有所属 hart 的线程写，
+ * head 用 release 发布，不加锁。
+ *
+ * RVEMU_TRACE=<N> 打开，N 为每个 hart 保留的条数（向上取 2 的幂）。轨迹在以下时机
+ * 写到 RVEMU_TRACE_OUT（默认 trace.bin）：
+ *   - 模拟器退出时
+ *   - 收到 SIGUSR2 时（由 CPU 线程在下一条指令后写出）
+ *   - 模拟器自身 SIGSEGV / SIGBUS / SIGFPE / SIGABRT 时（信号处理函数里直接 write）
+ * 用 rvtrace 工具解码。
+ */
+
+#define TRACE_MAGIC     "RVTRACE1"
+#define TRACE_MAX_ENTRIES (1u << 26)
+
+#define TRACE_F_LOAD    0x01    // mem_addr 是读地址
+#define TRACE_F_STORE   0x02    // mem_addr 是写地址（AMO 两个都置）
+#define TRACE_F_EXC     0x04    // 这条指令触发了异常，rd_val 不是写回值，cause 有效
+
+typedef struct {
+    uint64_t pc;
+    uint32_t insn;      // 压缩指令只有低 16 位有效
+    uint8_t  priv;      // 执行这条指令时的特权级
+    uint8_t  rd;        // 写回的整数寄存器，0 表示没有
+    uint8_t  flags;
+    uint8_t  cause;     // TRACE_F_EXC 时的异常号
+    uint64_t rd_val;
+    uint64_t mem_addr;
+} TraceRec;
+
+// 文件格式：TraceFileHeader，然后每个 hart 一个 TraceHartHeader 加 count 条 TraceRec（旧的在前）
+typedef struct {
+    char     magic[8];
+    uint32_t rec_size;
+    uint32_t nharts;
+} TraceFileHeader;
+
+typedef struct {
+    uint32_t hart;
+    uint32_t reserved;
+    uint64_t total;     // 该 hart 一共记录过的指令数
+    uint64_t count;
+} TraceHartHeader;
+
+typedef struct {
+    TraceRec *buf;
+    uint64_t mask;
+    uint64_t head;          // 已写入的条数
+    // 当前指令的访存和异常，由 get_pa / take_trap 填，写记录时清零
+    uint64_t mem_addr;
+    uint8_t  flags;
+    uint8_t  cause;
+} TraceRing;
+
+extern bool trace_on;
+extern TraceRing trace_rings[MAX_CORES];
+extern volatile sig_atomic_t trace_dump_pending;
+
+int trace_init(const char *spec, const char *out_path, int nharts);
+void trace_record_slow(CPU_State *cpu, uint64_t pc, uint32_t insn, uint8_t priv);
+void trace_dump(void);
+void trace_set_clone(int id);
+
+// cpu_step 在每条指令执行完后调用
+static inline void trace_record(CPU_State *cpu, uint64_t pc, uint32_t insn, uint8_t priv) {
+    if (__builtin_expect(trace_on, 0))
+        trace_record_slow(cpu, pc, insn, priv);
+}
+
+// get_pa 调用：记下当前指令的访存地址（取指不记）
+static inline void trace_note_mem(CPU_State *cpu, uint64_t vaddr, int acc_type) {
+    if (__builtin_expect(trace_on, 0) && acc_type != ACC_FETCH) {
+        TraceRing *r = &trace_rings[cpu->hartid];
+        r->mem_addr = vaddr;
+        r->flags |= acc_type == ACC_LOAD ? TRACE_F_LOAD : TRACE_F_STORE;
+    }
+}
+
+// take_trap 调用：同步异常记到当前指令上，中断发生在指令之间，不记
+static inline void trace_note_exception(CPU_State *cpu, uint64_t cause) {
+    if (__builtin_expect(trace_on, 0)) {
+        TraceRing *r = &trace_rings[cpu->hartid];
+        r->flags |= TRACE_F_EXC;
+        r->cause = (uint8_t)cause;
+    }
+}
+
+#endif
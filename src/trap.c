@@ -1,10 +1,11 @@
 #include "trap.h"
+#include "stats.h"
+#include "trace.h"
 #include "uart.h"
 
 #define DIRECT 0U
 #define VECTORED 1U
-extern int log_enable;
-extern int j;
+extern VM_LOCAL int j;
 
 static bool should_delegate_to_smode(CPU_State *cpu,uint64_t cause){
 
@@ -63,9 +64,6 @@ static void take_smode_trap(CPU_State *cpu, uint64_t cause, bool is_interrupt){
     //6. 跳转到stvec指向的地址
     uint64_t stvec = read_csr(cpu, CSR_STVEC);
 
-    if(log_enable){
-        printf("[S-Mode Trap] stvec:0x%16lx, scause:0x%16lx\n", stvec, scause);
-    }
     uint64_t base = stvec & ~0x3ULL;
     uint64_t mode = stvec & 0x3;
 
@@ -75,10 +73,6 @@ static void take_smode_trap(CPU_State *cpu, uint64_t cause, bool is_interrupt){
         cpu->pc = base;
     }
 
-    if(log_enable){
-        printf("[S-Mode Trap]pc:0x%16lx\n", cpu->pc);
-       
-    }
 
 }
 
@@ -113,7 +107,10 @@ static void take_mmode_trap(CPU_State *cpu, uint64_t cause, bool is_interrupt){
 
 /* cause: 低位为异常/中断编号； is_interrupt: true 表示中断(need set mcause MSB) */
 void take_trap(CPU_State *cpu, uint64_t cause, bool is_interrupt){
-    
+    if (is_interrupt) STAT_INC(interrupts[cause % STATS_MAX_CAUSE]);
+    else              STAT_INC(exceptions[cause % STATS_MAX_CAUSE]);
+    if (!is_interrupt) trace_note_exception(cpu, cause);
+
     if(cpu->privilege <= 1)
         take_smode_trap(cpu,cause,is_interrupt);
     else
@@ -207,9 +204,6 @@ void check_and_handle_interrupts(CPU_State *cpu){
         uint64_t sip_stip = (mip & MIP_STIP) ? SIP_STIP:0; // sstc expanded timer support
         uint64_t sip_ssip = (mip & MIP_MSIP) && (mideleg & (1 << 1)) ? SIP_SSIP:0;
         
-        if(log_enable){
-            printf("[Interrupt Check] sstatus:%d,sip_seip:%d, sip_stip:%d, sip_ssip:%d\n", sstatus & SSTATUS_SIE ? 1 : 0, sip_seip?1:0, sip_stip?1:0, sip_ssip?1:0);
-        }
         if(current_privilege == 1){
             if(!(cpu->csr[CSR_SSTATUS] & SSTATUS_SIE))   return;
         }
@@ -3,7 +3,7 @@
 #include "mmu.h"
 #include "uart.h"
 
-extern uint8_t* memory;
+extern VM_LOCAL uint8_t* memory;
 typedef int32_t (*SyscallHandler)(CPU_State* cpu);
 SyscallHandler syscall_handlers[0xFFFF] = {0};
 
@@ -7,18 +7,36 @@
 #include "uart.h"
 #include "cpu.h"
 #include <ctype.h>
-extern int log_enable;
-extern CPU_State cpu[MAX_CORES];
-static void uart_update_lsr(UARTDevice *u) {
-    u->lsr = 0;
-    if (u->rx_count > 0) u->lsr |= LSR_DR;
-    if (u->tx_count == 0) u->lsr |= LSR_THRE | LSR_TEMT;
-    // keep OE if set by overflow
-    if (u->tx_count > 0) u->lsr &= ~(LSR_THRE | LSR_TEMT);
+#include <sys/uio.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+extern VM_LOCAL CPU_State cpu[MAX_CORES];
+/* ---------- lock-free SPSC rings ---------- */
+static inline uint32_t ring_load(const uint32_t *p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static inline void ring_store(uint32_t *p, uint32_t v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+
+static inline uint32_t tx_used(UARTDevice *u) { return ring_load(&u->tx_head) - ring_load(&u->tx_tail); }
+static inline uint32_t rx_used(UARTDevice *u) { return ring_load(&u->rx_head) - ring_load(&u->rx_tail); }
+
+static inline bool tx_buf_is_empty(UARTDevice *u) { return tx_used(u) == 0; }
+static inline bool tx_buf_is_full(UARTDevice *u)  { return tx_used(u) >= UART_TX_BUF_SIZE; }
+static inline bool rx_buf_is_empty(UARTDevice *u) { return rx_used(u) == 0; }
+static inline bool rx_buf_is_full(UARTDevice *u)  { return rx_used(u) >= UART_RX_BUF_SIZE; }
+
+// LSR 由环的状态即时计算，轮询 LSR 不需要和 TX/RX 线程抢锁
+static uint8_t uart_lsr(UARTDevice *u) {
+    uint8_t lsr = __atomic_load_n(&u->lsr, __ATOMIC_RELAXED) & LSR_OE;   // keep OE if set by overflow
+    if (!rx_buf_is_empty(u)) lsr |= LSR_DR;
+    // tx_buf 还有空位就允许继续写 THR；波特率模式下当前帧发完之前不允许。
+    // 确定性模式下环满由 tx_buf_push 等待，客户机看不到
+    if (!u->tx_in_progress && (u->deterministic || !tx_buf_is_full(u))) lsr |= LSR_THRE;
+    if (!u->tx_in_progress && (u->deterministic || tx_buf_is_empty(u))) lsr |= LSR_TEMT;
+    return lsr;
 }
 
 static void uart_set_overrun(UARTDevice *u) {
-    u->lsr |= LSR_OE;
+    __atomic_or_fetch(&u->lsr, LSR_OE, __ATOMIC_RELAXED);
 }
 
 void uart_update_irq_old(UARTDevice* uart) {
@@ -42,21 +60,21 @@ void uart_update_irq_old(UARTDevice* uart) {
 
     }
     // 检查接收数据中断 (IER bit0)
-    if ((uart->ier & 0x01) && (uart->rx_count > 0)) {
+    if ((uart->ier & 0x01) && !rx_buf_is_empty(uart)) {
         raise_irq = 1;
         irq_type = 0x04; // 接收数据可用
         uart->iir = irq_type;
  
     }
     // 检查发送保持寄存器空中断 (IER bit1)
-    else if ((uart->ier & 0x02) && (uart->lsr & 0x20)) {
+    else if ((uart->ier & 0x02) && (uart_lsr(uart) & 0x20)) {
         raise_irq = 1;
         irq_type = 0x02; // 发送保持寄存器空
         uart->iir = irq_type;
 
     }
     // 检查线路状态中断 (IER bit2)
-    else if ((uart->ier & 0x04) && (uart->lsr & 0x1E)) { // 任何错误条件
+    else if ((uart->ier & 0x04) && (uart_lsr(uart) & 0x1E)) { // 任何错误条件
         raise_irq = 1;
         irq_type = 0x06; // 接收线路状态
         uart->iir = irq_type;
@@ -86,21 +104,8 @@ void uart_update_irq_old(UARTDevice* uart) {
 
 }
 
-void uart_start_tx(UARTDevice *u, uint8_t ch)
-{
-    // 直接打印
-    putchar(ch);
-    fflush(stdout);
-
-    // 模拟“发送完成”
-    uart_tx_complete(u);
-}
-
 void uart_tx_complete(UARTDevice *u)
 {
-    // 标记发送完成
-    u->lsr |= LSR_TX_EMPTY;
-
     // 触发 TX 中断（只触发一次！）
     if (u->ier & IER_TX_ENABLE) {
         u->irq_pending = 1;
@@ -117,96 +122,131 @@ void uart_tx_complete(UARTDevice *u)
 }
 
 /* ---------- utility (circular buffer) ---------- */
-static inline bool tx_buf_is_empty(UARTDevice *u) { return u->tx_count == 0; }
-static inline bool tx_buf_is_full(UARTDevice *u)  { return u->tx_count >= UART_TX_BUF_SIZE; }
-static inline bool rx_buf_is_empty(UARTDevice *u) { return u->rx_count == 0; }
-static inline bool rx_buf_is_full(UARTDevice *u)  { return u->rx_count >= UART_RX_BUF_SIZE; }
-
-static bool tx_buf_push(UARTDevice *u, uint8_t b) {
-
-    // 检查锁状态（我们已经在锁内）
-
-    bool ret = !tx_buf_is_full(u);
-
-    // 检查缓冲区状态
-
-    if (!ret) {
+static void tx_wake(UARTDevice *u) {
+    pthread_mutex_lock(&u->lock);
+    pthread_cond_signal(&u->tx_cond);
+    pthread_mutex_unlock(&u->lock);
+}
 
-        // policy: drop oldest (advance tail)
-        u->tx_tail = (u->tx_tail + 1) % UART_TX_BUF_SIZE;
-        u->tx_count--;
+// 生产者发布 head 之后调用（之前 TX 环里有 used 字节，刚放进 n 字节）。
+// TX 线程睡着就叫醒；在攒批时越过半满也叫醒一次，让它立即写出。
+// 生产者「写 head、全屏障、读 tx_sleeping」，TX 线程「写 tx_sleeping、全屏障、读 head」，
+// 两边至少有一边看到对方，所以不会出现 TX 线程睡下、生产者也不叫的情况。
+static void tx_kick(UARTDevice *u, uint32_t used, uint32_t n) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&u->tx_sleeping, __ATOMIC_RELAXED) ||
+        (used < UART_TX_WAKE_LEVEL && used + n >= UART_TX_WAKE_LEVEL))
+        tx_wake(u);
+}
 
-    }
-    if(u->tx_count >= UART_TX_BUF_SIZE){
-        pthread_mutex_unlock(&u->lock);
+// CPU 线程调用（TX 生产者）。满了丢弃新字节：TX 线程直接从环里 writev，已入环的数据不能被覆盖
+static bool tx_buf_push(UARTDevice *u, uint8_t b) {
+    uint32_t head = u->tx_head;
+    uint32_t used = head - ring_load(&u->tx_tail);
+    while (u->deterministic && used >= UART_TX_BUF_SIZE && u->running) {
+        tx_wake(u);
+        usleep(50);
+        used = head - ring_load(&u->tx_tail);
+    }
+    if (used >= UART_TX_BUF_SIZE) {
+        u->tx_dropped++;
         return false;
     }
 
-    u->tx_buf[u->tx_head] = b;
-
-    u->tx_head = (u->tx_head + 1) % UART_TX_BUF_SIZE;
-    u->tx_count++;
-    uart_update_lsr(u);
-
-    //if(tx_buf_is_empty(u))
-    { 
-
-        pthread_cond_signal(&u->tx_cond); 
-    }
-
-    return ret;
-}
-
-static bool tx_buf_pop(UARTDevice *u, uint8_t *out) {
-    
-    if (tx_buf_is_empty(u)) return false;
-    *out = u->tx_buf[u->tx_tail];
-    u->tx_tail = (u->tx_tail + 1) % UART_TX_BUF_SIZE;
-    u->tx_count--;
-    
-    uart_update_lsr(u);
+    u->tx_buf[head & (UART_TX_BUF_SIZE - 1)] = b;
+    ring_store(&u->tx_head, head + 1);
+    tx_kick(u, used, 1);
     return true;
 }
 
-static void rx_buf_push(UARTDevice *u, uint8_t b) {
-    pthread_mutex_lock(&u->lock);
+// RX 线程调用（RX 生产者）：一次推入读到的整批字节，只发布一次 head、只触发一次中断。
+// 满了丢弃新字节并置 OE（和 16550 的 overrun 行为一致）
+static void rx_buf_push(UARTDevice *u, const uint8_t *buf, size_t n) {
+    uint32_t head = u->rx_head;
+    uint32_t tail = ring_load(&u->rx_tail);
 
-    if (rx_buf_is_full(u)) {
-        u->rx_tail = (u->rx_tail + 1) % UART_RX_BUF_SIZE;
-        u->rx_count--;
-        u->lsr |= LSR_OE;
+    for (size_t i = 0; i < n; i++) {
+        if (head - tail >= UART_RX_BUF_SIZE) {
+            uart_set_overrun(u);
+            break;
+        }
+        u->rx_buf[head & (UART_RX_BUF_SIZE - 1)] = buf[i];
+        head++;
     }
+    u->rx_bytes += head - u->rx_head;
+    ring_store(&u->rx_head, head);
 
-    u->rx_buf[u->rx_head] = b;
-    u->rx_head = (u->rx_head + 1) % UART_RX_BUF_SIZE;
-    u->rx_count++;
-
-    // 🔥关键1：设置数据就绪
-    u->lsr |= LSR_DR;
-
-    // 🔥关键2：只要有数据就触发中断（模拟16550）
+    // 只要有数据就触发中断（模拟16550）
     if (u->ier & 0x01) {   // RX interrupt enable
         if (u->plic) {
-            printf("[UART] RX push triggering IRQ %d\n", u->irq_num);
             plic_set_irq(u->irq_num, 1);
         }
     }
+}
 
-    pthread_mutex_unlock(&u->lock);
+// 确定性模式下 RX 线程调用：暂存输入，叫醒 WFI 里的 CPU 线程来投递。满了丢弃。
+// 没有 cpu_opaque（库里的 Machine）时由 machine_run 自己来取，不叫醒
+static void rx_stage_push(UARTDevice *u, const uint8_t *buf, size_t n) {
+    pthread_mutex_lock(&u->rx_stage_lock);
+    uint32_t len = u->rx_stage_len;
+    if (n > UART_RX_BUF_SIZE - len) n = UART_RX_BUF_SIZE - len;
+    memcpy(u->rx_stage + len, buf, n);
+    __atomic_store_n(&u->rx_stage_len, len + n, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&u->rx_stage_lock);
+
+    CPU_State *c = u->cpu_opaque;
+    if (!c) return;
+    pthread_mutex_lock(&c->lock);
+    pthread_cond_signal(&c->cond);
+    pthread_mutex_unlock(&c->lock);
 }
 
+// CPU 线程调用（RX 消费者）
 static bool rx_buf_pop(UARTDevice *u, uint8_t *out) {
-    pthread_mutex_lock(&u->lock);
-    bool ret = false;
-    if (rx_buf_is_empty(u)) ret = false;
-    *out = u->rx_buf[u->rx_tail];
-    u->rx_tail = (u->rx_tail + 1) % UART_RX_BUF_SIZE;
-    u->rx_count--;
-    uart_update_lsr(u);
-    pthread_mutex_unlock(&u->lock);
-    ret = true;
-    uart_update_irq(u);
-    return ret;
+    uint32_t tail = u->rx_tail;
+    if (ring_load(&u->rx_head) == tail) return false;
+    *out = u->rx_buf[tail & (UART_RX_BUF_SIZE - 1)];
+    ring_store(&u->rx_tail, tail + 1);
+    return true;
+}
+
+// 内置 SBI 的控制台（sbi.h）：直接进出环，不经过寄存器，也不产生中断
+bool uart_putc(UARTDevice *u, uint8_t c) {
+    return tx_buf_push(u, c);
+}
+
+// CPU 线程调用（TX 生产者，和 THR 写入是同一个线程）：virtio-console 的整批输出拷进 TX 环，
+// 由 TX 线程写出。不丢字节：环满时叫醒 TX 线程，等它腾出空间（后端写不进去时它按超时丢弃，等待有上限）
+void uart_tx_write(UARTDevice *u, const uint8_t *buf, uint32_t len) {
+    while (len > 0) {
+        uint32_t head = u->tx_head;
+        uint32_t used = head - ring_load(&u->tx_tail);
+        if (used >= UART_TX_BUF_SIZE) {
+            if (!u->running) {
+                u->tx_dropped += len;
+                return;
+            }
+            tx_wake(u);
+            usleep(50);
+            continue;
+        }
+        uint32_t n = UART_TX_BUF_SIZE - used;
+        if (n > len) n = len;
+        uint32_t idx = head & (UART_TX_BUF_SIZE - 1);
+        uint32_t first = UART_TX_BUF_SIZE - idx;
+        if (first > n) first = n;
+        memcpy(&u->tx_buf[idx], buf, first);
+        memcpy(u->tx_buf, buf + first, n - first);
+        ring_store(&u->tx_head, head + n);
+        tx_kick(u, used, n);
+        buf += n;
+        len -= n;
+    }
+}
+
+int uart_getc(UARTDevice *u) {
+    uint8_t c;
+    return rx_buf_pop(u, &c) ? c : -1;
 }
 
 /* ---------- IRQ helper ---------- */
@@ -235,94 +275,116 @@ static void uart_maybe_clear_irq(UARTDevice *u) {
     }
 }
 
-/* ---------- TX thread: consumes tx_buf and writes to stdout ---------- */
+/* ---------- TX thread: consumes tx_buf and writes to the char backend ---------- */
+// 每次醒来把 tx_buf 里的所有字节用一次 writev 写出（绕回时两段）。
+// CPU 线程只写 head 一侧的空闲区，所以 writev 期间不需要持锁，写完再发布新的 tail。
+// u->lock 只用来配合 tx_cond 睡眠。
 static void *uart_tx_thread(void *arg) {
     UARTDevice *u = (UARTDevice *)arg;
-    while (1) {
 
+    while (1) {
         pthread_mutex_lock(&u->lock);
-        while (u->running && tx_buf_is_empty(u)) {
-            // wait until there's data or we're shutting down
+        // 等数据或者退出：先挂出 tx_sleeping 再查一次环（和 tx_kick 配对），生产者只在看到它时才碰锁
+        while (u->running) {
+            __atomic_store_n(&u->tx_sleeping, true, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            if (!tx_buf_is_empty(u)) break;
             pthread_cond_wait(&u->tx_cond, &u->lock);
         }
+        __atomic_store_n(&u->tx_sleeping, false, __ATOMIC_RELAXED);
         if (!u->running && tx_buf_is_empty(u)) {
             pthread_mutex_unlock(&u->lock);
             break;
         }
-        
-        uint8_t b;
-        bool ok = tx_buf_pop(u, &b);
-
-
-       /* if(ok){
-            ssize_t written = write(u->serial_fd, &b, 1);
-            if(written != 1) perror("Uart TX write failed\n");
-            usleep(87);// 模拟波特率延迟 (115200 baud = ~87μs per byte)  
-        } */
-
-      //  printf("[uart]ok:%d b:%d\n",ok,b);
-        // update IRQ state before unlocking
-        //uart_maybe_raise_irq(u);
-        
+        // 攒批：最多等 UART_TX_COALESCE_US 或者攒到半满，避免每个字节一次唤醒和 write
+        if (u->running && tx_used(u) < UART_TX_WAKE_LEVEL) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += UART_TX_COALESCE_US * 1000L;
+            if (ts.tv_nsec >= 1000000000L) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000L;
+            }
+            while (u->running && tx_used(u) < UART_TX_WAKE_LEVEL &&
+                   pthread_cond_timedwait(&u->tx_cond, &u->lock, &ts) != ETIMEDOUT)
+                ;
+        }
         pthread_mutex_unlock(&u->lock);
 
-        if(!ok) continue;
-        write(STDOUT_FILENO, &b, 1);
-        if(b == '\n') fflush(stdout);
-        usleep(87);// 模拟波特率延迟 (115200 baud = ~87μs per byte)  
-        uart_update_irq(u);
-    }
-
-    if (u->serial_fd >= 0) {
-        close(u->serial_fd);
-        u->serial_fd = -1;
+        uint32_t tail = u->tx_tail;
+        uint32_t n = ring_load(&u->tx_head) - tail;
+        uint32_t idx = tail & (UART_TX_BUF_SIZE - 1);
+
+        struct iovec iov[2];
+        uint32_t first = UART_TX_BUF_SIZE - idx;
+        if (first > n) first = n;
+        iov[0].iov_base = &u->tx_buf[idx];
+        iov[0].iov_len = first;
+        iov[1].iov_base = u->tx_buf;
+        iov[1].iov_len = n - first;
+        int iovcnt = iov[1].iov_len ? 2 : 1;
+
+        // 输出端关闭或长时间写不进去时由后端丢弃，不阻塞客户机
+        char_backend_write(&u->chr, iov, iovcnt);
+
+        bool was_full = ring_load(&u->tx_head) - tail >= UART_TX_BUF_SIZE;
+        ring_store(&u->tx_tail, tail + n);
+        u->tx_bytes += n;
+        u->tx_writes++;
+        // 环满时客户机在等 THRE，腾出空间后补一个 TX 中断
+        if (was_full && !u->tx_in_progress && !u->deterministic) uart_tx_complete(u);
     }
     return NULL;
 }
 
-/* ---------- RX thread: reads from stdin and pushes to rx_buf ---------- */
+/* ---------- RX thread: reads from the char backend and pushes to rx_buf ---------- */
+// 阻塞在 poll 上：输入可读时立即读完并推入 rx_buf，rx_wake_fd (eventfd) 可读表示要退出。
+// 没有输入时线程不会被唤醒。后端的输入 fd 是非阻塞的，poll 报告可读后一直读到 EAGAIN。
 static void *uart_rx_thread(void *arg) {
     UARTDevice *u = (UARTDevice *)arg;
-    printf("[UART] RX thread started\n");
-    fflush(stdout);
-    int input_fd = STDIN_FILENO;
+    bool input_eof = false;
 
-       // 设置stdin为非阻塞
-    int flags = fcntl(input_fd, F_GETFL, 0);
-    fcntl(input_fd, F_SETFL, flags | O_NONBLOCK);
+    struct pollfd pfd[2] = {
+        { .fd = -1,            .events = POLLIN },
+        { .fd = u->rx_wake_fd, .events = POLLIN },
+    };
 
-    // set stdin non-blocking? We'll use blocking read in a loop to keep things simple.
     while (u->running) {
-        
-        uint8_t buf[128];
-        ssize_t r = read(input_fd, buf, sizeof(buf));
-        if (r <= 0) {
+        // unix 后端在等待连接和已连接之间切换时，要 poll 的 fd 会变
+        pfd[0].fd = input_eof ? -1 : char_backend_poll_fd(&u->chr);
+        int r = poll(pfd, 2, -1);
+        if (r < 0) {
             if (errno == EINTR) continue;
-
-            if (errno == EAGAIN || errno == EWOULDBLOCK || r == 0) {
-                usleep(10000);
-                continue;
-            }
-
-            perror("[UART] read error");
-            continue;
+            perror("[UART] poll");
+            break;
         }
-        for (ssize_t i = 0; i < r; ++i) 
-        {
-            // 特殊处理：如果按Ctrl+D (EOF)
-            if (buf[i] == 0x04) {
-                printf("\n[UART] EOF (Ctrl+D) received\n");
-                cpu[0].running = false; // 直接停止 CPU 运行
-                continue;
+        if (pfd[1].revents) break;   // uart_destroy
+        if (!pfd[0].revents) continue;
+
+        while (1) {
+            uint8_t buf[256];
+            uint8_t out[256];
+            size_t n_out = 0;
+            ssize_t n = char_backend_read(&u->chr, buf, sizeof(buf));
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (n <= 0) {
+                // EOF 或读错误：不再监听输入，只等退出通知
+                input_eof = true;
+                break;
             }
-            rx_buf_push(u, buf[i]);
-            printf("RX thread got: %c\n", buf[i]);
-            fflush(stdout);
-         
+            for (ssize_t i = 0; i < n; ++i) {
+                // 特殊处理：如果按Ctrl+D (EOF)
+                if (buf[i] == 0x04 && u->cpu_opaque) {
+                    printf("\n[UART] EOF (Ctrl+D) received\n");
+                    ((CPU_State *)u->cpu_opaque)->running = false; // 直接停止 CPU 运行
+                    continue;
+                }
+                out[n_out++] = buf[i];
+            }
+            if (n_out && u->deterministic) rx_stage_push(u, out, n_out);
+            else if (n_out) rx_buf_push(u, out, n_out);
         }
-        
-        //uart_maybe_raise_irq(u); // may set RX irq
-
     }
     return NULL;
 }
@@ -333,8 +395,8 @@ uint32_t uart_mmio_read(UARTDevice *u, uint64_t offset, unsigned size) {
     uint32_t res = 0;
     uint8_t value = 0;
     bool dlab = (u->lcr & 0x80) != 0;
-    
-    pthread_mutex_lock(&u->lock);
+
+    // 寄存器只由 CPU 线程访问，和 TX/RX 线程之间只通过无锁环交互，不加锁
     switch (offset) {// cpu access addr
         case UART_REG_DATA: { // rbr/thr
             if(dlab){ //访问 DLL,DLL 用于设置波特率（Baud rate）
@@ -344,8 +406,7 @@ uint32_t uart_mmio_read(UARTDevice *u, uint64_t offset, unsigned size) {
                 uint8_t b = 0;
                 if (rx_buf_pop(u, &b)) {
                     res = (uint32_t)b;
-                     if (u->rx_count == 0) {
-                        u->lsr &= ~LSR_DR;
+                     if (rx_buf_is_empty(u)) {
                         if (u->plic) {
                             plic_set_irq(u->irq_num, 0);
                         }
@@ -377,7 +438,7 @@ uint32_t uart_mmio_read(UARTDevice *u, uint64_t offset, unsigned size) {
         {
             res = u->iir;
             // 如果有接收数据中断
-            if ((u->ier & 0x01) && (u->rx_count > 0)) {
+            if ((u->ier & 0x01) && !rx_buf_is_empty(u)) {
             res = 0x04; // 接收数据可用中断
             }
             break;
@@ -394,11 +455,9 @@ uint32_t uart_mmio_read(UARTDevice *u, uint64_t offset, unsigned size) {
         }
         case 5: //lsr
         {
-            res = u->lsr;
-            if(log_enable){
-                fprintf(stderr, "[UART] LSR read: 0x%08lx\n",res); 
-              
-            }   
+            res = uart_lsr(u);
+            // 读 LSR 清除 OE
+            __atomic_and_fetch(&u->lsr, (uint8_t)~LSR_OE, __ATOMIC_RELAXED);
             break;
         }
         case 6: //msr
@@ -424,7 +483,6 @@ uint32_t uart_mmio_read(UARTDevice *u, uint64_t offset, unsigned size) {
             res = 0xFFFFFFFFu;
             break;
     }
-    pthread_mutex_unlock(&u->lock);
     // adjust to requested size (support 1/2/4 byte reads)
     if (size == 1) return res & 0xFF;
     if (size == 2) return res & 0xFFFF;
@@ -437,12 +495,12 @@ void uart_update_baud(UARTDevice *uart) {
         uart->baud_rate = 1843200 / (16 * divisor);
     else
         uart->baud_rate = 1843200 / 16;
+    uart->bit_time_ps = (uint64_t)(1e12 / uart->baud_rate);
 }
 
 void uart_mmio_write(UARTDevice *u, uint64_t offset, uint32_t val, unsigned size) {
 
     bool need_irq_update = false;
-    pthread_mutex_lock(&u->lock);
     
     // normalize val to 32-bit
     uint32_t v = val;
@@ -470,10 +528,15 @@ void uart_mmio_write(UARTDevice *u, uint64_t offset, uint32_t val, unsigned size
                 }*/
                 uint8_t ch = val & 0xFF;
                 u->thr = ch;
-                // 标记正在发送
-                u->lsr &= ~LSR_TX_EMPTY;
-                // 启动发送（关键）
-                uart_start_tx(u, ch);
+                if (!tx_buf_push(u, ch)) break;
+                if (u->baud_emulation) {
+                    // 一帧 10 位，完成时间按虚拟时间计算，由 uart_update 放行
+                    u->tx_in_progress = true;
+                    u->tx_next_bit_time = cpu[0].cycle_count * CPU_CYCLE_PS + 10 * u->bit_time_ps;
+                } else if (uart_lsr(u) & LSR_THRE) {
+                    // 不限速：还能继续写就立即报告发送完成
+                    uart_tx_complete(u);
+                }
 
                 /* soc
                 // maybe set TX irq pending if buffer empty (depends on semantics)
@@ -503,15 +566,11 @@ void uart_mmio_write(UARTDevice *u, uint64_t offset, uint32_t val, unsigned size
             u->fcr = val;
             u->fifo_enable = (u->fcr & 0x01) ? 1:0;
             u->dma_mode = (u->fcr & 0x08) ? 1:0;
-            if(u->fcr & 0x02){ //rx fifo reset
-                u->rx_count = 0;
-                u->rx_head = 0;
-                u->rx_tail = 0;
-            }else if(u->fcr & 0x04){ // tx fifo reset
-                u->tx_count = 0;
-                u->tx_head = 0;
-                u->rx_tail = 0;
+            if(u->fcr & 0x02){ //rx fifo reset：CPU 线程是 RX 的消费者，直接追上 head
+                ring_store(&u->rx_tail, ring_load(&u->rx_head));
             }
+            // tx fifo reset (0x04)：已入环的字节视为已经在线路上，不再撤回
+
             
             uint8_t trigeer_bits = (u->fcr >> 6) & 0x03;
             switch (trigeer_bits)
@@ -563,9 +622,7 @@ void uart_mmio_write(UARTDevice *u, uint64_t offset, uint32_t val, unsigned size
         default:
             break;
     }
-    
-    pthread_mutex_unlock(&u->lock);
-    fflush(stdout);
+
     if(offset == 1|| offset == 4){
         uart_update_irq(u);
     }
@@ -581,7 +638,7 @@ void uart_init(UARTDevice* uart) {
     memset(uart, 0, sizeof(UARTDevice));
     
     // 初始化寄存器默认值
-    uart->lsr = (1 << 5) | (1 << 6); // THRE + TEMT
+    uart->lsr = 0;                   // THRE/TEMT/DR 由环状态即时计算，这里只存 OE
     uart->msr = 0xB0;                // DCD, DSR, CTS, RI
     /*
     位 7: DCD (Data Carrier Detect) = 1 - 载波检测到 表示“物理链路可用”
@@ -625,202 +682,142 @@ void uart_init(UARTDevice* uart) {
     // 初始化 FIFO
     uart->rx_head = 0;
     uart->rx_tail = 0;
-    uart->rx_count = 0;
-    
-    // 配置终端为原始模式
-    uart->terminal_configured = false;
-    if (isatty(STDIN_FILENO)) {//isatty() 检测文件描述符是否连接到终端，确保只在真实终端上配置终端模式。
-        struct termios term; //检查标准输入是否是终端设备。
-
-      
-        tcgetattr(STDIN_FILENO, &uart->original_termios);
-        term = uart->original_termios;
-        //    tcgetattr() 获取当前终端的属性
-        //保存到 original_termios 以便在程序退出时恢复
-        
-        cfmakeraw(&term);
-        
-        /*作用：将终端设置为原始模式。
-          原理：cfmakeraw() 将终端配置为：
-
-                禁用回显 (echo)
-
-                禁用规范模式（按行缓冲）
-
-                禁用信号生成（如 Ctrl+C, Ctrl+Z）
-
-                禁用特殊字符处理
-
-                允许逐字符读取
-        */
-
-        term.c_oflag |= OPOST;  // 启用输出处理
-        //    OPOST 启用输出后处理，允许正常的换行转换等
-        //如果没有这个标志，输出可能不会正常换行
-                // 只禁用规范模式，保持回显
-        term.c_lflag &= ~ICANON;  // 禁用规范模式（逐字符输入）
-        // term.c_lflag |= ECHO;   // 确保回显启用（如果需要）
-        
-        // 设置非阻塞
-        term.c_cc[VMIN] = 0;
-        term.c_cc[VTIME] = 0;
-        
-        tcsetattr(STDIN_FILENO, TCSANOW, &term);
-        uart->terminal_configured = true;
-        /*
-            作用：立即应用新的终端设置，并标记终端已配置。
-            原理：TCSANOW 表示立即改变终端属性，不等待输出完成。
-        */
-        //isatty(STDIN_FILENO) 只是 检测环境是否安全，
-        //真正让 UART 行为像硬件的是 把终端设置为原始模式。
-
-        
-        // 设置非阻塞输入
-        fcntl(STDIN_FILENO, F_SETFL, O_NONBLOCK);
-        /*
-            O_NONBLOCK 使得 read() 调用在没有输入时立即返回而不是阻塞
-            这对于模拟器很重要，避免在等待输入时阻塞整个模拟器
-        */
-    }
 }
 
+// 终端的原始模式设置在 char_backend_open(stdio) 里，这里只负责恢复
 void uart_cleanup(UARTDevice* uart) {
-    if (uart->terminal_configured) {
-        tcsetattr(STDIN_FILENO, TCSANOW, &uart->original_termios);
-    }
+    char_backend_restore(&uart->chr);
 }
 
-void serial_create(UARTDevice *u,const char *serial_dev){
-    // 打开串口设备
-    u->serial_fd = open(u->serial_device, O_RDWR | O_NOCTTY);
-    if (u->serial_fd < 0) {
-        perror("Failed to open serial device");
-        free(u);
-        return NULL;
-    }
+// 波特率模式下由主循环调用：当前帧的虚拟发送时间到了就放行 THRE 并报告发送完成
+void uart_update(UARTDevice* uart, uint64_t current_time_ps) {
+    if (!uart->tx_in_progress || current_time_ps < uart->tx_next_bit_time) return;
 
-       // 配置串口
-    struct termios options;
-    tcgetattr(u->serial_fd, &options);
-    
-    // 设置波特率
-    cfsetispeed(&options, B115200);
-    cfsetospeed(&options, B115200);
-    
-    // 8数据位，无校验，1停止位
-    options.c_cflag &= ~PARENB;
-    options.c_cflag &= ~CSTOPB;
-    options.c_cflag &= ~CSIZE;
-    options.c_cflag |= CS8;
-    
-    // 启用接收，忽略调制解调器状态
-    options.c_cflag |= (CLOCAL | CREAD);
-    
-    // 原始输入模式
-    options.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);
-    
-    // 原始输出模式  
-    options.c_oflag &= ~OPOST;
-    
-    // 无阻塞读取，立即返回
-    options.c_cc[VMIN]  = 0;
-    options.c_cc[VTIME] = 0;
-    
-    tcsetattr(u->serial_fd, TCSANOW, &options);
-    
-    //strncpy(u->serial_device, serial_dev, sizeof(u->serial_device)-1);
-     
+    uart->tx_in_progress = false;
+    uart_tx_complete(uart);
 }
 
-void uart_update(UARTDevice* uart, uint64_t current_time_ps) {
-    // --- 处理发送状态机 ---
-    if (uart->tx_in_progress && current_time_ps >= uart->tx_next_bit_time) {
-        // 时间到了，发送下一个位
-
-        if (uart->tx_bit_pos == -1) {
-            // 刚才发送的是起始位，现在开始发送数据位 LSB
-            uart->tx_bit_pos = 0;
-            // 设置TX引脚为数据位的第0位 (这里只是模拟，可能没有实际的引脚)
-            // simulated_tx_pin = (uart->tx_current_byte >> 0) & 1;
-        } else if (uart->tx_bit_pos < 8) {
-            // 发送数据位
-            uart->tx_bit_pos++;
-            // simulated_tx_pin = (uart->tx_current_byte >> uart->tx_bit_pos) & 1;
-        } else {
-            // 数据位发送完毕，发送停止位
-            // simulated_tx_pin = 1; // 停止位为高电平
-            // 一帧发送完成！
-            uart->tx_in_progress = false;
-            // 设置线路状态寄存器：发送保持寄存器空（THRE）和发送器空（TEMT）为1
-            uart->lsr |= (1 << 5) | (1 << 6); // 假设第5位是THRE，第6位是TEMT
-            // 可以触发一个发送完成中断 here
-            return; // 本次更新结束
-        }
+// chr_spec 选择主机侧后端（见 char_backend.h），NULL 为 stdio
+static int uart_start_threads(UARTDevice *u) {
+    u->running = true;
+    u->rx_wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (u->rx_wake_fd < 0) {
+        perror("uart eventfd");
+        return -1;
+    }
 
-        // 计算下一个位变化的时间
-        uart->tx_next_bit_time += uart->bit_time_ps;
+    // spawn threads
+    if (pthread_create(&u->tx_thread, NULL, uart_tx_thread, u) != 0) {
+        perror("uart tx thread create");
+        close(u->rx_wake_fd);
+        return -1;
+    }
+    if (pthread_create(&u->rx_thread, NULL, uart_rx_thread, u) != 0) {
+        // rx thread failure is not fatal; continue without rx
+        u->running = false;
+        pthread_join(u->tx_thread, NULL);
+        perror("uart rx thread create");
+        close(u->rx_wake_fd);
+        return -1;
     }
+    return 0;
 }
 
-UARTDevice *uart_create(uint64_t base_addr, void *cpu_opaque, int irq_num) {
+// TX 线程写完剩余输出后退出，RX 线程由 eventfd 唤醒退出
+static void uart_stop_threads(UARTDevice *u) {
+    pthread_mutex_lock(&u->lock);
+    u->running = false;
+    pthread_cond_signal(&u->tx_cond);
+    pthread_mutex_unlock(&u->lock);
+    uint64_t one = 1;
+    write(u->rx_wake_fd, &one, sizeof(one));   // 唤醒阻塞在 poll 上的 RX 线程
+    pthread_join(u->tx_thread, NULL);
+    pthread_join(u->rx_thread, NULL);
+    close(u->rx_wake_fd);
+}
+
+UARTDevice *uart_create(uint64_t base_addr, void *cpu_opaque, int irq_num, const char *chr_spec) {
     UARTDevice *u = (UARTDevice *)calloc(1, sizeof(UARTDevice));
     if (!u) return NULL;
 
+    uart_init(u);   // uart_init 会清零整个结构体，波特率要在它之后设置
     u->baud_rate = 115200;
     // 将位时间转换为皮秒。1秒 = 1e12 皮秒
     u->bit_time_ps = (uint64_t)(1e12 / u->baud_rate);
-
     u->tx_in_progress = false;
+    // RVEMU_UART_BAUD=1：按波特率在虚拟时间上限速（默认不限速）
+    const char *baud = getenv("RVEMU_UART_BAUD");
+    u->baud_emulation = baud && atoi(baud) != 0;
 
-    uart_init(u);
     u->base_addr = base_addr; // cpu access
     u->ctrl = 0;
     u->irq_status = 0;
     pthread_mutex_init(&u->lock, NULL);
     pthread_cond_init(&u->tx_cond, NULL);
-    u->tx_head = u->tx_tail = u->tx_count = 0;
-    u->rx_head = u->rx_tail = u->rx_count = 0;
+    pthread_mutex_init(&u->rx_stage_lock, NULL);
+    u->tx_head = u->tx_tail = 0;
+    u->rx_head = u->rx_tail = 0;
     u->cpu_opaque = cpu_opaque;
     //u->irq_cb = irq_cb;
     u->irq_num = irq_num;
     u->running = true;
     u->plic = &plic;
-    u->serial_fd = -1;
-    u->lsr = (1 << 5) | (1 << 6);
-    
-    // spawn threads
-    if (pthread_create(&u->tx_thread, NULL, uart_tx_thread, u) != 0) {
-        perror("uart tx thread create");
+    u->lsr = 0;
+    if (char_backend_open(&u->chr, chr_spec) < 0) {
         free(u);
         return NULL;
     }
-    if (pthread_create(&u->rx_thread, NULL, uart_rx_thread, u) != 0) {
-        // rx thread failure is not fatal; continue without rx
-        u->running = false;
-        pthread_join(u->tx_thread, NULL);
-        perror("uart rx thread create");
+    if (uart_start_threads(u) < 0) {
+        char_backend_close(&u->chr);
         free(u);
         return NULL;
     }
     return u;
 }
 
+// 录制 / 回放：在主循环开始前调用
+void uart_set_deterministic(UARTDevice *u) {
+    u->deterministic = true;
+}
+
+// CPU 线程调用：取走暂存的输入
+uint32_t uart_rx_take(UARTDevice *u, uint8_t *buf, uint32_t max) {
+    pthread_mutex_lock(&u->rx_stage_lock);
+    uint32_t n = u->rx_stage_len < max ? u->rx_stage_len : max;
+    memcpy(buf, u->rx_stage, n);
+    memmove(u->rx_stage, u->rx_stage + n, u->rx_stage_len - n);
+    __atomic_store_n(&u->rx_stage_len, u->rx_stage_len - n, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&u->rx_stage_lock);
+    return n;
+}
+
+// CPU 线程调用：投递到 RX 环，和 RX 线程推入的效果一样
+void uart_rx_inject(UARTDevice *u, const uint8_t *buf, uint32_t n) {
+    rx_buf_push(u, buf, n);
+}
+
+// fork 之前调用：停掉主机侧线程，子进程里不会有拿着锁的线程
+void uart_pause(UARTDevice *u) {
+    uart_stop_threads(u);
+}
+
+// fork 之后在父子进程里各自调用；chr_spec 非空时换一个新的字符后端。
+// 旧后端不关：unix 后端关闭时会 unlink 父进程还在用的 socket 路径
+int uart_resume(UARTDevice *u, const char *chr_spec) {
+    if (chr_spec && char_backend_open(&u->chr, chr_spec) < 0) return -1;
+    return uart_start_threads(u);
+}
+
 void uart_destroy(UARTDevice *u) {
     if (!u) return;
-    pthread_mutex_lock(&u->lock);
-    u->running = false;
-        // 关闭串口设备
-    if (u->serial_fd >= 0) {
-        close(u->serial_fd);
-        printf("[UART] Serial device closed\n");
-    }
     uart_cleanup(u);
-    pthread_cond_signal(&u->tx_cond);
-    pthread_mutex_unlock(&u->lock);
-    pthread_join(u->tx_thread, NULL);
-    pthread_join(u->rx_thread, NULL);
+    uart_stop_threads(u);
+    char_backend_close(&u->chr);   // TX 线程已经写完剩余输出
     pthread_mutex_destroy(&u->lock);
     pthread_cond_destroy(&u->tx_cond);
+    pthread_mutex_destroy(&u->rx_stage_lock);
+    fprintf(stderr, "[UART] tx %lu bytes in %lu writes (%lu dropped)\n",
+            u->tx_bytes, u->tx_writes, u->tx_dropped);
     free(u);
 }
 
@@ -5,14 +5,14 @@
 #include "common.h"
 
 #include "plic.h"
+#include "char_backend.h"
 
 /* Opaque CPU callback for raising/clearing IRQs */
 typedef void (*uart_irq_cb_t)(void *cpu_opaque, int raise, int irq_num);
 
 /* Device structure */
 typedef struct UARTDevice {
-    int serial_fd;              // 串口设备文件描述符
-    char serial_device[256];    // 串口设备路径
+    CharBackend chr;            // 主机侧字符后端：stdio / file / unix / pty / tty / null
 
     uint8_t rbr;    // 接收缓冲寄存器
     uint8_t thr;    // 发送保持寄存器
@@ -23,7 +23,7 @@ typedef struct UARTDevice {
           //bit0 = 1 表示无中断，0 表示有中断；bits[3:1] 标示中断类型（优先级）。
     uint8_t lcr;    // 线路控制寄存器
     uint8_t mcr;    // Modem 控制寄存器
-    uint8_t lsr;    // 线路状态寄存器
+    uint8_t lsr;    // 线路状态寄存器：只保存 OE 这样的粘滞位，DR/THRE/TEMT 读时由环的状态计算
     uint8_t msr;    // Modem 状态寄存器
     uint8_t scr;    // 暂存寄存器
 
@@ -54,24 +54,22 @@ typedef struct UARTDevice {
     */
 
 
-    // circular buffers
+    // circular buffers：单生产者/单消费者无锁环
+    // head/tail 是单调递增的计数，下标 = 计数 & (SIZE - 1)，已用 = head - tail
+    // TX: CPU 线程（写 THR）推进 head，TX 线程推进 tail
+    // RX: RX 线程推进 head，CPU 线程（读 RBR）推进 tail
     uint8_t tx_buf[UART_TX_BUF_SIZE];
-    uint32_t tx_head, tx_tail; // head: next write index, tail: next read index
-    uint32_t tx_count;
+    uint32_t tx_head, tx_tail;
 
     uint8_t rx_buf[UART_RX_BUF_SIZE];
     uint32_t rx_head, rx_tail;
-    uint32_t rx_count;
 
     // status flags are derived, but cached helpers can be kept
-    pthread_mutex_t lock;
+    pthread_mutex_t lock;       // 只用于 TX 线程睡眠/唤醒和 irq_status，寄存器访问不加锁
     pthread_mutex_t tx_buf_lock;
     pthread_cond_t  tx_cond;
+    bool tx_sleeping;           // TX 线程睡在 tx_cond 上等数据，生产者发布 head 后据此决定要不要叫醒
 
-    // 终端设置
-    struct termios original_termios;
-    bool terminal_configured;
-    
     bool running;
 
     // host integration
@@ -91,25 +89,52 @@ typedef struct UARTDevice {
     // thread handles
     pthread_t tx_thread;
     pthread_t rx_thread;
+    int rx_wake_fd;          // eventfd，写入后 RX 线程退出
  
     uint64_t bit_time_ps;    // 每位的时间，单位皮秒 (picoseconds) 以便高精度
 
-    // 发送状态机
+    // 波特率模拟（可选）：打开后 THR 写入占用一帧（起始位 + 8 数据位 + 停止位）的虚拟时间，
+    // 期间 THRE 为 0；关闭时只要 tx_buf 有空位 THRE 就为 1，输出不限速
+    bool baud_emulation;
     bool tx_in_progress;     // 是否正在发送一帧数据
-    uint8_t tx_current_byte; // 当前正在发送的字节
-    int tx_bit_pos;          // 当前发送到了第几位 (0=起始位，1-8=数据位...)
-    uint64_t tx_next_bit_time; // 下一个位变化的时间点（你的模拟器的时间）
+    uint64_t tx_next_bit_time; // 当前帧发送完成的虚拟时间点（皮秒）
+
+    // 统计
+    uint64_t tx_bytes;
+    uint64_t tx_writes;      // TX 线程的 write 调用次数
+    uint64_t tx_dropped;     // tx_buf 满时丢弃的字节
+    uint64_t rx_bytes;       // RX 线程写、导出统计时读
+
+    // 录制 / 回放（replay.h）：RX 线程读到的字节先放进 rx_stage，由 CPU 线程在确定的指令点投递；
+    // TX 环满时 CPU 线程等 TX 线程腾出空间，LSR 不随主机写出的快慢变化
+    bool deterministic;
+    uint8_t rx_stage[UART_RX_BUF_SIZE];
+    uint32_t rx_stage_len;
+    pthread_mutex_t rx_stage_lock;
 
     void *plic;
 
 } UARTDevice;
 
-UARTDevice *uart_create(uint64_t base_addr, void *cpu_opaque, int irq_num);
+UARTDevice *uart_create(uint64_t base_addr, void *cpu_opaque, int irq_num, const char *chr_spec);
 uart_irq_cb_t cpu_irq_raise_cb(void *opaque, int level, int irq_num);
 void simulator_printc(char c);
 uint32_t mmio_read(UARTDevice *uart,uint64_t offset,int size);
 void mmio_write(UARTDevice *uart,uint64_t offset, uint32_t val, int size);
 void uart_cleanup(UARTDevice* uart);
 void uart_destroy(UARTDevice *u);
+void uart_pause(UARTDevice *u);
+int uart_resume(UARTDevice *u, const char *chr_spec);
+void uart_update(UARTDevice* uart, uint64_t current_time_ps);
+void uart_set_deterministic(UARTDevice *u);
+uint32_t uart_rx_take(UARTDevice *u, uint8_t *buf, uint32_t max);
+void uart_rx_inject(UARTDevice *u, const uint8_t *buf, uint32_t n);
+bool uart_putc(UARTDevice *u, uint8_t c);
+void uart_tx_write(UARTDevice *u, const uint8_t *buf, uint32_t len);
+int uart_getc(UARTDevice *u);
+
+static inline bool uart_rx_staged(UARTDevice *u) {
+    return __atomic_load_n(&u->rx_stage_len, __ATOMIC_ACQUIRE) != 0;
+}
 
 #endif
\ No newline at end of file
@@ -5,17 +5,13 @@
 #include "bus.h"
 #include "plic.h"
 #include "memory.h"
-#include "mmu.h"
-extern uint8_t* memory;
-extern Bus bus;
-extern CPU_State cpu[MAX_CORES];
-extern int log_enable;
+extern VM_LOCAL uint8_t* memory;
+extern VM_LOCAL Bus bus;
+extern VM_LOCAL CPU_State cpu[MAX_CORES];
 // 全局设备实例
-virtio_blk_device dev;
+VM_LOCAL virtio_blk_device dev;
 
-struct disk_op_list pending_ops;  // 待处理的磁盘操作列表
-
-static BlockCache bc;
+VM_LOCAL struct disk_op_list pending_ops;  // 待处理的磁盘操作列表
 
 static void inline phys_write(uint64_t addr,uint64_t value, uint8_t size){
     memory_write(memory,addr,value,size);
@@ -46,63 +42,27 @@ uint8_t* phys_write_raw(uint64_t addr) {
 }
 
 
-void load_block(uint64_t blockno) {
-    if (bc.valid && bc.blockno == blockno)
-        return;
-
-    uint64_t offset = blockno * BSIZE;
-
-    for (int i = 0; i < BSIZE; i++) {
-        bc.data[i] = dev.disk_data[offset + i];
-    }
-
-    bc.blockno = blockno;
-    bc.valid = 1;
-}
-
-
-// 从磁盘镜像文件加载整个 fs.img 到内存（简单方式）
-void virtio_blk_init(const char *disk_image_path) {
-    FILE *f = fopen(disk_image_path, "rb");
-    int fd = fileno(f);
-    char realpath_buf[256];
-    sprintf(realpath_buf, "/proc/self/fd/%d", fd);
-    char link[256];
-    readlink(realpath_buf, link, sizeof(link));
-    printf("[REAL FILE] %s\n", link);
-
-    printf("Opening disk: %s\n", disk_image_path);  
-    if (!f) {
+// 打开磁盘镜像：base 直接 mmap，不再整块读入内存；overlay_path 非空时写入走写时复制 delta。失败返回 -1
+int virtio_blk_init(const char *disk_image_path, const char *overlay_path) {
+    printf("Opening disk: %s\n", disk_image_path);
+    dev.disk = disk_image_open(disk_image_path, overlay_path);
+    if (!dev.disk) {
         fprintf(stderr, "Cannot open disk image: %s\n", disk_image_path);
-        exit(1);
+        return -1;
     }
 
-    fseek(f, 0, SEEK_END);
-    long size = ftell(f);
-    printf("disk size = %ld bytes\n", size);
-    fseek(f, 0, SEEK_SET);
-
-    dev.disk_data = malloc(size);
-    if (!dev.disk_data) {
-        perror("malloc disk");
-        exit(1);
+    // RVEMU_DISK_WB_MS=<ms>: 后台回写周期，0 表示只在 FLUSH 和淘汰时写出
+    const char *wb = getenv("RVEMU_DISK_WB_MS");
+    dev.cache = block_cache_create(dev.disk, wb ? atoi(wb) : BLK_CACHE_WB_INTERVAL_MS);
+    if (!dev.cache) {
+        fprintf(stderr, "Cannot allocate disk cache\n");
+        disk_image_close(dev.disk);
+        dev.disk = NULL;
+        return -1;
     }
 
-    if (fread(dev.disk_data, 1, size, f) != (size_t)size) {
-        perror("read disk");
-        exit(1);
-    }
-
-
-    clearerr(f);
-    printf("[INIT CHECK] disk_data[0..15]=%02x %02x %02x %02x ...\n",
-    dev.disk_data[0],
-    dev.disk_data[1],
-    dev.disk_data[2],
-    dev.disk_data[3]);
-
-
-    fclose(f);
+    uint64_t size = dev.disk->size;
+    printf("disk size = %ld bytes\n", size);
 
     dev.disk_size_sectors = size / 512;
     if (size % 512 != 0) {
@@ -116,7 +76,18 @@ void virtio_blk_init(const char *disk_image_path) {
     dev.used_ring = 0;
 
     
-    printf("virtio-blk: loaded %s, %lu sectors\n", disk_image_path, dev.disk_size_sectors);
+    printf("virtio-blk: loaded %s%s%s, %lu sectors\n", disk_image_path,
+           overlay_path ? " + overlay " : "", overlay_path ? overlay_path : "",
+           dev.disk_size_sectors);
+    return 0;
+}
+
+// 写出缓存中的脏块并关闭镜像
+void virtio_blk_close(void) {
+    block_cache_destroy(dev.cache);
+    dev.cache = NULL;
+    disk_image_close(dev.disk);
+    dev.disk = NULL;
 }
 
 // 读取 avail ring 中的 next idx
@@ -146,113 +117,168 @@ static void complete_request(uint16_t desc_idx, uint8_t status) {
 }
 
 
-static void complete_disk_operation(struct disk_operation *op) {
-   // printf("[VIRTIO] Completing operation for desc %u\n", op->head_desc_idx);
-    
-    // 1. 遍历描述符链，处理数据
-    uint16_t desc_idx = op->head_desc_idx;
-    uint64_t req_addr = 0, data_addr = 0;
-    
+static int indirect_negotiated(void) {
+    return (dev.driver_features >> VIRTIO_RING_F_INDIRECT_DESC) & 1;
+}
+
+// 读取一个描述符（desc_base 为描述符所在的物理地址）。
+// 描述符里的 addr 是客户机物理地址，直接用，不经过 hart 的 MMU（那样会按当前 satp 翻译、注入缺页、污染 TLB）
+static void read_desc(uint64_t desc_base, virtio_blk_seg *seg, uint16_t *next) {
+    seg->addr  = phys_read(desc_base + 0, 8);
+    seg->len   = phys_read(desc_base + 8, 4);
+    seg->flags = phys_read(desc_base + 12, 2);
+    *next      = phys_read(desc_base + 14, 2);
+}
+
+// 把描述符链展开成段数组：直接描述符按 next 遍历，
+// 遇到 VRING_DESC_F_INDIRECT 时进入间接表（表内下标从 0 开始，同样用 next 串联）。
+// 返回段数，出错返回 -1。
+static int collect_segments(uint16_t head, virtio_blk_seg *segs, int max) {
+    int n = 0;
+    uint16_t desc_idx = head;
+    int hops = 0;
+
     while (1) {
-        uint64_t desc_base = dev.desc_addr + desc_idx * 16;//第 desc_idx 个描述符
-                                                //(16= 8 字节 addr、4 字节 len、2 字节 flags、2 字节 next)
-        uint64_t f_addr = phys_read(desc_base + 0, 8);   
-        uint64_t addr = get_pa(&cpu[0],f_addr,ACC_LOAD);
-        //printf("[desc %u] faddr: 0x%16lx,pa:0x%16lx\n", desc_idx, f_addr,  addr); 
-        uint32_t len = phys_read(desc_base + 8, 4);
-        uint16_t flags = phys_read(desc_base + 12, 2);
-        uint16_t next = phys_read(desc_base + 14, 2);
-
-        // 第一个描述符是 virtio_blk_req
-        if (desc_idx == op->head_desc_idx) {
-            req_addr = addr;
-        } else if (flags & VRING_DESC_F_NEXT) {
-            // 数据描述符
-            data_addr = addr;
+        if (desc_idx >= dev.queue_num || hops++ > dev.queue_num) {
+            fprintf(stderr, "[virtio] bad descriptor index %u\n", desc_idx);
+            return -1;
         }
- 
-        if (!(flags & VRING_DESC_F_NEXT)) {
-            // 最后一个描述符是状态
-            // 写状态 0 表示成功
-            phys_write(addr, 0, 1);
-            break;
+
+        virtio_blk_seg d;
+        uint16_t next;
+        read_desc(dev.desc_addr + desc_idx * VRING_DESC_SIZE, &d, &next);
+
+        if (d.flags & VRING_DESC_F_INDIRECT) {
+            if (!indirect_negotiated()) {
+                fprintf(stderr, "[virtio] indirect descriptor without negotiation\n");
+                return -1;
+            }
+            // 间接表：d.addr 指向 desc[len/16]，驱动不得再设置 NEXT
+            uint32_t table_num = d.len / VRING_DESC_SIZE;
+            uint16_t i = 0;
+            uint32_t visited = 0;
+            while (1) {
+                if (i >= table_num || visited++ >= table_num || n >= max) {
+                    fprintf(stderr, "[virtio] bad indirect table (num=%u idx=%u)\n", table_num, i);
+                    return -1;
+                }
+                uint16_t inext;
+                read_desc(d.addr + i * VRING_DESC_SIZE, &segs[n], &inext);
+                if (segs[n].flags & VRING_DESC_F_INDIRECT) {
+                    fprintf(stderr, "[virtio] nested indirect descriptor\n");
+                    return -1;
+                }
+                int more = segs[n].flags & VRING_DESC_F_NEXT;
+                n++;
+                if (!more) break;
+                i = inext;
+            }
+            return n;
         }
-        
+
+        if (n >= max) return -1;
+        segs[n++] = d;
+        if (!(d.flags & VRING_DESC_F_NEXT)) break;
         desc_idx = next;
     }
- 
-    // 2. 处理磁盘 I/O
-    if (req_addr && data_addr) {
-        uint32_t type = phys_read(req_addr, 4);
-        uint64_t sector = phys_read(req_addr + 8, 8);
-        uint64_t blockno = sector/2;
-        uint64_t sector_in_block = sector % 2 ; 
-
-        uint64_t disk_offset = sector * 512;
-        uint64_t buf_offset  = sector_in_block * 512;
-        
-        if (type == VIRTIO_BLK_T_IN) {
+    return n;
+}
 
+// 在磁盘与客户机内存之间搬运 len 字节，经过写回块缓存
+static int disk_transfer(uint64_t disk_off, uint64_t pa, uint32_t len, int to_disk) {
+    uint64_t disk_bytes = dev.disk_size_sectors * 512;
+    if (len == 0) return 0;
+    if (disk_off + len > disk_bytes) {
+        fprintf(stderr, "[virtio] access beyond disk end: off=0x%lx len=%u\n", disk_off, len);
+        return -1;
+    }
 
-           // printf("sector=%lu to addr:0x%lx\n", sector, data_addr);
-            //printf("disk_data[%d]=%x\n", offset, dev.disk_data[offset]);
+    uint8_t *guest = phys_write_raw(pa);
+    if (!guest || !phys_write_raw(pa + len - 1)) return -1;
 
-            // 读操作：磁盘 -> 内存
-               
-            load_block(blockno);
-            //printf("[CACHE] load block %ld\n", blockno);
-            //  写回 512B（但来自完整block）
-            for (int i = 0; i < 1024; i++) {
-                bus_write(&cpu[0].bus,
-                        data_addr +i,
-                        bc.data[buf_offset + i],
-                        1);
-            }
+    if (to_disk)
+        return block_cache_write(dev.cache, disk_off, guest, len);
+    ram_mark_dirty(pa - MEMORY_BASE, len);
+    return block_cache_read(dev.cache, disk_off, guest, len);
+}
 
+static void complete_disk_operation(struct disk_operation *op) {
+   // printf("[VIRTIO] Completing operation for desc %u\n", op->head_desc_idx);
 
-        } else if (type == VIRTIO_BLK_T_OUT) {
-            // 写操作：内存 -> 磁盘
-            load_block(blockno);
+    // 1. 展开描述符链：req + data... + status
+    static VM_LOCAL virtio_blk_seg segs[VIRTIO_BLK_MAX_SEGS];
+    int nsegs = collect_segments(op->head_desc_idx, segs, VIRTIO_BLK_MAX_SEGS);
+    uint8_t status = VIRTIO_BLK_S_OK;
+    uint32_t written = 0;
+
+    if (nsegs < 2) {
+        fprintf(stderr, "[virtio] malformed request at desc %u\n", op->head_desc_idx);
+        status = VIRTIO_BLK_S_IOERR;
+    } else {
+        // 2. 处理磁盘 I/O
+        uint64_t req_addr = segs[0].addr;
+        uint32_t type = phys_read(req_addr, 4);
+        uint64_t sector = phys_read(req_addr + 8, 8);
+        uint64_t disk_offset = sector * 512;
 
-            //  写入 cache
-            for (int i = 0; i < 1024; i++) {
-                uint8_t val = bus_read(&cpu[0].bus,
-                                    data_addr + i,
-                                    1);
+        if (type == VIRTIO_BLK_T_FLUSH) {
+            // 脏块按序写出后再落盘
+            if (block_cache_flush(dev.cache) < 0 || disk_image_flush(dev.disk) < 0)
+                status = VIRTIO_BLK_S_IOERR;
+        }
 
-                bc.data[buf_offset + i] = val;
+        for (int i = 1; i < nsegs - 1 && status == VIRTIO_BLK_S_OK && type != VIRTIO_BLK_T_FLUSH; i++) {
+            virtio_blk_seg *d = &segs[i];
+            if (type == VIRTIO_BLK_T_IN) {
+                // 读操作：磁盘 -> 内存
+                if (disk_transfer(disk_offset, d->addr, d->len, 0) < 0) status = VIRTIO_BLK_S_IOERR;
+                else written += d->len;
+            } else if (type == VIRTIO_BLK_T_OUT) {
+                // 写操作：内存 -> 磁盘
+                if (disk_transfer(disk_offset, d->addr, d->len, 1) < 0) status = VIRTIO_BLK_S_IOERR;
+            } else {
+                status = VIRTIO_BLK_S_UNSUPP;
             }
+            disk_offset += d->len;
+        }
+      //  printf("[virtio] sector=%ld segs=%d\n", sector, nsegs);
 
-            uint64_t disk_offset = blockno * BSIZE;
-            for (int i = 0; i < BSIZE; i++) {
-                dev.disk_data[disk_offset + i] = bc.data[i];
-            }
+        if (type == VIRTIO_BLK_T_IN) {
+            dev.reqs_in++;
+            dev.bytes_in += written;
+        } else if (type == VIRTIO_BLK_T_OUT) {
+            dev.reqs_out++;
+            dev.bytes_out += disk_offset - sector * 512;
+        } else if (type == VIRTIO_BLK_T_FLUSH) {
+            dev.reqs_flush++;
         }
-      //  printf("[virtio] sector=%ld data_addr=0x%lx\n", sector, data_addr);
+        if (status != VIRTIO_BLK_S_OK) dev.reqs_err++;
+
+        // 最后一个描述符是状态
+        phys_write(segs[nsegs - 1].addr, status, 1);
+        written += 1;
     }
 
-    
- 
     // 3. 更新 used ring
     // used->ring[used_idx % queue_num].id = head_desc_idx
-    // used->ring[used_idx % queue_num].len = 数据长度
+    // used->ring[used_idx % queue_num].len = 写入客户机的字节数
     uint64_t used_addr = dev.used_ring; // used 在 avail 之后
     uint16_t used_idx = phys_read(used_addr + 2, 2);
    // printf("[complete_disk_operation] used_idx before update: %d\n", used_idx);
     uint64_t used_ring_offset = 4 + (used_idx % dev.queue_num) * 8;
-    
+
     phys_write(used_addr + used_ring_offset, op->head_desc_idx, 2); // id
-    phys_write(used_addr + used_ring_offset + 4, 512, 4); // len
-    
+    phys_write(used_addr + used_ring_offset + 4, written, 4); // len
+
     // 更新 used->idx
     used_idx++;
     phys_write(used_addr + 2, used_idx, 2);
    // printf("[VIRTIO] used_idx addr: 0x%16lx, value: %d\n", used_addr + 2, used_idx);
-    
+
     // 4. 触发中断
     dev.interrupt_status = 1;
     plic_set_irq(VIRTIO_IRQ,1);
-    
+
  //   printf("[VIRTIO] Operation completed, interrupt triggered\n");
 }
 
@@ -262,9 +288,6 @@ void virtio_disk_update(uint64_t *current_cycle) {
     for (op = LIST_FIRST(&pending_ops); op != NULL; op = next_op) {
         // 提前保存下一个指针
         next_op = LIST_NEXT(op, entriess);
-        if(log_enable){
-            printf("[disk_update] current_cycle: %lu, op completion_time: %lu\n", *current_cycle, op->completion_time);
-        }
         if (!op->completed && *current_cycle >= op->completion_time) {
        //     printf("[DISK] Operation completed for desc %u\n", op->head_desc_idx);
             complete_disk_operation(op);
@@ -280,14 +303,17 @@ static void start_async_disk_operation(uint16_t head_desc_idx) {
     struct disk_operation *op = malloc(sizeof(struct disk_operation));
     op->head_desc_idx = head_desc_idx; //描述符链的头部索引 idx[0] 
 
-    // 👉 解析 desc[0]
-    uint64_t desc_base = dev.desc_addr + head_desc_idx * 16;
-
-    uint64_t req_addr = phys_read(desc_base + 0, 8);
+    // 👉 解析 desc[0]（可能是间接表，取展开后的第一段）
+    virtio_blk_seg req;
+    uint16_t next;
+    read_desc(dev.desc_addr + head_desc_idx * VRING_DESC_SIZE, &req, &next);
+    if ((req.flags & VRING_DESC_F_INDIRECT) && indirect_negotiated()) {
+        read_desc(req.addr, &req, &next);
+    }
 
     // 👉 解析 req
-    uint32_t type   = phys_read(req_addr + 0, 4);
-    uint64_t sector = phys_read(req_addr + 8, 8);
+    uint32_t type   = phys_read(req.addr + 0, 4);
+    uint64_t sector = phys_read(req.addr + 8, 8);
 
    // printf("[virtio] type=%d sector=%ld\n", type, sector);
     op->sector = sector;
@@ -313,11 +339,10 @@ static void process_queue() {
     
     uint16_t last_avail = get_avail_idx();
 
-    static uint16_t prev_avail = 0;
-   // printf("[virtio process] prev=%d last=%d\n", prev_avail, last_avail);
+   // printf("[virtio process] prev=%d last=%d\n", dev.last_avail_idx, last_avail);
 
-    while (prev_avail != last_avail) {
-        uint16_t avail_idx = prev_avail % dev.queue_num;
+    while (dev.last_avail_idx != last_avail) {
+        uint16_t avail_idx = dev.last_avail_idx % dev.queue_num;
        // uint16_t desc_idx = phys_read(dev.avail_ring + 4 + avail_idx * 2, 2);  // avail->ring[]
         uint16_t desc_idx = bus_read(&cpu[0].bus, dev.avail_ring + 4 + avail_idx * 2, 2);
         uint64_t addr = dev.avail_ring + 4 + avail_idx * 2;
@@ -325,7 +350,7 @@ static void process_queue() {
    //     printf("[virtio process] avail_idx=%d desc_idx=%d addr:0x%08lx\n",
    //            avail_idx, desc_idx, addr);
         start_async_disk_operation(desc_idx);
-        prev_avail++;
+        dev.last_avail_idx++;
     }
 }
 
@@ -335,9 +360,16 @@ uint32_t virtio_mmio_read(void *opaque,uint64_t offset,uint8_t size) {
         case 0x004: return 2;                     // Version (modern)
         case 0x008: return 2;                     // DeviceID (block)
         case 0x00c: return 0x554d4551;            // VendorID (QEMU)
-        case 0x010: return (1ULL << 5);           // DeviceFeatures (支持 RO 等)
-        case 0x014: return (1ULL << 5);           // DeviceFeaturesSel 用后返回
-        case 0x020: return 0;                     // DriverFeatures
+        case 0x010:                               // DeviceFeatures (按 DeviceFeaturesSel 选字)
+            if (dev.device_features_sel == 0)
+                return (1u << VIRTIO_BLK_F_RO) | (1u << VIRTIO_BLK_F_FLUSH) |
+                       (1u << VIRTIO_RING_F_INDIRECT_DESC);
+            if (dev.device_features_sel == 1)
+                return 1u << (VIRTIO_F_VERSION_1 - 32);
+            return 0;
+        case 0x014: return dev.device_features_sel; // DeviceFeaturesSel
+        case 0x020:                               // DriverFeatures
+            return (uint32_t)(dev.driver_features >> (32 * (dev.driver_features_sel & 1)));
         case 0x034: return 8;                     // QueueNumMax (xv6 用 8)
         case 0x044: return dev.queue_ready;       // QueueReady
         case 0x060: return dev.interrupt_status;                     // InterruptStatus (处理完后清0)
@@ -355,6 +387,19 @@ uint32_t virtio_mmio_read(void *opaque,uint64_t offset,uint8_t size) {
 void virtio_mmio_write(void *opaque,uint64_t offset, uint64_t value,uint8_t size) {
     switch (offset) {
 
+        case 0x014: // DeviceFeaturesSel
+            dev.device_features_sel = value;
+            break;
+        case 0x020: // DriverFeatures
+            if (dev.driver_features_sel == 0)
+                dev.driver_features = (dev.driver_features & ~0xffffffffULL) | (uint32_t)value;
+            else if (dev.driver_features_sel == 1)
+                dev.driver_features = (dev.driver_features & 0xffffffffULL) | ((uint64_t)(uint32_t)value << 32);
+            break;
+        case 0x024: // DriverFeaturesSel
+            dev.driver_features_sel = value;
+            break;
+
         case 0x030: // QueueSel
        //dev.queue_sel = value;
      //   printf("[virtio] select queue %d\n", value);
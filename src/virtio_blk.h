@@ -3,6 +3,8 @@
 #define VIRTIO_BLK_H
 
 #include "common.h"
+#include "disk_image.h"
+#include "block_cache.h"
 
 
 // 请求结构（guest -> device）
@@ -17,7 +19,8 @@ typedef struct {
 // 设备状态
 typedef struct {
     uint64_t disk_size_sectors;  // fs.img 大小 / 512
-    uint8_t *disk_data;          // 直接指向加载的 fs.img 内存（可选：也可以用文件）
+    DiskImage *disk;             // 磁盘后端（base mmap + 可选 overlay）
+    BlockCache *cache;           // 写回块缓存，位于 disk 之上
 
     // 队列相关（xv6 只用 queue 0）
     uint16_t queue_num;          // 驱动设置的队列大小（xv6 用 8）
@@ -25,11 +28,30 @@ typedef struct {
     uint64_t avail_ring;        // avail ring 物理地址
     uint64_t used_ring;        // used ring 物理地址
     uint16_t last_used_idx;      // 用于写入 used ring
+    uint16_t last_avail_idx;     // 设备已经取走的 avail 下标
     int queue_ready;             // 1 表示队列已就绪
     int status;
     int interrupt_status;
+
+    // 特性协商
+    uint32_t device_features_sel; // DeviceFeaturesSel 选择的 32 位字
+    uint32_t driver_features_sel; // DriverFeaturesSel 选择的 32 位字
+    uint64_t driver_features;     // 驱动确认的特性位
+
+    // 统计
+    uint64_t reqs_in, reqs_out, reqs_flush, reqs_err;
+    uint64_t bytes_in, bytes_out;
 } virtio_blk_device;
 
+// 一条请求展开后的描述符段（直接链 + 间接表统一处理）
+typedef struct {
+    uint64_t addr;   // 已翻译的物理地址
+    uint32_t len;
+    uint16_t flags;
+} virtio_blk_seg;
+
+#define VIRTIO_BLK_MAX_SEGS 256  // 单个请求最多的描述符段数（含间接表）
+
 
 
 
@@ -51,16 +73,8 @@ struct disk_operation {
 LIST_HEAD(disk_op_list, disk_operation);
 
 
-#define BSIZE 1024
-
-typedef struct {
-    uint64_t blockno;
-    uint8_t data[BSIZE];
-    int valid;
-} BlockCache;
-
-
-void virtio_blk_init(const char *disk_image_path);
+int virtio_blk_init(const char *disk_image_path, const char *overlay_path);
+void virtio_blk_close(void);
 uint32_t virtio_mmio_read(void *opaque,uint64_t offset,uint8_t size);
 void virtio_mmio_write(void *opaque,uint64_t offset, uint64_t value,uint8_t size) ;
 void virtio_blk_raise_interrupt(void);  
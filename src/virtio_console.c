@@ -0,0 +1,145 @@
+// virtio_console.c
+// virtio-console (virtio-mmio, modern, 单端口)
+//
+// 16550 每个字节一次 MMIO trap；这里客户机一次 QueueNotify 交过来整条 transmitq，
+// 所有可用链的内容拷进 UART 的 TX 环，由 UART 的 TX 线程攒批写出（CPU 线程不碰主机 fd），
+// 整批只更新一次 used->idx、只发一次中断。
+// 输入仍然走 UART（stdin 只有一个读者），receiveq 的缓冲区设备只持有不填充。
+#include "virtio_console.h"
+#include "plic.h"
+#include <sys/ioctl.h>
+
+VM_LOCAL virtio_console_device condev;
+
+static void process_tx(void) {
+    virtio_queue *q = &condev.vq[VIRTIO_CONSOLE_TX_QUEUE];
+    if (!q->ready || !q->num) return;
+
+    static VM_LOCAL virtq_seg segs[VIRTQ_MAX_SEGS];
+    uint16_t end = virtq_avail_idx(q);
+    int done = 0;
+
+    while (q->last_avail_idx != end) {
+        uint16_t head = virtq_avail_ring(q, q->last_avail_idx++);
+        int n = virtq_collect_chain(q, head, segs, VIRTQ_MAX_SEGS);
+        for (int i = 0; i < n; i++) {
+            if (segs[i].flags & VRING_DESC_F_WRITE || !segs[i].len) continue;
+            uint8_t *p = virtq_guest_ptr(segs[i].addr, segs[i].len);
+            if (!p) continue;
+            uart_tx_write(condev.uart, p, segs[i].len);
+            condev.tx_bytes += segs[i].len;
+        }
+        virtq_push_used(q, head, 0);
+        done++;
+    }
+
+    if (done) {
+        condev.tx_writes++;
+        condev.tx_chains += done;
+        virtq_publish_used(q);
+        condev.interrupt_status |= 1;
+        plic_set_irq(VIRTIO_CONSOLE_IRQ, 1);
+    }
+}
+
+uint64_t virtio_console_mmio_read(void *opaque, uint64_t offset, unsigned size) {
+    (void)opaque;
+    virtio_queue *q = &condev.vq[condev.queue_sel % VIRTIO_CONSOLE_NUM_QUEUES];
+
+    if (offset >= 0x100) {
+        // config space: cols(2) rows(2) max_nr_ports(4) emerg_wr(4)
+        uint8_t cfg[12] = {0};
+        memcpy(cfg + 0, &condev.cols, 2);
+        memcpy(cfg + 2, &condev.rows, 2);
+        cfg[4] = 1;
+        uint64_t v = 0;
+        uint64_t o = offset - 0x100;
+        for (unsigned i = 0; i < size && o + i < sizeof(cfg); i++)
+            v |= (uint64_t)cfg[o + i] << (8 * i);
+        return v;
+    }
+
+    uint32_t v;
+    if (virtq_mmio_read(q, offset, &v)) return v;
+
+    switch (offset) {
+        case 0x000: return 0x74726976;            // MagicValue
+        case 0x004: return 2;                     // Version (modern)
+        case 0x008: return 3;                     // DeviceID (console)
+        case 0x00c: return 0x554d4551;            // VendorID
+        case 0x010:                               // DeviceFeatures
+            if (condev.device_features_sel == 0)
+                return (1u << VIRTIO_CONSOLE_F_SIZE) | (1u << VIRTIO_CONSOLE_F_EMERG_WRITE);
+            if (condev.device_features_sel == 1)
+                return 1u << (VIRTIO_F_VERSION_1 - 32);
+            return 0;
+        case 0x014: return condev.device_features_sel;
+        case 0x020: return (uint32_t)(condev.driver_features >> (32 * (condev.driver_features_sel & 1)));
+        case 0x030: return condev.queue_sel;
+        case 0x034: return condev.queue_sel < VIRTIO_CONSOLE_NUM_QUEUES ? VIRTIO_CONSOLE_QUEUE_MAX : 0;
+        case 0x060: return condev.interrupt_status;
+        case 0x070: return condev.status;
+        case 0x0fc: return 0;                     // ConfigGeneration
+        default:    return 0;
+    }
+}
+
+void virtio_console_mmio_write(void *opaque, uint64_t offset, uint64_t value, unsigned size) {
+    (void)opaque;
+    virtio_queue *q = &condev.vq[condev.queue_sel % VIRTIO_CONSOLE_NUM_QUEUES];
+
+    if (offset == 0x108 && size >= 1) {
+        // emerg_wr：驱动就绪前的单字节早期输出
+        uint8_t c = value;
+        uart_tx_write(condev.uart, &c, 1);
+        return;
+    }
+    if (virtq_mmio_write(q, offset, value, VIRTIO_CONSOLE_QUEUE_MAX)) return;
+
+    switch (offset) {
+        case 0x014: condev.device_features_sel = value; break;
+        case 0x020:
+            if (condev.driver_features_sel == 0)
+                condev.driver_features = (condev.driver_features & ~0xffffffffULL) | (uint32_t)value;
+            else if (condev.driver_features_sel == 1)
+                condev.driver_features = (condev.driver_features & 0xffffffffULL) | ((uint64_t)(uint32_t)value << 32);
+            break;
+        case 0x024: condev.driver_features_sel = value; break;
+        case 0x030: condev.queue_sel = value; break;
+        case 0x050:                               // QueueNotify
+            if (value == VIRTIO_CONSOLE_TX_QUEUE) process_tx();
+            break;
+        case 0x064:                               // InterruptACK
+            condev.interrupt_status &= ~(uint32_t)value;
+            break;
+        case 0x070:
+            condev.status = value;
+            if (value == 0) {
+                memset(condev.vq, 0, sizeof(condev.vq));
+                condev.driver_features = 0;
+                condev.interrupt_status = 0;
+            }
+            break;
+        default: break;
+    }
+}
+
+void virtio_console_init(UARTDevice *uart) {
+    memset(&condev, 0, sizeof(condev));
+    condev.uart = uart;
+    condev.cols = 80;
+    condev.rows = 25;
+
+    struct winsize ws;
+    int fd = uart->chr.out_fd;
+    if (fd >= 0 && isatty(fd) && ioctl(fd, TIOCGWINSZ, &ws) == 0 && ws.ws_col) {
+        condev.cols = ws.ws_col;
+        condev.rows = ws.ws_row;
+    }
+}
+
+void virtio_console_close(void) {
+    if (condev.tx_chains)
+        fprintf(stderr, "[console] %lu bytes in %lu buffers, %lu batches\n",
+                condev.tx_bytes, condev.tx_chains, condev.tx_writes);
+}
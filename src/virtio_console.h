@@ -0,0 +1,41 @@
+// virtio_console.h
+#ifndef VIRTIO_CONSOLE_H
+#define VIRTIO_CONSOLE_H
+
+#include "common.h"
+#include "virtio_queue.h"
+#include "uart.h"
+
+#define VIRTIO_CONSOLE_NUM_QUEUES 2      // port 0: 0 = receiveq, 1 = transmitq
+#define VIRTIO_CONSOLE_RX_QUEUE   0
+#define VIRTIO_CONSOLE_TX_QUEUE   1
+#define VIRTIO_CONSOLE_QUEUE_MAX  256
+
+typedef struct {
+    int status;
+    uint32_t interrupt_status;
+
+    uint32_t device_features_sel;
+    uint32_t driver_features_sel;
+    uint64_t driver_features;
+
+    uint32_t queue_sel;
+    virtio_queue vq[VIRTIO_CONSOLE_NUM_QUEUES];
+
+    UARTDevice *uart;       // 输出经过 UART 的 TX 环和 TX 线程，后端和串口共用（见 char_backend.h）
+    uint16_t cols, rows;
+
+    // 统计
+    uint64_t tx_bytes;
+    uint64_t tx_chains;
+    uint64_t tx_writes;     // 交给 TX 环的批数（每次 QueueNotify 一批）
+} virtio_console_device;
+
+void virtio_console_init(UARTDevice *uart);
+void virtio_console_close(void);
+uint64_t virtio_console_mmio_read(void *opaque, uint64_t offset, unsigned size);
+void virtio_console_mmio_write(void *opaque, uint64_t offset, uint64_t value, unsigned size);
+
+extern VM_LOCAL virtio_console_device condev;
+
+#endif
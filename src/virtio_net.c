@@ -0,0 +1,348 @@
+// virtio_net.c
+// virtio-net (virtio-mmio, modern)：queue 0 接收，queue 1 发送
+//
+// 接收线程只负责从后端读帧放进 rxq，客户机内存只在 CPU 线程里访问：
+// virtio_net_update 一次把 rxq 里能放下的帧全部投递，整批只更新一次 used->idx、只发一次中断；
+// 发送在 QueueNotify 时把 avail 里所有链一次取完，同样整批完成。
+#include "virtio_net.h"
+#include "plic.h"
+#include <poll.h>
+#include <stddef.h>
+
+virtio_net_device netdev;
+
+static int has_feature(int bit) {
+    return (netdev.driver_features >> bit) & 1;
+}
+
+static uint32_t hdr_size(void) {
+    // legacy 且未协商 MRG_RXBUF 时没有 num_buffers 字段
+    if (has_feature(VIRTIO_F_VERSION_1) || has_feature(VIRTIO_NET_F_MRG_RXBUF))
+        return sizeof(virtio_net_hdr);
+    return sizeof(virtio_net_hdr) - sizeof(uint16_t);
+}
+
+static void publish_used(virtio_queue *q) {
+    virtq_publish_used(q);
+    netdev.interrupt_status |= 1;
+    plic_set_irq(VIRTIO_NET_IRQ, 1);
+}
+
+/* ---------------- 发送 ---------------- */
+
+static void process_tx(void) {
+    virtio_queue *q = &netdev.vq[VIRTIO_NET_TX_QUEUE];
+    if (!q->ready || !q->num) return;
+
+    static virtq_seg segs[VIRTQ_MAX_SEGS];
+    struct iovec iov[VIRTQ_MAX_SEGS];
+    uint16_t end = virtq_avail_idx(q);
+    int done = 0;
+
+    while (q->last_avail_idx != end) {
+        uint16_t head = virtq_avail_ring(q, q->last_avail_idx++);
+        int n = virtq_collect_chain(q, head, segs, VIRTQ_MAX_SEGS);
+
+        // 去掉开头的 virtio_net_hdr，剩下的段直接交给 writev/sendmsg，不做拷贝
+        uint32_t skip = hdr_size();
+        uint64_t frame = 0;
+        int iovcnt = 0;
+        for (int i = 0; i < n; i++) {
+            uint64_t addr = segs[i].addr;
+            uint32_t len = segs[i].len;
+            if (skip) {
+                uint32_t s = len < skip ? len : skip;
+                addr += s;
+                len -= s;
+                skip -= s;
+            }
+            if (!len) continue;
+            uint8_t *p = virtq_guest_ptr(addr, len);
+            if (!p) {
+                iovcnt = 0;
+                break;
+            }
+            iov[iovcnt].iov_base = p;
+            iov[iovcnt].iov_len = len;
+            iovcnt++;
+            frame += len;
+        }
+
+        if (iovcnt > 0 && net_backend_send(&netdev.backend, iov, iovcnt) > 0) {
+            netdev.tx_packets++;
+            netdev.tx_bytes += frame;
+        } else {
+            netdev.tx_dropped++;
+        }
+        virtq_push_used(q, head, 0);
+        done++;
+    }
+
+    if (done) {
+        netdev.tx_batches++;
+        publish_used(q);
+    }
+}
+
+/* ---------------- 接收 ---------------- */
+
+// 把一个帧写进客户机的接收缓冲区。
+// 协商了 MRG_RXBUF 时可以跨多条链，否则必须放进一条链。
+// 可用缓冲区不够时返回 0，帧留在 rxq 里等驱动补充缓冲区。
+static int deliver_frame(virtio_net_pkt *pkt) {
+    virtio_queue *q = &netdev.vq[VIRTIO_NET_RX_QUEUE];
+    static virtq_seg segs[VIRTQ_MAX_SEGS];
+    uint16_t heads[VIRTQ_MAX_SEGS];
+    uint32_t used_len[VIRTQ_MAX_SEGS];
+    int nchains = 0;
+
+    uint16_t end = virtq_avail_idx(q);
+    uint16_t idx = q->last_avail_idx;
+    uint32_t hlen = hdr_size();
+    uint32_t total = hlen + pkt->len;
+    uint32_t off = 0;   // 已写入的字节数（含头）
+    int mrg = has_feature(VIRTIO_NET_F_MRG_RXBUF);
+
+    virtio_net_hdr hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    uint32_t nb_pos = hlen == sizeof(virtio_net_hdr) ? offsetof(virtio_net_hdr, num_buffers) : UINT32_MAX - 1;
+    uint8_t *nb_lo = NULL, *nb_hi = NULL;
+
+    while (off < total) {
+        if (idx == end || nchains == VIRTQ_MAX_SEGS) return 0;
+        uint16_t head = virtq_avail_ring(q, idx++);
+        int n = virtq_collect_chain(q, head, segs, VIRTQ_MAX_SEGS);
+        if (n < 0) return 0;
+
+        uint32_t chain_start = off;
+        for (int i = 0; i < n && off < total; i++) {
+            if (!(segs[i].flags & VRING_DESC_F_WRITE)) continue;
+            uint32_t chunk = segs[i].len;
+            if (chunk > total - off) chunk = total - off;
+            uint8_t *p = virtq_guest_wptr(segs[i].addr, chunk);
+            if (!p) return 0;
+            // 头部占据逻辑流的前 hlen 字节
+            for (uint32_t k = 0; k < chunk; k++, off++) {
+                if (off < hlen) {
+                    p[k] = ((uint8_t *)&hdr)[off];
+                    if (off == nb_pos) nb_lo = &p[k];
+                    if (off == nb_pos + 1) nb_hi = &p[k];
+                } else {
+                    p[k] = pkt->data[off - hlen];
+                }
+            }
+        }
+        heads[nchains] = head;
+        used_len[nchains] = off - chain_start;
+        nchains++;
+
+        if (!mrg && off < total) {
+            // 单条链放不下，截断（驱动给的缓冲区比 MTU 小）
+            netdev.rx_dropped++;
+            break;
+        }
+    }
+
+    // num_buffers 在第一条链的头部里，链数确定后回填
+    if (nb_lo) *nb_lo = nchains & 0xff;
+    if (nb_hi) *nb_hi = nchains >> 8;
+
+    for (int i = 0; i < nchains; i++) virtq_push_used(q, heads[i], used_len[i]);
+    q->last_avail_idx = idx;
+    netdev.rx_packets++;
+    netdev.rx_bytes += pkt->len;
+    return 1;
+}
+
+// CPU 线程每步调用：没有待投递的帧时只有一次读
+void virtio_net_update(void) {
+    if (!__atomic_load_n(&netdev.rxq_count, __ATOMIC_ACQUIRE)) return;
+
+    virtio_queue *q = &netdev.vq[VIRTIO_NET_RX_QUEUE];
+    if (!q->ready || !q->num || !(netdev.status & 0x4)) return;   // DRIVER_OK
+    if (netdev.rx_replay) return;
+
+    int done = 0;
+    pthread_mutex_lock(&netdev.rxq_lock);
+    while (netdev.rxq_count) {
+        if (!deliver_frame(&netdev.rxq[netdev.rxq_tail])) break;
+        if (netdev.rx_record) netdev.rx_record(netdev.rxq[netdev.rxq_tail].data, netdev.rxq[netdev.rxq_tail].len);
+        netdev.rxq_tail = (netdev.rxq_tail + 1) % VIRTIO_NET_RXQ_DEPTH;
+        __atomic_store_n(&netdev.rxq_count, netdev.rxq_count - 1, __ATOMIC_RELEASE);
+        done++;
+    }
+    pthread_mutex_unlock(&netdev.rxq_lock);
+
+    if (done) {
+        netdev.rx_batches++;
+        publish_used(q);
+    }
+}
+
+// 回放：同一时刻的帧逐个注入，最后 virtio_net_rx_publish 一次，和录制时的整批投递一致
+int virtio_net_rx_inject(const uint8_t *data, uint32_t len) {
+    static virtio_net_pkt pkt;
+    virtio_queue *q = &netdev.vq[VIRTIO_NET_RX_QUEUE];
+    if (!q->ready || !q->num || len > sizeof(pkt.data)) return 0;
+    pkt.len = len;
+    memcpy(pkt.data, data, len);
+    return deliver_frame(&pkt);
+}
+
+void virtio_net_rx_publish(void) {
+    netdev.rx_batches++;
+    publish_used(&netdev.vq[VIRTIO_NET_RX_QUEUE]);
+}
+
+static void *net_rx_thread(void *arg) {
+    virtio_net_device *nd = arg;
+    uint8_t buf[VIRTIO_NET_MAX_FRAME];
+
+    if (net_backend_wait_ready(&nd->backend, &nd->running) < 0) return NULL;
+
+    struct pollfd pfd = { .fd = nd->backend.fd, .events = POLLIN };
+    while (nd->running) {
+        // 带超时的 poll，关闭时不需要额外唤醒手段
+        if (poll(&pfd, 1, 100) <= 0) continue;
+        ssize_t n = net_backend_recv(&nd->backend, buf, sizeof(buf));
+        if (n == 0) {
+            printf("[net] peer closed\n");
+            break;
+        }
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            perror("[net] recv");
+            break;
+        }
+
+        pthread_mutex_lock(&nd->rxq_lock);
+        if (nd->rxq_count == VIRTIO_NET_RXQ_DEPTH) {
+            nd->rx_dropped++;   // 客户机来不及收，和真实网卡一样丢帧
+        } else {
+            virtio_net_pkt *pkt = &nd->rxq[nd->rxq_head];
+            pkt->len = n;
+            memcpy(pkt->data, buf, n);
+            nd->rxq_head = (nd->rxq_head + 1) % VIRTIO_NET_RXQ_DEPTH;
+            __atomic_store_n(&nd->rxq_count, nd->rxq_count + 1, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&nd->rxq_lock);
+    }
+    return NULL;
+}
+
+/* ---------------- MMIO ---------------- */
+
+uint64_t virtio_net_mmio_read(void *opaque, uint64_t offset, unsigned size) {
+    (void)opaque;
+    virtio_queue *q = &netdev.vq[netdev.queue_sel % VIRTIO_NET_NUM_QUEUES];
+
+    if (offset >= 0x100) {
+        // config space: mac[6] + status(2)
+        uint8_t cfg[8];
+        memcpy(cfg, netdev.mac, 6);
+        cfg[6] = VIRTIO_NET_S_LINK_UP;
+        cfg[7] = 0;
+        uint64_t v = 0;
+        uint64_t o = offset - 0x100;
+        for (unsigned i = 0; i < size && o + i < sizeof(cfg); i++)
+            v |= (uint64_t)cfg[o + i] << (8 * i);
+        return v;
+    }
+
+    uint32_t v;
+    if (virtq_mmio_read(q, offset, &v)) return v;
+
+    switch (offset) {
+        case 0x000: return 0x74726976;            // MagicValue
+        case 0x004: return 2;                     // Version (modern)
+        case 0x008: return 1;                     // DeviceID (network)
+        case 0x00c: return 0x554d4551;            // VendorID
+        case 0x010:                               // DeviceFeatures
+            if (netdev.device_features_sel == 0)
+                return (1u << VIRTIO_NET_F_MAC) | (1u << VIRTIO_NET_F_MRG_RXBUF) |
+                       (1u << VIRTIO_NET_F_STATUS);
+            if (netdev.device_features_sel == 1)
+                return 1u << (VIRTIO_F_VERSION_1 - 32);
+            return 0;
+        case 0x014: return netdev.device_features_sel;
+        case 0x020: return (uint32_t)(netdev.driver_features >> (32 * (netdev.driver_features_sel & 1)));
+        case 0x030: return netdev.queue_sel;
+        case 0x034: return netdev.queue_sel < VIRTIO_NET_NUM_QUEUES ? VIRTIO_NET_QUEUE_MAX : 0;
+        case 0x060: return netdev.interrupt_status;
+        case 0x070: return netdev.status;
+        case 0x0fc: return 0;                     // ConfigGeneration
+        default:    return 0;
+    }
+}
+
+void virtio_net_mmio_write(void *opaque, uint64_t offset, uint64_t value, unsigned size) {
+    (void)opaque;
+    (void)size;
+    virtio_queue *q = &netdev.vq[netdev.queue_sel % VIRTIO_NET_NUM_QUEUES];
+    if (virtq_mmio_write(q, offset, value, VIRTIO_NET_QUEUE_MAX)) return;
+
+    switch (offset) {
+        case 0x014: netdev.device_features_sel = value; break;
+        case 0x020:
+            if (netdev.driver_features_sel == 0)
+                netdev.driver_features = (netdev.driver_features & ~0xffffffffULL) | (uint32_t)value;
+            else if (netdev.driver_features_sel == 1)
+                netdev.driver_features = (netdev.driver_features & 0xffffffffULL) | ((uint64_t)(uint32_t)value << 32);
+            break;
+        case 0x024: netdev.driver_features_sel = value; break;
+        case 0x030: netdev.queue_sel = value; break;
+        case 0x050:                               // QueueNotify
+            if (value == VIRTIO_NET_TX_QUEUE) process_tx();
+            else if (value == VIRTIO_NET_RX_QUEUE) virtio_net_update();  // 新的接收缓冲区
+            break;
+        case 0x064:                               // InterruptACK
+            netdev.interrupt_status &= ~(uint32_t)value;
+            break;
+        case 0x070:
+            netdev.status = value;
+            if (value == 0) {
+                // 设备复位
+                memset(netdev.vq, 0, sizeof(netdev.vq));
+                netdev.driver_features = 0;
+                netdev.interrupt_status = 0;
+            }
+            break;
+        default: break;
+    }
+}
+
+/* ---------------- 初始化 ---------------- */
+
+int virtio_net_init(const char *backend_spec) {
+    memset(&netdev, 0, sizeof(netdev));
+    pthread_mutex_init(&netdev.rxq_lock, NULL);
+
+    // 本地管理的单播 MAC，低字节用 pid 区分同一主机上的多个实例
+    pid_t pid = getpid();
+    uint8_t mac[6] = { 0x52, 0x54, 0x00, 0x12, (uint8_t)(pid >> 8), (uint8_t)pid };
+    memcpy(netdev.mac, mac, 6);
+
+    if (net_backend_open(&netdev.backend, backend_spec) < 0) return -1;
+
+    netdev.running = true;
+    if (pthread_create(&netdev.rx_thread, NULL, net_rx_thread, &netdev) != 0) {
+        perror("[net] rx thread");
+        netdev.running = false;
+        net_backend_close(&netdev.backend);
+        return -1;
+    }
+    printf("[net] virtio-net at 0x%llx, mac %02x:%02x:%02x:%02x:%02x:%02x\n",
+           VIRTIO_NET_BASE, mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    return 0;
+}
+
+void virtio_net_close(void) {
+    if (!netdev.running) return;
+    netdev.running = false;
+    pthread_join(netdev.rx_thread, NULL);
+    net_backend_close(&netdev.backend);
+    printf("[net] rx %lu pkts/%lu bytes (%lu dropped, %lu batches), tx %lu pkts/%lu bytes (%lu dropped, %lu batches)\n",
+           netdev.rx_packets, netdev.rx_bytes, netdev.rx_dropped, netdev.rx_batches,
+           netdev.tx_packets, netdev.tx_bytes, netdev.tx_dropped, netdev.tx_batches);
+    pthread_mutex_destroy(&netdev.rxq_lock);
+}
@@ -0,0 +1,76 @@
+// virtio_net.h
+#ifndef VIRTIO_NET_H
+#define VIRTIO_NET_H
+
+#include "common.h"
+#include "net_backend.h"
+#include "virtio_queue.h"
+
+#define VIRTIO_NET_NUM_QUEUES 2      // 0 = receiveq, 1 = transmitq
+#define VIRTIO_NET_RX_QUEUE   0
+#define VIRTIO_NET_TX_QUEUE   1
+#define VIRTIO_NET_QUEUE_MAX  256    // QueueNumMax
+
+#define VIRTIO_NET_MAX_FRAME  1518   // 未协商 GSO，帧不超过以太网 MTU
+#define VIRTIO_NET_RXQ_DEPTH  256    // 主机侧待投递帧队列深度
+
+// virtio_net_hdr（VERSION_1 / MRG_RXBUF 时带 num_buffers，共 12 字节）
+typedef struct {
+    uint8_t  flags;
+    uint8_t  gso_type;
+    uint16_t hdr_len;
+    uint16_t gso_size;
+    uint16_t csum_start;
+    uint16_t csum_offset;
+    uint16_t num_buffers;
+} __attribute__((packed)) virtio_net_hdr;
+
+typedef struct {
+    uint16_t len;
+    uint8_t data[VIRTIO_NET_MAX_FRAME];
+} virtio_net_pkt;
+
+typedef struct {
+    uint8_t mac[6];
+    int status;
+    uint32_t interrupt_status;
+
+    uint32_t device_features_sel;
+    uint32_t driver_features_sel;
+    uint64_t driver_features;
+
+    uint32_t queue_sel;
+    virtio_queue vq[VIRTIO_NET_NUM_QUEUES];
+
+    NetBackend backend;
+    bool running;
+    pthread_t rx_thread;
+
+    // 接收线程 -> CPU 线程的帧队列，CPU 线程在 virtio_net_update 里批量投递
+    virtio_net_pkt rxq[VIRTIO_NET_RXQ_DEPTH];
+    uint32_t rxq_head, rxq_tail;
+    uint32_t rxq_count;
+    pthread_mutex_t rxq_lock;
+
+    // 录制 / 回放（replay.h）：rx_record 非空时每投递一帧回调一次；
+    // rx_replay 时不投递 rxq 里的帧，由 virtio_net_rx_inject 按日志注入
+    void (*rx_record)(const uint8_t *data, uint32_t len);
+    bool rx_replay;
+
+    // 统计
+    uint64_t rx_packets, rx_bytes, rx_dropped;
+    uint64_t tx_packets, tx_bytes, tx_dropped;
+    uint64_t rx_batches, tx_batches;   // 每批一次中断
+} virtio_net_device;
+
+int virtio_net_init(const char *backend_spec);
+void virtio_net_close(void);
+uint64_t virtio_net_mmio_read(void *opaque, uint64_t offset, unsigned size);
+void virtio_net_mmio_write(void *opaque, uint64_t offset, uint64_t value, unsigned size);
+void virtio_net_update(void);
+int virtio_net_rx_inject(const uint8_t *data, uint32_t len);
+void virtio_net_rx_publish(void);
+
+extern virtio_net_device netdev;
+
+#endif
@@ -0,0 +1,108 @@
+// virtio_queue.c
+#include "virtio_queue.h"
+#include "memory.h"
+
+extern VM_LOCAL uint8_t* memory;
+
+uint8_t *virtq_guest_ptr(uint64_t pa, uint64_t len) {
+    if (pa < MEMORY_BASE || len > MEMORY_SIZE || pa - MEMORY_BASE > MEMORY_SIZE - len) {
+        fprintf(stderr, "[virtq] guest buffer 0x%lx+%lu out of DRAM range\n", pa, len);
+        return NULL;
+    }
+    return &memory[pa - MEMORY_BASE];
+}
+
+// 设备要往里写的缓冲区：同 virtq_guest_ptr，另外记脏页
+uint8_t *virtq_guest_wptr(uint64_t pa, uint64_t len) {
+    uint8_t *p = virtq_guest_ptr(pa, len);
+    if (p) ram_mark_dirty(pa - MEMORY_BASE, len);
+    return p;
+}
+
+static uint64_t guest_read(uint64_t pa, int size) {
+    uint64_t v = 0;
+    uint8_t *p = virtq_guest_ptr(pa, size);
+    if (p) memcpy(&v, p, size);
+    return v;
+}
+
+static void guest_write(uint64_t pa, uint64_t v, int size) {
+    uint8_t *p = virtq_guest_wptr(pa, size);
+    if (p) memcpy(p, &v, size);
+}
+
+uint16_t virtq_avail_idx(virtio_queue *q) {
+    return guest_read(q->avail + 2, 2);
+}
+
+uint16_t virtq_avail_ring(virtio_queue *q, uint16_t i) {
+    return guest_read(q->avail + 4 + (i % q->num) * 2, 2);
+}
+
+// 展开一条直接描述符链，返回段数，出错返回 -1
+int virtq_collect_chain(virtio_queue *q, uint16_t head, virtq_seg *segs, int max) {
+    uint16_t idx = head;
+    int n = 0;
+    while (1) {
+        if (idx >= q->num || n >= max) {
+            fprintf(stderr, "[virtq] bad descriptor chain at %u\n", head);
+            return -1;
+        }
+        uint64_t d = q->desc + (uint64_t)idx * VRING_DESC_SIZE;
+        segs[n].addr  = guest_read(d, 8);
+        segs[n].len   = guest_read(d + 8, 4);
+        segs[n].flags = guest_read(d + 12, 2);
+        uint16_t next = guest_read(d + 14, 2);
+        n++;
+        if (!(segs[n - 1].flags & VRING_DESC_F_NEXT)) break;
+        idx = next;
+    }
+    return n;
+}
+
+// 只写 used 元素，used->idx 由 virtq_publish_used 在一批结束后统一更新
+void virtq_push_used(virtio_queue *q, uint16_t head, uint32_t len) {
+    uint64_t e = q->used + 4 + (q->used_idx % q->num) * 8;
+    guest_write(e, head, 4);
+    guest_write(e + 4, len, 4);
+    q->used_idx++;
+}
+
+void virtq_publish_used(virtio_queue *q) {
+    guest_write(q->used + 2, q->used_idx, 2);
+}
+
+int virtq_mmio_read(virtio_queue *q, uint64_t offset, uint32_t *value) {
+    switch (offset) {
+        case 0x038: *value = q->num; break;
+        case 0x044: *value = q->ready; break;
+        case 0x080: *value = q->desc & 0xffffffffULL; break;
+        case 0x084: *value = q->desc >> 32; break;
+        case 0x090: *value = q->avail & 0xffffffffULL; break;
+        case 0x094: *value = q->avail >> 32; break;
+        case 0x0a0: *value = q->used & 0xffffffffULL; break;
+        case 0x0a4: *value = q->used >> 32; break;
+        default: return 0;
+    }
+    return 1;
+}
+
+static void set_lo(uint64_t *r, uint32_t v) { *r = (*r & ~0xffffffffULL) | v; }
+static void set_hi(uint64_t *r, uint32_t v) { *r = (*r & 0xffffffffULL) | ((uint64_t)v << 32); }
+
+int virtq_mmio_write(virtio_queue *q, uint64_t offset, uint32_t value, uint32_t num_max) {
+    switch (offset) {
+        case 0x038:
+            if (value <= num_max) q->num = value;
+            break;
+        case 0x044: q->ready = value & 1; break;
+        case 0x080: set_lo(&q->desc, value); break;
+        case 0x084: set_hi(&q->desc, value); break;
+        case 0x090: set_lo(&q->avail, value); break;
+        case 0x094: set_hi(&q->avail, value); break;
+        case 0x0a0: set_lo(&q->used, value); break;
+        case 0x0a4: set_hi(&q->used, value); break;
+        default: return 0;
+    }
+    return 1;
+}
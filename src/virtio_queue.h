@@ -0,0 +1,43 @@
+// virtio_queue.h
+#ifndef VIRTIO_QUEUE_H
+#define VIRTIO_QUEUE_H
+
+#include "common.h"
+
+/*
+ * split virtqueue 的设备侧公共部分（virtio-net / virtio-console 共用）
+ *
+ * 描述符、avail、used 都按客户机物理地址访问，只能在 CPU 线程里调用。
+ */
+
+#define VIRTQ_MAX_SEGS 64   // 单个描述符链最多的段数
+
+typedef struct {
+    uint32_t num;
+    uint64_t desc;
+    uint64_t avail;
+    uint64_t used;
+    int ready;
+    uint16_t last_avail_idx;    // 设备已经取走的 avail 下标
+    uint16_t used_idx;
+} virtio_queue;
+
+typedef struct {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+} virtq_seg;
+
+uint8_t *virtq_guest_ptr(uint64_t pa, uint64_t len);
+uint8_t *virtq_guest_wptr(uint64_t pa, uint64_t len);
+uint16_t virtq_avail_idx(virtio_queue *q);
+uint16_t virtq_avail_ring(virtio_queue *q, uint16_t i);
+int virtq_collect_chain(virtio_queue *q, uint16_t head, virtq_seg *segs, int max);
+void virtq_push_used(virtio_queue *q, uint16_t head, uint32_t len);
+void virtq_publish_used(virtio_queue *q);
+
+// virtio-mmio 中与队列相关的寄存器（QueueNum/Ready/Desc/Driver/Device），处理了返回 1
+int virtq_mmio_read(virtio_queue *q, uint64_t offset, uint32_t *value);
+int virtq_mmio_write(virtio_queue *q, uint64_t offset, uint32_t value, uint32_t num_max);
+
+#endif
@@ -0,0 +1,161 @@
+// vmfork.c
+// 到达分叉点后 fork 出多个 VM 克隆，见 vmfork.h
+#include "vmfork.h"
+#include "cpu.h"
+#include "uart.h"
+#include "virtio_blk.h"
+#include "virtio_net.h"
+#include "block_cache.h"
+#include "stats.h"
+#include "trace.h"
+#include "profiler.h"
+#include "instmix.h"
+#include <sys/wait.h>
+
+extern VM_LOCAL CPU_State cpu[MAX_CORES];
+extern VM_LOCAL virtio_blk_device dev;
+
+VM_LOCAL int vmfork_pending;
+bool vmfork_ebreak_armed;
+VM_LOCAL int vmctl_exit_code;
+VM_LOCAL uint64_t vmctl_marker_value;
+VM_LOCAL uint32_t vmctl_input_len;
+
+static struct {
+    int nclones;
+    int jobs;
+    int clone_id;           // 0 = 父进程 / 没有分叉
+    const char *serial;     // 含 %d 的串口后端
+    UARTDevice *uart;
+} vf;
+
+int vmfork_init(const char *nclones_spec, UARTDevice *uart) {
+    vf.uart = uart;
+    if (!nclones_spec) return 0;
+    vf.nclones = atoi(nclones_spec);
+    if (vf.nclones <= 0) {
+        fprintf(stderr, "[fork] bad RVEMU_FORK '%s'\n", nclones_spec);
+        return -1;
+    }
+    if (dev.disk && dev.disk->overlay_fd >= 0) {
+        fprintf(stderr, "[fork] clones need a raw disk, unset RVEMU_DISK_OVERLAY\n");
+        return -1;
+    }
+    if (netdev.running) {
+        fprintf(stderr, "[fork] cannot clone with virtio-net attached, unset RVEMU_NET\n");
+        return -1;
+    }
+
+    const char *jobs = getenv("RVEMU_FORK_JOBS");
+    vf.jobs = jobs && atoi(jobs) > 0 ? atoi(jobs) : vf.nclones;
+    vf.serial = getenv("RVEMU_FORK_SERIAL");
+    if (!vf.serial) vf.serial = "file:clone-%d.log";
+
+    const char *at = getenv("RVEMU_FORK_AT");
+    if (at && strcmp(at, "ebreak") == 0) {
+        vmfork_ebreak_armed = true;
+    } else if (at && strcmp(at, "mmio") != 0) {
+        fprintf(stderr, "[fork] bad RVEMU_FORK_AT '%s' (want mmio or ebreak)\n", at);
+        return -1;
+    }
+    printf("[fork] %d clones at %s marker, %d at a time\n",
+           vf.nclones, vmfork_ebreak_armed ? "ebreak" : "mmio", vf.jobs);
+    return 0;
+}
+
+// 子进程：重新起主机侧线程，串口换成自己的后端，输出文件加上编号
+static void clone_start(int id, int wb_ms) {
+    vf.clone_id = id;
+    vmfork_ebreak_armed = false;
+    stats_set_clone(id);
+    trace_set_clone(id);
+    prof_set_clone(id);
+    instmix_set_clone(id);
+
+    char spec[512];
+    snprintf(spec, sizeof(spec), vf.serial, id);
+    if (vf.uart && uart_resume(vf.uart, spec) < 0) _exit(125);
+    if (dev.disk) dev.cache = block_cache_create(dev.disk, wb_ms);
+}
+
+int vmfork_run(void) {
+    vmfork_pending = 0;
+    if (!vf.nclones || vf.clone_id) return -1;   // 没打开克隆，或者已经在子进程里
+    vmfork_ebreak_armed = false;
+
+    // 停掉所有主机线程：fork 只复制当前线程，别的线程拿着的锁在子进程里永远不会释放
+    if (vf.uart) uart_pause(vf.uart);
+    int wb_ms = dev.cache ? dev.cache->wb_interval_ms : 0;
+    if (dev.cache) {
+        block_cache_destroy(dev.cache);   // 脏块写进 raw 镜像的私有映射，随 fork 一起共享
+        dev.cache = NULL;
+    }
+    printf("[fork] marker reached at pc=0x%lx after %lu instructions\n", cpu[0].pc, cpu[0].inst_count);
+    fflush(NULL);   // 否则缓冲里的输出每个子进程都会再写一遍
+    pid_t *pids = calloc(vf.nclones + 1, sizeof(pid_t));
+    int next = 1, running = 0, failed = 0;
+    while (next <= vf.nclones || running > 0) {
+        if (next <= vf.nclones && running < vf.jobs) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                free(pids);
+                clone_start(next, wb_ms);
+                return -1;
+            }
+            if (pid < 0) {
+                perror("[fork] fork");
+                failed++;
+            } else {
+                pids[next] = pid;
+                running++;
+            }
+            next++;
+            continue;
+        }
+
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0) break;
+        running--;
+        int id = 0;
+        for (int i = 1; i <= vf.nclones; i++)
+            if (pids[i] == pid) id = i;
+        int code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        if (code) failed++;
+        fprintf(stderr, "[fork] clone %d (pid %d) exited with %d\n", id, pid, code);
+    }
+    free(pids);
+
+    fprintf(stderr, "[fork] %d clones: %d passed, %d failed\n", vf.nclones, vf.nclones - failed, failed);
+    // 串口线程重新起起来，调用方照常走 uart_destroy 收尾
+    if (vf.uart) uart_resume(vf.uart, NULL);
+    return failed ? 1 : 0;
+}
+
+uint64_t vmctl_read(void *opaque, uint64_t offset, unsigned size) {
+    (void)opaque;
+    (void)size;
+    switch (offset) {
+        case VMCTL_CLONE_ID: return vf.clone_id;
+        case VMCTL_NCLONES:  return vf.nclones;
+        case VMCTL_INPUT_LEN: return vmctl_input_len;
+        default:             return 0;
+    }
+}
+
+void vmctl_write(void *opaque, uint64_t offset, uint64_t value, unsigned size) {
+    (void)opaque;
+    (void)size;
+    switch (offset) {
+        case VMCTL_MARKER:
+            vmctl_marker_value = value;
+            vmfork_pending = 1;
+            break;
+        case VMCTL_EXIT:
+            vmctl_exit_code = value & 0xff;
+            cpu[0].running = false;
+            break;
+        default:
+            break;
+    }
+}
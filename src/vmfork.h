@@ -0,0 +1,57 @@
+// vmfork.h
+#ifndef VMFORK_H
+#define VMFORK_H
+
+#include "common.h"
+
+/*
+ * fork() 克隆 VM
+ *
+ * 客户机跑到分叉点（写 VMCTL 的 MARKER，或 RVEMU_FORK_AT=ebreak 时执行 ebreak）后，模拟器 fork 出
+ * N 个子进程，各自从同一状态接着跑。客户机内存和 raw 磁盘的私有映射由主机内核写时复制共享，
+ * 每个克隆只为自己改过的页付出内存。子进程读 CLONE_ID 得到编号（1..N）挑不同的输入 / 用例，
+ * 写 EXIT 结束并给出退出码。父进程不再运行客户机，等所有子进程退出后汇总，有失败时状态为 1。
+ * 子进程的 stats / trace / profile / instmix 输出路径加上 .clone-<id> 后缀，互不覆盖。
+ *
+ * 控制设备（VMCTL_BASE，不克隆时也能用 EXIT 结束模拟并设置退出码）：
+ *   0x00 MARKER    W  到达分叉点（模糊测试时是快照点，写入的值为输入缓冲区的物理地址）
+ *   0x04 CLONE_ID  R  0 = 没有分叉，1..N = 子进程编号
+ *   0x08 NCLONES   R  RVEMU_FORK 的值
+ *   0x0c EXIT      W  结束模拟，低 8 位为进程退出码（模糊测试时结束这一轮）
+ *   0x10 INPUT_LEN R  模糊测试本轮输入的长度（见 fuzz.h）
+ *
+ *   RVEMU_FORK=<N>               子进程个数
+ *   RVEMU_FORK_AT=mmio|ebreak    分叉点，默认 mmio
+ *   RVEMU_FORK_JOBS=<M>          同时运行的子进程上限，默认 N
+ *   RVEMU_FORK_SERIAL=<spec>     子进程的串口后端，%d 换成编号，默认 file:clone-%d.log
+ *
+ * 只支持 raw 磁盘：overlay 的索引和数据文件是 MAP_SHARED / 共享 fd，克隆之间会互相覆盖。
+ * virtio-net 的后端连接没法复制，打开网络时不能克隆。
+ */
+
+#define VMCTL_MARKER    0x00
+#define VMCTL_CLONE_ID  0x04
+#define VMCTL_NCLONES   0x08
+#define VMCTL_EXIT      0x0c
+#define VMCTL_INPUT_LEN 0x10
+
+extern VM_LOCAL int vmfork_pending;          // 到达分叉点，主循环里处理（MMIO 回调里不能 fork）
+extern bool vmfork_ebreak_armed;    // RVEMU_FORK_AT=ebreak 且还没分叉
+extern VM_LOCAL int vmctl_exit_code;
+extern VM_LOCAL uint64_t vmctl_marker_value; // 最近一次写 MARKER 的值
+extern VM_LOCAL uint32_t vmctl_input_len;
+
+struct UARTDevice;
+int vmfork_init(const char *nclones_spec, struct UARTDevice *uart);
+int vmfork_run(void);
+uint64_t vmctl_read(void *opaque, uint64_t offset, unsigned size);
+void vmctl_write(void *opaque, uint64_t offset, uint64_t value, unsigned size);
+
+// 返回 -1 表示继续运行客户机（没有分叉，或者在子进程里）；
+// 父进程等完所有克隆后返回汇总的退出状态，调用方据此结束模拟
+static inline int vmfork_poll(void) {
+    if (__builtin_expect(vmfork_pending, 0)) return vmfork_run();
+    return -1;
+}
+
+#endif
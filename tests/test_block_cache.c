@@ -0,0 +1,100 @@
+// test_block_cache.c
+// 块缓存：批量回写进行中，同一块被淘汰后立刻重新读入，读到的必须是最后写入的内容。
+//
+// 每轮：写一批块号比 X 小、互不相邻的块和块 X，让回写线程开始一次 block_cache_flush。
+// 主线程先拿着磁盘的 lock，回写拷完脏块、拿到 io_lock 后就卡在第一次 disk_image_write 上，
+// 这时放开磁盘，读同组的其他块把 X 挤出去，再重新读 X（回写按块号排序，X 排在最后）。
+// 如果回写一拷走 X 就把它当成干净的，淘汰时不写出，重新读入拿到的就是磁盘上的旧数据。
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+
+#include "block_cache.h"
+#include "disk_image.h"
+
+#define ITERATIONS  500
+#define DISK_BLOCKS (BLK_CACHE_SETS * (BLK_CACHE_WAYS + 2))
+#define TARGET      (DISK_BLOCKS - 1)   // 块 X，同组的其他块都在它前面
+#define FILLER_STEP 2
+
+static BlockCache *bc;
+static int go;          // 主线程置 1 让回写线程做一次 flush，做完清 0；-1 表示退出
+
+static void *flusher(void *arg) {
+    (void)arg;
+    for (;;) {
+        int g = __atomic_load_n(&go, __ATOMIC_ACQUIRE);
+        if (g < 0) break;
+        if (g == 0) {
+            sched_yield();
+            continue;
+        }
+        block_cache_flush(bc);
+        __atomic_store_n(&go, 0, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+int main(void) {
+    char base[] = "/tmp/rvemu-bc-XXXXXX";
+    int fd = mkstemp(base);
+    if (fd < 0 || ftruncate(fd, (off_t)DISK_BLOCKS * BSIZE) < 0) {
+        perror("test disk");
+        return 1;
+    }
+    close(fd);
+    // overlay 模式：写出走 pwrite，窗口比 raw 模式的 memcpy 宽
+    char overlay[sizeof(base) + 4];
+    snprintf(overlay, sizeof(overlay), "%s.cow", base);
+
+    DiskImage *disk = disk_image_open(base, overlay);
+    if (!disk) return 1;
+    bc = block_cache_create(disk, 0);
+
+    pthread_t th;
+    pthread_create(&th, NULL, flusher, NULL);
+
+    uint8_t buf[BSIZE], got[BSIZE];
+    int failures = 0;
+    for (uint32_t v = 1; v <= ITERATIONS && !failures; v++) {
+        memset(buf, 0, sizeof(buf));
+        memcpy(buf, &v, sizeof(v));
+        for (uint64_t b = 0; b < TARGET; b += FILLER_STEP)
+            if (b % BLK_CACHE_SETS != TARGET % BLK_CACHE_SETS)
+                block_cache_write(bc, b * BSIZE, buf, BSIZE);
+        block_cache_write(bc, (uint64_t)TARGET * BSIZE, buf, BSIZE);
+
+        // 开始一次回写，等它拷完脏块、拿着 io_lock 停在磁盘的 lock 上
+        pthread_mutex_lock(&disk->lock);
+        __atomic_store_n(&go, 1, __ATOMIC_RELEASE);
+        while (pthread_mutex_trylock(&bc->io_lock) == 0) {
+            pthread_mutex_unlock(&bc->io_lock);
+            sched_yield();
+        }
+        pthread_mutex_unlock(&disk->lock);
+
+        // 同组的 BLK_CACHE_WAYS 个其他块把 X 挤出去，再读回 X
+        for (int w = 1; w <= BLK_CACHE_WAYS; w++)
+            block_cache_read(bc, (uint64_t)(TARGET - w * BLK_CACHE_SETS) * BSIZE, got, BSIZE);
+        block_cache_read(bc, (uint64_t)TARGET * BSIZE, got, BSIZE);
+        uint32_t seen;
+        memcpy(&seen, got, sizeof(seen));
+        if (seen != v) {
+            fprintf(stderr, "iteration %u: read back %u (stale)\n", v, seen);
+            failures++;
+        }
+        while (__atomic_load_n(&go, __ATOMIC_ACQUIRE) == 1) sched_yield();
+    }
+
+    __atomic_store_n(&go, -1, __ATOMIC_RELEASE);
+    pthread_join(th, NULL);
+    block_cache_destroy(bc);
+    disk_image_close(disk);
+    unlink(overlay);
+    unlink(base);
+    if (failures) return 1;
+    printf("block cache flush/evict race: %d iterations OK\n", ITERATIONS);
+    return 0;
+}